@@ -5,6 +5,10 @@
 //  Created by Antony Searle on 22/6/2024.
 //
 
+#include <chrono>
+#include <string>
+#include <vector>
+
 #include "HeapString.hpp"
 
 #include "test.hpp"
@@ -12,11 +16,10 @@
 namespace wry {
     
     HeapString::~HeapString() {
-        printf("%p:%s\n", this, __PRETTY_FUNCTION__);
     }
 
     const HeapString* HeapString::make(std::string_view view) {
-        return make(std::hash<std::string_view>()(view), view);
+        return make(heap_string_hash(view), view);
     }
 
     std::string_view HeapString::as_string_view() const {
@@ -36,15 +39,13 @@ namespace wry {
 
     Term HeapString::_term_eq(Term right) const {
         // term_eq has already confirmed right is OBJECT-tagged with a
-        // different pointer.  Cross-subtype is ERROR; same subtype
-        // compares the cached hash first (cheap negative), then bytes.
+        // different pointer.  Cross-subtype is ERROR; same subtype is
+        // interned, so a different pointer is different bytes.
         HeapTerm* p = _term_as_object(right);
         if (!p || p->_save_type_tag() != HeapString::SAVE_TYPE_TAG)
             return term_make_error();
-        const HeapString* o = static_cast<const HeapString*>(p);
-        if (_hash != o->_hash) return term_make_false();
-        if (_size != o->_size) return term_make_false();
-        return term_make_boolean_with(std::memcmp(_bytes, o->_bytes, _size) == 0);
+        assert(as_string_view() != static_cast<const HeapString*>(p)->as_string_view());
+        return term_make_false();
     }
 
     Term HeapString::_term_less(Term right) const {
@@ -63,27 +64,12 @@ namespace wry {
         // a SMALL_INTEGER (narrowed to 60 bits to fit inline).
         return term_make_integer_with((int64_t)(_hash >> 4));
     }
-//
-//    HeapString const* HeapString::make(std::size_t hc, std::string_view view) {
-//        void* a = malloc(sizeof(HeapString) + view.size());
-//        HeapString* b = new(a) HeapString;
-//        b->_hash = hc;
-//        b->_size = view.size();
-//        std::memcpy(b->_bytes, view.data(), view.size());
-//        return b;
-//    }
-//
-//
-//    HeapString const* HeapString::make(std::string_view view) {
-//        return make(hash_combine(view.data(), view.size()), view);
-//    }
-
-
 
     const HeapString* HeapString::make(size_t hash, std::string_view view) {
-        // TODO(ctrie.md Phase 3): intern via the global string ctrie.  For
-        // now (Phase 0) we allocate a fresh HeapString every call; the trie
-        // machinery exists but is not yet on the production allocation path.
+        return _heap_string_ctrie_mutator_find_upgrade_or_emplace(hash, view);
+    }
+
+    const HeapString* HeapString::_make_uninterned(size_t hash, std::string_view view) {
         size_t n = view.size();
         size_t bytes = sizeof(HeapString) + n;
         void* raw = GarbageCollected::operator new(bytes);
@@ -92,13 +78,9 @@ namespace wry {
         a->_hash = hash;
         a->_size = n;
         std::memcpy(a->_bytes, view.data(), n);
-        printf("%p:%s\n", a, __PRETTY_FUNCTION__);
         return a;
     }
 
-
-
-
     define_test("[string interning]") {
 
         bool a_emplaced = false;
@@ -129,6 +111,67 @@ namespace wry {
         // free-quarantine.
         assert(c_emplaced);
 
+        // Through the production factory: one object per content, with the
+        // interned hash
+        {
+            HeapString const* e = HeapString::make("interned string");
+            HeapString const* f = HeapString::make(std::string("interned ") + "string");
+            HeapString const* g = HeapString::make("another string");
+            assert(e == f);
+            assert(e != g);
+            assert(e->_hash == heap_string_hash("interned string"));
+        }
+
+        co_return;
+    };
+
+    namespace {
+
+        // Keeps the timed loops live under NDEBUG
+        constinit Atomic<std::size_t> heap_string_sink{0};
+
+    } // anonymous namespace
+
+    // Intern throughput under concurrent load.  Workers draw from a shared
+    // vocabulary, so most calls hit a live string, as names and mnemonics
+    // do; the baseline is the uninterned allocation interning replaces.
+    define_test("[string interning] throughput") {
+
+        std::vector<std::string> vocabulary;
+        for (int i = 0; i != 1 << 10; ++i)
+            vocabulary.push_back("vocabulary_word_" + std::to_string(i));
+
+        constexpr int WORKERS = 16;
+        constexpr int PER_WORKER = 1 << 14;
+        printf("intern throughput, %d workers x %d strings (ns per string)\n", WORKERS, PER_WORKER);
+        printf("%12s %12s\n", "uninterned", "interned");
+        double seconds[2] = {};
+        for (int interned = 0; interned != 2; ++interned) {
+            auto t0 = std::chrono::steady_clock::now();
+            Coroutine::Nursery nursery;
+            for (int w = 0; w != WORKERS; ++w) {
+                co_await nursery.fork([](std::vector<std::string> const& vocabulary, int w, bool interned) -> Coroutine::Future<> {
+                    std::size_t check = 0;
+                    for (int i = 0; i != PER_WORKER; ++i) {
+                        std::string_view view = vocabulary[(i * 7 + w) % vocabulary.size()];
+                        std::size_t hash = heap_string_hash(view);
+                        HeapString const* p = (interned
+                                               ? HeapString::make(hash, view)
+                                               : HeapString::_make_uninterned(hash, view));
+                        check += p->_size;
+                    }
+                    heap_string_sink.fetch_add_relaxed(check);
+                    co_return;
+                }(vocabulary, w, interned));
+            }
+            co_await nursery.join();
+            auto t1 = std::chrono::steady_clock::now();
+            seconds[interned] = std::chrono::duration<double>(t1 - t0).count();
+        }
+        printf("%12.1f %12.1f\n",
+               seconds[0] * 1e9 / (WORKERS * PER_WORKER),
+               seconds[1] * 1e9 / (WORKERS * PER_WORKER));
+
         co_return;
     };
 
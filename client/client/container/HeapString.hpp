@@ -23,9 +23,15 @@ namespace wry {
 
         static void* operator new(std::size_t, void* ptr) noexcept { return ptr; }
 
+        // Interned: equal bytes give the same HeapString, for as long as
+        // anything holds it strongly.  `hash` must be heap_string_hash(view).
         static const HeapString* make(std::size_t hash, std::string_view view);
         static const HeapString* make(std::string_view view);
 
+        // A fresh, uninterned allocation; only the intern dictionary should
+        // call this
+        static const HeapString* _make_uninterned(std::size_t hash, std::string_view view);
+
         size_t _hash;
         size_t _size;
         char _bytes[] __counted_by(_size);
@@ -38,9 +44,9 @@ namespace wry {
         virtual void _garbage_collected_scan() const override final;
         virtual void _garbage_collected_debug() const override final;
 
-        // Content equality / ordering / hash.  Two HeapStrings with the
-        // same bytes compare equal and hash equal even though they may
-        // sit at different addresses (interning is unwired in production).
+        // Equality is identity: HeapStrings are interned, so distinct
+        // addresses hold distinct bytes.  Ordering is by content.  The hash
+        // is computed once, at interning.
         virtual Term _term_eq(Term right) const override final;
         virtual Term _term_less(Term right) const override final;
         virtual Term _term_hash() const override final;
@@ -54,6 +60,10 @@ namespace wry {
         return a->_hash;
     }
 
+    inline size_t heap_string_hash(std::string_view view) {
+        return wry::hash_combine(view.data(), view.size());
+    }
+
 //    template<size_t N> requires (N > 0)
 //    constexpr Term::Term(const char (&ntbs)[N]) {
 //        const size_t M = N - 1;
@@ -101,7 +111,7 @@ namespace wry {
 
     struct std_string_Hasher {
         std::size_t operator()(std::string const& x) const {
-            return wry::hash_combine(x.data(), x.size());
+            return heap_string_hash(x);
         }
     };
 
@@ -123,24 +133,32 @@ namespace wry {
     // fresh string (true) or upgraded an existing holder (false).  The alter
     // lambda may run several times racing other mutators; the invocation
     // whose CAS wins runs last, so the flag ends with the effective path.
-    inline HeapString const* _heap_string_ctrie_mutator_find_upgrade_or_emplace(std::string s,
+    inline HeapString const* _heap_string_ctrie_mutator_find_upgrade_or_emplace(std::size_t hash,
+                                                                                std::string_view view,
                                                                                 bool* did_emplace = nullptr) {
+        assert(hash == heap_string_hash(view));
         WeakDict* t = heap_string_weak_dictionary();
-        auto [before, after] = t->alter(s, [&s, did_emplace](std::optional<WeakHolder<HeapString> const*> before) {
+        std::string s{view};
+        // Fast path: a live holder upgrades without writing the trie
+        if (std::optional<WeakHolder<HeapString> const*> before = t->find(s, hash)) {
+            if (HeapString const* p = before.value()->mutator_try_upgrade()) {
+                if (did_emplace)
+                    *did_emplace = false;
+                return p;
+            }
+        }
+        auto [before, after] = t->alter(s, hash, [hash, view, did_emplace](std::optional<WeakHolder<HeapString> const*> before) {
             if (before.has_value()) {
                 // It does exist, try to get permission:
                 if (before.value()->mutator_try_upgrade()) {
-                    printf("%p:HeapString: mutator upgraded\n", before.value()->_weak);
                     if (did_emplace)
                         *did_emplace = false;
                     return WeakDict::AlterChoice::keep();
                 }
-                printf("%p:HeapString: mutator upgrade failed\n", before.value()->_weak);
                 // On this path, _weak is GONE and may already be invalid
             }
             // Compete to install a new string
-            HeapString const* nhs = HeapString::make(s);
-            printf("%p:HeapString: mutator tries to install\n", nhs);
+            HeapString const* nhs = HeapString::_make_uninterned(hash, view);
             WeakHolder<HeapString> const* nwh = new WeakHolder<HeapString>{nhs};
             if (did_emplace)
                 *did_emplace = true;
@@ -149,17 +167,21 @@ namespace wry {
         return (*after)->_weak;
     }
 
+    inline HeapString const* _heap_string_ctrie_mutator_find_upgrade_or_emplace(std::string_view view,
+                                                                                bool* did_emplace = nullptr) {
+        return _heap_string_ctrie_mutator_find_upgrade_or_emplace(heap_string_hash(view), view, did_emplace);
+    }
+
     inline void _heap_string_ctrie_collector_try_erase(WeakHolder<HeapString> const* victim) {
         WeakDict* t = heap_string_weak_dictionary();
         // The collector is in charge of killing the string, so it knows it is
         // still alive, so we can get the key out of it
         std::string s{victim->_weak->as_string_view()};
-        (void) t->alter(s, [victim, &s](std::optional<WeakHolder<HeapString> const*> before) {
+        (void) t->alter(s, victim->_weak->_hash, [victim](std::optional<WeakHolder<HeapString> const*> before) {
             if (before.has_value() && before.value() == victim) {
-                printf("HeapString: collector erases\n");
                 return WeakDict::AlterChoice::erase();
             } else {
-                printf("HeapString: collector found replacement\n");
+                // A mutator already replaced us
                 return WeakDict::AlterChoice::keep();
             }
         });
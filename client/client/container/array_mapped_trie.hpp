@@ -11,27 +11,73 @@
 #include <algorithm>
 #include <memory>
 #include <optional>
+#include <variant>
 #include <vector>
 
 #include "compressed_array.hpp"
 #include "garbage_collected.hpp"
 #include "variant.hpp"
 #include "coroutine.hpp"
+#include "task_trace.hpp"
 #include "bit.hpp"
 #include "stdint.hpp"
 
 
 namespace wry {
 
+    // The structural set operations of ArrayMappedTrie::set_operation
+    enum ArrayMappedTrieSetOperation {
+        AMT_UNION,
+        AMT_INTERSECTION,
+        AMT_DIFFERENCE,
+        AMT_SYMMETRIC_DIFFERENCE,
+    };
+
+    // The per-node cache of an augmented ArrayMappedTrie: the subtree's
+    // entry count and the fold of its entries under the Augment monoid,
+    // which supplies
+    //
+    //     using value_type = S;
+    //     static S identity();
+    //     static S leaf(Word key, T const& value);
+    //     static S combine(S const& left, S const& right);
+    //
+    // with combine associative; it is applied in key order, so need not
+    // commute.  S is plain data: it is not scanned by the collector.
+    template<typename Augment>
+    struct ArrayMappedTrieAugment {
+        size_t size = 0;
+        typename Augment::value_type summary = Augment::identity();
+    };
+
+    // Unaugmented: no storage, no maintenance
+    template<>
+    struct ArrayMappedTrieAugment<void> {
+    };
+
+    // The trivial monoid, for rank, select and counting alone
+    struct ArrayMappedTrieCounted {
+        using value_type = std::monostate;
+        static std::monostate identity() { return {}; }
+        static std::monostate leaf(auto&&, auto&&) { return {}; }
+        static std::monostate combine(std::monostate, std::monostate) { return {}; }
+    };
+
     // A radix trie over a fixed-width unsigned Word, branching SYMBOL_WIDTH
     // bits at a time.  Key-first to match the project's container convention.
     // Bitmap is derived (one presence bit per child slot), not a free knob;
     // SYMBOL_WIDTH defaults to 5 (32-way nodes).
+    //
+    // Augment, if not void, caches a monoid over the entries in every node
+    // (see ArrayMappedTrieAugment), recomputed from the node's children or
+    // values wherever a node is built, which gives O(depth) count_in_range,
+    // rank, select and fold_range.  Unaugmented tries pay nothing.
     template<
     typename Word,
     typename T,
     typename Discipline,
-    int SYMBOL_WIDTH = 5>
+    int SYMBOL_WIDTH = 5,
+    typename Augment = void>
     struct ArrayMappedTrie : Discipline::IntrusiveAllocator {
 
         using Bitmap = unsigned_integer_of_bit_width_t<((std::size_t)1 << SYMBOL_WIDTH)>;
@@ -42,6 +88,8 @@ namespace wry {
         static constexpr bool _is_set = std::is_empty_v<T>;
         static constexpr size_t _leaf_item_bytes = _is_set ? 0 : sizeof(T);
 
+        static constexpr bool _is_augmented = !std::is_void_v<Augment>;
+
         static constexpr size_t WORD_WIDTH = sizeof(Word) * CHAR_BIT;
         static constexpr size_t BITMAP_WIDTH = sizeof(Bitmap) * CHAR_BIT;
 
@@ -97,6 +145,7 @@ namespace wry {
         size_t _debug_capacity;
         size_t _debug_count;
 #endif
+        [[no_unique_address]] ArrayMappedTrieAugment<Augment> _augment;
         Bitmap _bitmap; // bitmap of which items are present
         union {
             // compressed flexible member array of children or values
@@ -255,6 +304,7 @@ namespace wry {
                                                                        count,
                                                                        bitmap);
             if constexpr (!_is_set) new_node->_values[0] = std::move(value);
+            new_node->_recompute_augment();
             return new_node;
         }
 
@@ -400,6 +450,7 @@ namespace wry {
                                         c->_values,
                                         resolver);
             }
+            c->_recompute_augment();
             return c;
         } // merge(a, b, f)
 
@@ -494,6 +545,7 @@ namespace wry {
                                               new_node->_children,
                                               get_index_for_key(key),
                                               new_child);
+            new_node->_recompute_augment();
             return new_node;
         }
 
@@ -506,21 +558,23 @@ namespace wry {
                                                        new_node->_children,
                                                        get_index_for_key(key),
                                                        new_child);
+            new_node->_recompute_augment();
             return new_node;
         }
 
         [[nodiscard]] ArrayMappedTrie* _Nonnull clone_and_erase_child_containing_key(Word key) const {
             assert(has_children());
+            assert(bitmap_includes_key(key));
             ArrayMappedTrie* new_node = clone_with_capacity(popcount(_bitmap));
             [[maybe_unused]] ArrayMappedTrie const* _ = nullptr;
-            bool did_erase = compressed_array_erase_for_index(new_node->_bitmap,
-                                                              new_node->_children,
-                                                              get_index_for_key(key),
-                                                              _);
-            assert(did_erase);
+            compressed_array_erase_for_index(new_node->_bitmap,
+                                             new_node->_children,
+                                             get_index_for_key(key),
+                                             _);
 #ifndef NDEBUG
             --(new_node->_debug_count);
 #endif
+            new_node->_recompute_augment();
             return new_node;
         }
 
@@ -568,16 +622,17 @@ namespace wry {
                                                                      new_child,
                                                                      _);
             }
+            new_node->_recompute_augment();
             return { new_node, leaf_did_assign };
         }
 
+        // The trie without key, sharing everything off the path to it; this
+        // itself if the key is absent.  Null if the key was the last entry.
         [[nodiscard]] std::pair<ArrayMappedTrie const* _Nullable, bool> clone_and_erase_key(Word key, T& victim) const {
-            // TODO: Do we handle all cases correctly?
-            // - Replacing a count one ArrayMappedTrie with nullptr
-            // - Replacing a count two ArrayMappedTrie with surviving child
             if (!prefix_includes_key(key) || !bitmap_includes_key(key))
                 // Word not present
                 return { this, false };
+            int count = std::popcount(_bitmap);
             int compressed_index = get_compressed_index_for_key(key);
             if (has_children()) {
                 const ArrayMappedTrie* _Nonnull child = _children[compressed_index];
@@ -586,21 +641,38 @@ namespace wry {
                 assert((new_child == child) == !did_erase);
                 if (!did_erase)
                     return { this, false };
-                return {
-                    clone_and_assign_child(new_child),
-                    true
-                };
+                if (new_child)
+                    return { clone_and_assign_child(new_child), true };
+                // Honour the ">= 2 children" invariant
+                if (count == 2)
+                    return { _children[1 - compressed_index], true };
+                return { clone_and_erase_child_containing_key(key), true };
             } else {
                 assert(has_values());
                 // we already established that bitmap_includes_key(key)
-                ArrayMappedTrie* _Nonnull new_node = clone();
-                // TODO: we allocate enough for the clone then erase one
+                if (count == 1) {
+                    if constexpr (!_is_set)
+                        victim = _values[0];
+                    return { nullptr, true };
+                }
                 int index = get_index_for_key(key);
-                compressed_array_erase_for_index(new_node->_bitmap,
-                                                 new_node->_values,
-                                                 index,
-                                                 victim);
-                return { new_node, true };
+                if constexpr (_is_set) {
+                    ArrayMappedTrie* _Nonnull new_node = make(_prefix, 0, count - 1, count - 1,
+                                                              _bitmap & ~bitmask_for_index<Bitmap>(index));
+                    new_node->_recompute_augment();
+                    return { new_node, true };
+                } else {
+                    ArrayMappedTrie* _Nonnull new_node = clone();
+                    compressed_array_erase_for_index(new_node->_bitmap,
+                                                     new_node->_values,
+                                                     index,
+                                                     victim);
+#ifndef NDEBUG
+                    --(new_node->_debug_count);
+#endif
+                    new_node->_recompute_augment();
+                    return { new_node, true };
+                }
             }
         }
 
@@ -619,12 +691,36 @@ namespace wry {
             }
         }
 
+        // Estimated number of entries, from the fanout along the leftmost
+        // path; exact for a uniformly full trie, and O(depth) for any
+        size_t _estimated_size() const {
+            size_t n = 1;
+            const ArrayMappedTrie* node = this;
+            for (;;) {
+                n *= std::popcount(node->_bitmap);
+                if (node->has_values())
+                    return n;
+                node = node->_children[0];
+            }
+        }
+
+        // Forks children only while the work queue is hungry for them, and
+        // visits small subtrees sequentially; see global_work_queue.hpp
         Coroutine::Task coroutine_parallel_for_each(auto&& action) const {
             if (has_children()) {
+                if (_estimated_size() < global_work_queue_sequential_cutoff()) {
+                    for_each(action);
+                    co_return;
+                }
                 int n = std::popcount(_bitmap);
                 Coroutine::Nursery nursery;
-                for (int i = 0; i != n; ++i)
-                    co_await nursery.fork(_children[i]->coroutine_parallel_for_each(action));
+                for (int i = 0; i != n; ++i) {
+                    const ArrayMappedTrie* child = _children[i];
+                    if (global_work_queue_should_fork(child->_estimated_size()))
+                        co_await nursery.fork(child->coroutine_parallel_for_each(action));
+                    else
+                        co_await child->coroutine_parallel_for_each(action);
+                }
                 co_await nursery.join();
             } else {
                 Bitmap b = _bitmap;
@@ -684,6 +780,120 @@ namespace wry {
 
 
 
+        // ---- Augmented queries -------------------------------------------
+        //
+        // Ranges are of keys, inclusive at both ends so that they can reach
+        // the top of the Word.  A node wholly inside the range answers from
+        // its cache and one wholly outside is skipped, so only the nodes on
+        // the paths to the two ends are opened: O(depth) nodes, each a scan
+        // of at most 2^SYMBOL_WIDTH cached children.
+
+        // The least and greatest keys the node's prefix admits
+        Word _key_range_front() const {
+            return _prefix;
+        }
+
+        Word _key_range_back() const {
+            return _prefix | ~get_prefix_mask();
+        }
+
+        // The leaf slots whose keys lie in [lo, hi]
+        Bitmap _leaf_select_for_range(Word lo, Word hi) const {
+            assert(has_values());
+            int a = (lo > _prefix) ? (int)(lo - _prefix) : 0;
+            int b = (hi < _key_range_back()) ? (int)(hi - _prefix) : (int)INDEX_MASK;
+            return (Bitmap)((Bitmap)~(Bitmap)0 >> (BITMAP_WIDTH - 1 - (b - a))) << a;
+        }
+
+        // The fold of the leaf's entries in `select`
+        auto _fold_leaf(Bitmap select) const {
+            static_assert(_is_augmented);
+            assert(has_values());
+            typename Augment::value_type result = Augment::identity();
+            Bitmap b = _bitmap;
+            for (int i = 0; b != 0; ++i, (b &= (b-1))) {
+                int j = bit::ctz(b);
+                if (!((select >> j) & 1))
+                    continue;
+                Word key = _prefix | (Word)j;
+                if constexpr (_is_set)
+                    result = Augment::combine(result, Augment::leaf(key, T{}));
+                else
+                    result = Augment::combine(result, Augment::leaf(key, _values[i]));
+            }
+            return result;
+        }
+
+        [[nodiscard]] size_t size() const {
+            static_assert(_is_augmented);
+            return _augment.size;
+        }
+
+        [[nodiscard]] auto const& summary() const {
+            static_assert(_is_augmented);
+            return _augment.summary;
+        }
+
+        // The number of entries with keys in [lo, hi]
+        [[nodiscard]] size_t count_in_range(Word lo, Word hi) const {
+            static_assert(_is_augmented);
+            if ((hi < lo) || (hi < _key_range_front()) || (_key_range_back() < lo))
+                return 0;
+            if ((lo <= _key_range_front()) && (_key_range_back() <= hi))
+                return _augment.size;
+            if (has_values())
+                return std::popcount((Bitmap)(_bitmap & _leaf_select_for_range(lo, hi)));
+            size_t n = 0;
+            int count = std::popcount(_bitmap);
+            for (int i = 0; i != count; ++i)
+                n += _children[i]->count_in_range(lo, hi);
+            return n;
+        }
+
+        // The fold of the entries with keys in [lo, hi], in key order
+        [[nodiscard]] auto fold_range(Word lo, Word hi) const {
+            static_assert(_is_augmented);
+            if ((hi < lo) || (hi < _key_range_front()) || (_key_range_back() < lo))
+                return Augment::identity();
+            if ((lo <= _key_range_front()) && (_key_range_back() <= hi))
+                return _augment.summary;
+            if (has_values())
+                return _fold_leaf(_leaf_select_for_range(lo, hi));
+            typename Augment::value_type result = Augment::identity();
+            int count = std::popcount(_bitmap);
+            for (int i = 0; i != count; ++i)
+                result = Augment::combine(result, _children[i]->fold_range(lo, hi));
+            return result;
+        }
+
+        // The number of entries with keys less than `key`
+        [[nodiscard]] size_t rank(Word key) const {
+            return key ? count_in_range(0, key - 1) : 0;
+        }
+
+        // The entry of rank k.  Precondition: k < size()
+        [[nodiscard]] std::conditional_t<_is_set, Word, std::pair<Word, T>>
+        select(size_t k) const {
+            static_assert(_is_augmented);
+            assert(k < _augment.size);
+            const ArrayMappedTrie* node = this;
+            while (node->has_children()) {
+                const ArrayMappedTrie* const* child = node->_children;
+                for (; k >= (*child)->_augment.size; ++child)
+                    k -= (*child)->_augment.size;
+                node = *child;
+            }
+            Bitmap b = node->_bitmap;
+            for (size_t i = 0; i != k; ++i)
+                b &= (b - 1);
+            Word key = node->_prefix | (Word)bit::ctz(b);
+            if constexpr (_is_set) {
+                return key;
+            } else {
+                return { key, node->_values[k] };
+            }
+        }
+
         // ---- Parallel rebuild (Stage 1) ----------------------------------
         //
         // Rebuild `source` (which may be null) by applying, for each modifier
@@ -698,6 +908,11 @@ namespace wry {
         // Parallel over the trie via a Nursery; a subtree with no modifier key
         // in its range is returned by pointer, unchanged (the dominant saving).
         // Frozen-phase only: `source` must stay immutable for the call.
+        //
+        // Granularity is adaptive: a slice below the work queue's sequential
+        // cutoff is rebuilt by the same co-recursion as plain calls, and
+        // above it each child is forked only if the pool is hungry, and
+        // otherwise awaited in place.  See global_work_queue.hpp.
 
         template<typename Action, typename Combine>
         [[nodiscard]] static const ArrayMappedTrie* _Nullable
@@ -725,24 +940,53 @@ namespace wry {
             return acc;
         }
 
-        template<typename Action, typename Combine>
-        [[nodiscard]] static Coroutine::Future<const ArrayMappedTrie*>
-        _rebuild_inrange(const ArrayMappedTrie* source, // internal; mods in range; a<b
-                         const std::vector<std::pair<Word, Action>>& mods,
-                         size_t a, size_t b,
-                         const Combine& combine) {
+        // One child's share of the modifiers; `child` is null where the
+        // modifiers create a new child
+        struct _RebuildWork {
+            const ArrayMappedTrie* _Nullable child;
+            size_t lo, hi;
+        };
+
+        // Split [i, j) into the part [a, b) inside `source`'s prefix range
+        // and the disjoint parts to either side.
+        template<typename Action>
+        [[nodiscard]] static std::pair<size_t, size_t>
+        _rebuild_bounds(const ArrayMappedTrie* _Nonnull source,
+                        const std::vector<std::pair<Word, Action>>& mods,
+                        size_t i, size_t j) {
             const int sh = source->_shift;
             const Word prefix = source->_prefix;
+            auto lb = [&](size_t lo, size_t hi, Word bound) -> size_t {
+                return (size_t)(std::lower_bound(
+                    mods.begin() + lo, mods.begin() + hi, bound,
+                    [](const std::pair<Word, Action>& e, Word v) { return e.first < v; })
+                    - mods.begin());
+            };
+            size_t a = lb(i, j, prefix);
+            size_t b;
+            if ((size_t)sh + (size_t)SYMBOL_WIDTH >= WORD_WIDTH) {
+                b = j;                                         // node reaches the top of the word
+            } else {
+                Word upper = prefix + ((Word)1 << (sh + SYMBOL_WIDTH));
+                b = (upper <= prefix) ? j : lb(a, j, upper);   // upper<=prefix => it wrapped
+            }
+            return {a, b};
+        }
+
+        // Merge-walk the source's children (in index order) against runs of
+        // modifier keys grouped by their index at this level.  Deriving the
+        // index straight from the key avoids any (c+1)<<sh overflow.
+        template<typename Action>
+        [[nodiscard]] static std::vector<_RebuildWork>
+        _rebuild_partition(const ArrayMappedTrie* _Nonnull source, // internal; mods in range; a<b
+                           const std::vector<std::pair<Word, Action>>& mods,
+                           size_t a, size_t b) {
+            const int sh = source->_shift;
             const int nchild = std::popcount(source->_bitmap);
             auto index_of = [sh](Word key) -> int {
                 return (int)((key >> sh) & INDEX_MASK);
             };
-
-            // Merge-walk the source's children (in index order) against runs of
-            // modifier keys grouped by their index at this level.  Deriving the
-            // index straight from the key avoids any (c+1)<<sh overflow.
-            struct Work { const ArrayMappedTrie* child; size_t lo, hi; };
-            std::vector<Work> work;
+            std::vector<_RebuildWork> work;
             size_t p = a;
             int kc = 0;
             while (p < b || kc < nchild) {
@@ -758,34 +1002,95 @@ namespace wry {
                     child = source->_children[kc];
                     ++kc;
                 }
-                work.push_back(Work{child, p, q});
+                work.push_back(_RebuildWork{child, p, q});
                 p = q;
             }
+            return work;
+        }
 
-            std::vector<const ArrayMappedTrie*> outs(work.size(), nullptr);
-            {
-                Coroutine::Nursery nursery;
-                for (size_t t = 0; t != work.size(); ++t)
-                    co_await nursery.fork(outs[t],
-                        coroutine_parallel_rebuild(work[t].child, mods,
-                                                   work[t].lo, work[t].hi, combine));
-                co_await nursery.join();
-            }
-
-            // Assemble the surviving disjoint children (already in index order),
-            // collapsing to honour the ">= 2 children" invariant.
+        // Assemble the surviving disjoint children (already in index order),
+        // collapsing to honour the ">= 2 children" invariant.
+        [[nodiscard]] static const ArrayMappedTrie* _Nullable
+        _assemble(Word prefix, int sh,
+                  const ArrayMappedTrie* _Nullable const* outs, size_t n) {
             int nz = 0;
             const ArrayMappedTrie* only = nullptr;
-            for (const ArrayMappedTrie* c : outs)
-                if (c) { ++nz; only = c; }
+            for (size_t k = 0; k != n; ++k)
+                if (outs[k]) { ++nz; only = outs[k]; }
             if (nz == 0)
-                co_return nullptr;
+                return nullptr;
             if (nz == 1)
-                co_return only;
+                return only;
             ArrayMappedTrie* node = make(prefix, sh, nz, 0, 0);
-            for (const ArrayMappedTrie* c : outs)
-                if (c) node->insert_child(c);
-            co_return node;
+            for (size_t k = 0; k != n; ++k)
+                if (outs[k]) node->insert_child(outs[k]);
+            node->_recompute_augment();
+            return node;
+        }
+
+        [[nodiscard]] static const ArrayMappedTrie* _Nullable
+        _rebuild_assemble(Word prefix, int sh,
+                          const std::vector<const ArrayMappedTrie*>& outs) {
+            return _assemble(prefix, sh, outs.data(), outs.size());
+        }
+
+        // The co-recursion without coroutines, for slices too small to be
+        // worth forking
+        template<typename Action, typename Combine>
+        [[nodiscard]] static const ArrayMappedTrie* _Nullable
+        rebuild_sequential(const ArrayMappedTrie* _Nullable source,
+                           const std::vector<std::pair<Word, Action>>& mods,
+                           size_t i, size_t j,
+                           const Combine& combine) {
+            if (i == j)
+                return source;                                 // share, no mods
+            if (!source || source->has_values() || (j - i) < 2)
+                return rebuild_serial(source, mods, i, j, combine);
+            auto [a, b] = _rebuild_bounds(source, mods, i, j);
+            const ArrayMappedTrie* result = source;
+            if (a != b) {
+                std::vector<_RebuildWork> work = _rebuild_partition(source, mods, a, b);
+                std::vector<const ArrayMappedTrie*> outs(work.size(), nullptr);
+                for (size_t t = 0; t != work.size(); ++t)
+                    outs[t] = rebuild_sequential(work[t].child, mods,
+                                                 work[t].lo, work[t].hi, combine);
+                result = _rebuild_assemble(source->_prefix, source->_shift, outs);
+            }
+            if (a > i)
+                result = merge(rebuild_serial(nullptr, mods, i, a, combine), result);
+            if (j > b)
+                result = merge(result, rebuild_serial(nullptr, mods, b, j, combine));
+            return result;
+        }
+
+        template<typename Action, typename Combine>
+        [[nodiscard]] static Coroutine::Future<const ArrayMappedTrie*>
+        _rebuild_inrange(const ArrayMappedTrie* source, // internal; mods in range; a<b
+                         const std::vector<std::pair<Word, Action>>& mods,
+                         size_t a, size_t b,
+                         const Combine& combine) {
+            std::vector<_RebuildWork> work = _rebuild_partition(source, mods, a, b);
+            std::vector<const ArrayMappedTrie*> outs(work.size(), nullptr);
+            {
+                Coroutine::Nursery nursery;
+                for (size_t t = 0; t != work.size(); ++t) {
+                    size_t n = work[t].hi - work[t].lo;
+                    if (global_work_queue_should_fork(n))
+                        co_await nursery.fork(outs[t],
+                            coroutine_parallel_rebuild(work[t].child, mods,
+                                                       work[t].lo, work[t].hi, combine));
+                    else if (n < global_work_queue_sequential_cutoff()) {
+                        TaskTraceSpan span{"ArrayMappedTrie::rebuild_sequential", n};
+                        outs[t] = rebuild_sequential(work[t].child, mods,
+                                                     work[t].lo, work[t].hi, combine);
+                    }
+                    else
+                        outs[t] = co_await coroutine_parallel_rebuild(work[t].child, mods,
+                                                                      work[t].lo, work[t].hi, combine);
+                }
+                co_await nursery.join();
+            }
+            co_return _rebuild_assemble(source->_prefix, source->_shift, outs);
         }
 
         template<typename Action, typename Combine>
@@ -798,27 +1103,12 @@ namespace wry {
                 co_return source;                              // share, no mods
             if (!source || source->has_values() || (j - i) < 2)
                 co_return rebuild_serial(source, mods, i, j, combine);
-
-            const int sh = source->_shift;
-            const Word prefix = source->_prefix;
-            auto lb = [&](size_t lo, size_t hi, Word bound) -> size_t {
-                return (size_t)(std::lower_bound(
-                    mods.begin() + lo, mods.begin() + hi, bound,
-                    [](const std::pair<Word, Action>& e, Word v) { return e.first < v; })
-                    - mods.begin());
-            };
-
-            // Split mods into the part inside this node's prefix range [a, b)
-            // and the disjoint parts to either side.
-            size_t a = lb(i, j, prefix);
-            size_t b;
-            if ((size_t)sh + (size_t)SYMBOL_WIDTH >= WORD_WIDTH) {
-                b = j;                                         // node reaches the top of the word
-            } else {
-                Word upper = prefix + ((Word)1 << (sh + SYMBOL_WIDTH));
-                b = (upper <= prefix) ? j : lb(a, j, upper);   // upper<=prefix => it wrapped
+            if ((j - i) < global_work_queue_sequential_cutoff()) {
+                TaskTraceSpan span{"ArrayMappedTrie::rebuild_sequential", j - i};
+                co_return rebuild_sequential(source, mods, i, j, combine);
             }
 
+            auto [a, b] = _rebuild_bounds(source, mods, i, j);
             const ArrayMappedTrie* inside =
                 (a == b) ? source
                          : co_await _rebuild_inrange(source, mods, a, b, combine);
@@ -847,10 +1137,212 @@ namespace wry {
                                              /* bitmap */ 0);
             new_node->insert_child(a);
             new_node->insert_child(b);
+            new_node->_recompute_augment();
             return new_node;
         }
 
 
+        // Set algebra by simultaneous descent.  A subtree that only one
+        // operand reaches is kept or dropped whole, identical subtrees are
+        // resolved by pointer, and a node whose result equals an operand IS
+        // that operand; so the cost is proportional to the structure where
+        // the operands differ, not to their sizes, and the result shares
+        // everything else.  Sets only; the union of maps is merge() with a
+        // resolver.
+
+        // Cases decided without descending: an empty operand, the same
+        // operand, or disjoint prefixes
+        template<ArrayMappedTrieSetOperation OP>
+        [[nodiscard]] static bool
+        _set_operation_shallow(ArrayMappedTrie const* _Nullable a,
+                               ArrayMappedTrie const* _Nullable b,
+                               ArrayMappedTrie const* _Nullable& result) {
+            static_assert(_is_set);
+            if (a == b) {
+                result = (OP == AMT_UNION || OP == AMT_INTERSECTION) ? a : nullptr;
+                return true;
+            }
+            if (!a || !b || prefixes_are_disjoint(a, b)) {
+                if constexpr (OP == AMT_INTERSECTION)
+                    result = nullptr;
+                else if constexpr (OP == AMT_DIFFERENCE)
+                    result = a;
+                else
+                    result = !a ? b : !b ? a : merge_disjoint(a, b);
+                return true;
+            }
+            return false;
+        }
+
+        // Operands at different levels: the one with the larger shift, and
+        // its child in the slot that contains the other, if any
+        [[nodiscard]] static std::pair<ArrayMappedTrie const* _Nonnull, ArrayMappedTrie const* _Nullable>
+        _set_operation_slot(ArrayMappedTrie const* _Nonnull a,
+                            ArrayMappedTrie const* _Nonnull b) {
+            ArrayMappedTrie const* big = (a->_shift > b->_shift) ? a : b;
+            ArrayMappedTrie const* small = (big == a) ? b : a;
+            if (!big->bitmap_includes_key(small->_prefix))
+                return { big, nullptr };
+            return { big, big->_children[big->get_compressed_index_for_key(small->_prefix)] };
+        }
+
+        // Put the slot's outcome back: the rest of the larger operand is
+        // kept by union, symmetric difference and difference from it, and
+        // dropped by intersection and difference from the smaller
+        template<ArrayMappedTrieSetOperation OP>
+        [[nodiscard]] static ArrayMappedTrie const* _Nullable
+        _set_operation_reattach(ArrayMappedTrie const* _Nonnull a,
+                                ArrayMappedTrie const* _Nonnull b,
+                                ArrayMappedTrie const* _Nonnull big,
+                                ArrayMappedTrie const* _Nullable child,
+                                ArrayMappedTrie const* _Nullable result) {
+            if (!child) {
+                // the smaller operand meets nothing in the larger
+                if constexpr (OP == AMT_INTERSECTION)
+                    return nullptr;
+                else if constexpr (OP == AMT_DIFFERENCE)
+                    return a;
+                else
+                    return big->clone_and_insert_child(big == a ? b : a);
+            }
+            if ((OP == AMT_INTERSECTION) || (OP == AMT_DIFFERENCE && big == b))
+                return result;
+            if (result == child)
+                return big;
+            if (result)
+                return big->clone_and_assign_child(result);
+            if (std::popcount(big->_bitmap) == 2)
+                return big->_children[big->_children[0] == child ? 1 : 0];
+            return big->clone_and_erase_child_containing_key(child->_prefix);
+        }
+
+        template<ArrayMappedTrieSetOperation OP>
+        [[nodiscard]] static ArrayMappedTrie const* _Nullable
+        _set_operation_leaves(ArrayMappedTrie const* _Nonnull a,
+                              ArrayMappedTrie const* _Nonnull b) {
+            Bitmap c{};
+            switch (OP) {
+                case AMT_UNION: c = a->_bitmap | b->_bitmap; break;
+                case AMT_INTERSECTION: c = a->_bitmap & b->_bitmap; break;
+                case AMT_DIFFERENCE: c = a->_bitmap & ~b->_bitmap; break;
+                case AMT_SYMMETRIC_DIFFERENCE: c = a->_bitmap ^ b->_bitmap; break;
+            }
+            if (c == a->_bitmap)
+                return a;
+            if (c == b->_bitmap)
+                return b;
+            if (!c)
+                return nullptr;
+            int n = std::popcount(c);
+            ArrayMappedTrie* _Nonnull new_node = make(a->_prefix, 0, n, n, c);
+            new_node->_recompute_augment();
+            return new_node;
+        }
+
+        // Children of two branches with the same prefix and shift, paired by
+        // slot, in index order
+        [[nodiscard]] static int
+        _set_operation_pairs(ArrayMappedTrie const* _Nonnull a,
+                             ArrayMappedTrie const* _Nonnull b,
+                             ArrayMappedTrie const* _Nullable (*pairs)[2]) {
+            int n = 0;
+            for (Bitmap m = a->_bitmap | b->_bitmap; m; m &= (m - 1), ++n) {
+                Bitmap select = m & (Bitmap)(~m + 1);
+                Bitmap below = select - 1;
+                pairs[n][0] = (a->_bitmap & select)
+                    ? a->_children[std::popcount((Bitmap)(a->_bitmap & below))] : nullptr;
+                pairs[n][1] = (b->_bitmap & select)
+                    ? b->_children[std::popcount((Bitmap)(b->_bitmap & below))] : nullptr;
+            }
+            return n;
+        }
+
+        // Share an operand whose children all came through unchanged
+        [[nodiscard]] static ArrayMappedTrie const* _Nullable
+        _set_operation_assemble(ArrayMappedTrie const* _Nonnull a,
+                                ArrayMappedTrie const* _Nonnull b,
+                                ArrayMappedTrie const* _Nullable const (*pairs)[2],
+                                ArrayMappedTrie const* _Nullable const* outs,
+                                int n) {
+            bool is_a = true;
+            bool is_b = true;
+            for (int k = 0; k != n; ++k) {
+                is_a = is_a && (outs[k] == pairs[k][0]);
+                is_b = is_b && (outs[k] == pairs[k][1]);
+            }
+            if (is_a)
+                return a;
+            if (is_b)
+                return b;
+            return _assemble(a->_prefix, a->_shift, outs, n);
+        }
+
+        template<ArrayMappedTrieSetOperation OP>
+        [[nodiscard]] static ArrayMappedTrie const* _Nullable
+        set_operation(ArrayMappedTrie const* _Nullable a,
+                      ArrayMappedTrie const* _Nullable b) {
+            ArrayMappedTrie const* result = nullptr;
+            if (_set_operation_shallow<OP>(a, b, result))
+                return result;
+            if (a->_shift != b->_shift) {
+                auto [big, child] = _set_operation_slot(a, b);
+                if (child)
+                    result = (big == a) ? set_operation<OP>(child, b) : set_operation<OP>(a, child);
+                return _set_operation_reattach<OP>(a, b, big, child, result);
+            }
+            if (a->has_values())
+                return _set_operation_leaves<OP>(a, b);
+            ArrayMappedTrie const* pairs[(size_t)1 << SYMBOL_WIDTH][2];
+            ArrayMappedTrie const* outs[(size_t)1 << SYMBOL_WIDTH];
+            int n = _set_operation_pairs(a, b, pairs);
+            for (int k = 0; k != n; ++k)
+                outs[k] = set_operation<OP>(pairs[k][0], pairs[k][1]);
+            return _set_operation_assemble(a, b, pairs, outs, n);
+        }
+
+        // Forks slot pairs while the work queue is hungry for them, as
+        // coroutine_parallel_rebuild does
+        template<ArrayMappedTrieSetOperation OP>
+        [[nodiscard]] static Coroutine::Future<const ArrayMappedTrie*>
+        coroutine_parallel_set_operation(ArrayMappedTrie const* _Nullable a,
+                                         ArrayMappedTrie const* _Nullable b) {
+            ArrayMappedTrie const* result = nullptr;
+            if (_set_operation_shallow<OP>(a, b, result))
+                co_return result;
+            size_t n = a->_estimated_size() + b->_estimated_size();
+            if (n < global_work_queue_sequential_cutoff()) {
+                TaskTraceSpan span{"ArrayMappedTrie::set_operation", n};
+                co_return set_operation<OP>(a, b);
+            }
+            if (a->_shift != b->_shift) {
+                auto [big, child] = _set_operation_slot(a, b);
+                if (child && (big == a))
+                    result = co_await coroutine_parallel_set_operation<OP>(child, b);
+                else if (child)
+                    result = co_await coroutine_parallel_set_operation<OP>(a, child);
+                co_return _set_operation_reattach<OP>(a, b, big, child, result);
+            }
+            if (a->has_values())
+                co_return _set_operation_leaves<OP>(a, b);
+            ArrayMappedTrie const* pairs[(size_t)1 << SYMBOL_WIDTH][2];
+            ArrayMappedTrie const* outs[(size_t)1 << SYMBOL_WIDTH] = {};
+            int m = _set_operation_pairs(a, b, pairs);
+            {
+                Coroutine::Nursery nursery;
+                for (int k = 0; k != m; ++k) {
+                    size_t w = ((pairs[k][0] ? pairs[k][0]->_estimated_size() : 0)
+                                + (pairs[k][1] ? pairs[k][1]->_estimated_size() : 0));
+                    if (global_work_queue_should_fork(w))
+                        co_await nursery.fork(outs[k], coroutine_parallel_set_operation<OP>(pairs[k][0], pairs[k][1]));
+                    else
+                        outs[k] = co_await coroutine_parallel_set_operation<OP>(pairs[k][0], pairs[k][1]);
+                }
+                co_await nursery.join();
+            }
+            co_return _set_operation_assemble(a, b, pairs, outs, m);
+        }
+
+
         void _assert_invariant_shallow() const {
             assert(_bitmap);
             int count = popcount(_bitmap);
@@ -900,6 +1392,7 @@ namespace wry {
             ArrayMappedTrie* _Nonnull node = make(_prefix, _shift, (uint32_t)capacity, count, _bitmap);
             size_t item_size = has_children() ? sizeof(const ArrayMappedTrie*) : _leaf_item_bytes;
             memcpy(node->_children, _children, count * item_size);
+            node->_augment = _augment;
             return node;
         }
 
@@ -907,7 +1400,27 @@ namespace wry {
             return clone_with_capacity(std::popcount(_bitmap));
         }
 
-        // Modify mutable; must be before publication
+        // Modify mutable; must be before publication, and be followed by
+        // _recompute_augment
+
+        // Refold the cached augmentation from the node's own children or
+        // values, which must be complete
+        void _recompute_augment() {
+            if constexpr (_is_augmented) {
+                int n = std::popcount(_bitmap);
+                if (has_children()) {
+                    _augment = _children[0]->_augment;
+                    for (int i = 1; i != n; ++i) {
+                        _augment.size += _children[i]->_augment.size;
+                        _augment.summary = Augment::combine(_augment.summary,
+                                                            _children[i]->_augment.summary);
+                    }
+                } else {
+                    _augment.size = n;
+                    _augment.summary = _fold_leaf(_bitmap);
+                }
+            }
+        }
 
         void insert_child(ArrayMappedTrie const* _Nonnull new_child) {
             assert(has_children());
@@ -937,8 +1450,8 @@ namespace wry {
 
     }; // ArrayMappedTrie
 
-    template<typename Word, typename T, typename Discipline, int SYMBOL_WIDTH>
-    void print(ArrayMappedTrie<Word, T, Discipline, SYMBOL_WIDTH> const* _Nullable s) {
+    template<typename Word, typename T, typename Discipline, int SYMBOL_WIDTH, typename Augment>
+    void print(ArrayMappedTrie<Word, T, Discipline, SYMBOL_WIDTH, Augment> const* _Nullable s) {
         if (!s) {
             printf("nullptr\n");
         }
@@ -5,8 +5,11 @@
 //  Created by Antony Searle on 23/11/2024.
 //
 
+#include <latch>
 #include <map>
 #include <set>
+#include <thread>
+#include <vector>
 
 #include "concurrent_skiplist.hpp"
 
@@ -138,4 +141,199 @@ namespace wry {
         co_return;
     };
 
+    define_test("skiplist_erase") {
+        auto guard = pin_global_epoch();
+        for (int iter = 0; iter != 64; ++iter) {
+            ConcurrentSkiplistSet<uint64_t, DefaultKeyService<uint64_t>, EpochDiscipline, true> a;
+            std::set<uint64_t> b;
+            for (int i = 0; i != 512; ++i) {
+                // Dense enough for ranges to hit
+                uint64_t k = std::rand() & 0xFFF;
+                switch (std::rand() % 8) {
+                    case 0:
+                    case 1:
+                    case 2: {
+                        bool inserted = a.try_emplace(k).second;
+                        assert(inserted == b.insert(k).second);
+                        break;
+                    }
+                    case 3:
+                    case 4: {
+                        // Mostly keys that are present
+                        if (!b.empty() && (std::rand() & 1))
+                            k = *std::next(b.begin(), std::rand() % b.size());
+                        bool erased = a.erase(k);
+                        assert(erased == (bool)b.erase(k));
+                        break;
+                    }
+                    case 5: {
+                        uint64_t last = k + (std::rand() & 0xFF);
+                        size_t erased = a.erase_range(k, last);
+                        assert(erased == (size_t)std::distance(b.lower_bound(k), b.lower_bound(last)));
+                        b.erase(b.lower_bound(k), b.lower_bound(last));
+                        break;
+                    }
+                    default: {
+                        auto c = a.find(k);
+                        assert((c == a.end()) == !b.contains(k));
+                        auto d = a.lower_bound(k);
+                        auto e = b.lower_bound(k);
+                        assert((d == a.end()) == (e == b.end()));
+                        assert((d == a.end()) || (*d == *e));
+                        break;
+                    }
+                }
+                assert(a.size() == b.size());
+            }
+            {
+                auto c = a.begin();
+                for (uint64_t k : b)
+                    assert((c != a.end()) && (*c++ == k));
+                assert(c == a.end());
+            }
+            // Every erased node is unlinked from every level, so a frozen
+            // reader sees only live nodes
+            std::set<uint64_t> got;
+            collect_via_partition(a.make_cursor(), 0, 15, 32, got);
+            assert(got == b);
+            if (!(iter & 15))
+                mutator_repin();
+        }
+        unpin_global_epoch(guard);
+        co_return;
+    };
+
+    // Linearizability under a mixed concurrent load.  Each thread runs
+    // try_emplace, erase and find on a few keys, stamping each operation's
+    // invocation and response from a shared counter.  A set is the product
+    // of independent per-key registers, and linearizability is local, so
+    // each key's history is checked alone by a Wing-Gong search for a
+    // sequential order that respects real time.
+    namespace {
+
+        struct SkiplistHistoryEntry {
+            uint64_t invoke;
+            uint64_t response;
+            int kind;                      // 0 insert, 1 erase, 2 find
+            bool result;
+        };
+
+        bool _skiplist_linearize(std::vector<SkiplistHistoryEntry> const& ops,
+                                 uint64_t done,
+                                 bool present,
+                                 std::set<std::pair<uint64_t, bool>>& dead_ends) {
+            size_t n = ops.size();
+            if (done == ((n == 64) ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1)))
+                return true;
+            if (!dead_ends.emplace(done, present).second)
+                return false;
+            // Any pending operation invoked before the earliest pending
+            // response may take effect next
+            uint64_t horizon = UINT64_MAX;
+            for (size_t i = 0; i != n; ++i)
+                if (!(done >> i & 1))
+                    horizon = std::min(horizon, ops[i].response);
+            for (size_t i = 0; i != n; ++i) {
+                if ((done >> i & 1) || (ops[i].invoke > horizon))
+                    continue;
+                SkiplistHistoryEntry const& op = ops[i];
+                bool next = present;
+                switch (op.kind) {
+                    case 0:
+                        if (op.result != !present)
+                            continue;
+                        next = true;
+                        break;
+                    case 1:
+                        if (op.result != present)
+                            continue;
+                        next = false;
+                        break;
+                    default:
+                        if (op.result != present)
+                            continue;
+                        break;
+                }
+                if (_skiplist_linearize(ops, done | ((uint64_t)1 << i), next, dead_ends))
+                    return true;
+            }
+            return false;
+        }
+
+    } // anonymous namespace
+
+    define_test("skiplist_linearizable") {
+        constexpr int THREADS = 4;
+        constexpr int KEYS = 16;
+        constexpr int OPERATIONS = 96;
+        for (int round = 0; round != 64; ++round) {
+            ConcurrentSkiplistSet<uint64_t, DefaultKeyService<uint64_t>, RegionDiscipline, true> a;
+            // Half the keys start present
+            for (uint64_t k = 0; k != KEYS; k += 2)
+                (void) a.try_emplace(k);
+            Atomic<uint64_t> clock{0};
+            std::vector<std::pair<uint64_t, SkiplistHistoryEntry>> histories[THREADS];
+            std::latch start{THREADS};
+            std::vector<std::thread> threads;
+            for (int t = 0; t != THREADS; ++t) {
+                threads.emplace_back([&, t] {
+                    uint64_t x = 0x9E3779B97F4A7C15ull * (uint64_t)(round * THREADS + t + 1);
+                    start.arrive_and_wait();
+                    for (int j = 0; j != OPERATIONS; ++j) {
+                        x ^= x << 13;
+                        x ^= x >> 7;
+                        x ^= x << 17;
+                        uint64_t key = x % KEYS;
+                        SkiplistHistoryEntry entry;
+                        entry.kind = (int)((x >> 32) % 3);
+                        entry.invoke = clock.fetch_add_acq_rel(1);
+                        switch (entry.kind) {
+                            case 0:
+                                entry.result = a.try_emplace(key).second;
+                                break;
+                            case 1:
+                                entry.result = a.erase(key);
+                                break;
+                            default:
+                                entry.result = a.find(key) != a.end();
+                                break;
+                        }
+                        entry.response = clock.fetch_add_acq_rel(1);
+                        histories[t].emplace_back(key, entry);
+                    }
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+
+            std::vector<SkiplistHistoryEntry> by_key[KEYS];
+            for (auto const& history : histories)
+                for (auto const& [key, entry] : history)
+                    by_key[key].push_back(entry);
+            size_t present = 0;
+            for (uint64_t k = 0; k != KEYS; ++k) {
+                assert(by_key[k].size() <= 64);
+                std::set<std::pair<uint64_t, bool>> dead_ends;
+                bool ok = _skiplist_linearize(by_key[k], 0, !(k & 1), dead_ends);
+                assert(ok);
+                present += a.find(k) != a.end();
+            }
+
+            // Quiescent: the count is exact, and no erased node is still
+            // linked at any level
+            assert(a.size() == present);
+            std::set<uint64_t> got;
+            for (uint64_t k : a)
+                got.insert(k);
+            assert(got.size() == present);
+            auto head = a._head;
+            for (size_t i = 0; i != head->_top.load_relaxed(); ++i)
+                for (auto* node = head->_next[i].load_acquire(); node; node = node->_next[i].load_acquire()) {
+                    assert(!_skiplist_detail::_is_marked(node));
+                    assert(got.contains(node->_key));
+                }
+        }
+        co_return;
+    };
+
 } // namespace wry
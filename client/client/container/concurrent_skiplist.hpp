@@ -9,12 +9,15 @@
 #define concurrent_skiplist_hpp
 
 
+#include <algorithm>
+#include <cstdint>
 #include <optional>
 
 #include "assert.hpp"
 #include "epoch_allocator.hpp"
 #include "garbage_collected.hpp"
 #include "key_service.hpp"
+#include "region.hpp"
 #include "utility.hpp"
 #include "coroutine.hpp"
 
@@ -22,14 +25,27 @@ namespace wry {
 
     // Concurrent skiplist
     //
-    // size() and erase() lack a compelling use case at the moment are not
-    // currently implemented.  Both would likely involve significant changes
-    // and introduce per-operation overhead.
-    // - size() would require maintaining an essentially separate concurrent
-    //   counter.
-    // - erase() would require upgrading each level into a Harris-Michael linked
-    //   list, with a stolen pointer bit marking deletion, and every (mutating)
-    //   traversal required to help in the cleanup.
+    // Each level is a Harris-Michael linked list.  erase() marks a node by
+    // stealing the low bit of its own _next[i], top level first; whoever
+    // marks level 0 has erased the key.  A marked slot is frozen, since
+    // every CAS on a _next slot expects an unmarked value, and mutating
+    // traversals (_search) unlink the marked nodes they pass.  Readers walk
+    // straight through marked nodes, stripping the bit.
+    //
+    // Unlinked nodes are never freed individually: they live until their
+    // epoch is reclaimed or their region is released, so a reader pinned
+    // before the unlink can finish its walk.  Under the garbage-collected
+    // disciplines a tagged pointer would confuse the write barrier, so
+    // erase() is not offered there (see AtomicMarkedScanSlot).
+    //
+    // Once the skiplist is frozen every erase has finished its unlink, so
+    // frozen readers (FrozenCursor, coroutine_parallel_for_each) never see
+    // a mark.
+    //
+    // size() is opt-in, since counting puts a shared write on every insert
+    // and erase.  A skiplist instantiated with IsCounted counts them in a
+    // few padded stripes, chosen per thread, which size() sums; it is
+    // approximate while mutators run.
     
     // References:
     // Tim Harris, "A Pragmatic Implementation of Non-Blocking Linked-Lists," DISC 2001
@@ -53,6 +69,25 @@ namespace wry {
             return x;
         }
 
+        // Nodes and Heads come from the discipline's allocator or, for a
+        // region discipline, from the region the Head was made in.
+        template<typename Discipline>
+        void* _Nonnull _allocate_zeroed(Region* _Nullable region,
+                                        size_t number_of_bytes,
+                                        size_t alignment) {
+            void* _Nonnull raw;
+            if constexpr (is_region_discipline_v<Discipline>) {
+                assert(region);
+                raw = region->allocate(number_of_bytes, alignment);
+            } else {
+                // Not checked; we accept crashing on OOM.
+                raw = Discipline::IntrusiveAllocator::operator new(number_of_bytes,
+                                                                   std::align_val_t{alignment});
+            }
+            std::memset(raw, 0, number_of_bytes);
+            return raw;
+        }
+
         struct LoadNonatomic {
             auto operator()(auto const& x) const {
                 return x.nonatomic_load();
@@ -65,6 +100,75 @@ namespace wry {
             }
         };
 
+        // The Harris mark in the low bit of a _next slot
+
+        template<typename T>
+        bool _is_marked(T* _Nullable p) {
+            return (uintptr_t)p & 1;
+        }
+
+        template<typename T>
+        T* _Nullable _unmarked(T* _Nullable p) {
+            return (T*)((uintptr_t)p & ~(uintptr_t)1);
+        }
+
+        template<typename T>
+        T* _Nonnull _with_mark(T* _Nullable p) {
+            return (T*)((uintptr_t)p | 1);
+        }
+
+        // First node at or after p, along level 0, that is not erased
+        template<typename Loader, typename Node>
+        Node* _Nullable _skip_erased(Node* _Nullable p) {
+            while (p) {
+                Node* _Nullable q = Loader{}(p->_next[0]);
+                if (!_is_marked(q))
+                    break;
+                p = _unmarked(q);
+            }
+            return p;
+        }
+
+        // Approximate size
+        constexpr size_t SKIPLIST_COUNT_STRIPES = 8;
+
+        // Padded rather than aligned: the Head's allocators promise only
+        // the fundamental alignment
+        struct _SkiplistCountStripe {
+            Atomic<int64_t> count;
+            char _padding[64 - sizeof(Atomic<int64_t>)];
+        };
+
+        constinit inline Atomic<size_t> _skiplist_stripe_source{0};
+        constinit inline thread_local size_t _skiplist_stripe = SIZE_MAX;
+
+        inline size_t _skiplist_this_thread_stripe() {
+            if (_skiplist_stripe == SIZE_MAX) [[unlikely]]
+                _skiplist_stripe = (_skiplist_stripe_source.fetch_add_relaxed(1)
+                                    % SKIPLIST_COUNT_STRIPES);
+            return _skiplist_stripe;
+        }
+
+        template<bool IsCounted>
+        struct _SkiplistCount {
+            _SkiplistCountStripe _stripes[SKIPLIST_COUNT_STRIPES];
+            void add(int64_t delta) {
+                _stripes[_skiplist_this_thread_stripe()].count.fetch_add_relaxed(delta);
+            }
+            size_t load() const {
+                int64_t n = 0;
+                for (auto const& stripe : _stripes)
+                    n += stripe.count.load_relaxed();
+                return (size_t)std::max<int64_t>(n, 0);
+            }
+        };
+
+        // Uncounted skiplists pay nothing on insert or erase
+        template<>
+        struct _SkiplistCount<false> {
+            void add(int64_t) {}
+        };
+
         template<typename Key, typename Compare, typename Discipline>
         struct Node : Discipline::IntrusiveAllocator {
 
@@ -87,18 +191,18 @@ namespace wry {
             , _size(n) {
             }
 
-            static Node* _Nonnull with_size_emplace(size_t n, auto&&... args) {
+            static Node* _Nonnull with_size_emplace(Region* _Nullable region, size_t n, auto&&... args) {
                 size_t number_of_bytes = sizeof(Node) + sizeof(*_next) * n;
-                // Not checked; we accept crashing on OOM.
-                void* _Nonnull raw = Discipline::IntrusiveAllocator::operator new(number_of_bytes,
-                                                                                  std::align_val_t{alignof(Node)});
-                std::memset(raw, 0, number_of_bytes);
+                void* _Nonnull raw = _allocate_zeroed<Discipline>(region, number_of_bytes, alignof(Node));
                 return new(raw) Node(n, FORWARD(args)...);
             }
 
-            static Node* _Nonnull with_random_size_emplace(auto&&... args) {
-                size_t n = 1 + __builtin_ctzll(_skiplist_xorshift64());
-                Node* a = with_size_emplace(n, FORWARD(args)...);
+            static size_t random_size() {
+                return 1 + __builtin_ctzll(_skiplist_xorshift64());
+            }
+
+            static Node* _Nonnull with_random_size_emplace(Region* _Nullable region, auto&&... args) {
+                Node* a = with_size_emplace(region, random_size(), FORWARD(args)...);
                 return a;
             }
 
@@ -158,7 +262,7 @@ namespace wry {
 
             basic_iterator& operator++() {
                 assert(current);
-                current = Loader{}(current->_next[0]);
+                current = _skip_erased<Loader>(_unmarked(Loader{}(current->_next[0])));
                 return *this;
             }
 
@@ -170,7 +274,7 @@ namespace wry {
 
         }; // struct basic_iterator
 
-        template<typename Key, typename Compare, typename Discipline>
+        template<typename Key, typename Compare, typename Discipline, bool IsCounted>
         struct Head : Discipline::IntrusiveAllocator {
 
             template<typename T> using AtomicSlot = Discipline::template AtomicSlot<T>;
@@ -187,18 +291,25 @@ namespace wry {
 
             Compare _compare;
             Atomic<size_t> _top;
+            // Region disciplines: the region holding the Head and every Node
+            Region* _Nullable _region;
+            [[no_unique_address]] _SkiplistCount<IsCounted> _count;
             AtomicSlot<Node* _Nullable> _next[] __counted_by(HEAD_LEVELS);
 
-            explicit Head(Compare comp) : _compare(std::move(comp)), _top(1) {}
+            Head(Compare comp, Region* _Nullable region)
+            : _compare(std::move(comp)), _top(1), _region(region) {}
 
             static Head* _Nonnull make(Compare comp) {
+                Region* region = nullptr;
+                if constexpr (is_region_discipline_v<Discipline>) {
+                    // Nodes are freed with the region, never destroyed
+                    static_assert(std::is_trivially_destructible_v<Key>);
+                    region = new Region;
+                }
                 size_t n = HEAD_LEVELS;
                 size_t number_of_bytes = sizeof(Head) + sizeof(*_next) * n;
-                // Not checked; we accept crashing on OOM.
-                void* _Nonnull raw = Discipline::IntrusiveAllocator::operator new(number_of_bytes,
-                                                                                  std::align_val_t{alignof(Head)});
-                std::memset(raw, 0, number_of_bytes);
-                return new(raw) Head(std::move(comp));
+                void* _Nonnull raw = _allocate_zeroed<Discipline>(region, number_of_bytes, alignof(Head));
+                return new(raw) Head(std::move(comp), region);
             }
 
             // Implicit-override pattern, see Node above.
@@ -235,17 +346,35 @@ namespace wry {
             basic_iterator<Key, Compare, Discipline, Loader>
             lower_bound(const Query& query) const;
 
-            [[nodiscard]] std::pair<Node* _Nullable, bool>
-            _link_level(size_t i, AtomicSlot<Node* _Nullable>* _Nonnull left, Node* _Nullable expected, Node* _Nonnull desired);
-
-            template<typename Keylike, typename... Args>
-            std::pair<Node* _Nullable, bool>
-            _try_emplace(size_t i, AtomicSlot<Node* _Nullable>* _Nonnull left, Keylike&& keylike, Args&&... args);
+            // For each level i < levels, the first node not less than
+            // `query` and the slot that points to it, unlinking marked nodes
+            // on the way
+            template<typename Query>
+            void _search(Query const& query,
+                         size_t levels,
+                         AtomicSlot<Node* _Nullable>* _Nonnull* _Nonnull preds,
+                         Node* _Nullable* _Nonnull succs);
 
             template<typename Keylike, typename... Args>
             std::pair<basic_iterator<Key, Compare, Discipline, LoadAcquire>, bool>
             try_emplace(Keylike&& keylike, Args&&... args);
 
+            // True if this call erased the node
+            [[nodiscard]] bool _erase_node(Node* _Nonnull node);
+
+            template<typename Query>
+            bool erase(Query const& query);
+
+            // Erase the keys in [first, last); returns how many this call
+            // erased
+            template<typename Query1, typename Query2>
+            size_t erase_range(Query1 const& first, Query2 const& last);
+
+            // Exact when quiescent
+            [[nodiscard]] size_t size() const requires IsCounted {
+                return _count.load();
+            }
+
             // Precondition: frozen
             template<typename Action> [[nodiscard]] Coroutine::Task
             coroutine_parallel_for_each(Action&& action) const;
@@ -308,12 +437,12 @@ namespace wry {
 
     }
 
-    template<typename Key, typename Compare, typename Discipline>
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted = false>
     struct ConcurrentSkiplistSet {
 
         using iterator = _skiplist_detail::basic_iterator<Key, Compare, Discipline, _skiplist_detail::LoadAcquire>;
 
-        using Head = _skiplist_detail::Head<Key, Compare, Discipline>;
+        using Head = _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>;
         Head* _Nonnull _head;
 
         using FrozenCursor = _skiplist_detail::FrozenCursor<Key, Compare, Discipline>;
@@ -334,7 +463,7 @@ namespace wry {
         
         [[nodiscard]] iterator begin() const {
             return iterator{
-                _head->_next[0].load_acquire()
+                _skiplist_detail::_skip_erased<_skiplist_detail::LoadAcquire>(_head->_next[0].load_acquire())
             };
         }
         
@@ -342,6 +471,11 @@ namespace wry {
             return iterator{nullptr};
         }
 
+        // Approximate while mutators run
+        [[nodiscard]] size_t size() const requires IsCounted {
+            return _head->size();
+        }
+
         template<typename Query>
         [[nodiscard]] iterator find(Query const& query) const {
             assert(_head);
@@ -361,13 +495,28 @@ namespace wry {
             
         }
 
+        // Returns true if this call erased the key.  Not for the
+        // garbage-collected disciplines.
+        template<typename Query>
+        bool erase(Query const& query) {
+            assert(_head);
+            return _head->erase(query);
+        }
+
+        // Erase [first, last); returns how many keys this call erased
+        template<typename Query1, typename Query2>
+        size_t erase_range(Query1 const& first, Query2 const& last) {
+            assert(_head);
+            return _head->erase_range(first, last);
+        }
+
     }; // ConcurrentSkiplistSet<Key, Compare, IntrusiveAllocator>
 
     
-    template<typename Key, typename Compare, typename Discipline>
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
     template<typename Loader, typename Query>
     [[nodiscard]] _skiplist_detail::basic_iterator<Key, Compare, Discipline, Loader>
-    _skiplist_detail::Head<Key, Compare, Discipline>
+    _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
     ::find(Query const& query) const
     {
         using iterator = _skiplist_detail::basic_iterator<Key, Compare, Discipline, Loader>;
@@ -376,7 +525,8 @@ namespace wry {
         // TODO: Why is this called left?
         auto left = _next + i;
         for (;;) {
-            Node* _Nullable candidate = Loader{}(*left);
+            // Walking through an erased node is fine; its slots are frozen
+            Node* _Nullable candidate = _unmarked(Loader{}(*left));
             if (!candidate || _compare(query, candidate->_key)) {
                 if (i == 0)
                     return iterator{nullptr};
@@ -385,15 +535,18 @@ namespace wry {
             } else if (_compare(candidate->_key, query)) {
                 left = candidate->_next + i;
             } else {
+                // Found, unless erased and not yet unlinked
+                if (_is_marked(Loader{}(candidate->_next[0])))
+                    return iterator{nullptr};
                 return iterator{candidate};
             }
         }
     }
 
-    template<typename Key, typename Compare, typename Discipline>
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
     template<typename Loader, typename Query>
     [[nodiscard]] _skiplist_detail::basic_iterator<Key, Compare, Discipline, Loader>
-    _skiplist_detail::Head<Key, Compare, Discipline>
+    _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
     ::lower_bound(const Query& query) const
     {
         using iterator = _skiplist_detail::basic_iterator<Key, Compare, Discipline, Loader>;
@@ -405,31 +558,31 @@ namespace wry {
         assert((i + 1) > 0);
         auto left = _next + i;
         for (;;) {
-            Node* _Nullable candidate = Loader{}(*left);
+            Node* _Nullable candidate = _unmarked(Loader{}(*left));
             if (!candidate || _compare(query, candidate->_key)) {
                 // candidate is null or strictly greater than query; no equal
                 // key was found at a higher level, so at level 0 this is the
                 // lower bound (possibly end()).
                 if (i == 0)
-                    return iterator{candidate};
+                    return iterator{_skip_erased<Loader>(candidate)};
                 --i;
                 --left;
             } else if (_compare(candidate->_key, query)) {
                 left = candidate->_next + i;
             } else {
                 // exact match: an equal key is its own lower bound
-                return iterator{candidate};
+                return iterator{_skip_erased<Loader>(candidate)};
             }
         }
     }
 
-    template<typename Key, typename Compare, typename Discipline>
-    [[nodiscard]] std::pair<_skiplist_detail::Node<Key, Compare, Discipline>* _Nullable, bool>
-    _skiplist_detail::Head<Key, Compare, Discipline>
-    ::_link_level(size_t i,
-                  AtomicSlot<Node* _Nullable>* _Nonnull left,
-                  Node* _Nullable expected,
-                  Node* _Nonnull desired)
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
+    template<typename Query>
+    void _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
+    ::_search(Query const& query,
+              size_t levels,
+              AtomicSlot<Node* _Nullable>* _Nonnull* _Nonnull preds,
+              Node* _Nullable* _Nonnull succs)
     {
         // STYLE: GOTO considered helpful for concurrent code that
         // handles failure by restarting from an earlier step.
@@ -437,110 +590,206 @@ namespace wry {
         // multiple conditional breaks and continues require careful
         // reasoning to work out where control flow actually ends up. /rant
     alpha:
-        assert(left && desired);
-        assert(!expected || (std::as_const(_compare)(desired->_key, expected->_key)));
-        // desired is thread-private here; the publishing CAS below
-        // carries release ordering, so this preceding store can be
-        // non-atomic.
-        desired->_next[i].nonatomic_store(expected);
-        if (left->compare_exchange_strong_release_acquire(expected, desired))
-            return { desired, true };
-    beta:
-        if (!expected || (std::as_const(_compare)(desired->_key, expected->_key)))
-            goto alpha;
-        if (!(std::as_const(_compare)(expected->_key, desired->_key)))
-            return std::pair(expected, false);
-        left = expected->_next + i;
-        expected = left->load_acquire();
-        goto beta;
-    }
-    
-    template<typename Key, typename Compare, typename Discipline>
-    template<typename Keylike, typename... Args>
-    std::pair<typename _skiplist_detail::Node<Key, Compare, Discipline>* _Nullable, bool>
-    _skiplist_detail::Head<Key, Compare, Discipline>
-    ::_try_emplace(size_t i,
-                   AtomicSlot<Node* _Nullable>* _Nonnull left,
-                   Keylike&& keylike,
-                   Args&&... args)
-    {
-    alpha:
-        Node* _Nullable candidate = left->load_acquire();
-        if (!candidate || std::as_const(_compare)(keylike, candidate->_key))
-            goto beta;
-        if (!(std::as_const(_compare)(candidate->_key, keylike)))
-            return {candidate, false};
-        left = candidate->_next + i;
-        goto alpha;
-    beta:
-        assert(!candidate || std::as_const(_compare)(keylike, candidate->_key));
-        if (i == 0) {
-            return _link_level(0, left, candidate,
-                               Node::with_random_size_emplace(FORWARD(keylike),
-                                                              FORWARD(args)...));
-            // If _link_level fails, we are relying on the Node we just
-            // created being cleaned up eventually by IntrusiveAllocator.
-            // Doing nothing is correct for EpochAllocator and
-            // GarbageCollected.
-        } else {
-            auto result = _try_emplace(i - 1, left - 1, FORWARD(keylike), FORWARD(args)...);
-            if (result.second && (i < result.first->_size)) {
-                result = _link_level(i, left, candidate, result.first);
-                assert(result.second);
+        // The _next array of the rightmost node (or Head) less than query
+        AtomicSlot<Node* _Nullable>* _Nonnull base = _next;
+        for (size_t i = levels; i--;) {
+            AtomicSlot<Node* _Nullable>* _Nonnull left = base + i;
+            Node* _Nullable candidate = left->load_acquire();
+            if (_is_marked(candidate)) {
+                // Our predecessor is being erased
+                goto alpha;
             }
-            return result;
+            while (candidate) {
+                Node* _Nullable next = candidate->_next[i].load_acquire();
+                if (_is_marked(next)) {
+                    // candidate is being erased; help unlink it
+                    Node* _Nullable expected = candidate;
+                    if (!left->compare_exchange_strong_acq_rel_acquire(expected, _unmarked(next)))
+                        goto alpha;
+                    candidate = _unmarked(next);
+                    continue;
+                }
+                if (!std::as_const(_compare)(candidate->_key, query))
+                    break;
+                base = candidate->_next;
+                left = base + i;
+                candidate = next;
+            }
+            preds[i] = left;
+            succs[i] = candidate;
         }
     }
-    
-    
+
     // `try_emplace` is winner-takes-all on the value; intended for sets of
     // strongly ordered values or for atomic-headed coordination patterns
     // For other concurrent map use, prefer a different primitive that can
     // delegate the decision of what ends up in the structure.
     // `java.util.concurrentConcurrentHashMap.compute` is an example
-    template<typename Key, typename Compare, typename Discipline>
+    //
+    // Fraser's insert: link level 0, which decides the race, then link the
+    // upper levels one by one, searching again whenever a link fails.  An
+    // erase may mark the node while its upper levels are still being
+    // linked; a marked upper slot ends the linking early.
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
     template<typename Keylike, typename... Args>
     std::pair<typename _skiplist_detail::basic_iterator<Key, Compare, Discipline, _skiplist_detail::LoadAcquire>, bool>
-    _skiplist_detail::Head<Key, Compare, Discipline>
+    _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
     ::try_emplace(Keylike&& keylike, Args&&... args)
     {
-        size_t i = _top.load_relaxed();
-        assert(i > 0);
-        auto result = _try_emplace(i - 1, _next + (i - 1), FORWARD(keylike), FORWARD(args)...);
-        if (result.second && result.first->_size > i) {
-            _top.fetch_max_relaxed(result.first->_size);
-            while (i < result.first->_size) {
-                auto [discovered, wrote] = _link_level(i, _next + i, nullptr, result.first);
-                // _link_level only returns wrote=false when an equivalent key is
-                // already in the level-i chain.  By the skiplist invariant, any
-                // level-i node is also in level 0; we just successfully inserted
-                // at level 0 with a unique key, so no equivalent key exists at
-                // any level.  Hence wrote should always be true here.
-                assert(wrote);
-                ++i;
-            }
-        }
-        return { basic_iterator<Key, Compare, Discipline, _skiplist_detail::LoadAcquire>{ result.first }, result.second };
+        using iterator = basic_iterator<Key, Compare, Discipline, LoadAcquire>;
+        AtomicSlot<Node* _Nullable>* _Nonnull preds[HEAD_LEVELS];
+        Node* _Nullable succs[HEAD_LEVELS];
+
+        // Choose the height up front so one search covers it
+        size_t height = Node::random_size();
+        size_t levels = std::max(_top.load_relaxed(), height);
+        assert(levels <= HEAD_LEVELS);
+        _search(keylike, levels, preds, succs);
+        if (succs[0] && !std::as_const(_compare)(keylike, succs[0]->_key))
+            return { iterator{ succs[0] }, false };
+
+        Node* _Nonnull node = Node::with_size_emplace(_region,
+                                                      height,
+                                                      FORWARD(keylike),
+                                                      FORWARD(args)...);
+        for (;;) {
+            // node is thread-private until the CAS publishes it with release
+            // ordering, so this preceding store can be non-atomic.
+            node->_next[0].nonatomic_store(succs[0]);
+            Node* _Nullable expected = succs[0];
+            if (preds[0]->compare_exchange_strong_release_acquire(expected, node))
+                break;
+            _search(node->_key, levels, preds, succs);
+            if (succs[0] && !std::as_const(_compare)(node->_key, succs[0]->_key)) {
+                // Lost the race.  We are relying on the Node we just created
+                // being cleaned up eventually by IntrusiveAllocator.  Doing
+                // nothing is correct for EpochAllocator, GarbageCollected and
+                // Region.
+                return { iterator{ succs[0] }, false };
+            }
+        }
+        _count.add(1);
+        if (height == 1)
+            return { iterator{ node }, true };
+
+        _top.fetch_max_relaxed(height);
+        for (size_t i = 1; i != height; ++i) {
+            for (;;) {
+                Node* _Nullable expected = succs[i];
+                Node* _Nullable next = node->_next[i].load_acquire();
+                if (_is_marked(next))
+                    goto erased;
+                if ((next != expected)
+                    && !node->_next[i].compare_exchange_strong_acq_rel_acquire(next, expected))
+                    continue;
+                if (preds[i]->compare_exchange_strong_acq_rel_acquire(expected, node))
+                    break;
+                _search(node->_key, levels, preds, succs);
+            }
+        }
+        {
+            // An erase that marked a level after we read it but before we
+            // linked it there may have searched past the link.  Read level 0
+            // with an RMW: if it is unmarked, the marking erase is ordered
+            // after our links and its cleanup will see them; if it is
+            // marked, clean up ourselves.
+            Node* _Nullable next = node->_next[0].load_relaxed();
+            while (!_is_marked(next)
+                   && !node->_next[0].compare_exchange_weak_acq_rel_relaxed(next, next))
+                ;
+            if (!_is_marked(next))
+                return { iterator{ node }, true };
+        }
+    erased:
+        _search(node->_key, levels, preds, succs);
+        return { iterator{ node }, true };
     }
-    
+
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
+    [[nodiscard]] bool _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
+    ::_erase_node(Node* _Nonnull node)
+    {
+        static_assert(!std::is_base_of_v<GarbageCollected, typename Discipline::IntrusiveAllocator>,
+                      "erase would store tagged pointers through the write barrier");
+        // Mark top down, so that level 0, which decides the race, is last
+        for (size_t i = node->_size; --i;) {
+            Node* _Nullable next = node->_next[i].load_relaxed();
+            while (!_is_marked(next)
+                   && !node->_next[i].compare_exchange_weak_acq_rel_relaxed(next, _with_mark(next)))
+                ;
+        }
+        Node* _Nullable next = node->_next[0].load_relaxed();
+        for (;;) {
+            if (_is_marked(next))
+                return false;
+            if (node->_next[0].compare_exchange_weak_acq_rel_relaxed(next, _with_mark(next)))
+                break;
+        }
+        _count.add(-1);
+        // Unlink it from every level
+        AtomicSlot<Node* _Nullable>* _Nonnull preds[HEAD_LEVELS];
+        Node* _Nullable succs[HEAD_LEVELS];
+        _search(node->_key, std::max(_top.load_relaxed(), node->_size), preds, succs);
+        return true;
+    }
+
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
+    template<typename Query>
+    bool _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
+    ::erase(Query const& query)
+    {
+        AtomicSlot<Node* _Nullable>* _Nonnull preds[HEAD_LEVELS];
+        Node* _Nullable succs[HEAD_LEVELS];
+        _search(query, _top.load_relaxed(), preds, succs);
+        Node* _Nullable node = succs[0];
+        if (!node || std::as_const(_compare)(query, node->_key))
+            return false;
+        return _erase_node(node);
+    }
+
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
+    template<typename Query1, typename Query2>
+    size_t _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
+    ::erase_range(Query1 const& first, Query2 const& last)
+    {
+        // Each node is unlinked by its own search.  One search for `last`
+        // would unlink a run of marked nodes, but not those behind a node
+        // inserted into the range meanwhile, which would then survive
+        // into the frozen phase.
+        size_t count = 0;
+        Node* _Nullable node = lower_bound(first).current;
+        while (node && std::as_const(_compare)(node->_key, last)) {
+            count += _erase_node(node);
+            node = _skip_erased<LoadAcquire>(_unmarked(node->_next[0].load_acquire()));
+        }
+        return count;
+    }
+
 
     // ADL hook for GC parents that hold a ConcurrentSkiplistSet member.
     //
     // GC mode: recurse into _head; the spine is then traced via the
     // virtual overrides on Head and each Node.
-    template<typename Key, typename H, typename Discipline>
+    template<typename Key, typename H, typename Discipline, bool IsCounted>
     requires (std::is_base_of_v<GarbageCollected, typename Discipline::IntrusiveAllocator>)
-    void garbage_collected_scan(ConcurrentSkiplistSet<Key, H, Discipline> const& self) {
+    void garbage_collected_scan(ConcurrentSkiplistSet<Key, H, Discipline, IsCounted> const& self) {
         garbage_collected_scan(self._head);
     }
 
+    // Region mode: the nodes are untraced; keep their region alive.
+    template<typename Key, typename H, typename Discipline, bool IsCounted>
+    requires (is_region_discipline_v<Discipline>)
+    void garbage_collected_scan(ConcurrentSkiplistSet<Key, H, Discipline, IsCounted> const& self) {
+        garbage_collected_scan(self._head->_region);
+    }
+
     // Bump mode: no-op.  GC payloads inside epoch-allocated nodes must
     // already be reachable to the collector via some independent path
     // (otherwise they'd already have been collected), so there's no need
     // to trace through the bump skiplist.
-    template<typename Key, typename H, typename Discipline>
+    template<typename Key, typename H, typename Discipline, bool IsCounted>
     requires (std::is_base_of_v<BumpAllocated, typename Discipline::IntrusiveAllocator>)
-    void garbage_collected_scan(ConcurrentSkiplistSet<Key, H, Discipline> const&) {
+    void garbage_collected_scan(ConcurrentSkiplistSet<Key, H, Discipline, IsCounted> const&) {
         // no-op
     }
 
@@ -551,7 +800,7 @@ namespace wry {
     // existing element yet.  In general, it would require T to be atomic.
     
     
-    template<typename Key, typename T, typename H, typename Discipline>
+    template<typename Key, typename T, typename H, typename Discipline, bool IsCounted = false>
     struct ConcurrentSkiplistMap {
         
         using P = std::pair<Key, T>;
@@ -577,7 +826,7 @@ namespace wry {
             
         };
         
-        using S = ConcurrentSkiplistSet<P, ComparePair, Discipline>;
+        using S = ConcurrentSkiplistSet<P, ComparePair, Discipline, IsCounted>;
         using iterator = S::iterator;
         
         S _set;
@@ -601,6 +850,18 @@ namespace wry {
         std::pair<iterator, bool> try_emplace(auto&& keylike, auto&&... args) {
             return _set.try_emplace(FORWARD(keylike), FORWARD(args)...);
         }
+
+        bool erase(auto const& keylike) {
+            return _set.erase(keylike);
+        }
+
+        size_t erase_range(auto const& first, auto const& last) {
+            return _set.erase_range(first, last);
+        }
+
+        [[nodiscard]] size_t size() const requires IsCounted {
+            return _set.size();
+        }
         
         using Cursor = S::FrozenCursor;
         Cursor make_cursor() const {
@@ -671,9 +932,9 @@ namespace wry {
     }
 
 
-    template<typename Key, typename Compare, typename Discipline>
+    template<typename Key, typename Compare, typename Discipline, bool IsCounted>
     template<typename Action>
-    Coroutine::Task _skiplist_detail::Head<Key, Compare, Discipline>
+    Coroutine::Task _skiplist_detail::Head<Key, Compare, Discipline, IsCounted>
     ::coroutine_parallel_for_each(Action&& action) const {
         Node* bound = nullptr;
         Coroutine::Nursery nursery;
@@ -710,7 +971,7 @@ namespace wry {
     template<typename Key, typename Compare, typename Discipline>
     struct FrozenSkiplistSet {
 
-        using Head = _skiplist_detail::Head<Key, Compare, Discipline>;
+        using Head = _skiplist_detail::Head<Key, Compare, Discipline, false>;
         using Node = _skiplist_detail::Node<Key, Compare, Discipline>;
         template<typename T>
         using AtomicSlot = Discipline::template AtomicSlot<T>;
@@ -737,13 +998,13 @@ namespace wry {
         template<typename Query> [[nodiscard]] iterator
         find(Query const& query) const {
             assert(_head);
-            return _head->find(query, _skiplist_detail::LoadNonatomic{});
+            return _head->template find<_skiplist_detail::LoadNonatomic>(query);
         }
 
         template<typename Query> [[nodiscard]] iterator
         lower_bound(Query const& query) const {
             assert(_head);
-            return _head->lower_bound(query, _skiplist_detail::LoadNonatomic{});
+            return _head->template lower_bound<_skiplist_detail::LoadNonatomic>(query);
         }
         template<typename Action> [[nodiscard]] Coroutine::Task
         coroutine_parallel_for_each(Action&& action) const {
@@ -768,7 +1029,11 @@ namespace wry {
 
     template<typename Key, typename Compare, typename Discipline>
     void garbage_collected_scan(FrozenSkiplistSet<Key, Compare, Discipline> const& x) {
-        garbage_collected_scan(x._head);
+        if constexpr (is_region_discipline_v<Discipline>) {
+            garbage_collected_scan(x._head->_region);
+        } else {
+            garbage_collected_scan(x._head);
+        }
     }
 
 } // namespace wry
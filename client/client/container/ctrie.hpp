@@ -195,7 +195,7 @@ namespace wry {
 
         };
 
-        FindResult _find(INode const* self, K key,std::size_t hc, int lev, INode const* parent) const {
+        FindResult _find(INode const* self, K const& key, std::size_t hc, int lev, INode const* parent) const {
             assert(hc == _hasher(key));
             auto mn = READ(self->main);
             if (auto cn = mn->as_cnode()) {
@@ -218,7 +218,7 @@ namespace wry {
         }
 
         template<typename F>
-        AlterResult _alter(INode const* self, K key, size_t hc, int lev, INode const* parent, F const& fn) const {
+        AlterResult _alter(INode const* self, K const& key, size_t hc, int lev, INode const* parent, F const& fn) const {
             assert(hc == _hasher(key));
             auto mn = READ(self->main);
 
@@ -597,7 +597,7 @@ namespace wry {
             }
         };
 
-        LNode const* find_lnode_for_key(LNode const* self, K key) const {
+        LNode const* find_lnode_for_key(LNode const* self, K const& key) const {
             for (LNode const* current = self; current; current = current->next) {
                 assert(current->sn);
                 assert(_hasher(current->sn->k) == _hasher(key));
@@ -607,7 +607,7 @@ namespace wry {
             return nullptr;
         }
 
-        FindResult _find(LNode const* self, K key) const {
+        FindResult _find(LNode const* self, K const& key) const {
             LNode const* target = find_lnode_for_key(self, key);
             return (target
                     ? FindResult::ok(target->sn->v)
@@ -653,9 +653,15 @@ namespace wry {
         , _key_equal(std::move(key_equal_)) {
         }
 
-        std::optional<V> find(K key) {
+        std::optional<V> find(K const& key) {
+            return find(key, _hasher(key));
+        }
+
+        // find, with the hash of key already in hand (for example, cached in
+        // the object the key names)
+        std::optional<V> find(K const& key, std::size_t hc) {
             for (;;) {
-                FindResult a = _find(root, key, _hasher(key), 0, nullptr);
+                FindResult a = _find(root, key, hc, 0, nullptr);
                 switch (a.tag) {
                     case FindResult::OK:        return a.value;
                     case FindResult::NOT_FOUND: return std::nullopt;
@@ -668,13 +674,22 @@ namespace wry {
         // alter: atomically looks up a key, provides the associated value if
         // any to a user function returning AlterChoice
         template<typename F>
-        std::pair<std::optional<V>, std::optional<V>> alter(K key, F const& fn)
+        std::pair<std::optional<V>, std::optional<V>> alter(K const& key, F const& fn)
+        requires requires(F const& f, std::optional<V> const& in) {
+            { f(in) } -> std::same_as<AlterChoice>;
+        }
+        {
+            return alter(key, _hasher(key), fn);
+        }
+
+        template<typename F>
+        std::pair<std::optional<V>, std::optional<V>> alter(K const& key, std::size_t hc, F const& fn)
         requires requires(F const& f, std::optional<V> const& in) {
             { f(in) } -> std::same_as<AlterChoice>;
         }
         {
             for (;;) {
-                auto r = _alter(root, key, _hasher(key), 0, nullptr, fn);
+                auto r = _alter(root, key, hc, 0, nullptr, fn);
                 switch (r.tag) {
                     case AlterResult::OK:
                         return { r.before, r.after };
@@ -0,0 +1,185 @@
+//
+//  flat_frozen_set.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <chrono>
+#include <map>
+#include <set>
+
+#include "flat_frozen_set.hpp"
+
+#include "test.hpp"
+
+namespace wry {
+
+    namespace {
+
+        using FlatSkiplist = ConcurrentSkiplistSet<uint64_t, DefaultKeyService<uint64_t>, EpochDiscipline>;
+        using FlatFrozen = FrozenSkiplistSet<uint64_t, DefaultKeyService<uint64_t>, EpochDiscipline>;
+        using Flat = FlatFrozenSet<uint64_t, std::less<uint64_t>>;
+
+        // As collect_via_partition in concurrent_skiplist.cpp, for any
+        // FrozenCursor-like cursor
+        template<typename Cursor>
+        void flat_collect_via_partition(Cursor cursor, uint64_t lo, int shift, int n_slots,
+                                        std::set<uint64_t>& out) {
+            auto codeof = [](Cursor const& c) -> uint64_t {
+                auto* k = c.key();
+                return k ? *k : ~(uint64_t)0;
+            };
+            if (shift == 0) {
+                Cursor c = cursor;
+                while (!c.bottom())
+                    c = c.down();
+                while (codeof(c) < lo)
+                    c = c.right();
+                uint64_t hi = lo + 32;
+                while (codeof(c) < hi) {
+                    out.insert(codeof(c));
+                    c = c.right();
+                }
+                return;
+            }
+            std::optional<Cursor> result[32] = {};
+            skiplist_partition_frame(cursor, lo, shift, n_slots, result,
+                                     [](uint64_t key) { return key; });
+            for (int ci = 0; ci < n_slots; ++ci)
+                if (result[ci])
+                    flat_collect_via_partition(*result[ci], lo + ((uint64_t)ci << shift),
+                                               shift - 5, 32, out);
+        }
+
+    } // anonymous namespace
+
+    define_test("flat_frozen_set") {
+
+        auto guard = pin_global_epoch();
+
+        // Against std::set, for sizes around the powers of two where the
+        // Eytzinger tree and the implicit skiplist change shape
+        for (int iter = 0; iter != 200; ++iter) {
+            FlatSkiplist a;
+            std::set<uint64_t> b;
+            int N = (iter < 40) ? iter : std::rand() % 300;
+            for (int i = 0; i != N; ++i) {
+                uint64_t k = std::rand() & ((1u << 20) - 1);
+                a.try_emplace(k);
+                b.insert(k);
+            }
+            FlatFrozen frozen{std::move(a)};
+            Flat c = Flat::compact(frozen, [](uint64_t k) { return (int64_t)(k & 7); });
+            assert(c.size() == b.size());
+            assert(std::equal(c.begin(), c.end(), b.begin(), b.end()));
+
+            // prefix sums
+            int64_t sum = 0;
+            size_t i = 0;
+            for (uint64_t k : b) {
+                assert(c.prefix(i) == sum);
+                sum += (int64_t)(k & 7);
+                ++i;
+            }
+            assert(c.total() == sum);
+
+            // lower_bound and find, on and between keys
+            for (int j = 0; j != 64; ++j) {
+                uint64_t q = std::rand() & ((1u << 20) - 1);
+                if ((j & 1) && !b.empty())
+                    q = *std::next(b.begin(), std::rand() % b.size());
+                auto d = b.lower_bound(q);
+                size_t e = c.lower_bound_index(q);
+                assert(e == (size_t)std::distance(b.begin(), d));
+                size_t f = c.find_index(q);
+                if (b.contains(q)) {
+                    assert(f == e);
+                    assert(c[f] == q);
+                } else {
+                    assert(f == c.size());
+                }
+            }
+
+            // the implicit skiplist partitions like the real one
+            std::set<uint64_t> got;
+            flat_collect_via_partition(c.make_cursor(), 0, 15, 32, got);
+            assert(got == b);
+
+            if (!(iter & 31))
+                mutator_repin();
+        }
+
+        // Adopted keys with parallel prefixes, across several blocks, agree
+        // with a serial compaction
+        {
+            FlatSkiplist a;
+            for (size_t i = 0; i != 3 * Flat::PREFIX_BLOCK + 17; ++i)
+                a.try_emplace(((uint64_t)std::rand() << 16) ^ (uint64_t)std::rand());
+            FlatFrozen frozen{std::move(a)};
+            auto weight = [](uint64_t k) { return (int64_t)(k & 7); };
+            Flat c = Flat::compact(frozen, weight);
+            Flat d = Flat::adopt(std::vector<uint64_t>(c.begin(), c.end()));
+            co_await d.coroutine_parallel_prefix([&d, &weight](size_t i) {
+                return weight(d[i]);
+            });
+            assert(d.size() == c.size());
+            for (size_t i = 0; i != c.size() + 1; ++i)
+                assert(d.prefix(i) == c.prefix(i));
+            for (size_t i = 0; i != c.size(); ++i)
+                assert(d.weight(i) == weight(c[i]));
+            assert(d.find_index(c[100]) == 100);
+        }
+
+        // lower_bound and full scan, skiplist against flat
+        printf("frozen set (ns per op)\n");
+        printf("%8s %12s %12s %12s %12s\n", "size", "skip lb", "flat lb", "skip scan", "flat scan");
+        for (int n : {1 << 8, 1 << 12, 1 << 16, 1 << 20}) {
+            FlatSkiplist a;
+            for (int i = 0; i != n; ++i)
+                a.try_emplace(((uint64_t)std::rand() << 16) ^ (uint64_t)std::rand());
+            FlatFrozen frozen{std::move(a)};
+            Flat c = Flat::compact(frozen);
+            std::vector<uint64_t> queries;
+            for (int i = 0; i != (1 << 16); ++i)
+                queries.push_back(((uint64_t)std::rand() << 16) ^ (uint64_t)std::rand());
+
+            uint64_t check[2] = {};
+            double seconds[4] = {};
+            auto t0 = std::chrono::steady_clock::now();
+            for (uint64_t q : queries) {
+                auto p = frozen.lower_bound(q);
+                check[0] += (p != frozen.end()) ? *p : 0;
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            for (uint64_t q : queries) {
+                auto p = c.lower_bound(q);
+                check[1] += (p != c.end()) ? *p : 0;
+            }
+            auto t2 = std::chrono::steady_clock::now();
+            assert(check[0] == check[1]);
+            seconds[0] = std::chrono::duration<double>(t1 - t0).count() / queries.size();
+            seconds[1] = std::chrono::duration<double>(t2 - t1).count() / queries.size();
+
+            t0 = std::chrono::steady_clock::now();
+            for (uint64_t k : frozen)
+                check[0] += k;
+            t1 = std::chrono::steady_clock::now();
+            for (uint64_t k : c)
+                check[1] += k;
+            t2 = std::chrono::steady_clock::now();
+            assert(check[0] == check[1]);
+            seconds[2] = std::chrono::duration<double>(t1 - t0).count() / n;
+            seconds[3] = std::chrono::duration<double>(t2 - t1).count() / n;
+
+            printf("%8d %12.1f %12.1f %12.2f %12.2f\n", n,
+                   seconds[0] * 1e9, seconds[1] * 1e9, seconds[2] * 1e9, seconds[3] * 1e9);
+            mutator_repin();
+        }
+
+        unpin_global_epoch(guard);
+        co_return;
+
+    };
+
+} // namespace wry
@@ -0,0 +1,282 @@
+//
+//  flat_frozen_set.hpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#ifndef flat_frozen_set_hpp
+#define flat_frozen_set_hpp
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "concurrent_skiplist.hpp"
+
+namespace wry {
+
+    // Flattened frozen skiplist
+    //
+    // Once published, a frozen skiplist is read-only, but every level of a
+    // search is still a dependent pointer load and, usually, a cache miss.
+    // `compact` copies the keys, in one pass along level zero, into a
+    // sorted array, and adds
+    //
+    //   - an Eytzinger (breadth-first) copy, so that lower_bound descends an
+    //     implicit binary tree whose top levels share a few cache lines, with
+    //     a branch-free loop that prefetches four levels ahead;
+    //
+    //   - optionally, exclusive prefix sums of a weight per key, so that a
+    //     cumulant is one lower_bound and one load;
+    //
+    //   - a Cursor with FrozenCursor's interface over an implicit perfect
+    //     skiplist, in which sorted index i has height 1 + ctz(i + 1), so
+    //     skiplist_partition_frame and the leaf walks of the parallel
+    //     rebuild slice the array unchanged.
+    //
+    // The keys are copied, so mutable key fields (ReadyKey::requested) must
+    // be final before compacting.  Where the weights are not yet final, the
+    // index can be built from the immutable part of each key with `adopt`,
+    // alongside whatever produces the weights, and the prefix sums filled
+    // in afterwards by `coroutine_parallel_prefix`.  Storage is the
+    // ordinary heap: the flat set is a transient view, and must not outlive
+    // the referents of its keys.
+
+    template<typename Key, typename Compare>
+    struct FlatFrozenSet {
+
+        struct Cursor {
+
+            FlatFrozenSet const* _Nullable _set;    // null at the end
+            size_t _position;                       // sorted index + 1; 0 is the head
+            size_t _level;
+
+            bool bottom() const {
+                return _level == 0;
+            }
+
+            Cursor down() const {
+                assert(_level);
+                return Cursor{ _set, _position, _level - 1 };
+            }
+
+            bool end() const {
+                return _set == nullptr;
+            }
+
+            Cursor right() const {
+                assert(_set);
+                size_t next = _position + ((size_t)1 << _level);
+                return Cursor{ (next <= _set->size()) ? _set : nullptr, next, _level };
+            }
+
+            Key const* _Nullable key() const {
+                assert(_set);
+                size_t next = _position + ((size_t)1 << _level);
+                return (next <= _set->size()) ? _set->_keys.data() + (next - 1) : nullptr;
+            }
+
+        }; // struct Cursor
+
+        [[no_unique_address]] Compare _compare;
+        std::vector<Key> _keys;            // sorted
+        std::vector<Key> _eytzinger;       // node k (1-based) at [k - 1]
+        std::vector<uint32_t> _rank;       // sorted index of each Eytzinger node
+        std::vector<int64_t> _prefix;      // exclusive; empty if unweighted
+
+        FlatFrozenSet() = default;
+
+        explicit FlatFrozenSet(Compare comp)
+        : _compare(std::move(comp)) {
+        }
+
+        // Any sorted range: a FrozenSkiplistSet, or a frozen
+        // ConcurrentSkiplistMap with its pair comparator
+        template<typename Range>
+        [[nodiscard]] static FlatFrozenSet compact(Range const& sorted, Compare comp = Compare{}) {
+            FlatFrozenSet result{std::move(comp)};
+            for (auto const& key : sorted)
+                result._keys.push_back(key);
+            result._build_eytzinger();
+            return result;
+        }
+
+        // `weight(key) -> int64_t` is summed into exclusive prefixes
+        template<typename Range, typename Weight>
+        [[nodiscard]] static FlatFrozenSet compact(Range const& sorted, Weight&& weight, Compare comp = Compare{}) {
+            FlatFrozenSet result{std::move(comp)};
+            int64_t sum = 0;
+            for (auto const& key : sorted) {
+                result._keys.push_back(key);
+                result._prefix.push_back(sum);
+                sum += (int64_t)weight(key);
+            }
+            result._prefix.push_back(sum);
+            result._build_eytzinger();
+            return result;
+        }
+
+        // Keys already in sorted order; unweighted until
+        // coroutine_parallel_prefix
+        [[nodiscard]] static FlatFrozenSet adopt(std::vector<Key> sorted, Compare comp = Compare{}) {
+            FlatFrozenSet result{std::move(comp)};
+            result._keys = std::move(sorted);
+            result._build_eytzinger();
+            return result;
+        }
+
+        // `weight(i) -> int64_t` for sorted index i is summed into exclusive
+        // prefixes, a block per task: each block sums its own prefixes, a
+        // pass over the block totals finds their bases, and each block then
+        // adds its base
+        static constexpr size_t PREFIX_BLOCK = 4096;
+
+        template<typename Weight> [[nodiscard]] Coroutine::Task
+        coroutine_parallel_prefix(Weight weight) {
+            size_t n = _keys.size();
+            _prefix.assign(n + 1, 0);
+            size_t blocks = (n + PREFIX_BLOCK - 1) / PREFIX_BLOCK;
+            std::vector<int64_t> totals(blocks, 0);
+            {
+                Coroutine::Nursery nursery;
+                for (size_t b = 0; b != blocks; ++b)
+                    co_await nursery.fork(_coroutine_block_prefix(b, weight, totals[b]));
+                co_await nursery.join();
+            }
+            int64_t base = 0;
+            for (int64_t& total : totals)
+                base += std::exchange(total, base);
+            _prefix[n] = base;
+            {
+                Coroutine::Nursery nursery;
+                for (size_t b = 1; b < blocks; ++b)
+                    co_await nursery.fork(_coroutine_block_rebase(b, totals[b]));
+                co_await nursery.join();
+            }
+        }
+
+        template<typename Weight> [[nodiscard]] Coroutine::Task
+        _coroutine_block_prefix(size_t block, Weight const& weight, int64_t& total) {
+            size_t first = block * PREFIX_BLOCK;
+            size_t last = std::min(first + PREFIX_BLOCK, _keys.size());
+            int64_t sum = 0;
+            for (size_t i = first; i != last; ++i) {
+                _prefix[i] = sum;
+                sum += (int64_t)weight(i);
+            }
+            total = sum;
+            co_return;
+        }
+
+        [[nodiscard]] Coroutine::Task
+        _coroutine_block_rebase(size_t block, int64_t base) {
+            size_t first = block * PREFIX_BLOCK;
+            size_t last = std::min(first + PREFIX_BLOCK, _keys.size());
+            for (size_t i = first; i != last; ++i)
+                _prefix[i] += base;
+            co_return;
+        }
+
+        void _build_eytzinger() {
+            size_t n = _keys.size();
+            assert(n < UINT32_MAX);
+            _rank.assign(n, 0);
+            // An in-order walk of the implicit tree visits the nodes in
+            // sorted order
+            uint32_t i = 0;
+            size_t k = n ? 1 : 0;
+            while (k) {
+                while (2 * k <= n)
+                    k = 2 * k;
+                for (;;) {
+                    _rank[k - 1] = i++;
+                    if (2 * k + 1 <= n) {
+                        k = 2 * k + 1;
+                        break;
+                    }
+                    // Climb past the right children to the next ancestor
+                    k >>= std::countr_one(k) + 1;
+                    if (!k)
+                        break;
+                }
+            }
+            assert(i == n);
+            _eytzinger.clear();
+            _eytzinger.reserve(n);
+            for (size_t s = 0; s != n; ++s)
+                _eytzinger.push_back(_keys[_rank[s]]);
+        }
+
+        [[nodiscard]] size_t size() const { return _keys.size(); }
+        [[nodiscard]] bool is_empty() const { return _keys.empty(); }
+
+        [[nodiscard]] Key const& operator[](size_t i) const {
+            assert(i < _keys.size());
+            return _keys[i];
+        }
+
+        [[nodiscard]] Key const* begin() const { return _keys.data(); }
+        [[nodiscard]] Key const* end() const { return _keys.data() + _keys.size(); }
+
+        // Sorted index of the first key not less than `query`, or size()
+        template<typename Query> [[nodiscard]] size_t
+        lower_bound_index(Query const& query) const {
+            size_t n = _eytzinger.size();
+            Key const* e = _eytzinger.data();
+            size_t k = 1;
+            while (k <= n) {
+                // Sixteen descendants four levels down share a line or two
+                __builtin_prefetch(e + std::min(16 * k, n) - 1);
+                k = 2 * k + (size_t)_compare(e[k - 1], query);
+            }
+            // Undo the trailing right turns, and the left turn before them
+            k >>= std::countr_one(k) + 1;
+            return k ? _rank[k - 1] : n;
+        }
+
+        template<typename Query> [[nodiscard]] Key const*
+        lower_bound(Query const& query) const {
+            return begin() + lower_bound_index(query);
+        }
+
+        // Sorted index of the key equivalent to `query`, or size()
+        template<typename Query> [[nodiscard]] size_t
+        find_index(Query const& query) const {
+            size_t i = lower_bound_index(query);
+            return ((i != size()) && !_compare(query, _keys[i])) ? i : size();
+        }
+
+        template<typename Query> [[nodiscard]] Key const*
+        find(Query const& query) const {
+            return begin() + find_index(query);
+        }
+
+        // Weight of the keys before sorted index i; i == size() is the total
+        [[nodiscard]] int64_t prefix(size_t i) const {
+            assert(i < _prefix.size());
+            return _prefix[i];
+        }
+
+        [[nodiscard]] int64_t weight(size_t i) const {
+            return prefix(i + 1) - prefix(i);
+        }
+
+        [[nodiscard]] int64_t total() const {
+            return _prefix.empty() ? 0 : _prefix.back();
+        }
+
+        [[nodiscard]] Cursor make_cursor() const {
+            size_t n = _keys.size();
+            size_t top = n ? (size_t)(std::bit_width(n) - 1) : 0;
+            return Cursor{ this, 0, top };
+        }
+
+    }; // struct FlatFrozenSet
+
+} // namespace wry
+
+#endif /* flat_frozen_set_hpp */
@@ -5,11 +5,140 @@
 //  Created by Antony Searle on 31/5/2026.
 //
 
+#include <chrono>
+#include <random>
+#include <vector>
+
 #include "persistent_array.hpp"
 #include "test.hpp"
 
 namespace wry {
 
+    namespace {
+
+        // The flat placeholder that PersistentArray replaced, kept as a
+        // benchmark baseline: every operation copies the whole array
+        template<typename T>
+        struct FlatPersistentArray : GarbageCollected {
+
+            std::size_t _size;
+            T _elements[] __counted_by(_size);
+
+            static void* _Nonnull operator new(std::size_t, void* _Nonnull ptr) {
+                return ptr;
+            }
+
+            virtual void _garbage_collected_debug() const override {
+                printf("%s\n", __PRETTY_FUNCTION__);
+            }
+
+            virtual void _garbage_collected_scan() const override {
+                using wry::garbage_collected_scan;
+                for (std::size_t i = 0; i != _size; ++i)
+                    garbage_collected_scan(_elements[i]);
+            }
+
+            ~FlatPersistentArray() override {
+                std::destroy_n(_elements, _size);
+            }
+
+            explicit FlatPersistentArray(std::size_t n) : _size(n) {}
+
+            static auto _allocate(std::size_t n) -> FlatPersistentArray* _Nonnull {
+                void* _Nonnull p = GarbageCollected::operator new(sizeof(FlatPersistentArray) + n * sizeof(T));
+                return new(p) FlatPersistentArray(n);
+            }
+
+            static auto size(FlatPersistentArray const* _Nullable a) -> std::size_t {
+                return a ? a->_size : 0;
+            }
+
+            static auto at(FlatPersistentArray const* _Nonnull a, std::size_t i) -> T {
+                return a->_elements[i];
+            }
+
+            static auto set(FlatPersistentArray const* _Nonnull a, std::size_t i, T value) -> FlatPersistentArray const* {
+                FlatPersistentArray* r = _allocate(a->_size);
+                std::uninitialized_copy_n(a->_elements, a->_size, r->_elements);
+                r->_elements[i] = std::move(value);
+                return r;
+            }
+
+            static auto push_back(FlatPersistentArray const* _Nullable a, T value) -> FlatPersistentArray const* {
+                std::size_t n = size(a);
+                FlatPersistentArray* r = _allocate(n + 1);
+                if (n)
+                    std::uninitialized_copy_n(a->_elements, n, r->_elements);
+                std::construct_at(r->_elements + n, std::move(value));
+                return r;
+            }
+
+            static auto cat(FlatPersistentArray const* _Nullable a, FlatPersistentArray const* _Nullable b) -> FlatPersistentArray const* {
+                std::size_t na = size(a);
+                std::size_t nb = size(b);
+                if (!na)
+                    return b;
+                if (!nb)
+                    return a;
+                FlatPersistentArray* r = _allocate(na + nb);
+                std::uninitialized_copy_n(a->_elements, na, r->_elements);
+                std::uninitialized_copy_n(b->_elements, nb, r->_elements + na);
+                return r;
+            }
+
+            static auto split(FlatPersistentArray const* _Nonnull a, std::size_t i)
+            -> std::pair<FlatPersistentArray const*, FlatPersistentArray const*> {
+                FlatPersistentArray* l = _allocate(i);
+                FlatPersistentArray* r = _allocate(a->_size - i);
+                std::uninitialized_copy_n(a->_elements, i, l->_elements);
+                std::uninitialized_copy_n(a->_elements + i, a->_size - i, r->_elements);
+                return { l, r };
+            }
+
+        };
+
+        // Keeps the timed lookups live under NDEBUG
+        std::uint64_t persistent_array_sink = 0;
+
+        // The same operation mix on either sequence, in ns per op
+        template<typename A>
+        void persistent_array_benchmark_one(const char* name, std::size_t n) {
+            std::mt19937_64 rng(n);
+            auto lap = [t = std::chrono::steady_clock::now()](std::size_t ops) mutable {
+                auto t1 = std::chrono::steady_clock::now();
+                double ns = std::chrono::duration<double>(t1 - t).count() * 1e9 / ops;
+                t = t1;
+                return ns;
+            };
+            double ns[5];
+            A const* a = nullptr;
+            lap(1);
+            for (std::size_t i = 0; i != n; ++i)
+                a = A::push_back(a, i);
+            ns[0] = lap(n);
+            std::uint64_t check = 0;
+            for (std::size_t i = 0; i != n; ++i)
+                check += A::at(a, rng() % n);
+            ns[1] = lap(n);
+            A const* b = a;
+            for (std::size_t i = 0; i != 1024; ++i)
+                b = A::set(b, rng() % n, i);
+            ns[2] = lap(1024);
+            for (std::size_t i = 0; i != 256; ++i) {
+                auto [l, r] = A::split(a, 1 + rng() % (n - 1));
+                check += A::size(l);
+            }
+            ns[3] = lap(256);
+            for (std::size_t i = 0; i != 256; ++i)
+                check += A::size(A::cat(a, b));
+            ns[4] = lap(256);
+            persistent_array_sink += check;
+            printf("%20s %8zu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                   name, n, ns[0], ns[1], ns[2], ns[3], ns[4]);
+        }
+
+    } // anonymous namespace
+
     // Smoke test for the PersistentArray placeholder sequence.  A "sequence" is
     // a (possibly null) node pointer the caller rebinds; the static ops build
     // new nodes and return new tops.
@@ -96,4 +225,133 @@ namespace wry {
         co_return;
     };
 
+    define_test("PersistentArray_rrb") {
+
+        using A = PersistentArray<std::uint64_t>;
+
+        auto check = [](A const* a, std::vector<std::uint64_t> const& b) {
+            assert(A::size(a) == b.size());
+            std::size_t i = 0;
+            A::for_each(a, [&](std::uint64_t x) {
+                assert(x == b[i]);
+                ++i;
+            });
+            assert(i == b.size());
+            for (std::size_t j = 0; j < b.size(); j += 1 + j / 16)
+                assert(A::at(a, j) == b[j]);
+        };
+
+        // Against std::vector, with enough concatenation and slicing to
+        // build deep relaxed trees
+        {
+            std::mt19937_64 rng(1);
+            std::vector<A const*> as = { nullptr };
+            std::vector<std::vector<std::uint64_t>> bs = { {} };
+            for (int iter = 0; iter != 4000; ++iter) {
+                std::size_t k = rng() % as.size();
+                A const* a = as[k];
+                std::vector<std::uint64_t> b = bs[k];
+                switch (rng() % 6) {
+                    case 0: {
+                        std::size_t n = rng() % 1000;
+                        for (std::size_t i = 0; i != n; ++i) {
+                            a = A::push_back(a, rng());
+                            b.push_back(A::back(a));
+                        }
+                        break;
+                    }
+                    case 1:
+                        for (std::size_t n = rng() % 40; n-- && !b.empty();) {
+                            a = A::pop_back(a);
+                            b.pop_back();
+                        }
+                        break;
+                    case 2:
+                        if (!b.empty()) {
+                            std::size_t i = rng() % b.size();
+                            b[i] = rng();
+                            a = A::set(a, i, b[i]);
+                        }
+                        break;
+                    case 3: {
+                        std::size_t j = rng() % as.size();
+                        a = A::cat(a, as[j]);
+                        b.insert(b.end(), bs[j].begin(), bs[j].end());
+                        break;
+                    }
+                    case 4: {
+                        std::size_t first = rng() % (b.size() + 1);
+                        std::size_t last = first + rng() % (b.size() - first + 1);
+                        a = A::slice(a, first, last);
+                        b = std::vector<std::uint64_t>(b.begin() + first, b.begin() + last);
+                        break;
+                    }
+                    case 5: {
+                        std::size_t i = rng() % (b.size() + 1);
+                        auto [l, r] = A::split(a, i);
+                        check(l, std::vector<std::uint64_t>(b.begin(), b.begin() + i));
+                        a = A::cat(r, l);
+                        std::rotate(b.begin(), b.begin() + i, b.end());
+                        break;
+                    }
+                }
+                check(a, b);
+                check(as[k], bs[k]);    // the source is untouched
+                if (b.size() < 200000) {
+                    as.push_back(a);
+                    bs.push_back(std::move(b));
+                }
+                if (as.size() > 64) {
+                    std::size_t j = 1 + rng() % (as.size() - 1);
+                    as.erase(as.begin() + j);
+                    bs.erase(bs.begin() + j);
+                }
+            }
+        }
+
+        mutator_repin();
+
+        // A Transient edits its own nodes in place and copies the rest
+        {
+            std::vector<std::uint64_t> b;
+            A::Transient t;
+            for (std::uint64_t i = 0; i != 5000; ++i) {
+                t.push_back(i);
+                b.push_back(i);
+            }
+            A const* a = t.persistent();
+            check(a, b);
+            for (std::uint64_t i = 0; i < 5000; i += 7)
+                t.set(i, ~i);
+            t.push_back(5000);
+            check(a, b);                // frozen before the edits
+            A const* c = t.persistent();
+            assert(A::size(c) == 5001);
+            for (std::uint64_t i = 0; i != 5001; ++i)
+                assert(A::at(c, i) == ((i % 7) ? i : ~i));
+
+            A::Transient u(A::cat(a, a));
+            for (std::uint64_t i = 0; i != 10000; ++i)
+                u.set(i, i + 1);
+            A const* d = u.persistent();
+            for (std::uint64_t i = 0; i != 10000; ++i)
+                assert(A::at(d, i) == i + 1 && u.at(i) == i + 1);
+            check(a, b);
+        }
+
+        mutator_repin();
+
+        // RRB against the flat placeholder
+        printf("PersistentArray (ns per op)\n");
+        printf("%20s %8s %10s %10s %10s %10s %10s\n", "", "size", "push_back", "at", "set", "split", "cat");
+        for (std::size_t n : {1 << 8, 1 << 12}) {
+            persistent_array_benchmark_one<FlatPersistentArray<std::uint64_t>>("flat", n);
+            mutator_repin();
+            persistent_array_benchmark_one<PersistentArray<std::uint64_t>>("RRB", n);
+            mutator_repin();
+        }
+
+        co_return;
+    };
+
 } // namespace wry
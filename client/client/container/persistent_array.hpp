@@ -8,34 +8,49 @@
 #ifndef persistent_array_hpp
 #define persistent_array_hpp
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <utility>
 
 #include "assert.hpp"
+#include "atomic.hpp"
 #include "garbage_collected.hpp"
 #include "utility.hpp"
 
 namespace wry {
 
-    // PersistentArray<T> -- an immutable, contiguous, garbage-collected array.
+    // Source of Transient edit tokens; zero is never issued, and marks a
+    // node as frozen
+    constinit inline Atomic<std::uint64_t> _persistent_array_edit_source{1};
+
+    // PersistentArray<T> -- an immutable, garbage-collected sequence.
+    //
+    // A Relaxed Radix Balanced tree (Bagwell and Rompf; L'orange).  Leaves
+    // hold up to 32 elements and branches up to 32 children.  A branch
+    // whose children are all full but the last is regular, and indexes by
+    // shifting; concatenation and slicing leave underfull children behind,
+    // and such relaxed branches also keep cumulative child sizes, which a
+    // lookup scans forward from the radix guess.  The last 1...32 elements
+    // live in a separate tail leaf, so push_back and pop_back usually copy
+    // one leaf and touch the tree once per 32.
     //
-    // This is the deliberately-dumb placeholder for a persistent sequence: it
-    // stores its elements in a flexible array member and every operation
-    // (push/pop at either end, split, cat) allocates a fresh node and copies,
-    // so they are all O(n).  The point is to establish the USAGE of a
-    // persistent deque/sequence cheaply; once the call sites tell us which
-    // operations actually matter we can swap in an asymptotically better
-    // structure (finger tree / order-statistic B+ / RRB) behind a similar
-    // interface.
+    //   at, set                O(log32 n)
+    //   push_back, pop_back    amortised O(1)
+    //   cat, split, slice      O(log n), copying O(1) nodes per level
+    //   push_front, pop_front  O(log n), by cat and slice
     //
     // Like PersistentStack, there is no wrapper object: a sequence IS a
-    // (possibly null) `PersistentArray<T> const*` that the caller owns and
-    // rebinds, null meaning empty.  A live node therefore always has
-    // `_size >= 1`.  The static operations build new nodes and return new
-    // tops; nothing mutates a published node.  The node is built mutably while
-    // still unpublished, then reached through pointer-to-const -- the
-    // setup-then-freeze discipline in miniature.
+    // (possibly null) `PersistentArray<T> const*` header that the caller
+    // owns and rebinds, null meaning empty.  A live header therefore always
+    // has `_size >= 1`.  The static operations path-copy and return new
+    // headers; nothing mutates a published node.
+    //
+    // A Transient builds or batch-edits a sequence in place, editing only
+    // the nodes it allocated itself.  Those nodes are not yet published to
+    // the collector, so a Transient must not be held across
+    // mutator_repin() or unpin.
     //
     // T is assumed nothrow-constructible; the multi-step builds below are not
     // exception-safe for a throwing T (the realistic payloads -- Term,
@@ -44,14 +59,69 @@ namespace wry {
     template<typename T>
     struct PersistentArray : GarbageCollected {
 
-        std::size_t _size;
-        T _elements[] __counted_by(_size);
+        static constexpr int BITS = 5;
+        static constexpr std::size_t WIDTH = std::size_t{1} << BITS;
 
-        // Placement new, declared locally so it is not hidden by the inherited
-        // GarbageCollected allocator (see the placement-new lookup gotcha).
-        static void* _Nonnull operator new(std::size_t, void* _Nonnull ptr) {
-            return ptr;
-        }
+        // Concatenation leaves at most this many more nodes per level than
+        // a perfect packing; more slack is cheaper to concatenate but slower
+        // to index
+        static constexpr std::size_t EXTRAS = 2;
+
+        struct _Node : GarbageCollected {
+            std::uint64_t _edit = 0;    // token of the owning Transient, or 0
+            std::uint32_t _count = 0;   // elements or children
+        };
+
+        struct _Leaf : _Node {
+
+            union { T _elements[WIDTH]; };
+
+            explicit _Leaf(std::uint64_t edit) {
+                this->_edit = edit;
+            }
+
+            ~_Leaf() override {
+                std::destroy_n(_elements, this->_count);
+            }
+
+            virtual void _garbage_collected_debug() const override {
+                printf("%s\n", __PRETTY_FUNCTION__);
+            }
+
+            virtual void _garbage_collected_scan() const override {
+                using wry::garbage_collected_scan;
+                for (std::uint32_t i = 0; i != this->_count; ++i)
+                    garbage_collected_scan(_elements[i]);
+            }
+
+        };
+
+        struct _Branch : _Node {
+
+            bool _is_relaxed = false;               // a child before the last is not full
+            std::size_t _sizes[WIDTH];              // cumulative element counts
+            _Node const* _Nonnull _children[WIDTH];
+
+            explicit _Branch(std::uint64_t edit) {
+                this->_edit = edit;
+            }
+
+            virtual void _garbage_collected_debug() const override {
+                printf("%s\n", __PRETTY_FUNCTION__);
+            }
+
+            virtual void _garbage_collected_scan() const override {
+                using wry::garbage_collected_scan;
+                for (std::uint32_t i = 0; i != this->_count; ++i)
+                    garbage_collected_scan(_children[i]);
+            }
+
+        };
+
+        std::size_t _size;
+        int _shift;                         // BITS times the height of _root
+        _Node const* _Nullable _root;       // all but the tail; a leaf if _shift == 0
+        _Leaf const* _Nonnull _tail;        // the last 1...WIDTH elements
 
         virtual void _garbage_collected_debug() const override {
             printf("%s\n", __PRETTY_FUNCTION__);
@@ -59,12 +129,8 @@ namespace wry {
 
         virtual void _garbage_collected_scan() const override {
             using wry::garbage_collected_scan;
-            for (std::size_t i = 0; i != _size; ++i)
-                garbage_collected_scan(_elements[i]);
-        }
-
-        ~PersistentArray() override {
-            std::destroy_n(_elements, _size);
+            garbage_collected_scan(_root);
+            garbage_collected_scan(_tail);
         }
 
         // -- queries --
@@ -81,7 +147,11 @@ namespace wry {
         [[nodiscard]] static auto at(PersistentArray const* _Nonnull a, std::size_t i) -> T {
             assert(a);
             assert(i < a->_size);
-            return a->_elements[i];
+            std::size_t offset = a->_size - a->_tail->_count;
+            if (i >= offset)
+                return a->_tail->_elements[i - offset];
+            _Leaf const* leaf = _leaf_at(a->_root, a->_shift, i);
+            return leaf->_elements[i];
         }
 
         // Precondition: non-empty.
@@ -91,7 +161,17 @@ namespace wry {
 
         [[nodiscard]] static auto back(PersistentArray const* _Nonnull a) -> T {
             assert(a);
-            return at(a, a->_size - 1);
+            return a->_tail->_elements[a->_tail->_count - 1];
+        }
+
+        // Visit the elements in order, a leaf at a time
+        static void for_each(PersistentArray const* _Nullable a, auto&& f) {
+            if (!a)
+                return;
+            if (a->_root)
+                _for_each(a->_root, a->_shift, f);
+            for (std::uint32_t i = 0; i != a->_tail->_count; ++i)
+                f(a->_tail->_elements[i]);
         }
 
         // -- construction --
@@ -100,57 +180,75 @@ namespace wry {
         // sequence.
         [[nodiscard]] static auto
         from(T const* _Nullable first, std::size_t count) -> PersistentArray const* _Nullable {
-            if (!count)
-                return nullptr;
-            PersistentArray* a = _allocate(count);
-            std::uninitialized_copy_n(first, count, a->_elements);
-            return a;
+            Transient t;
+            for (std::size_t i = 0; i != count; ++i)
+                t.push_back(first[i]);
+            return t.persistent();
+        }
+
+        // Replace the element at i.  Precondition: i < size.
+        [[nodiscard]] static auto
+        set(PersistentArray const* _Nonnull a, std::size_t i, T value) -> PersistentArray const* _Nonnull {
+            assert(a);
+            assert(i < a->_size);
+            std::size_t offset = a->_size - a->_tail->_count;
+            if (i >= offset) {
+                _Leaf* tail = _editable(a->_tail, 0);
+                tail->_elements[i - offset] = std::move(value);
+                return _make(a->_size, a->_shift, a->_root, tail);
+            }
+            return _make(a->_size, a->_shift, _set(a->_root, a->_shift, i, std::move(value), 0), a->_tail);
         }
 
         // -- deque --
 
         [[nodiscard]] static auto
         push_back(PersistentArray const* _Nullable a, T value) -> PersistentArray const* _Nonnull {
-            std::size_t n = size(a);
-            PersistentArray* r = _allocate(n + 1);
-            if (n)
-                std::uninitialized_copy_n(a->_elements, n, r->_elements);
-            std::construct_at(r->_elements + n, std::move(value));
-            return r;
+            if (!a) {
+                _Leaf* tail = new _Leaf(0);
+                std::construct_at(tail->_elements, std::move(value));
+                tail->_count = 1;
+                return _make(1, 0, nullptr, tail);
+            }
+            _Node const* root = a->_root;
+            int shift = a->_shift;
+            _Leaf* tail;
+            if (a->_tail->_count < WIDTH) {
+                tail = _editable(a->_tail, 0);
+            } else {
+                _append_leaf(root, shift, a->_tail, 0);
+                tail = new _Leaf(0);
+            }
+            std::construct_at(tail->_elements + tail->_count, std::move(value));
+            ++tail->_count;
+            return _make(a->_size + 1, shift, root, tail);
         }
 
         [[nodiscard]] static auto
         push_front(PersistentArray const* _Nullable a, T value) -> PersistentArray const* _Nonnull {
-            std::size_t n = size(a);
-            PersistentArray* r = _allocate(n + 1);
-            std::construct_at(r->_elements, std::move(value));
-            if (n)
-                std::uninitialized_copy_n(a->_elements, n, r->_elements + 1);
-            return r;
+            return cat(push_back(nullptr, std::move(value)), a);
         }
 
         // Precondition: non-empty.
         [[nodiscard]] static auto
         pop_back(PersistentArray const* _Nonnull a) -> PersistentArray const* _Nullable {
             assert(a && a->_size);
-            std::size_t n = a->_size - 1;
-            if (!n)
+            if (a->_size == 1)
                 return nullptr;
-            PersistentArray* r = _allocate(n);
-            std::uninitialized_copy_n(a->_elements, n, r->_elements);
-            return r;
+            if (a->_tail->_count > 1)
+                return _make(a->_size - 1, a->_shift, a->_root,
+                             _leaf_slice(a->_tail, 0, a->_tail->_count - 1));
+            _Node const* root = a->_root;
+            int shift = a->_shift;
+            _Leaf const* tail = _detach_tail(root, shift, 0);
+            return _make(a->_size - 1, shift, root, tail);
         }
 
         // Precondition: non-empty.
         [[nodiscard]] static auto
         pop_front(PersistentArray const* _Nonnull a) -> PersistentArray const* _Nullable {
             assert(a && a->_size);
-            std::size_t n = a->_size - 1;
-            if (!n)
-                return nullptr;
-            PersistentArray* r = _allocate(n);
-            std::uninitialized_copy_n(a->_elements + 1, n, r->_elements);
-            return r;
+            return _drop_front(a, 1);
         }
 
         // -- split / cat --
@@ -158,16 +256,36 @@ namespace wry {
         [[nodiscard]] static auto
         cat(PersistentArray const* _Nullable a, PersistentArray const* _Nullable b)
         -> PersistentArray const* _Nullable {
-            std::size_t na = size(a);
-            std::size_t nb = size(b);
-            if (!na)
+            if (!a)
                 return b;
-            if (!nb)
+            if (!b)
                 return a;
-            PersistentArray* r = _allocate(na + nb);
-            std::uninitialized_copy_n(a->_elements, na, r->_elements);
-            std::uninitialized_copy_n(b->_elements, nb, r->_elements + na);
-            return r;
+            std::size_t n = a->_size + b->_size;
+            _Node const* root = a->_root;
+            int shift = a->_shift;
+            if (!b->_root && (a->_tail->_count + b->_tail->_count <= WIDTH)) {
+                // b fits in a's tail
+                _Leaf* tail = _editable(a->_tail, 0);
+                std::uninitialized_copy_n(b->_tail->_elements, b->_tail->_count,
+                                          tail->_elements + tail->_count);
+                tail->_count += b->_tail->_count;
+                return _make(n, shift, root, tail);
+            }
+            _append_leaf(root, shift, a->_tail, 0);
+            if (b->_root) {
+                root = _concat(root, shift, b->_root, b->_shift);
+                shift = std::max(shift, b->_shift) + BITS;
+                _collapse(root, shift);
+            }
+            return _make(n, shift, root, b->_tail);
+        }
+
+        // The elements [first, last).  Precondition: first <= last <= size.
+        [[nodiscard]] static auto
+        slice(PersistentArray const* _Nullable a, std::size_t first, std::size_t last)
+        -> PersistentArray const* _Nullable {
+            assert(first <= last && last <= size(a));
+            return _drop_front(_take_front(a, last), first);
         }
 
         // Split into [0, i) and [i, size).  Precondition: i <= size.  The
@@ -175,28 +293,519 @@ namespace wry {
         [[nodiscard]] static auto
         split(PersistentArray const* _Nullable a, std::size_t i)
         -> std::pair<PersistentArray const* _Nullable, PersistentArray const* _Nullable> {
-            std::size_t n = size(a);
-            assert(i <= n);
-            if (i == 0)
-                return { nullptr, a };
-            if (i == n)
-                return { a, nullptr };
-            PersistentArray* l = _allocate(i);
-            PersistentArray* r = _allocate(n - i);
-            std::uninitialized_copy_n(a->_elements, i, l->_elements);
-            std::uninitialized_copy_n(a->_elements + i, n - i, r->_elements);
-            return { l, r };
+            assert(i <= size(a));
+            return { _take_front(a, i), _drop_front(a, i) };
         }
 
+        // -- transient --
+
+        // A batch-mutable builder.  Nodes stamped with the transient's token
+        // are edited in place, any others are copied on the way, so a run of
+        // k pushes or sets costs about k stores rather than k path copies.
+        // `persistent()` freezes the result and leaves the transient working
+        // on it under a fresh token.
+        class Transient {
+
+            std::uint64_t _edit;
+            std::size_t _size = 0;
+            int _shift = 0;
+            _Node const* _Nullable _root = nullptr;
+            _Leaf const* _Nullable _tail = nullptr;
+
+        public:
+
+            explicit Transient(PersistentArray const* _Nullable a = nullptr)
+            : _edit(_persistent_array_edit_source.fetch_add_relaxed(1)) {
+                if (a) {
+                    _size = a->_size;
+                    _shift = a->_shift;
+                    _root = a->_root;
+                    _tail = a->_tail;
+                }
+            }
+
+            Transient(Transient const&) = delete;
+            Transient& operator=(Transient const&) = delete;
+
+            [[nodiscard]] auto size() const -> std::size_t {
+                return _size;
+            }
+
+            [[nodiscard]] auto at(std::size_t i) const -> T {
+                assert(i < _size);
+                std::size_t offset = _size - _tail->_count;
+                if (i >= offset)
+                    return _tail->_elements[i - offset];
+                return _leaf_at(_root, _shift, i)->_elements[i];
+            }
+
+            void push_back(T value) {
+                _Leaf* tail;
+                if (!_tail) {
+                    tail = new _Leaf(_edit);
+                } else if (_tail->_count == WIDTH) {
+                    _append_leaf(_root, _shift, _tail, _edit);
+                    tail = new _Leaf(_edit);
+                } else {
+                    tail = _editable(_tail, _edit);
+                }
+                std::construct_at(tail->_elements + tail->_count, std::move(value));
+                ++tail->_count;
+                _tail = tail;
+                ++_size;
+            }
+
+            void set(std::size_t i, T value) {
+                assert(i < _size);
+                std::size_t offset = _size - _tail->_count;
+                if (i >= offset) {
+                    _Leaf* tail = _editable(_tail, _edit);
+                    tail->_elements[i - offset] = std::move(value);
+                    _tail = tail;
+                } else {
+                    _root = _set(_root, _shift, i, std::move(value), _edit);
+                }
+            }
+
+            [[nodiscard]] auto persistent() -> PersistentArray const* _Nullable {
+                _edit = _persistent_array_edit_source.fetch_add_relaxed(1);
+                return _size ? _make(_size, _shift, _root, _tail) : nullptr;
+            }
+
+        };
+
     private:
 
-        explicit PersistentArray(std::size_t n) : _size(n) {}
+        PersistentArray(std::size_t n, int shift, _Node const* _Nullable root, _Leaf const* _Nonnull tail)
+        : _size(n)
+        , _shift(shift)
+        , _root(root)
+        , _tail(tail) {
+        }
+
+        [[nodiscard]] static auto
+        _make(std::size_t n, int shift, _Node const* _Nullable root, _Leaf const* _Nonnull tail)
+        -> PersistentArray const* _Nonnull {
+            assert(n == (root ? _size_of(root, shift) : 0) + tail->_count);
+            return new PersistentArray(n, shift, root, tail);
+        }
+
+        static auto _as_leaf(_Node const* _Nonnull node) -> _Leaf const* _Nonnull {
+            return static_cast<_Leaf const*>(node);
+        }
+
+        static auto _as_branch(_Node const* _Nonnull node) -> _Branch const* _Nonnull {
+            return static_cast<_Branch const*>(node);
+        }
+
+        static auto _size_of(_Node const* _Nonnull node, int shift) -> std::size_t {
+            return shift ? _as_branch(node)->_sizes[node->_count - 1] : node->_count;
+        }
+
+        // Recompute the sizes and relaxation of a branch at `shift`
+        static void _update(_Branch* _Nonnull b, int shift) {
+            std::size_t full = std::size_t{1} << shift;
+            std::size_t total = 0;
+            bool relaxed = false;
+            for (std::uint32_t i = 0; i != b->_count; ++i) {
+                std::size_t n = _size_of(b->_children[i], shift - BITS);
+                relaxed = relaxed || ((n != full) && (i + 1 != b->_count));
+                total += n;
+                b->_sizes[i] = total;
+            }
+            b->_is_relaxed = relaxed;
+        }
+
+        // As _update, when only the last child has changed or been appended
+        static void _update_back(_Branch* _Nonnull b, int shift) {
+            std::uint32_t n = b->_count;
+            std::size_t before = (n > 1) ? b->_sizes[n - 2] : 0;
+            b->_sizes[n - 1] = before + _size_of(b->_children[n - 1], shift - BITS);
+            if ((n > 1) && (before - ((n > 2) ? b->_sizes[n - 3] : 0) != (std::size_t{1} << shift)))
+                b->_is_relaxed = true;
+        }
+
+        // The child of `b` holding element i, rebasing i to that child
+        static auto _child_index(_Branch const* _Nonnull b, int shift, std::size_t& i) -> std::uint32_t {
+            // Children hold at most 1 << shift elements, so the radix guess
+            // never overshoots
+            std::uint32_t j = (std::uint32_t)(i >> shift);
+            if (b->_is_relaxed) {
+                while (b->_sizes[j] <= i)
+                    ++j;
+                if (j)
+                    i -= b->_sizes[j - 1];
+            } else {
+                i -= (std::size_t)j << shift;
+            }
+            assert(j < b->_count);
+            return j;
+        }
+
+        static auto _leaf_at(_Node const* _Nonnull node, int shift, std::size_t& i) -> _Leaf const* _Nonnull {
+            for (; shift; shift -= BITS) {
+                _Branch const* b = _as_branch(node);
+                node = b->_children[_child_index(b, shift, i)];
+            }
+            return _as_leaf(node);
+        }
+
+        static void _for_each(_Node const* _Nonnull node, int shift, auto& f) {
+            if (!shift) {
+                _Leaf const* leaf = _as_leaf(node);
+                for (std::uint32_t i = 0; i != leaf->_count; ++i)
+                    f(leaf->_elements[i]);
+                return;
+            }
+            _Branch const* b = _as_branch(node);
+            for (std::uint32_t i = 0; i != b->_count; ++i)
+                _for_each(b->_children[i], shift - BITS, f);
+        }
+
+        // The node itself if the edit token owns it, else a copy that it does
+        static auto _editable(_Leaf const* _Nonnull leaf, std::uint64_t edit) -> _Leaf* _Nonnull {
+            if (edit && (leaf->_edit == edit))
+                return const_cast<_Leaf*>(leaf);
+            _Leaf* r = new _Leaf(edit);
+            std::uninitialized_copy_n(leaf->_elements, leaf->_count, r->_elements);
+            r->_count = leaf->_count;
+            return r;
+        }
+
+        static auto _editable(_Branch const* _Nonnull b, std::uint64_t edit) -> _Branch* _Nonnull {
+            if (edit && (b->_edit == edit))
+                return const_cast<_Branch*>(b);
+            _Branch* r = new _Branch(edit);
+            std::copy_n(b->_sizes, b->_count, r->_sizes);
+            std::copy_n(b->_children, b->_count, r->_children);
+            r->_count = b->_count;
+            r->_is_relaxed = b->_is_relaxed;
+            return r;
+        }
+
+        // A new leaf holding the elements [first, last) of `leaf`
+        static auto _leaf_slice(_Leaf const* _Nonnull leaf, std::size_t first, std::size_t last) -> _Leaf* _Nonnull {
+            assert(first < last && last <= leaf->_count);
+            _Leaf* r = new _Leaf(0);
+            std::uninitialized_copy(leaf->_elements + first, leaf->_elements + last, r->_elements);
+            r->_count = (std::uint32_t)(last - first);
+            return r;
+        }
+
+        static auto _set(_Node const* _Nonnull node, int shift, std::size_t i, T&& value, std::uint64_t edit)
+        -> _Node const* _Nonnull {
+            if (!shift) {
+                _Leaf* r = _editable(_as_leaf(node), edit);
+                r->_elements[i] = std::move(value);
+                return r;
+            }
+            _Branch const* b = _as_branch(node);
+            std::uint32_t j = _child_index(b, shift, i);
+            _Node const* child = _set(b->_children[j], shift - BITS, i, std::move(value), edit);
+            _Branch* r = _editable(b, edit);
+            r->_children[j] = child;
+            return r;
+        }
+
+        // Wrap `node` in single-child branches from shift `from` up to `to`
+        static auto _new_path(_Node const* _Nonnull node, int from, int to, std::uint64_t edit) -> _Node const* _Nonnull {
+            while (from < to) {
+                _Branch* b = new _Branch(edit);
+                b->_children[0] = node;
+                b->_count = 1;
+                from += BITS;
+                _update(b, from);
+                node = b;
+            }
+            return node;
+        }
+
+        // Append a leaf to the rightmost path of `b`, or null if it is full
+        static auto _push_leaf(_Branch const* _Nonnull b, int shift, _Leaf const* _Nonnull leaf, std::uint64_t edit)
+        -> _Branch* _Nullable {
+            if (shift > BITS) {
+                _Branch const* last = _as_branch(b->_children[b->_count - 1]);
+                if (_Branch* child = _push_leaf(last, shift - BITS, leaf, edit)) {
+                    _Branch* r = _editable(b, edit);
+                    r->_children[r->_count - 1] = child;
+                    _update_back(r, shift);
+                    return r;
+                }
+            }
+            if (b->_count == WIDTH)
+                return nullptr;
+            _Branch* r = _editable(b, edit);
+            r->_children[r->_count++] = _new_path(leaf, 0, shift - BITS, edit);
+            _update_back(r, shift);
+            return r;
+        }
+
+        // Append a leaf to a tree, growing it if necessary
+        static void _append_leaf(_Node const* _Nullable& root, int& shift, _Leaf const* _Nonnull leaf, std::uint64_t edit) {
+            if (!root) {
+                root = leaf;
+                shift = 0;
+                return;
+            }
+            if (shift) {
+                if (_Branch* r = _push_leaf(_as_branch(root), shift, leaf, edit)) {
+                    root = r;
+                    return;
+                }
+            }
+            _Branch* r = new _Branch(edit);
+            r->_children[0] = root;
+            r->_children[1] = _new_path(leaf, 0, shift, edit);
+            r->_count = 2;
+            shift += BITS;
+            _update(r, shift);
+            root = r;
+        }
+
+        // Remove the rightmost leaf of `b`, or return null if none remain
+        static auto _pop_leaf(_Branch const* _Nonnull b, int shift, std::uint64_t edit) -> _Branch* _Nullable {
+            if (shift > BITS) {
+                _Branch const* last = _as_branch(b->_children[b->_count - 1]);
+                if (_Branch* child = _pop_leaf(last, shift - BITS, edit)) {
+                    _Branch* r = _editable(b, edit);
+                    r->_children[r->_count - 1] = child;
+                    _update_back(r, shift);
+                    return r;
+                }
+            }
+            if (b->_count == 1)
+                return nullptr;
+            _Branch* r = _editable(b, edit);
+            --r->_count;
+            _update(r, shift);
+            return r;
+        }
+
+        // Strip single-child branches from the top of a tree
+        static void _collapse(_Node const* _Nullable& root, int& shift) {
+            if (!root)
+                shift = 0;
+            while (shift && (root->_count == 1)) {
+                root = _as_branch(root)->_children[0];
+                shift -= BITS;
+            }
+        }
+
+        // Remove the rightmost leaf of a nonempty tree, to become the tail
+        static auto _detach_tail(_Node const* _Nullable& root, int& shift, std::uint64_t edit) -> _Leaf const* _Nonnull {
+            assert(root);
+            _Node const* node = root;
+            for (int s = shift; s; s -= BITS)
+                node = _as_branch(node)->_children[node->_count - 1];
+            root = shift ? _pop_leaf(_as_branch(root), shift, edit) : nullptr;
+            _collapse(root, shift);
+            return _as_leaf(node);
+        }
+
+        // -- concatenation --
+        //
+        // The trees are zipped together down their facing edges.  At each
+        // level the children along the seam are gathered and, if there are
+        // more than EXTRAS beyond the fewest that could hold them, runs of
+        // underfull nodes are repacked; nodes already the planned size are
+        // shared.
+
+        // Concatenate two trees, returning a branch one level above the
+        // taller, with one or two children
+        static auto _concat(_Node const* _Nonnull left, int lshift, _Node const* _Nonnull right, int rshift)
+        -> _Branch* _Nonnull {
+            if (lshift > rshift) {
+                _Branch const* l = _as_branch(left);
+                _Branch* middle = _concat(l->_children[l->_count - 1], lshift - BITS, right, rshift);
+                return _rebalance(l, middle, nullptr, lshift);
+            }
+            if (lshift < rshift) {
+                _Branch const* r = _as_branch(right);
+                _Branch* middle = _concat(left, lshift, r->_children[0], rshift - BITS);
+                return _rebalance(nullptr, middle, r, rshift);
+            }
+            if (!lshift) {
+                _Branch* b = new _Branch(0);
+                b->_children[0] = left;
+                b->_children[1] = right;
+                b->_count = 2;
+                _update(b, BITS);
+                return b;
+            }
+            _Branch const* l = _as_branch(left);
+            _Branch const* r = _as_branch(right);
+            _Branch* middle = _concat(l->_children[l->_count - 1], lshift - BITS, r->_children[0], rshift - BITS);
+            return _rebalance(l, middle, r, lshift);
+        }
 
-        // Allocate a node sized for n elements via the GC allocator, then
-        // placement-new the header.  The caller constructs the n elements.
-        [[nodiscard]] static auto _allocate(std::size_t n) -> PersistentArray* _Nonnull {
-            void* _Nonnull p = GarbageCollected::operator new(sizeof(PersistentArray) + n * sizeof(T));
-            return new(p) PersistentArray(n);
+        // Merge the children of left (all but its last), middle and right
+        // (all but its first), which are at shift - BITS, into one or two
+        // branches at shift under a new branch
+        static auto _rebalance(_Branch const* _Nullable left, _Branch const* _Nonnull middle,
+                               _Branch const* _Nullable right, int shift) -> _Branch* _Nonnull {
+            _Node const* all[2 * WIDTH];
+            std::size_t n = 0;
+            if (left)
+                for (std::uint32_t i = 0; i + 1 < left->_count; ++i)
+                    all[n++] = left->_children[i];
+            for (std::uint32_t i = 0; i != middle->_count; ++i)
+                all[n++] = middle->_children[i];
+            if (right)
+                for (std::uint32_t i = 1; i < right->_count; ++i)
+                    all[n++] = right->_children[i];
+            assert(n <= 2 * WIDTH);
+
+            std::uint32_t counts[2 * WIDTH];
+            std::size_t m = _plan(all, n, counts);
+            _Node const* nodes[2 * WIDTH];
+            _execute(all, counts, m, shift - BITS, nodes);
+
+            _Branch* top = new _Branch(0);
+            for (std::size_t k = 0; k < m; k += WIDTH) {
+                _Branch* b = new _Branch(0);
+                b->_count = (std::uint32_t)std::min(WIDTH, m - k);
+                std::copy_n(nodes + k, b->_count, b->_children);
+                _update(b, shift);
+                top->_children[top->_count++] = b;
+            }
+            _update(top, shift + BITS);
+            return top;
+        }
+
+        // Plan how many slots each of the merged nodes holds, spreading each
+        // underfull node over its successors until few enough remain;
+        // returns the number of nodes
+        static auto _plan(_Node const* const* _Nonnull all, std::size_t n, std::uint32_t* _Nonnull counts) -> std::size_t {
+            std::size_t total = 0;
+            for (std::size_t i = 0; i != n; ++i) {
+                counts[i] = all[i]->_count;
+                total += counts[i];
+            }
+            std::size_t optimal = (total + WIDTH - 1) / WIDTH;
+            std::size_t i = 0;
+            while (n > optimal + EXTRAS) {
+                while (counts[i] > WIDTH - EXTRAS / 2)
+                    ++i;
+                std::size_t remaining = counts[i];
+                do {
+                    std::size_t filled = std::min(remaining + counts[i + 1], WIDTH);
+                    remaining = remaining + counts[i + 1] - filled;
+                    counts[i] = (std::uint32_t)filled;
+                    ++i;
+                } while (remaining);
+                std::copy(counts + i + 1, counts + n, counts + i);
+                --n;
+                --i;
+            }
+            return n;
+        }
+
+        // Build the planned nodes at `shift`, sharing those already the
+        // planned size
+        static void _execute(_Node const* const* _Nonnull all, std::uint32_t const* _Nonnull counts, std::size_t m,
+                             int shift, _Node const** _Nonnull nodes) {
+            std::size_t j = 0;          // next source node
+            std::uint32_t offset = 0;   // its slots already moved
+            for (std::size_t k = 0; k != m; ++k) {
+                if (!offset && (all[j]->_count == counts[k])) {
+                    nodes[k] = all[j++];
+                    continue;
+                }
+                if (shift) {
+                    _Branch* b = new _Branch(0);
+                    while (b->_count != counts[k]) {
+                        _Branch const* source = _as_branch(all[j]);
+                        std::uint32_t moved = std::min(counts[k] - b->_count, source->_count - offset);
+                        std::copy_n(source->_children + offset, moved, b->_children + b->_count);
+                        b->_count += moved;
+                        offset += moved;
+                        if (offset == source->_count) {
+                            ++j;
+                            offset = 0;
+                        }
+                    }
+                    _update(b, shift);
+                    nodes[k] = b;
+                } else {
+                    _Leaf* leaf = new _Leaf(0);
+                    while (leaf->_count != counts[k]) {
+                        _Leaf const* source = _as_leaf(all[j]);
+                        std::uint32_t moved = std::min(counts[k] - leaf->_count, source->_count - offset);
+                        std::uninitialized_copy_n(source->_elements + offset, moved, leaf->_elements + leaf->_count);
+                        leaf->_count += moved;
+                        offset += moved;
+                        if (offset == source->_count) {
+                            ++j;
+                            offset = 0;
+                        }
+                    }
+                    nodes[k] = leaf;
+                }
+            }
+        }
+
+        // -- slicing --
+
+        // The first n elements of a tree; 0 < n <= size
+        static auto _take(_Node const* _Nonnull node, int shift, std::size_t n) -> _Node const* _Nonnull {
+            if (n == _size_of(node, shift))
+                return node;
+            if (!shift)
+                return _leaf_slice(_as_leaf(node), 0, n);
+            _Branch const* b = _as_branch(node);
+            std::size_t i = n - 1;
+            std::uint32_t j = _child_index(b, shift, i);
+            _Branch* r = new _Branch(0);
+            std::copy_n(b->_children, j, r->_children);
+            r->_children[j] = _take(b->_children[j], shift - BITS, i + 1);
+            r->_count = j + 1;
+            _update(r, shift);
+            return r;
+        }
+
+        // All but the first n elements of a tree; 0 <= n < size
+        static auto _drop(_Node const* _Nonnull node, int shift, std::size_t n) -> _Node const* _Nonnull {
+            if (!n)
+                return node;
+            if (!shift)
+                return _leaf_slice(_as_leaf(node), n, node->_count);
+            _Branch const* b = _as_branch(node);
+            std::uint32_t j = _child_index(b, shift, n);
+            _Branch* r = new _Branch(0);
+            r->_children[0] = _drop(b->_children[j], shift - BITS, n);
+            std::copy(b->_children + j + 1, b->_children + b->_count, r->_children + 1);
+            r->_count = b->_count - j;
+            _update(r, shift);
+            return r;
+        }
+
+        static auto _take_front(PersistentArray const* _Nullable a, std::size_t n) -> PersistentArray const* _Nullable {
+            if (!n)
+                return nullptr;
+            if (n == a->_size)
+                return a;
+            std::size_t offset = a->_size - a->_tail->_count;
+            if (n > offset)
+                return _make(n, a->_shift, a->_root, _leaf_slice(a->_tail, 0, n - offset));
+            _Node const* root = _take(a->_root, a->_shift, n);
+            int shift = a->_shift;
+            _collapse(root, shift);
+            _Leaf const* tail = _detach_tail(root, shift, 0);
+            return _make(n, shift, root, tail);
+        }
+
+        static auto _drop_front(PersistentArray const* _Nullable a, std::size_t n) -> PersistentArray const* _Nullable {
+            if (!n)
+                return a;
+            if (n == a->_size)
+                return nullptr;
+            std::size_t offset = a->_size - a->_tail->_count;
+            if (n >= offset)
+                return _make(a->_size - n, 0, nullptr, _leaf_slice(a->_tail, n - offset, a->_tail->_count));
+            _Node const* root = _drop(a->_root, a->_shift, n);
+            int shift = a->_shift;
+            _collapse(root, shift);
+            return _make(a->_size - n, shift, root, a->_tail);
         }
 
     };
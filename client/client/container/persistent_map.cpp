@@ -5,7 +5,12 @@
 //  Created by Antony Searle on 24/11/2024.
 //
 
+#include <chrono>
 #include <cstdlib>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
 
 #include "persistent_map.hpp"
 #include "test.hpp"
@@ -163,6 +168,80 @@ namespace wry {
 
     };
 
+    // Adaptive granularity: the sequential, lazily split and eagerly forked
+    // rebuilds agree, and the parallel for_each visits everything once.
+    // Then the latency of small and large ticks under both policies.
+    define_test("amt_adaptive_rebuild") {
+
+        // Root pin for the whole work tree; see amt_parallel_rebuild.
+        auto guard = pin_global_epoch();
+
+        using A = PersistentMap<uint64_t, int>::AMT;
+        auto combine = [](const int*, const int& m) -> std::optional<int> {
+            if (m < 0)
+                return std::nullopt;
+            return m;
+        };
+        auto make_source = [](uint64_t n, uint64_t stride) {
+            const A* source = nullptr;
+            for (uint64_t k = 0; k != n; ++k)
+                source = A::insert(source, k * stride, (int)k);
+            return source;
+        };
+        auto make_mods = [](uint64_t n, uint64_t stride) {
+            std::vector<std::pair<uint64_t, int>> mods;
+            for (uint64_t k = 0; k != n; ++k)
+                mods.emplace_back(k * stride, (k % 5) ? (int)k : -1);
+            return mods;
+        };
+
+        {
+            const A* source = make_source(1 << 14, 7);
+            auto mods = make_mods(1 << 13, 11);
+            const A* expected = A::rebuild_sequential(source, mods, 0, mods.size(), combine);
+            for (int eager = 0; eager != 2; ++eager) {
+                _global_work_queue_set_eager_forking(eager);
+                const A* result = co_await A::coroutine_parallel_rebuild(
+                    source, mods, 0, mods.size(), combine);
+                std::map<uint64_t, int> a, b;
+                expected->for_each([&a](uint64_t k, int v) { a.emplace(k, v); });
+                result->for_each([&b](uint64_t k, int v) { b.emplace(k, v); });
+                assert(a == b);
+                Atomic<size_t> visited{0};
+                co_await result->coroutine_parallel_for_each([&visited](uint64_t, int) {
+                    visited.fetch_add_relaxed(1);
+                });
+                assert(visited.load_relaxed() == b.size());
+            }
+            _global_work_queue_set_eager_forking(false);
+        }
+
+        printf("amt rebuild latency (us)\n");
+        printf("%8s %10s %10s\n", "mods", "adaptive", "eager");
+        const A* source = make_source(1 << 16, 3);
+        for (uint64_t n : {16, 256, 4096, 1 << 16}) {
+            auto mods = make_mods(n, (1 << 16) * 3 / n);
+            double seconds[2] = {};
+            for (int eager = 0; eager != 2; ++eager) {
+                _global_work_queue_set_eager_forking(eager);
+                constexpr int REPEATS = 16;
+                auto t0 = std::chrono::steady_clock::now();
+                for (int i = 0; i != REPEATS; ++i)
+                    (void) co_await A::coroutine_parallel_rebuild(source, mods, 0, mods.size(), combine);
+                auto t1 = std::chrono::steady_clock::now();
+                seconds[eager] = std::chrono::duration<double>(t1 - t0).count() / REPEATS;
+                mutator_repin();
+            }
+            printf("%8llu %10.1f %10.1f\n",
+                   (unsigned long long)n, seconds[0] * 1e6, seconds[1] * 1e6);
+        }
+        _global_work_queue_set_eager_forking(false);
+
+        unpin_global_epoch(guard);
+        co_return;
+
+    };
+
     // Stage 1 end-to-end: materialize a real ConcurrentSkiplistMap modifier and
     // rebuild a PersistentMap, vs a std::map oracle (+ source immutability).
     define_test("persistentmap_parallel_rebuild") {
@@ -239,6 +318,187 @@ namespace wry {
         co_return;
 
     };
+
+    namespace {
+
+        struct PersistentMapSum {
+            using value_type = uint64_t;
+            static uint64_t identity() { return 0; }
+            static uint64_t leaf(uint64_t, int value) { return (uint64_t)value; }
+            static uint64_t combine(uint64_t a, uint64_t b) { return a + b; }
+        };
+
+        // Keeps the timed loops live under NDEBUG
+        uint64_t persistent_map_sink = 0;
+
+    } // anonymous namespace
+
+    // Rank, select and range folds against a std::map oracle, through set,
+    // erase and rebuild; then what the cache costs and what it buys
+    define_test("PersistentMap_augmented") {
+
+        // Root pin for the whole work tree; see amt_parallel_rebuild.
+        auto guard = pin_global_epoch();
+
+        using PM = PersistentMap<uint64_t, int, DefaultKeyService<uint64_t>, ScanDiscipline, PersistentMapSum>;
+        using Action = ParallelRebuildAction<int>;
+
+        std::mt19937_64 rng(49);
+
+        // A small domain forces depth; a few keys near the top of the word
+        // exercise the inclusive upper end
+        auto random_key = [&rng]() -> uint64_t {
+            uint64_t k = rng() % 3000;
+            return (rng() % 16) ? k : ~k;
+        };
+
+        for (int iter = 0; iter != 200; ++iter) {
+            PM m;
+            std::map<uint64_t, int> oracle;
+            for (int n = (int)(rng() % 400); n--;) {
+                uint64_t k = random_key();
+                int v = (int)(rng() % 1000);
+                m.set(k, v);
+                oracle[k] = v;
+            }
+            for (int n = (int)(rng() % 100); n--;) {
+                uint64_t k = random_key();
+                int _ = {};
+                m.try_erase(k, _);
+                oracle.erase(k);
+            }
+            std::map<uint64_t, Action> mm;
+            for (int n = (int)(rng() % 200); n--;) {
+                uint64_t k = random_key();
+                mm[k] = (rng() % 3) ? Action{Action::WRITE_VALUE, (int)(rng() % 1000)}
+                                    : Action{Action::CLEAR_VALUE, 0};
+            }
+            std::vector<std::pair<uint64_t, Action>> mods(mm.begin(), mm.end());
+            for (auto& [k, a] : mm) {
+                if (a.tag == Action::WRITE_VALUE)
+                    oracle[k] = a.value;
+                else
+                    oracle.erase(k);
+            }
+            m = co_await coroutine_parallel_rebuild_from_mods(m, mods, ParallelRebuildValueCombine<int>{});
+
+            assert(m.size() == oracle.size());
+            size_t k = 0;
+            for (auto [key, value] : oracle) {
+                assert(m.rank(key) == k);
+                assert(m.select(k) == std::make_pair(key, value));
+                ++k;
+            }
+            for (int n = 0; n != 100; ++n) {
+                uint64_t lo = random_key();
+                uint64_t hi = random_key();
+                size_t count = 0;
+                uint64_t sum = 0;
+                for (auto it = oracle.lower_bound(lo); (lo <= hi) && (it != oracle.end()) && (it->first <= hi); ++it) {
+                    ++count;
+                    sum += (uint64_t)it->second;
+                }
+                assert(m.count_in_range(lo, hi) == count);
+                assert(m.fold_range(lo, hi) == sum);
+                assert(m.rank(lo) == (size_t)std::distance(oracle.begin(), oracle.lower_bound(lo)));
+            }
+
+            if (!(iter & 7))
+                mutator_repin();
+        }
+
+        mutator_repin();
+
+        // The cost of maintaining the cache, on a whole build and on a
+        // small tick, against the unaugmented map
+        using Plain = PersistentMap<uint64_t, int>;
+        constexpr uint64_t N = 1 << 16;
+        constexpr int REPEATS = 16;
+        std::vector<std::pair<uint64_t, Action>> build;
+        std::vector<std::pair<uint64_t, Action>> tick;
+        for (uint64_t key = 0; key != N; ++key)
+            build.emplace_back(key * 3, Action{Action::WRITE_VALUE, (int)key});
+        for (uint64_t key = 0; key != 256; ++key)
+            tick.emplace_back(key * 3 * (N / 256), Action{Action::WRITE_VALUE, (int)key + 1});
+        Plain plain;
+        PM augmented;
+        double seconds[2][2] = {};
+        for (int t = 0; t != 2; ++t) {
+            auto const& mods = t ? tick : build;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r) {
+                Plain p = co_await coroutine_parallel_rebuild_from_mods(t ? plain : Plain{}, mods,
+                                                                        ParallelRebuildValueCombine<int>{});
+                persistent_map_sink += (uint64_t)(p._inner != nullptr);
+                if (!t)
+                    plain = p;
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r) {
+                PM a = co_await coroutine_parallel_rebuild_from_mods(t ? augmented : PM{}, mods,
+                                                                     ParallelRebuildValueCombine<int>{});
+                persistent_map_sink += a.size();
+                if (!t)
+                    augmented = a;
+            }
+            auto t2 = std::chrono::steady_clock::now();
+            seconds[t][0] = std::chrono::duration<double>(t1 - t0).count() / REPEATS;
+            seconds[t][1] = std::chrono::duration<double>(t2 - t1).count() / REPEATS;
+            mutator_repin();
+        }
+        printf("rebuild of a 2^16-entry map (us)\n");
+        printf("%8s %10s %10s\n", "mods", "plain", "augmented");
+        printf("%8llu %10.1f %10.1f\n", (unsigned long long)N, seconds[0][0] * 1e6, seconds[0][1] * 1e6);
+        printf("%8d %10.1f %10.1f\n", 256, seconds[1][0] * 1e6, seconds[1][1] * 1e6);
+
+        // Queries over the middle half, by scanning and from the cache
+        {
+            uint64_t lo = N * 3 / 4;
+            uint64_t hi = N * 9 / 4;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r) {
+                size_t count = 0;
+                uint64_t sum = 0;
+                plain.for_each([&](uint64_t key, int value) {
+                    if ((lo <= key) && (key <= hi)) {
+                        ++count;
+                        sum += (uint64_t)value;
+                    }
+                });
+                persistent_map_sink += count + sum;
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r)
+                persistent_map_sink += augmented.count_in_range(lo, hi) + augmented.fold_range(lo, hi);
+            auto t2 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r) {
+                size_t k = N / 2 + (size_t)r;
+                uint64_t found = 0;
+                plain.for_each([&](uint64_t key, int) {
+                    if (!k--)
+                        found = key;
+                });
+                persistent_map_sink += found;
+            }
+            auto t3 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r)
+                persistent_map_sink += augmented.select(N / 2 + (size_t)r).first;
+            auto t4 = std::chrono::steady_clock::now();
+            assert(augmented.count_in_range(lo, hi) == N / 2 + 1);
+            printf("queries on a 2^16-entry map (ns)\n");
+            printf("%16s %10s %10s\n", "", "scan", "augmented");
+            printf("%16s %10.0f %10.0f\n", "count+fold_range",
+                   std::chrono::duration<double>(t1 - t0).count() * 1e9 / REPEATS,
+                   std::chrono::duration<double>(t2 - t1).count() * 1e9 / REPEATS);
+            printf("%16s %10.0f %10.0f\n", "select",
+                   std::chrono::duration<double>(t3 - t2).count() * 1e9 / REPEATS,
+                   std::chrono::duration<double>(t4 - t3).count() * 1e9 / REPEATS);
+        }
+
+        unpin_global_epoch(guard);
+        co_return;
+
+    };
 }
 
 
@@ -32,7 +32,10 @@ namespace wry {
     // For coordinates represented in Z-order, the data structure operates
     // somewhat like a quadtree.
 
-    // TODO: index range lookup
+    // A PersistentMap with an Augment monoid (see array_mapped_trie.hpp)
+    // answers count_in_range, rank, select and fold_range in O(depth).
+    // Order and ranges are those of the key codes: for Coordinates, a
+    // Z-order interval, not a rectangle.
 
     // TODO: bottom-up rebuild
 
@@ -40,12 +43,12 @@ namespace wry {
     // TODO: rationalize policy types for slots, allocators and key services
 
 
-    template<typename Key, typename T, typename H = DefaultKeyService<Key>, typename D = ScanDiscipline>
+    template<typename Key, typename T, typename H = DefaultKeyService<Key>, typename D = ScanDiscipline, typename A = void>
     struct PersistentMap {
         
         using U = typename H::code_type;
 
-        using AMT = ArrayMappedTrie<U, T, ScanDiscipline::InnerDiscipline>;
+        using AMT = ArrayMappedTrie<U, T, ScanDiscipline::InnerDiscipline, 5, A>;
         using Slot = D::template Slot<AMT const*>;
         Slot _inner{};
 
@@ -104,11 +107,36 @@ namespace wry {
             }
         }
 
+        // Augmented queries
+
+        [[nodiscard]] size_t size() const {
+            return _inner ? _inner->size() : 0;
+        }
+
+        [[nodiscard]] size_t count_in_range(Key lo, Key hi) const {
+            return _inner ? _inner->count_in_range(H{}.encode(lo), H{}.encode(hi)) : 0;
+        }
+
+        [[nodiscard]] size_t rank(Key key) const {
+            return _inner ? _inner->rank(H{}.encode(key)) : 0;
+        }
+
+        // Precondition: k < size()
+        [[nodiscard]] std::pair<Key, T> select(size_t k) const {
+            assert(_inner);
+            auto [code, value] = _inner->select(k);
+            return { H{}.decode(code), value };
+        }
+
+        [[nodiscard]] auto fold_range(Key lo, Key hi) const {
+            return _inner ? _inner->fold_range(H{}.encode(lo), H{}.encode(hi)) : A::identity();
+        }
+
 
     };
     
-    template<typename Key, typename T, typename H, typename D>
-    void garbage_collected_scan(const PersistentMap<Key, T, H, D>& x) {
+    template<typename Key, typename T, typename H, typename D, typename A>
+    void garbage_collected_scan(const PersistentMap<Key, T, H, D, A>& x) {
         garbage_collected_scan(x._inner);
     }
 
@@ -117,13 +145,13 @@ namespace wry {
     // wrapper below and by WaitableMap's rebuild (which materializes its own dual
     // actions).  `mods` must be sorted by code (the rebuild precondition; see
     // container/docs/parallel_rebuild.md).
-    template<typename Key, typename T, typename H, typename D, typename Action, typename Combine>
-    [[nodiscard]] Coroutine::Future<PersistentMap<Key, T, H, D>>
+    template<typename Key, typename T, typename H, typename D, typename A, typename Action, typename Combine>
+    [[nodiscard]] Coroutine::Future<PersistentMap<Key, T, H, D, A>>
     coroutine_parallel_rebuild_from_mods(
-            const PersistentMap<Key, T, H, D>& source,
+            const PersistentMap<Key, T, H, D, A>& source,
             const std::vector<std::pair<typename H::code_type, Action>>& mods,
             const Combine& combine) {
-        using PM = PersistentMap<Key, T, H, D>;
+        using PM = PersistentMap<Key, T, H, D, A>;
         using AMT = typename PM::AMT;
         const AMT* inner = source._inner ? &*source._inner : nullptr;
         const AMT* result = co_await AMT::coroutine_parallel_rebuild(
@@ -135,10 +163,10 @@ namespace wry {
     // (dropping NONE so untouched subtrees stay shared), then apply it via the
     // AMT co-recursion.  Keys come out sorted by H's code because the modifier's
     // comparator agrees with H (the rebuild precondition).
-    template<typename Key, typename T, typename H, typename D,
+    template<typename Key, typename T, typename H, typename D, typename A,
              typename U, typename F, typename S2, typename D2>
-    [[nodiscard]] Coroutine::Future<PersistentMap<Key, T, H, D>>
-    coroutine_parallel_rebuild(const PersistentMap<Key, T, H, D>& source,
+    [[nodiscard]] Coroutine::Future<PersistentMap<Key, T, H, D, A>>
+    coroutine_parallel_rebuild(const PersistentMap<Key, T, H, D, A>& source,
                                const ConcurrentMap<Key, U, S2, D2>& modifier,
                                F&& action_for_key) {
         using Action = ParallelRebuildAction<T>;
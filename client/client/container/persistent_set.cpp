@@ -5,5 +5,157 @@
 //  Created by Antony Searle on 23/11/2024.
 //
 
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <random>
+
 #include "persistent_set.hpp"
+#include "test.hpp"
+
+namespace wry {
+
+    namespace {
+
+        using PS = PersistentSet<uint64_t, DefaultKeyService<uint64_t>, ScanDiscipline>;
+
+        // Every node is well formed and every branch has two children
+        void persistent_set_assert_invariant(PS::N const* node) {
+            if (!node)
+                return;
+            node->_assert_invariant_shallow();
+            if (node->has_children()) {
+                assert(std::popcount(node->_bitmap) >= 2);
+                for (int j = 0; j != std::popcount(node->_bitmap); ++j)
+                    persistent_set_assert_invariant(node->_children[j]);
+            }
+        }
+
+        std::set<uint64_t> persistent_set_contents(PS const& s) {
+            persistent_set_assert_invariant(s._inner);
+            std::set<uint64_t> result;
+            s.for_each([&result](uint64_t k) { result.insert(k); });
+            return result;
+        }
+
+        // Keeps the timed loops live under NDEBUG
+        std::size_t persistent_set_sink = 0;
+
+    } // anonymous namespace
+
+    define_test("PersistentSet_algebra") {
+
+        auto guard = pin_global_epoch();
+
+        // erase shares off-path structure and collapses emptied nodes
+        {
+            PS s;
+            for (uint64_t k = 0; k != 100; ++k)
+                s.set(k * 37);
+            PS t = s.clone_and_erase(1);
+            assert(t._inner == s._inner);
+            for (uint64_t k = 0; k != 100; ++k) {
+                t.erase(k * 37);
+                assert(!t.contains(k * 37));
+                assert(persistent_set_contents(t).size() == 99 - k);
+            }
+            assert(!t._inner);
+            assert(persistent_set_contents(s).size() == 100);
+        }
+
+        mutator_repin();
+
+        // Against std::set, over small domains so operands overlap at every
+        // level, and from a shared base so identical subtrees occur
+        std::mt19937_64 rng(1);
+        for (int iter = 0; iter != 400; ++iter) {
+            uint64_t domain = (uint64_t)8 << (rng() % 12);
+            std::set<uint64_t> base_oracle;
+            PS base;
+            for (int n = (int)(rng() % 200); n--;) {
+                uint64_t k = rng() % domain;
+                base.set(k);
+                base_oracle.insert(k);
+            }
+            PS a = base, b = base;
+            std::set<uint64_t> ao = base_oracle, bo = base_oracle;
+            for (int n = (int)(rng() % 20); n--;) {
+                uint64_t k = rng() % domain;
+                if (rng() & 1) { a.set(k); ao.insert(k); } else { a.erase(k); ao.erase(k); }
+                k = rng() % domain;
+                if (rng() & 1) { b.set(k); bo.insert(k); } else { b.erase(k); bo.erase(k); }
+            }
+            if (!(iter % 5))
+                b = PS{};
+            assert(persistent_set_contents(a) == ao);
+            assert(persistent_set_contents(b) == bo);
+
+            std::set<uint64_t> u, i, d, x;
+            std::set_union(ao.begin(), ao.end(), bo.begin(), bo.end(), std::inserter(u, u.end()));
+            std::set_intersection(ao.begin(), ao.end(), bo.begin(), bo.end(), std::inserter(i, i.end()));
+            std::set_difference(ao.begin(), ao.end(), bo.begin(), bo.end(), std::inserter(d, d.end()));
+            std::set_symmetric_difference(ao.begin(), ao.end(), bo.begin(), bo.end(), std::inserter(x, x.end()));
+            assert(persistent_set_contents(set_union(a, b)) == u);
+            assert(persistent_set_contents(set_intersection(a, b)) == i);
+            assert(persistent_set_contents(set_difference(a, b)) == d);
+            assert(persistent_set_contents(set_symmetric_difference(a, b)) == x);
+
+            PS pu = co_await coroutine_parallel_set_operation<AMT_UNION>(a, b);
+            PS pi = co_await coroutine_parallel_set_operation<AMT_INTERSECTION>(a, b);
+            PS pd = co_await coroutine_parallel_set_operation<AMT_DIFFERENCE>(a, b);
+            PS px = co_await coroutine_parallel_set_operation<AMT_SYMMETRIC_DIFFERENCE>(a, b);
+            assert(persistent_set_contents(pu) == u);
+            assert(persistent_set_contents(pi) == i);
+            assert(persistent_set_contents(pd) == d);
+            assert(persistent_set_contents(px) == x);
+
+            // a result equal to an operand is that operand
+            assert(set_union(a, a)._inner == a._inner);
+            assert(set_intersection(a, a)._inner == a._inner);
+            assert(!set_difference(a, a)._inner);
+            assert(set_union(a, set_intersection(a, b))._inner == a._inner);
+            assert(set_difference(a, PS{})._inner == a._inner);
+
+            if (!(iter & 7))
+                mutator_repin();
+        }
+
+        mutator_repin();
+
+        // One differing element costs a path, not a copy
+        {
+            PS a;
+            for (uint64_t k = 0; k != 1 << 16; ++k)
+                a.set(k * 3);
+            PS b = a.clone_and_set(1);
+            assert(set_union(a, b)._inner == b._inner);
+            assert(set_intersection(a, b)._inner == a._inner);
+            PS d = set_difference(b, a);
+            assert(persistent_set_contents(d) == std::set<uint64_t>{1});
+
+            printf("set difference of 2^16-element sets differing by one (ns)\n");
+            printf("%12s %12s\n", "rebuild", "structural");
+            constexpr int REPEATS = 16;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r) {
+                PS without;
+                b.for_each([&a, &without](uint64_t k) {
+                    if (!a.contains(k))
+                        without.set(k);
+                });
+                persistent_set_sink += (std::size_t)without._inner;
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r)
+                persistent_set_sink += (std::size_t)set_difference(b, a)._inner;
+            auto t2 = std::chrono::steady_clock::now();
+            printf("%12.0f %12.0f\n",
+                   std::chrono::duration<double>(t1 - t0).count() * 1e9 / REPEATS,
+                   std::chrono::duration<double>(t2 - t1).count() * 1e9 / REPEATS);
+        }
+
+        unpin_global_epoch(guard);
+        co_return;
+    };
 
+} // namespace wry
@@ -63,11 +63,24 @@ namespace wry {
             };
         }
         
+        // Shares everything off the path to key; *this if absent
+        [[nodiscard]] PersistentSet clone_and_erase(Key key) const {
+            U j = H{}.encode(key);
+            T _ = {};
+            return PersistentSet{
+                _inner ? _inner->clone_and_erase_key(j, _).first : nullptr
+            };
+        }
+
         // Mutable interface.  The backing structure remains immutable; this is
         // just sugar to tersely swing the pointer.
         PersistentSet& set(Key key) {
             return *this = clone_and_set(key);
         }
+
+        PersistentSet& erase(Key key) {
+            return *this = clone_and_erase(key);
+        }
                 
         void for_each(auto&& action) const {
             if (_inner) {
@@ -96,11 +109,50 @@ namespace wry {
         }
         
         void merge(PersistentSet const& other) {
-            _inner = N::merge(_inner, other._inner);
+            _inner = N::template set_operation<AMT_UNION>(_inner, other._inner);
         }
         
     }; // PersistentSet
     
+    // Structural set algebra; see ArrayMappedTrie::set_operation.  Cost is
+    // proportional to where the operands differ, and the result shares the
+    // operands' untouched subtrees.
+    
+    template<typename Key, typename H, typename D>
+    [[nodiscard]] PersistentSet<Key, H, D>
+    set_union(PersistentSet<Key, H, D> const& a, PersistentSet<Key, H, D> const& b) {
+        using N = typename PersistentSet<Key, H, D>::N;
+        return PersistentSet<Key, H, D>{ N::template set_operation<AMT_UNION>(a._inner, b._inner) };
+    }
+    
+    template<typename Key, typename H, typename D>
+    [[nodiscard]] PersistentSet<Key, H, D>
+    set_intersection(PersistentSet<Key, H, D> const& a, PersistentSet<Key, H, D> const& b) {
+        using N = typename PersistentSet<Key, H, D>::N;
+        return PersistentSet<Key, H, D>{ N::template set_operation<AMT_INTERSECTION>(a._inner, b._inner) };
+    }
+    
+    template<typename Key, typename H, typename D>
+    [[nodiscard]] PersistentSet<Key, H, D>
+    set_difference(PersistentSet<Key, H, D> const& a, PersistentSet<Key, H, D> const& b) {
+        using N = typename PersistentSet<Key, H, D>::N;
+        return PersistentSet<Key, H, D>{ N::template set_operation<AMT_DIFFERENCE>(a._inner, b._inner) };
+    }
+    
+    template<typename Key, typename H, typename D>
+    [[nodiscard]] PersistentSet<Key, H, D>
+    set_symmetric_difference(PersistentSet<Key, H, D> const& a, PersistentSet<Key, H, D> const& b) {
+        using N = typename PersistentSet<Key, H, D>::N;
+        return PersistentSet<Key, H, D>{ N::template set_operation<AMT_SYMMETRIC_DIFFERENCE>(a._inner, b._inner) };
+    }
+    
+    template<ArrayMappedTrieSetOperation OP, typename Key, typename H, typename D>
+    Coroutine::Future<PersistentSet<Key, H, D>>
+    coroutine_parallel_set_operation(PersistentSet<Key, H, D> const& a, PersistentSet<Key, H, D> const& b) {
+        using N = typename PersistentSet<Key, H, D>::N;
+        co_return PersistentSet<Key, H, D>{ co_await N::template coroutine_parallel_set_operation<OP>(a._inner, b._inner) };
+    }
+    
     /*
     template<typename Key, typename H> auto
     merge(PersistentSet<Key, H> const& left, PersistentSet<Key, H> const& right) -> PersistentSet<Key, H> {
@@ -0,0 +1,236 @@
+//
+//  swiss_table.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "swiss_table.hpp"
+#include "table.hpp"
+
+#include "test.hpp"
+
+namespace wry {
+
+    namespace {
+
+        // A key wider than a pointer, compared in full
+        struct SwissWideKey {
+            std::uint64_t _words[4];
+            bool operator==(SwissWideKey const&) const = default;
+            friend std::uint64_t hash(SwissWideKey const& x) {
+                return hash_combine(x._words, sizeof(x._words));
+            }
+        };
+
+        struct SwissStdHasher {
+            std::size_t operator()(std::uint64_t x) const { return hash(x); }
+            std::size_t operator()(const void* x) const { return hash((std::uint64_t)(std::uintptr_t)x); }
+            std::size_t operator()(SwissWideKey const& x) const { return hash(x); }
+        };
+
+        template<typename Key> using SwissStdMap = std::unordered_map<Key, std::uint64_t, SwissStdHasher>;
+
+        // Table has no pointer hash; carry pointers as integers
+        template<typename Key> using SwissRobinHood = Table<std::conditional_t<std::is_pointer_v<Key>, std::uintptr_t, Key>, std::uint64_t>;
+
+        auto swiss_table_robin_hood_key = [](auto const& k) {
+            if constexpr (std::is_pointer_v<std::decay_t<decltype(k)>>)
+                return (std::uintptr_t)k;
+            else
+                return k;
+        };
+
+        auto swiss_table_identity_key = [](auto const& k) {
+            return k;
+        };
+
+        // Keeps the timed lookups live under NDEBUG
+        std::uint64_t swiss_table_sink = 0;
+
+        // Time insertion of `keys` into a presized table, then hits and
+        // misses, in ns per op
+        template<typename Key, typename Map>
+        void swiss_table_benchmark_one(const char* name, Map map, auto&& key_of, std::vector<Key> const& keys,
+                                       std::vector<Key> const& hits, std::vector<Key> const& misses) {
+            std::uint64_t check = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i != keys.size(); ++i)
+                map.emplace(key_of(keys[i]), (std::uint64_t)i);
+            auto t1 = std::chrono::steady_clock::now();
+            for (Key const& k : hits)
+                check += map.find(key_of(k))->second;
+            auto t2 = std::chrono::steady_clock::now();
+            for (Key const& k : misses)
+                check += (map.find(key_of(k)) == map.end());
+            auto t3 = std::chrono::steady_clock::now();
+            assert(map.size() == keys.size());
+            assert(check >= misses.size());
+            swiss_table_sink += check;
+            printf("%20s %10.1f %10.1f %10.1f\n", name,
+                   std::chrono::duration<double>(t1 - t0).count() * 1e9 / keys.size(),
+                   std::chrono::duration<double>(t2 - t1).count() * 1e9 / hits.size(),
+                   std::chrono::duration<double>(t3 - t2).count() * 1e9 / misses.size());
+        }
+
+        template<typename Key>
+        void swiss_table_benchmark(const char* key_name, auto&& make_key) {
+            constexpr std::size_t CAPACITY = 1 << 18;
+            std::mt19937_64 rng(0);
+            for (double load : {0.25, 0.5, 0.75, 0.85}) {
+                std::size_t n = (std::size_t)(CAPACITY * load);
+                std::vector<Key> keys, hits, misses;
+                for (std::size_t i = 0; i != n; ++i) {
+                    keys.push_back(make_key(2 * i));
+                    misses.push_back(make_key(2 * i + 1));
+                }
+                std::shuffle(keys.begin(), keys.end(), rng);
+                hits = keys;
+                std::shuffle(hits.begin(), hits.end(), rng);
+                printf("%s keys, load %.2f of %zu slots (ns per op)\n", key_name, load, CAPACITY);
+                printf("%20s %10s %10s %10s\n", "", "insert", "find hit", "find miss");
+                // Capacity is fixed in advance so that every table runs at
+                // the nominal load
+                swiss_table_benchmark_one("Table", SwissRobinHood<Key>(with_capacity, CAPACITY), swiss_table_robin_hood_key, keys, hits, misses);
+                swiss_table_benchmark_one("SwissTable", SwissTable<Key, std::uint64_t>(with_capacity, CAPACITY - CAPACITY / 8), swiss_table_identity_key, keys, hits, misses);
+                SwissStdMap<Key> m;
+                m.max_load_factor(1.0f);
+                m.rehash(CAPACITY);
+                swiss_table_benchmark_one("std::unordered_map", std::move(m), swiss_table_identity_key, keys, hits, misses);
+            }
+        }
+
+    } // anonymous namespace
+
+    define_test("swiss_table") {
+
+        {
+            SwissTable<int, int> t;
+            assert(t.empty());
+            assert(t.begin() == t.end());
+            assert(t.find(7) == t.end());
+            assert(t.erase(7) == 0);
+        }
+
+        // Against std::unordered_map, with enough churn to rehash and reuse
+        // tombstones
+        {
+            SwissTable<std::uint64_t, std::uint64_t> a;
+            std::unordered_map<std::uint64_t, std::uint64_t> b;
+            std::mt19937_64 rng(1);
+            for (int i = 0; i != 100000; ++i) {
+                std::uint64_t k = rng() % 2000;
+                switch (rng() % 4) {
+                    case 0: {
+                        auto [p, f] = a.insert_or_assign(k, (std::uint64_t)i);
+                        assert(f == !b.contains(k));
+                        assert(p->first == k && p->second == (std::uint64_t)i);
+                        b[k] = i;
+                        break;
+                    }
+                    case 1: {
+                        auto [p, f] = a.emplace(k, (std::uint64_t)i);
+                        auto [q, g] = b.emplace(k, i);
+                        assert(f == g);
+                        assert(p->second == q->second);
+                        break;
+                    }
+                    case 2:
+                        assert(a.erase(k) == b.erase(k));
+                        break;
+                    case 3: {
+                        auto p = a.find(k);
+                        auto q = b.find(k);
+                        assert((p == a.end()) == (q == b.end()));
+                        assert((p == a.end()) || (p->second == q->second));
+                        break;
+                    }
+                }
+                assert(a.size() == b.size());
+                if (!(i % 4096))
+                    a._invariant();
+            }
+            a._invariant();
+            std::size_t n = 0;
+            for (auto const& [k, v] : std::as_const(a)) {
+                assert(b.at(k) == v);
+                ++n;
+            }
+            assert(n == b.size());
+            SwissTable<std::uint64_t, std::uint64_t> c(a);
+            assert(c.size() == a.size());
+            for (auto [k, v] : b)
+                assert(c.at(k) == v);
+            c.clear();
+            assert(c.empty() && (c.begin() == c.end()));
+        }
+
+        // Erasing from groups with an EMPTY leaves no tombstone, so a table
+        // kept below full load churns without tombstones or growth
+        {
+            SwissTable<std::uint64_t, int> t(with_capacity, 1000);
+            std::size_t capacity = t.capacity();
+            for (std::uint64_t k = 0; k != 10000; ++k) {
+                t[k] = 1;
+                if (k >= 500)
+                    assert(t.erase(k - 500) == 1);
+                assert(t.tombstones() == 0);
+            }
+            assert(t.capacity() == capacity);
+            t._invariant();
+        }
+
+        // Full groups do leave tombstones; they are reused or purged
+        // without unbounded growth
+        {
+            SwissTable<std::uint64_t, int> t;
+            for (std::uint64_t k = 0; k != 448; ++k)    // 7/8 of 512
+                t[k] = 1;
+            std::size_t capacity = t.capacity();
+            for (std::uint64_t k = 448; k != 100000; ++k) {
+                t.erase(k - 448);
+                t[k] = 1;
+            }
+            assert(t.size() == 448);
+            assert(t.capacity() <= 2 * capacity);
+            t._invariant();
+        }
+
+        // Non-trivial payloads are moved on rehash and destroyed once
+        {
+            auto counter = std::make_shared<int>(0);
+            {
+                SwissTable<int, std::shared_ptr<int>> t;
+                for (int k = 0; k != 1000; ++k)
+                    t.emplace(k, counter);
+                for (int k = 0; k != 1000; k += 2)
+                    t.erase(k);
+                assert(counter.use_count() == 501);
+            }
+            assert(counter.use_count() == 1);
+        }
+
+        // Robin Hood Table, SwissTable and std::unordered_map across load
+        // factors and key types
+        swiss_table_benchmark<std::uint64_t>("uint64_t", [](std::uint64_t i) {
+            return i;
+        });
+        std::vector<std::uint64_t> heap(1 << 19);
+        swiss_table_benchmark<const void*>("pointer", [&](std::uint64_t i) -> const void* {
+            return heap.data() + i;
+        });
+        swiss_table_benchmark<SwissWideKey>("32-byte", [](std::uint64_t i) {
+            return SwissWideKey{{i, ~i, i * 3, 17}};
+        });
+
+        co_return;
+
+    };
+
+} // namespace wry
@@ -0,0 +1,637 @@
+//
+//  swiss_table.hpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#ifndef swiss_table_hpp
+#define swiss_table_hpp
+
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "assert.hpp"
+#include "hash.hpp"
+#include "stdint.hpp"
+#include "utility.hpp"
+#include "with_capacity.hpp"
+
+namespace wry {
+
+    // Swiss table
+    //
+    // Table probes one slot at a time, and every probe loads a full 64-bit
+    // hash from a slot that is sizeof(Entry) wide.  SwissTable keeps a
+    // separate array of one-byte control words, each either EMPTY, DELETED,
+    // or FULL with the low seven bits of the hash (H2).  Slots are probed a
+    // group of sixteen at a time: one vector compare of the group's control
+    // bytes against H2 yields a bitmask of candidates, and only candidates
+    // touch the slot array, so a lookup usually costs one control line and
+    // one slot line, hit or miss.
+    //
+    // Groups are aligned, and the rest of the hash (H1) picks the first
+    // group of a triangular probe sequence, which visits every group.  A
+    // lookup stops at the first group with an EMPTY byte.  It follows that
+    // an erase can write EMPTY rather than a DELETED tombstone whenever its
+    // group already holds an EMPTY, because no probe can have passed over
+    // that group; only erases from full groups leave tombstones, and they
+    // are reused by insertion and purged by rehashing.
+    //
+    // The group operations use NEON or SSE2, and otherwise SWAR over two
+    // 64-bit words.
+    //
+    // Like Table, iteration order is nondeterministic and must not leak into
+    // the game state.
+
+    inline constexpr std::int8_t SWISS_EMPTY = -128;    // 0b10000000
+    inline constexpr std::int8_t SWISS_DELETED = -2;    // 0b11111110
+    inline constexpr std::size_t SWISS_GROUP_WIDTH = 16;
+
+    // Bitmask of the slots of a group, lowest first.  Each slot owns
+    // 1 << SHIFT bits, of which at most one is set.
+    struct SwissMask {
+
+#if defined(__ARM_NEON)
+        static constexpr int SHIFT = 2;
+#else
+        static constexpr int SHIFT = 0;
+#endif
+
+        std::uint64_t _bits;
+
+        explicit operator bool() const {
+            return _bits != 0;
+        }
+
+        bool operator!() const {
+            return _bits == 0;
+        }
+
+        int lowest() const {
+            assert(_bits);
+            return std::countr_zero(_bits) >> SHIFT;
+        }
+
+        int pop() {
+            int i = lowest();
+            _bits &= _bits - 1;
+            return i;
+        }
+
+    }; // struct SwissMask
+
+    struct SwissGroup {
+
+#if defined(__ARM_NEON)
+
+        uint8x16_t _ctrl;
+
+        explicit SwissGroup(std::int8_t const* _Nonnull p)
+        : _ctrl(vld1q_u8(reinterpret_cast<std::uint8_t const*>(p))) {
+        }
+
+        static SwissMask _narrow(uint8x16_t m) {
+            // Each 0xFF byte becomes a 0xF nibble; keep one bit of each
+            std::uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+            return SwissMask{bits & 0x8888888888888888ull};
+        }
+
+        SwissMask match(std::uint8_t h2) const {
+            return _narrow(vceqq_u8(_ctrl, vdupq_n_u8(h2)));
+        }
+
+        SwissMask match_empty() const {
+            return _narrow(vceqq_u8(_ctrl, vdupq_n_u8((std::uint8_t)SWISS_EMPTY)));
+        }
+
+        SwissMask match_empty_or_deleted() const {
+            return _narrow(vcltzq_s8(vreinterpretq_s8_u8(_ctrl)));
+        }
+
+#elif defined(__SSE2__)
+
+        __m128i _ctrl;
+
+        explicit SwissGroup(std::int8_t const* _Nonnull p)
+        : _ctrl(_mm_loadu_si128(reinterpret_cast<__m128i const*>(p))) {
+        }
+
+        SwissMask match(std::uint8_t h2) const {
+            return SwissMask{(std::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_ctrl, _mm_set1_epi8((char)h2)))};
+        }
+
+        SwissMask match_empty() const {
+            return SwissMask{(std::uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_ctrl, _mm_set1_epi8(SWISS_EMPTY)))};
+        }
+
+        SwissMask match_empty_or_deleted() const {
+            return SwissMask{(std::uint32_t)_mm_movemask_epi8(_ctrl)};
+        }
+
+#else
+
+        static constexpr std::uint64_t LSBS = 0x0101010101010101ull;
+        static constexpr std::uint64_t MSBS = 0x8080808080808080ull;
+
+        std::uint64_t _ctrl[2];
+
+        explicit SwissGroup(std::int8_t const* _Nonnull p) {
+            std::memcpy(_ctrl, p, SWISS_GROUP_WIDTH);
+        }
+
+        // Gather the most significant bit of each byte, as movemask
+        static SwissMask _narrow(std::uint64_t lo, std::uint64_t hi) {
+            constexpr std::uint64_t GATHER = 0x0102040810204080ull;
+            return SwissMask{(((lo >> 7) * GATHER) >> 56) | ((((hi >> 7) * GATHER) >> 56) << 8)};
+        }
+
+        // May report a false positive in a FULL byte that follows a match,
+        // which the key comparison rejects; never in an EMPTY or DELETED byte
+        static std::uint64_t _match_word(std::uint64_t w, std::uint8_t h2) {
+            std::uint64_t x = w ^ (LSBS * h2);
+            return (x - LSBS) & ~x & MSBS;
+        }
+
+        // Exact: EMPTY is the only control with bit 7 set and bit 1 clear
+        static std::uint64_t _empty_word(std::uint64_t w) {
+            return w & ~(w << 6) & MSBS;
+        }
+
+        SwissMask match(std::uint8_t h2) const {
+            return _narrow(_match_word(_ctrl[0], h2), _match_word(_ctrl[1], h2));
+        }
+
+        SwissMask match_empty() const {
+            return _narrow(_empty_word(_ctrl[0]), _empty_word(_ctrl[1]));
+        }
+
+        SwissMask match_empty_or_deleted() const {
+            return _narrow(_ctrl[0] & MSBS, _ctrl[1] & MSBS);
+        }
+
+#endif
+
+    }; // struct SwissGroup
+
+    template<typename Key, typename T>
+    struct SwissTable {
+
+        struct Slot {
+            union {
+                std::pair<Key, T> _kv;
+            };
+            Slot() {}
+            ~Slot() {}
+        };
+
+        using value_type = std::pair<const Key, T>;
+        using reference = value_type&;
+        using pointer = value_type*;
+        using const_reference = const value_type&;
+        using const_pointer = const value_type*;
+
+        template<bool IS_CONST>
+        struct _iterator {
+
+            std::int8_t const* _ctrl;
+            std::int8_t const* _end;
+            std::conditional_t<IS_CONST, Slot const, Slot>* _slot;
+
+            void _advance() {
+                while ((_ctrl != _end) && (*_ctrl < 0)) {
+                    ++_ctrl;
+                    ++_slot;
+                }
+            }
+
+            _iterator& operator++() {
+                assert(_ctrl != _end);
+                ++_ctrl;
+                ++_slot;
+                _advance();
+                return *this;
+            }
+
+            std::conditional_t<IS_CONST, const_reference, reference> operator*() const {
+                return reinterpret_cast<std::conditional_t<IS_CONST, const_reference, reference>>(_slot->_kv);
+            }
+
+            std::conditional_t<IS_CONST, const_pointer, pointer> operator->() const {
+                return &**this;
+            }
+
+            bool operator==(_iterator const& other) const {
+                return _ctrl == other._ctrl;
+            }
+
+            operator _iterator<true>() const requires (!IS_CONST) {
+                return _iterator<true>{_ctrl, _end, _slot};
+            }
+
+        };
+
+        using iterator = _iterator<false>;
+        using const_iterator = _iterator<true>;
+
+        std::int8_t* _ctrl;         // capacity() bytes, 16-aligned
+        Slot* _slots;
+        std::size_t _group_mask;    // groups - 1
+        std::size_t _count;
+        std::size_t _growth_left;   // insertions into EMPTY before rehash
+
+        static std::uint64_t _hash(auto const& keylike) {
+            if constexpr (std::is_pointer_v<std::decay_t<decltype(keylike)>>)
+                return hash((std::uint64_t)(std::uintptr_t)keylike);
+            else
+                return hash(keylike);
+        }
+
+        static std::uint8_t _h2(std::uint64_t h) {
+            return (std::uint8_t)(h & 0x7F);
+        }
+
+        std::size_t _h1(std::uint64_t h) const {
+            return (std::size_t)(h >> 7) & _group_mask;
+        }
+
+        static std::size_t _growth_limit(std::size_t capacity) {
+            // Load factor 7/8
+            return capacity - (capacity >> 3);
+        }
+
+        std::size_t capacity() const {
+            return _ctrl ? (_group_mask + 1) * SWISS_GROUP_WIDTH : 0;
+        }
+
+        std::size_t size() const {
+            return _count;
+        }
+
+        bool empty() const {
+            return !_count;
+        }
+
+        // Erased slots not yet reclaimed
+        std::size_t tombstones() const {
+            return _growth_limit(capacity()) - _count - _growth_left;
+        }
+
+        SwissTable()
+        : _ctrl(nullptr)
+        , _slots(nullptr)
+        , _group_mask(0)
+        , _count(0)
+        , _growth_left(0) {
+        }
+
+        SwissTable(with_capacity_t, std::size_t count)
+        : SwissTable() {
+            if (count)
+                _allocate(_groups_for(count));
+        }
+
+        SwissTable(SwissTable&& other)
+        : SwissTable() {
+            swap(other);
+        }
+
+        SwissTable(SwissTable const& other)
+        : SwissTable(with_capacity, other.size()) {
+            for (auto const& a : other)
+                insert(a);
+        }
+
+        ~SwissTable() {
+            _destroy_slots();
+            _deallocate(_ctrl, _slots);
+        }
+
+        SwissTable& operator=(SwissTable&& other) {
+            SwissTable(std::move(other)).swap(*this);
+            return *this;
+        }
+
+        SwissTable& operator=(SwissTable const& other) {
+            SwissTable(other).swap(*this);
+            return *this;
+        }
+
+        void swap(SwissTable& other) {
+            using std::swap;
+            swap(_ctrl, other._ctrl);
+            swap(_slots, other._slots);
+            swap(_group_mask, other._group_mask);
+            swap(_count, other._count);
+            swap(_growth_left, other._growth_left);
+        }
+
+        static std::size_t _groups_for(std::size_t count) {
+            std::size_t capacity = count + (count + 6) / 7;    // count <= 7/8 capacity
+            std::size_t groups = (capacity + SWISS_GROUP_WIDTH - 1) / SWISS_GROUP_WIDTH;
+            return std::bit_ceil(groups);
+        }
+
+        void _allocate(std::size_t groups) {
+            assert(std::has_single_bit(groups));
+            std::size_t n = groups * SWISS_GROUP_WIDTH;
+            _ctrl = (std::int8_t*) ::operator new(n, std::align_val_t{SWISS_GROUP_WIDTH});
+            _slots = (Slot*) ::operator new(n * sizeof(Slot), std::align_val_t{alignof(Slot)});
+            std::memset(_ctrl, SWISS_EMPTY, n);
+            _group_mask = groups - 1;
+            _growth_left = _growth_limit(n) - _count;
+        }
+
+        static void _deallocate(std::int8_t* _Nullable ctrl, Slot* _Nullable slots) {
+            if (ctrl) {
+                ::operator delete(ctrl, std::align_val_t{SWISS_GROUP_WIDTH});
+                ::operator delete(slots, std::align_val_t{alignof(Slot)});
+            }
+        }
+
+        void _destroy_slots() {
+            if constexpr (!std::is_trivially_destructible_v<std::pair<Key, T>>) {
+                std::size_t n = capacity();
+                for (std::size_t i = 0; i != n; ++i)
+                    if (_ctrl[i] >= 0)
+                        std::destroy_at(&_slots[i]._kv);
+            }
+        }
+
+        void clear() {
+            _destroy_slots();
+            _count = 0;
+            if (_ctrl) {
+                std::memset(_ctrl, SWISS_EMPTY, capacity());
+                _growth_left = _growth_limit(capacity());
+            }
+        }
+
+        // Rebuild into `groups` groups, dropping tombstones
+        void _resize(std::size_t groups) {
+            std::int8_t* old_ctrl = _ctrl;
+            Slot* old_slots = _slots;
+            std::size_t n = capacity();
+            _allocate(groups);
+            for (std::size_t i = 0; i != n; ++i) {
+                if (old_ctrl[i] >= 0) {
+                    std::size_t j = _find_non_full(_hash(old_slots[i]._kv.first));
+                    _ctrl[j] = old_ctrl[i];
+                    std::construct_at(&_slots[j]._kv, std::move(old_slots[i]._kv));
+                    std::destroy_at(&old_slots[i]._kv);
+                }
+            }
+            _deallocate(old_ctrl, old_slots);
+        }
+
+        void reserve(std::size_t count) {
+            std::size_t groups = _groups_for(count);
+            if (groups > (_ctrl ? _group_mask + 1 : 0))
+                _resize(groups);
+        }
+
+        void _rehash_and_grow_if_necessary() {
+            if (!_ctrl) {
+                _allocate(1);
+            } else if (_count * 32 <= capacity() * 25) {
+                // Mostly tombstones; purge them at the same size
+                _resize(_group_mask + 1);
+            } else {
+                _resize((_group_mask + 1) << 1);
+            }
+        }
+
+        // First EMPTY or DELETED slot on the probe sequence of h
+        std::size_t _find_non_full(std::uint64_t h) const {
+            std::size_t g = _h1(h);
+            for (std::size_t stride = 1;; ++stride) {
+                SwissMask m = SwissGroup(_ctrl + g * SWISS_GROUP_WIDTH).match_empty_or_deleted();
+                if (m)
+                    return g * SWISS_GROUP_WIDTH + m.lowest();
+                assert(stride <= _group_mask + 1);
+                g = (g + stride) & _group_mask;
+            }
+        }
+
+        // Index of any slot with hash h for which predicate is true, or -1
+        std::size_t _find(std::uint64_t h, auto&& predicate) const {
+            if (!_count)
+                return (std::size_t)-1;
+            std::uint8_t h2 = _h2(h);
+            std::size_t g = _h1(h);
+            for (std::size_t stride = 1;; ++stride) {
+                std::int8_t const* c = _ctrl + g * SWISS_GROUP_WIDTH;
+                SwissGroup group(c);
+                // The slot line does not depend on the compare; overlap them
+                __builtin_prefetch(_slots + g * SWISS_GROUP_WIDTH);
+                for (SwissMask m = group.match(h2); m;) {
+                    std::size_t i = g * SWISS_GROUP_WIDTH + m.pop();
+                    if (predicate(_slots[i]._kv))
+                        return i;
+                }
+                if (group.match_empty())
+                    return (std::size_t)-1;
+                assert(stride <= _group_mask + 1);
+                g = (g + stride) & _group_mask;
+            }
+        }
+
+        // The slot holding a match, or a slot prepared to receive one,
+        // whose pair the caller must construct
+        std::pair<std::size_t, bool> _find_or_prepare_insert(std::uint64_t h, auto&& predicate) {
+            std::size_t i = _find(h, predicate);
+            if (i != (std::size_t)-1)
+                return {i, false};
+            if (!_growth_left)
+                _rehash_and_grow_if_necessary();
+            i = _find_non_full(h);
+            _growth_left -= (_ctrl[i] == SWISS_EMPTY);
+            _ctrl[i] = (std::int8_t)_h2(h);
+            ++_count;
+            return {i, true};
+        }
+
+        void _erase_at(std::size_t i) {
+            assert(_ctrl[i] >= 0);
+            std::destroy_at(&_slots[i]._kv);
+            --_count;
+            std::size_t g = i & ~(SWISS_GROUP_WIDTH - 1);
+            if (SwissGroup(_ctrl + g).match_empty()) {
+                // No probe sequence continues past this group
+                _ctrl[i] = SWISS_EMPTY;
+                ++_growth_left;
+            } else {
+                _ctrl[i] = SWISS_DELETED;
+            }
+        }
+
+        iterator _make_iterator(std::size_t i) {
+            return iterator{_ctrl + i, _ctrl + capacity(), _slots + i};
+        }
+
+        const_iterator _make_iterator(std::size_t i) const {
+            return const_iterator{_ctrl + i, _ctrl + capacity(), _slots + i};
+        }
+
+        iterator begin() {
+            iterator it = _make_iterator(0);
+            it._advance();
+            return it;
+        }
+
+        iterator end() {
+            return _make_iterator(capacity());
+        }
+
+        const_iterator begin() const {
+            const_iterator it = _make_iterator(0);
+            it._advance();
+            return it;
+        }
+
+        const_iterator end() const {
+            return _make_iterator(capacity());
+        }
+
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        std::size_t _index_of(auto const& keylike) const {
+            return _find(_hash(keylike), [&](std::pair<Key, T> const& kv) {
+                return kv.first == keylike;
+            });
+        }
+
+        iterator find(auto const& keylike) {
+            std::size_t i = _index_of(keylike);
+            return (i != (std::size_t)-1) ? _make_iterator(i) : end();
+        }
+
+        const_iterator find(auto const& keylike) const {
+            std::size_t i = _index_of(keylike);
+            return (i != (std::size_t)-1) ? _make_iterator(i) : end();
+        }
+
+        bool contains(auto const& keylike) const {
+            return _index_of(keylike) != (std::size_t)-1;
+        }
+
+        std::size_t count(auto const& keylike) const {
+            return contains(keylike) ? 1 : 0;
+        }
+
+        T const& at(auto const& keylike) const {
+            std::size_t i = _index_of(keylike);
+            assert(i != (std::size_t)-1);
+            return _slots[i]._kv.second;
+        }
+
+        T& at(auto const& keylike) {
+            std::size_t i = _index_of(keylike);
+            assert(i != (std::size_t)-1);
+            return _slots[i]._kv.second;
+        }
+
+        std::pair<iterator, bool> emplace(auto&& key, auto&& value) {
+            auto [i, inserted] = _find_or_prepare_insert(_hash(key), [&](std::pair<Key, T> const& kv) {
+                return kv.first == key;
+            });
+            if (inserted)
+                std::construct_at(&_slots[i]._kv, FORWARD(key), FORWARD(value));
+            return {_make_iterator(i), inserted};
+        }
+
+        std::pair<iterator, bool> insert(auto&& value) {
+            auto [i, inserted] = _find_or_prepare_insert(_hash(value.first), [&](std::pair<Key, T> const& kv) {
+                return kv.first == value.first;
+            });
+            if (inserted)
+                std::construct_at(&_slots[i]._kv, FORWARD(value));
+            return {_make_iterator(i), inserted};
+        }
+
+        template<typename InputIt>
+        void insert(InputIt first, InputIt last) {
+            for (; first != last; ++first)
+                insert(*first);
+        }
+
+        std::pair<iterator, bool> insert_or_assign(auto&& k, auto&& v) {
+            auto [i, inserted] = _find_or_prepare_insert(_hash(k), [&](std::pair<Key, T> const& kv) {
+                return kv.first == k;
+            });
+            if (inserted) {
+                std::construct_at(&_slots[i]._kv, FORWARD(k), FORWARD(v));
+            } else {
+                _slots[i]._kv.second = FORWARD(v);
+            }
+            return {_make_iterator(i), inserted};
+        }
+
+        T& operator[](auto&& keylike) {
+            auto [i, inserted] = _find_or_prepare_insert(_hash(keylike), [&](std::pair<Key, T> const& kv) {
+                return kv.first == keylike;
+            });
+            if (inserted)
+                std::construct_at(&_slots[i]._kv,
+                                  std::piecewise_construct,
+                                  std::forward_as_tuple(FORWARD(keylike)),
+                                  std::tuple<>());
+            return _slots[i]._kv.second;
+        }
+
+        std::size_t erase(iterator pos) {
+            _erase_at(pos._ctrl - _ctrl);
+            return 1;
+        }
+
+        // range erase makes no sense for unordered map
+
+        std::size_t erase(auto const& keylike) {
+            std::size_t i = _index_of(keylike);
+            if (i == (std::size_t)-1)
+                return 0;
+            _erase_at(i);
+            return 1;
+        }
+
+        void _invariant() const {
+#ifndef NDEBUG
+            std::size_t n = capacity();
+            std::size_t full = 0;
+            for (std::size_t i = 0; i != n; ++i) {
+                if (_ctrl[i] < 0) {
+                    assert((_ctrl[i] == SWISS_EMPTY) || (_ctrl[i] == SWISS_DELETED));
+                    continue;
+                }
+                ++full;
+                std::uint64_t h = _hash(_slots[i]._kv.first);
+                assert(_ctrl[i] == (std::int8_t)_h2(h));
+                // no group before ours on the probe sequence has an EMPTY
+                std::size_t g = _h1(h);
+                for (std::size_t stride = 1; g != i / SWISS_GROUP_WIDTH; ++stride) {
+                    assert(!SwissGroup(_ctrl + g * SWISS_GROUP_WIDTH).match_empty());
+                    g = (g + stride) & _group_mask;
+                }
+            }
+            assert(full == _count);
+            assert(_count + _growth_left <= _growth_limit(n));
+#endif
+        }
+
+    }; // struct SwissTable<Key, T>
+
+} // namespace wry
+
+#endif /* swiss_table_hpp */
@@ -6,14 +6,75 @@
 //
 
 #include <set>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 #include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "hash.hpp"
 #include "table.hpp"
 #include "test.hpp"
 
 namespace wry {
+
+    namespace {
+
+        // One long-lived thread frees what the tables hand it
+        struct TableReclaimer {
+
+            struct Job {
+                void (*_Nonnull reclaim)(void* _Nonnull, std::uint64_t);
+                void* _Nonnull p;
+                std::uint64_t n;
+            };
+
+            std::mutex _mutex;
+            std::condition_variable _condition;
+            std::vector<Job> _jobs;
+
+            TableReclaimer() {
+                std::thread([this] { _run(); }).detach();
+            }
+
+            [[noreturn]] void _run() {
+                std::vector<Job> jobs;
+                for (;;) {
+                    {
+                        std::unique_lock lock{_mutex};
+                        _condition.wait(lock, [this] { return !_jobs.empty(); });
+                        jobs.swap(_jobs);
+                    }
+                    for (Job& job : jobs)
+                        job.reclaim(job.p, job.n);
+                    jobs.clear();
+                }
+            }
+
+        };
+
+        // Immortal, like its thread: tables may be destroyed during static
+        // destruction
+        TableReclaimer& _table_reclaimer() {
+            static TableReclaimer* reclaimer = new TableReclaimer;
+            return *reclaimer;
+        }
+
+    } // namespace
+
+    void table_reclaim_in_background(void (*_Nonnull reclaim)(void* _Nonnull, std::uint64_t),
+                                     void* _Nonnull p,
+                                     std::uint64_t n) {
+        TableReclaimer& reclaimer = _table_reclaimer();
+        {
+            std::scoped_lock guard{reclaimer._mutex};
+            reclaimer._jobs.push_back({reclaim, p, n});
+        }
+        reclaimer._condition.notify_one();
+    }
     
     define_test("table")
     {
@@ -156,6 +217,96 @@ namespace wry {
         
     };
     
+    define_test("table_incremental")
+    {
+        
+        // Against std::unordered_map, with every operation interleaved with
+        // migration
+        {
+            Table<int, int> t;
+            t.set_incremental_resize(true);
+            std::unordered_map<int, int> u;
+            std::mt19937 rng(1);
+            int migrating = 0;
+            for (int j = 0; j != 200000; ++j) {
+                int k = rng() % 20000;
+                switch (rng() % 4) {
+                    case 0:
+                    case 1: {
+                        auto [p, f] = t.insert_or_assign(k, j);
+                        assert(f == !u.contains(k));
+                        assert(p->second == j);
+                        u[k] = j;
+                        break;
+                    }
+                    case 2:
+                        assert(t.erase(k) == u.erase(k));
+                        break;
+                    case 3: {
+                        auto p = t.find(k);
+                        assert((p == t.end()) == !u.contains(k));
+                        if (p != t.end()) {
+                            assert(p->second == u[k]);
+                            // erase through an iterator that may point
+                            // into the old array
+                            if (k & 1) {
+                                t.erase(p);
+                                u.erase(k);
+                            }
+                        }
+                        break;
+                    }
+                }
+                assert(t.size() == u.size());
+                migrating += (bool) t._inner._old;
+                if (!(j % 1024)) {
+                    t._inner._invariant();
+                    // iteration spans both arrays
+                    std::size_t n = 0;
+                    for (auto [a, b] : t) {
+                        assert(u.at(a) == b);
+                        ++n;
+                    }
+                    assert(n == u.size());
+                }
+            }
+            assert(migrating);
+            
+            // Copies keep the choice; the default stops the world
+            Table<int, int> v{t};
+            assert(v._inner._incremental);
+            Table<int, int> w;
+            assert(!w._inner._incremental);
+        }
+        
+        // Worst single insert, incremental against stop-the-world
+        {
+            constexpr int N = 10'000'000;
+            for (bool incremental : {false, true}) {
+                Table<std::uint64_t, std::uint64_t> t;
+                t.set_incremental_resize(incremental);
+                double worst = 0.0;
+                auto t0 = std::chrono::steady_clock::now();
+                auto a = t0;
+                for (std::uint64_t k = 0; k != N; ++k) {
+                    t.emplace(k, k);
+                    auto b = std::chrono::steady_clock::now();
+                    worst = std::max(worst, std::chrono::duration<double>(b - a).count());
+                    a = b;
+                }
+                assert(t.size() == N);
+                printf("table %s resize: %d inserts in %.3f s, worst insert %.3f ms\n",
+                       incremental ? "incremental" : "stop-the-world",
+                       N,
+                       std::chrono::duration<double>(a - t0).count(),
+                       worst * 1e3);
+            }
+        }
+        
+        co_return;
+        
+    };
+    
 } // namespace wry
 
 /*
@@ -8,6 +8,9 @@
 #ifndef table_hpp
 #define table_hpp
 
+#include <cstdlib>
+#include <new>
+
 #include "assert.hpp"
 #include "algorithm.hpp"
 #include "hash.hpp"
@@ -73,6 +76,32 @@ namespace wry {
     // generation which is not great.  Pointers, for example, might want to
     // be rotr64(x, 4) & _mask
         
+    // A resize rehashes every entry, which for a large table is a
+    // multi-millisecond stall on whichever insert trips it.  A table that
+    // opts in with set_incremental_resize instead resizes incrementally, at
+    // some cost to each operation until migration finishes: the doubled
+    // array is allocated, the old array is kept alongside, and each later
+    // insert or erase migrates at least MIGRATION_STEP old slots.  Lookups
+    // try the new array and then the old; inserts try the old and then
+    // insert into the new; so every key is in exactly one.  Iteration visits
+    // the new array, then the old.
+    //
+    // Migration moves whole clusters (maximal runs of occupied slots), so
+    // that what remains of the old array is still a valid Robin Hood table
+    // that lookups and erases can use unchanged.  It starts at an empty slot
+    // and proceeds in slot order, so it meets every cluster at its head.
+    // Migration outpaces insertion, so the new array cannot reach its
+    // trigger before the old one is drained.
+    //
+    // Freeing a drained array of many megabytes returns its pages to the
+    // system, itself a multi-millisecond stall, so large drained arrays are
+    // handed to a background thread to free.
+
+    // Call reclaim(p, n) on a background thread (table.cpp)
+    void table_reclaim_in_background(void (*_Nonnull reclaim)(void* _Nonnull, std::uint64_t),
+                                     void* _Nonnull p,
+                                     std::uint64_t n);
+        
     template<typename Entry, typename EntryService>
     struct BasicTable {
         
@@ -81,6 +110,9 @@ namespace wry {
         using const_iterator = const value_type*;
         using reference = value_type&;
         
+        static constexpr std::uint64_t MIGRATION_STEP = 16;
+        static constexpr std::size_t BACKGROUND_RECLAIM_BYTES = std::size_t{1} << 20;
+        
         // an array of Entries
                 
         [[no_unique_address]] EntryService _service;
@@ -89,9 +121,16 @@ namespace wry {
         int _shift;
         std::uint64_t _count;
         std::uint64_t _trigger;
+        
+        // incremental resize
+        
+        BasicTable* _Nullable _old;     // being migrated from, if any
+        std::uint64_t _cursor;          // next slot of _old to migrate
+        std::uint64_t _remaining;       // slots of _old not yet migrated
+        bool _incremental;              // else resize stops the world
 
         std::uint64_t count() const {
-            return _count;
+            return _count + (_old ? _old->_count : 0);
         }
         
         std::uint64_t size() const {
@@ -99,16 +138,40 @@ namespace wry {
         }
         
         iterator begin() { return _entries; }
-        iterator end() { return _entries + size(); }
+        iterator end() { return _old ? _old->end() : _entries + size(); }
         const_iterator begin() const { return _entries; }
-        const_iterator end() const { return _entries + size(); }
-        const_iterator cbegin() const { return _entries; }
-        const_iterator cend() const { return _entries + size(); }
+        const_iterator end() const { return _old ? _old->end() : _entries + size(); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+        
+        // The first nonempty entry at or after p, in iteration order
+        template<typename E>
+        E* _skip_vacant(E* p) const {
+            for (;; ++p) {
+                if (_old && (p == _entries + size()))
+                    p = _old->_entries;
+                if ((p == end()) || _service.entry_is_nonempty(*p))
+                    return p;
+            }
+        }
+        
+        // The last nonempty entry before p, in iteration order
+        template<typename E>
+        E* _retreat_vacant(E* p) const {
+            do {
+                if (_old && (p == _old->_entries))
+                    p = _entries + size();
+                --p;
+            } while (_service.entry_is_empty(*p));
+            return p;
+        }
         
         void clear() noexcept {
-            for (auto& e : *this)
-                _service.clear_entry(e);
+            for (std::uint64_t i = 0; i != size(); ++i)
+                _service.clear_entry(_entries[i]);
             _count = 0;
+            delete _old;
+            _old = nullptr;
         }
         
         void swap(BasicTable& other) {
@@ -119,6 +182,10 @@ namespace wry {
             swap(_shift, other._shift);
             swap(_count, other._count);
             swap(_trigger, other._trigger);
+            swap(_old, other._old);
+            swap(_cursor, other._cursor);
+            swap(_remaining, other._remaining);
+            swap(_incremental, other._incremental);
         }
                 
         BasicTable(with_capacity_t, std::uint64_t capacity)
@@ -127,9 +194,8 @@ namespace wry {
                 _shift = __builtin_clzll((capacity | 15) - 1);
                 _mask = ((std::uint64_t) -1) >> _shift;
                 _trigger = _mask ^ (_mask >> 3);
-                _entries = (Entry*) ::operator new(sizeof(Entry) * size());
+                _entries = _allocate_entries(size());
                 _count = 0;
-                std::uninitialized_value_construct_n(_entries, size());
             }
         }
 
@@ -139,7 +205,11 @@ namespace wry {
         , _mask(-1)
         , _shift(61)
         , _count(0)
-        , _trigger(0) {
+        , _trigger(0)
+        , _old(nullptr)
+        , _cursor(0)
+        , _remaining(0)
+        , _incremental(false) {
         }
         
         BasicTable(BasicTable&& other)
@@ -148,8 +218,41 @@ namespace wry {
         }
 
         ~BasicTable() {
-            std::destroy_n(_entries, size());
-            ::operator delete(static_cast<void*>(_entries));
+            delete _old;
+            _deallocate_entries(_entries, size(), _count);
+        }
+        
+        // If the EntryService declares that an empty Entry is all zero bytes,
+        // the array needs no construction, and a large calloc gets untouched
+        // zero pages, so that a resize does not stall writing the new array
+        static constexpr bool _zero_is_empty = requires {
+            requires EntryService::ZERO_IS_EMPTY;
+        };
+        
+        static Entry* _allocate_entries(std::uint64_t n) {
+            if constexpr (_zero_is_empty) {
+                void* p = std::calloc(n, sizeof(Entry));
+                if (!p)
+                    throw std::bad_alloc();
+                return (Entry*) p;
+            } else {
+                Entry* p = (Entry*) ::operator new(n * sizeof(Entry));
+                std::uninitialized_value_construct_n(p, n);
+                return p;
+            }
+        }
+        
+        // Destroying an all-empty zero-is-empty array is a no-op, and can be
+        // skipped
+        static void _deallocate_entries(Entry* _Nullable p, std::uint64_t n, std::uint64_t count) {
+            if constexpr (_zero_is_empty) {
+                if (count)
+                    std::destroy_n(p, n);
+                std::free(p);
+            } else {
+                std::destroy_n(p, n);
+                ::operator delete(static_cast<void*>(p));
+            }
         }
         
         BasicTable& operator=(BasicTable&& other) {
@@ -174,6 +277,14 @@ namespace wry {
 
         // Find any entry with hash h for which predicate is true
         Entry* find(std::uint64_t h, auto&& predicate) const {
+            Entry* p = _find_local(h, predicate);
+            if (!p && _old)
+                p = _old->_find_local(h, predicate);
+            return p;
+        }
+        
+        // As find, in this array only
+        Entry* _find_local(std::uint64_t h, auto&& predicate) const {
             if (!_count)
                 return nullptr;
             std::uint64_t ih = _get_index(h); // preferred index
@@ -212,25 +323,32 @@ namespace wry {
             std::construct_at(_entries + i); // was relocated from and destroyed
         }
                         
-        std::uint64_t _insert_uninitialized(std::uint64_t h, auto&& predicate) {
+        // Returns the matching entry, or an empty entry the caller must fill
+        Entry* _insert_uninitialized(std::uint64_t h, auto&& predicate) {
             if (_count == _trigger)
                 resize();
+            if (_old) {
+                _migrate(MIGRATION_STEP);
+                if (_old)
+                    if (Entry* p = _old->_find_local(h, predicate))
+                        return p;
+            }
             std::uint64_t ih = _get_index(h);
             std::uint64_t i = ih;
             for (;;) {
                 if (_service.entry_is_empty(_entries[i])) {
                     ++_count;
-                    return i;
+                    return _entries + i;
                 }
                 std::uint64_t g = _service.get_hash(_entries[i]);
                 if ((g == h) && predicate(_entries[i])) {
-                    return i;
+                    return _entries + i;
                 }
                 std::uint64_t ig = _get_index(g);
                 if (_displacement(ih, i) > _displacement(ig, i)) {
                     _relocate_backward_from(i);
                     ++_count;
-                    return i;
+                    return _entries + i;
                 }
                 i = _next_index(i);
             }
@@ -264,58 +382,151 @@ namespace wry {
         }
         
         std::size_t erase(std::uint64_t h, auto&& predicate) {
+            if (_old)
+                _migrate(MIGRATION_STEP);
             Entry* p = find(h, predicate);
             if (!p)
                 return 0;
-            _relocate_forward_into(p - _entries);
-            --_count;
+            erase_at(p);
             return 1;
         }
         
-        void resize() {
+        void erase_at(Entry* p) {
+            if ((_entries <= p) && (p < _entries + size())) {
+                _relocate_forward_into(p - _entries);
+                --_count;
+            } else {
+                assert(_old);
+                _old->erase_at(p);
+                if (!_old->_count)
+                    _release_old();
+            }
+        }
+        
+        // Move a nonempty entry that is not already present into the table,
+        // leaving the source moved-from
+        void _emplace_distinct(Entry& source) {
+            uint64_t h = _service.get_hash(source);
+            uint64_t ih = _get_index(h);
+            uint64_t j = ih;
+            while (_service.entry_is_nonempty(_entries[j])) {
+                uint64_t g = _service.get_hash(_entries[j]);
+                uint64_t ig = _get_index(g);
+                // there should be no duplicates in the input
+                // assert((g != h) || _hasher.key_compare(_entries[j], source));
+                if (_displacement(ih, j) > _displacement(ig, j)) {
+                    using std::swap;
+                    swap(_entries[j], source);
+                    h = g;
+                    ih = ig;
+                }
+                j = _next_index(j);
+            }
+            _entries[j] = std::move(source);
+        }
+        
+        // Migrate at least `budget` slots of _old, stopping only between
+        // clusters
+        void _migrate(std::uint64_t budget) {
+            assert(_old);
+            BasicTable& old = *_old;
+            while (_remaining) {
+                Entry& e = old._entries[_cursor];
+                if (old._service.entry_is_nonempty(e)) {
+                    _emplace_distinct(e);
+                    old._service.clear_entry(e);
+                    --old._count;
+                    ++_count;
+                } else if (!budget) {
+                    break;
+                }
+                budget -= (budget != 0);
+                _cursor = old._next_index(_cursor);
+                --_remaining;
+            }
+            if (!old._count)
+                _release_old();
+        }
 
+        static void _reclaim_drained_entries(void* _Nonnull p, std::uint64_t n) {
+            _deallocate_entries((Entry*) p, n, 0);
+        }
+
+        // Free the drained _old, a large array off this thread
+        void _release_old() {
+            BasicTable* old = std::exchange(_old, nullptr);
+            assert(old && !old->_count);
+            std::uint64_t n = old->size();
+            if (n * sizeof(Entry) >= BACKGROUND_RECLAIM_BYTES) {
+                table_reclaim_in_background(&_reclaim_drained_entries, old->_entries, n);
+                old->_entries = nullptr;
+                old->_mask = -1;
+            }
+            delete old;
+        }
+        
+        void _allocate_doubled() {
             size_t n = size();
-            
-            Entry* first = _entries;
-            Entry* last = _entries + n;
-            
             n = n ? (n << 1) : 16;
-            _entries = (Entry*) operator new(n * sizeof(Entry));
+            _entries = _allocate_entries(n);
             _mask = n - 1;
             --_shift;
             assert((((uint64_t) -1) >> _shift) == _mask);
             _trigger = _mask ^ (_mask >> 3);
-            assert(_count < _trigger);
+        }
+        
+        void resize() {
             
-            std::uninitialized_value_construct_n(_entries, n);
+            if (_old)
+                _migrate(-1);
+            assert(!_old);
+            
+            if (_incremental && _count) {
+                // The current array becomes _old, and is migrated by later
+                // inserts and erases
+                _old = new BasicTable;
+                _old->_service = _service;
+                _old->_entries = _entries;
+                _old->_mask = _mask;
+                _old->_shift = _shift;
+                _old->_count = _count;
+                _old->_trigger = _trigger;
+                _allocate_doubled();
+                _count = 0;
+                _cursor = 0;
+                while (_service.entry_is_nonempty(_old->_entries[_cursor]))
+                    ++_cursor;
+                _remaining = _old->size();
+                return;
+            }
+
+            size_t n = size();
+            
+            Entry* first = _entries;
+            Entry* last = _entries + n;
+            
+            _allocate_doubled();
+            assert(_count < _trigger);
             
             for (Entry* p = first; p != last; ++p) {
                 if (*p) {
-                    uint64_t h = _service.get_hash(*p);
-                    uint64_t ih = _get_index(h);
-                    uint64_t j = ih;
-                    while (_service.entry_is_nonempty(_entries[j])) {
-                        uint64_t g = _service.get_hash(_entries[j]);
-                        uint64_t ig = _get_index(g);
-                        // there should be no duplicates in the input
-                        // assert((g != h) || _hasher.key_compare(_entries[j], *p));
-                        if (_displacement(ih, j) > _displacement(ig, j)) {
-                            using std::swap;
-                            swap(_entries[j], *p);
-                            h = g;
-                            ih = ig;
-                        }
-                        j = _next_index(j);
-                    }
-                    _entries[j] = std::move(*p);
+                    _emplace_distinct(*p);
+                    _service.clear_entry(*p); // <-- relocate instead?
                 }
-                std::destroy_at(p); // <-- relocate instead?
             }
-            ::operator delete(static_cast<void*>(first));
+            _deallocate_entries(first, last - first, 0);
         }
         
         void _invariant() const {
 #ifndef NDEBUG
+            if (_old) {
+                _old->_invariant();
+                assert(_old->_count);
+                assert(_count + _old->_count <= _trigger);
+                // the migrated slots are empty
+                for (std::uint64_t k = 1; k <= _old->size() - _remaining; ++k)
+                    assert(_service.entry_is_empty(_old->_entries[(_cursor - k) & _old->_mask]));
+            }
             assert(_count <= _trigger);
             if (_count == 0) {
                 return;
@@ -348,7 +559,7 @@ namespace wry {
         }
         
         std::uint64_t total_displacement() const {
-            std::uint64_t n = 0;
+            std::uint64_t n = _old ? _old->total_displacement() : 0;
             for (std::uint64_t i = 0; i != size(); ++i) {
                 if (_service.entry_is_nonempty(_entries[i])) {
                     std::uint64_t h = _service.get_hash(_entries[i]);
@@ -470,6 +681,9 @@ namespace wry {
             bool entry_is_nonempty(Entry const& e) const {
                 return (bool)e;
             }
+            
+            // A zero _hash is empty, and the union is then inactive
+            static constexpr bool ZERO_IS_EMPTY = true;
 
 
         };
@@ -494,15 +708,11 @@ namespace wry {
             }
             
             void _advance() {
-                while ((_pointer != _end()) && (!*_pointer))
-                    ++_pointer;
-
+                _pointer = _context->_skip_vacant(_pointer);
             }
             
             void _retreat() {
-                do {
-                    --_pointer;
-                } while (!*_pointer);
+                _pointer = _context->_retreat_vacant(_pointer);
             }
             
             iterator() = default;
@@ -559,15 +769,11 @@ namespace wry {
             }
             
             void _advance() {
-                while ((_pointer != _end()) && !*_pointer)
-                    ++_pointer;
-                
+                _pointer = _context->_skip_vacant(_pointer);
             }
             
             void _retreat() {
-                do {
-                    --_pointer;
-                } while (!*_pointer);
+                _pointer = _context->_retreat_vacant(_pointer);
             }
             
             const_iterator(const Entry* b, const BasicTable<Entry, EntryService>* c)
@@ -637,6 +843,7 @@ namespace wry {
         
         Table(const Table& other)
         : _inner(with_capacity, other.size()) {
+            _inner._incremental = other._inner._incremental;
             for (const auto& a : other) {
                 insert(a);
             }
@@ -644,6 +851,11 @@ namespace wry {
         
         ~Table() = default;
         
+        // Opt in to incremental resize; see BasicTable
+        void set_incremental_resize(bool flag) {
+            _inner._incremental = flag;
+        }
+        
         Table& operator=(const Table& other) {
             return Table(other).swap(*this);
         }
@@ -711,10 +923,9 @@ namespace wry {
 
         std::pair<iterator, bool> emplace(auto&& key, auto&& value) {
             std::uint64_t h = _inner._service.get_hash(key);
-            std::uint64_t i = _inner._insert_uninitialized(h, [&key](Entry& e) {
+            Entry* p = _inner._insert_uninitialized(h, [&key](Entry& e) {
                 return e._kv.first == key;
             });
-            Entry* p = _inner._entries + i;
             if (p->_hash) {
                 return {iterator{p, &_inner}, false};
             } else {
@@ -728,11 +939,10 @@ namespace wry {
 
         std::pair<iterator, bool> insert(auto&& value) {
             std::uint64_t h = _inner._service.get_hash(value);
-            std::uint64_t i = _inner._insert_uninitialized(h,
-                                                           [&](Entry& e) {
+            Entry* p = _inner._insert_uninitialized(h,
+                                                    [&](Entry& e) {
                 return e._kv.first == value.first;
             });
-            Entry* p = _inner._entries + i;
             if (p->_hash) {
                 return {iterator{p, &_inner}, false};
             } else {
@@ -750,11 +960,10 @@ namespace wry {
 
         std::pair<iterator, bool> insert_or_assign(auto&& k, auto&& v) {
             std::uint64_t h = _inner._service.get_hash(k);
-            std::uint64_t i = _inner._insert_uninitialized(h,
-                                                           [&](Entry& e) {
+            Entry* p = _inner._insert_uninitialized(h,
+                                                    [&](Entry& e) {
                 return e._kv.first == k;
             });
-            Entry* p = _inner._entries + i;
             if (p->_hash) {
                 p->_kv.first = std::forward<decltype(k)>(k);
                 p->_kv.second = std::forward<decltype(v)>(v);
@@ -770,8 +979,7 @@ namespace wry {
         
         std::size_t erase(iterator pos) {
             assert(pos._pointer->_hash);
-            _inner._relocate_forward_into(pos._pointer - _inner._entries);
-            --_inner._count;
+            _inner.erase_at(pos._pointer);
             return 1;
         }
         
@@ -786,10 +994,9 @@ namespace wry {
         
         T& operator[](auto&& keylike) {
             std::uint64_t h = _inner._service.get_hash(keylike);
-            std::uint64_t i = _inner._insert_uninitialized(h, [&](const Entry& e) {
+            Entry* p = _inner._insert_uninitialized(h, [&](const Entry& e) {
                 return e._kv.first == keylike;
             });
-            Entry* p = _inner._entries + i;
             if (!(p->_hash)) {
                 p->_hash = h;
                 std::construct_at(&(p->_kv),
@@ -6,6 +6,7 @@
 //
 
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <limits>
 #include <map>
@@ -244,6 +245,302 @@ namespace wry {
         co_return;
     };
 
+    namespace {
+
+        // Keeps the timed loops live under NDEBUG
+        u64 waitable_map_sink = 0;
+
+    } // anonymous namespace
+
+    // The parallel scan against the sequential one: the ordered fold must
+    // reproduce visit_in_region's order exactly, and a per-cell visit must
+    // write each cell once.  Then a full-extent scan, to see it scale.
+    define_test("waitable_map_parallel_visit_in_region") {
+
+        std::mt19937_64 gen{20261019};
+
+        WaitableMap<Coordinate, EntityID> m;
+        for (int i = 0; i != 1 << 14; ++i)
+            m.set(Coordinate{(i32)(gen() % 301) - 150, (i32)(gen() % 301) - 150},
+                  EntityID{gen() | 1});
+        for (int i = 0; i != 100; ++i)
+            m.set(Coordinate{(i32)gen(), (i32)gen()}, EntityID{gen() | 1});
+
+        using Hits = std::vector<std::pair<u64, u64>>;
+        auto concatenate = [](Hits a, Hits b) {
+            a.insert(a.end(), b.begin(), b.end());
+            return a;
+        };
+        auto record = [](Hits& a, Coordinate xy, EntityID id) {
+            a.emplace_back(DefaultKeyService<Coordinate>{}.encode(xy), id.data);
+        };
+
+        auto check = [&](Coordinate lo, Coordinate hi) -> Coroutine::Task {
+            Hits expected;
+            visit_in_region(m, lo, hi, [&](Coordinate xy, EntityID id) {
+                record(expected, xy, id);
+            });
+            Hits got = co_await coroutine_parallel_fold_in_region(m, lo, hi, Hits{}, record, concatenate);
+            assert(got == expected);
+        };
+        co_await check(Coordinate{-150, -150}, Coordinate{150, 150});
+        co_await check(Coordinate{-40, 7}, Coordinate{90, 11});
+        co_await check(Coordinate{3, 3}, Coordinate{3, 3});
+        co_await check(Coordinate{std::numeric_limits<i32>::min(),
+                                  std::numeric_limits<i32>::min()},
+                       Coordinate{std::numeric_limits<i32>::max(),
+                                  std::numeric_limits<i32>::max()});
+        for (int i = 0; i != 20; ++i) {
+            i32 x0 = (i32)(gen() % 301) - 150;
+            i32 y0 = (i32)(gen() % 301) - 150;
+            co_await check(Coordinate{x0, y0},
+                           Coordinate{x0 + (i32)(gen() % 200), y0 + (i32)(gen() % 200)});
+        }
+
+        // unsynchronized per-cell writes
+        {
+            constexpr i32 R = 150;
+            std::vector<u64> grid((2 * R + 1) * (2 * R + 1), 0);
+            co_await coroutine_parallel_visit_in_region(m, Coordinate{-R, -R}, Coordinate{R, R},
+                                                        [&grid](Coordinate xy, EntityID id) {
+                u64& cell = grid[(size_t)(xy.y + R) * (2 * R + 1) + (size_t)(xy.x + R)];
+                assert(!cell);
+                cell = id.data;
+            });
+            visit_in_region(m, Coordinate{-R, -R}, Coordinate{R, R},
+                            [&grid](Coordinate xy, EntityID id) {
+                assert(grid[(size_t)(xy.y + R) * (2 * R + 1) + (size_t)(xy.x + R)] == id.data);
+            });
+        }
+
+        // full scan of a dense 1024 x 1024 map
+        {
+            WaitableMap<Coordinate, EntityID> dense;
+            for (i32 y = 0; y != 1024; ++y)
+                for (i32 x = 0; x != 1024; ++x)
+                    dense.set(Coordinate{x, y}, EntityID{(u64)(y * 1024 + x) + 1});
+            Coordinate lo{0, 0};
+            Coordinate hi{1023, 1023};
+            auto add = [](u64& a, Coordinate, EntityID id) { a += id.data * id.data; };
+            auto plus = [](u64 a, u64 b) { return a + b; };
+            constexpr int REPEATS = 8;
+            u64 expected = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            for (int r = 0; r != REPEATS; ++r) {
+                expected = 0;
+                visit_in_region(dense, lo, hi, [&expected](Coordinate, EntityID id) {
+                    expected += id.data * id.data;
+                });
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            u64 got = 0;
+            for (int r = 0; r != REPEATS; ++r)
+                got = co_await coroutine_parallel_fold_in_region(dense, lo, hi, (u64)0, add, plus);
+            auto t2 = std::chrono::steady_clock::now();
+            assert(got == expected);
+            waitable_map_sink += got;
+            printf("full scan of 2^20 entries (ms)\n");
+            printf("%12s %12s\n", "sequential", "parallel");
+            printf("%12.3f %12.3f\n",
+                   std::chrono::duration<double>(t1 - t0).count() * 1e3 / REPEATS,
+                   std::chrono::duration<double>(t2 - t1).count() * 1e3 / REPEATS);
+        }
+
+        co_return;
+    };
+
+    // visit_changed_in_region must cover every cell whose entry differs
+    // between the versions, and report nothing for shared structure
+    define_test("waitable_map_visit_changed_in_region") {
+
+        std::mt19937_64 gen{20261020};
+
+        for (int iter = 0; iter != 200; ++iter) {
+            i32 span = 8 << (gen() % 10);
+            auto random_i32 = [&]() {
+                return (gen() % 20) ? (i32)(gen() % (2 * span + 1)) - span : (i32)gen();
+            };
+            WaitableMap<Coordinate, EntityID> a;
+            std::map<std::pair<i32, i32>, u64> truth_a;
+            for (int n = (int)(gen() % 2000); n--;) {
+                Coordinate xy{random_i32(), random_i32()};
+                u64 id = gen() | 1;
+                a.set(xy, EntityID{id});
+                truth_a[{xy.x, xy.y}] = id;
+            }
+            WaitableMap<Coordinate, EntityID> b = a;
+            std::map<std::pair<i32, i32>, u64> truth_b = truth_a;
+            for (int n = (int)(gen() % 8); n--;) {
+                if ((gen() & 1) && !truth_b.empty()) {
+                    auto it = std::next(truth_b.begin(), (std::ptrdiff_t)(gen() % truth_b.size()));
+                    EntityID victim = {};
+                    b.kv.try_erase(Coordinate{it->first.first, it->first.second}, victim);
+                    truth_b.erase(it);
+                } else {
+                    Coordinate xy{random_i32(), random_i32()};
+                    u64 id = gen() | 1;
+                    b.set(xy, EntityID{id});
+                    truth_b[{xy.x, xy.y}] = id;
+                }
+            }
+
+            Coordinate lo{std::numeric_limits<i32>::min(), std::numeric_limits<i32>::min()};
+            Coordinate hi{std::numeric_limits<i32>::max(), std::numeric_limits<i32>::max()};
+            if (iter & 1) {
+                lo = Coordinate{-span / 2, -span / 3};
+                hi = Coordinate{span / 3, span / 2};
+            }
+            std::vector<std::pair<Coordinate, Coordinate>> rectangles;
+            visit_changed_in_region(a, b, lo, hi, [&](Coordinate r0, Coordinate r1) {
+                assert((lo.x <= r0.x) && (r0.x <= r1.x) && (r1.x <= hi.x));
+                assert((lo.y <= r0.y) && (r0.y <= r1.y) && (r1.y <= hi.y));
+                rectangles.emplace_back(r0, r1);
+            });
+            auto check = [&](std::pair<i32, i32> xy) {
+                if ((xy.first < lo.x) || (hi.x < xy.first) || (xy.second < lo.y) || (hi.y < xy.second))
+                    return;
+                bool covered = false;
+                for (auto [r0, r1] : rectangles)
+                    covered = covered || ((r0.x <= xy.first) && (xy.first <= r1.x)
+                                          && (r0.y <= xy.second) && (xy.second <= r1.y));
+                assert(covered);
+            };
+            for (auto [xy, id] : truth_a) {
+                auto it = truth_b.find(xy);
+                if ((it == truth_b.end()) || (it->second != id))
+                    check(xy);
+            }
+            for (auto [xy, id] : truth_b)
+                if (!truth_a.contains(xy))
+                    check(xy);
+
+            int count = 0;
+            visit_changed_in_region(b, b, lo, hi, [&count](Coordinate, Coordinate) { ++count; });
+            assert(count == 0);
+        }
+
+        co_return;
+    };
+
+    // Differential oracle for visit_nearest / k_nearest / visit_in_radius:
+    // brute-force distances sorted by (distance, Morton code), which is the
+    // order ties must come out in.  Then the payoff against the obvious
+    // alternative, an expanding square of visit_in_region scans.
+    define_test("waitable_map_nearest") {
+
+        using H = DefaultKeyService<Coordinate>;
+        std::mt19937_64 gen{20261018};
+
+        WaitableMap<Coordinate, EntityID> m;
+        assert(k_nearest(m, Coordinate{0, 0}, 3).empty());
+
+        std::map<std::pair<i32, i32>, u64> truth;
+        auto put = [&](i32 x, i32 y) {
+            u64 id = gen() | 1;
+            m.set(Coordinate{x, y}, EntityID{id});
+            truth[{x, y}] = id;
+        };
+        for (int i = 0; i != 2000; ++i)
+            put((i32)(gen() % 61) - 30, (i32)(gen() % 61) - 30);
+        for (int i = 0; i != 500; ++i)
+            put((i32)(gen() % 20001) - 10000, (i32)(gen() % 20001) - 10000);
+        for (int i = 0; i != 50; ++i)
+            put((i32)gen(), (i32)gen());
+
+        using Hit = std::tuple<u64, u64, u64>; // distance, code, id
+        auto expected = [&](Coordinate centre, SpatialMetric metric, u64 radius) {
+            std::vector<Hit> result;
+            u64 limit = spatial_distance_for_radius(metric, radius);
+            for (auto&& [xy, id] : truth) {
+                Coordinate c{xy.first, xy.second};
+                u64 d = spatial_distance(metric, centre, c);
+                if (d <= limit)
+                    result.emplace_back(d, H{}.encode(c), id);
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        };
+
+        for (int i = 0; i != 100; ++i) {
+            Coordinate centre = (i % 4)
+                ? Coordinate{(i32)(gen() % 30001) - 15000, (i32)(gen() % 30001) - 15000}
+                : Coordinate{(i32)(gen() % 81) - 40, (i32)(gen() % 81) - 40};
+            SpatialMetric metric = (i & 1) ? SPATIAL_MANHATTAN : SPATIAL_EUCLIDEAN;
+            std::vector<Hit> all = expected(centre, metric, ~(u64)0);
+            assert(all.size() == truth.size());
+
+            size_t k = (size_t)(gen() % 40);
+            auto near = k_nearest(m, centre, k, metric);
+            assert(near.size() == std::min(k, all.size()));
+            for (size_t j = 0; j != near.size(); ++j) {
+                auto [d, code, id] = all[j];
+                assert(H{}.encode(near[j].first) == code);
+                assert(near[j].second.data == id);
+            }
+
+            u64 radius = gen() % 3000;
+            std::vector<Hit> within = expected(centre, metric, radius);
+            std::vector<Hit> got;
+            visit_in_radius(m, centre, radius, metric, [&](Coordinate xy, EntityID id) {
+                got.emplace_back(spatial_distance(metric, centre, xy), H{}.encode(xy), id.data);
+            });
+            assert(got == within);
+        }
+
+        // the sweep orders every entry, across the sign boundaries
+        {
+            auto near = k_nearest(m.kv, Coordinate{0, 0}, truth.size() + 1);
+            assert(near.size() == truth.size());
+        }
+
+        // k nearest on a sparse map: best-first against squares of doubling
+        // half-width, each a visit_in_region, until the k-th hit lies inside
+        // the square's inscribed circle
+        {
+            WaitableMap<Coordinate, EntityID> sparse;
+            for (int i = 0; i != 1 << 14; ++i)
+                sparse.set(Coordinate{(i32)(gen() % 2000001) - 1000000,
+                                      (i32)(gen() % 2000001) - 1000000},
+                           EntityID{gen() | 1});
+            std::vector<Coordinate> centres;
+            for (int i = 0; i != 256; ++i)
+                centres.push_back(Coordinate{(i32)(gen() % 2000001) - 1000000,
+                                             (i32)(gen() % 2000001) - 1000000});
+            constexpr size_t K = 8;
+
+            auto t0 = std::chrono::steady_clock::now();
+            for (Coordinate centre : centres) {
+                std::vector<std::pair<u64, u64>> hits;
+                for (i64 h = 1;; h *= 2) {
+                    hits.clear();
+                    visit_in_region(sparse,
+                                    Coordinate{(i32)std::max<i64>(centre.x - h, INT32_MIN),
+                                               (i32)std::max<i64>(centre.y - h, INT32_MIN)},
+                                    Coordinate{(i32)std::min<i64>(centre.x + h, INT32_MAX),
+                                               (i32)std::min<i64>(centre.y + h, INT32_MAX)},
+                                    [&](Coordinate xy, EntityID id) {
+                        hits.emplace_back(spatial_distance(SPATIAL_EUCLIDEAN, centre, xy), id.data);
+                    });
+                    std::sort(hits.begin(), hits.end());
+                    if ((hits.size() >= K) && (hits[K - 1].first <= (u64)(h * h)))
+                        break;
+                }
+                waitable_map_sink += hits[K - 1].second;
+            }
+            auto t1 = std::chrono::steady_clock::now();
+            for (Coordinate centre : centres)
+                waitable_map_sink += k_nearest(sparse, centre, K).back().second.data;
+            auto t2 = std::chrono::steady_clock::now();
+            printf("%zu nearest of 2^14 sparse entries (ns per query)\n", K);
+            printf("%12s %12s\n", "squares", "best-first");
+            printf("%12.0f %12.0f\n",
+                   std::chrono::duration<double>(t1 - t0).count() * 1e9 / centres.size(),
+                   std::chrono::duration<double>(t2 - t1).count() * 1e9 / centres.size());
+        }
+
+        co_return;
+    };
+
 } // namespace wry
 
 
@@ -8,6 +8,13 @@
 #ifndef waitable_map_hpp
 #define waitable_map_hpp
 
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
 #include "persistent_map.hpp"
 #include "persistent_set.hpp"
 #include "entity.hpp"
@@ -59,6 +66,33 @@ namespace wry {
     // everything".  Blocks disjoint from the query prune; blocks contained in
     // the query switch to a test-free for_each.
 
+    // The closed extent [x0, x1] x [y0, y1] of the Morton block a node
+    // covers; an axis with a free sign bit spans all of i32
+    struct _MortonBlock {
+        i32 x0, x1, y0, y1;
+    };
+
+    template<typename N>
+    _MortonBlock _morton_block_of(const N* node) {
+        using H = DefaultKeyService<Coordinate>;
+        Coordinate c0 = H{}.decode(node->_prefix);
+        Coordinate c1 = H{}.decode(node->_prefix | ~node->get_prefix_mask());
+        _MortonBlock b{c0.x, c1.x, c0.y, c1.y};
+        if (c0.x > c1.x) {
+            b.x0 = std::numeric_limits<i32>::min();
+            b.x1 = std::numeric_limits<i32>::max();
+        }
+        if (c0.y > c1.y) {
+            b.y0 = std::numeric_limits<i32>::min();
+            b.y1 = std::numeric_limits<i32>::max();
+        }
+        return b;
+    }
+
+    inline bool _morton_block_meets(_MortonBlock b, Coordinate lo, Coordinate hi) {
+        return (lo.x <= b.x1) && (b.x0 <= hi.x) && (lo.y <= b.y1) && (b.y0 <= hi.y);
+    }
+
     template<typename N, typename F>
     void _visit_in_region_descend(const N* node,
                                   Coordinate lo, Coordinate hi,
@@ -66,17 +100,11 @@ namespace wry {
         if (!node)
             return;
         using H = DefaultKeyService<Coordinate>;
-        Coordinate c0 = H{}.decode(node->_prefix);
-        Coordinate c1 = H{}.decode(node->_prefix | ~node->get_prefix_mask());
-        bool x_wraps = c0.x > c1.x;
-        bool y_wraps = c0.y > c1.y;
-        if (!x_wraps && ((c1.x < lo.x) || (hi.x < c0.x)))
-            return;
-        if (!y_wraps && ((c1.y < lo.y) || (hi.y < c0.y)))
+        _MortonBlock b = _morton_block_of(node);
+        if (!_morton_block_meets(b, lo, hi))
             return;
-        bool contained = !x_wraps && !y_wraps
-            && (lo.x <= c0.x) && (c1.x <= hi.x)
-            && (lo.y <= c0.y) && (c1.y <= hi.y);
+        bool contained = (lo.x <= b.x0) && (b.x1 <= hi.x)
+            && (lo.y <= b.y0) && (b.y1 <= hi.y);
         if (contained) {
             node->for_each([&action](uint64_t code, auto value) {
                 action(H{}.decode(code), value);
@@ -108,6 +136,358 @@ namespace wry {
                                  lo, hi, action);
     }
 
+    // ---- Parallel region scans ----------------------------------------------
+    //
+    // The same descent, forking the children of large partially-covered
+    // blocks while the work queue is hungry for them and scanning small
+    // blocks sequentially (see global_work_queue.hpp).  Each task owns one
+    // subtree, which is one contiguous range of Morton codes and so one
+    // quadtree block of the plane: concurrent calls of the action never
+    // share a cell, so an action writing per-cell output (a pixel, a tile)
+    // needs no synchronization.  Anything else it touches must be safe to
+    // touch concurrently.
+    //
+    // The fold gives each task its own accumulator, copied from `identity`,
+    // and combines the children's accumulators in Morton order, so with an
+    // associative `combine` the result is the one a sequential fold in
+    // visit_in_region order would produce, however the tasks were
+    // scheduled.  Concatenating vectors, for example, yields the entries in
+    // exactly the sequential order.
+
+    template<typename A, typename N, typename V, typename C>
+    Coroutine::Future<A> _coroutine_parallel_fold_in_region(const N* node,
+                                                            Coordinate lo, Coordinate hi,
+                                                            const A& identity,
+                                                            const V& visit,
+                                                            const C& combine) {
+        A accumulator = identity;
+        if (!node)
+            co_return accumulator;
+        size_t n = node->_estimated_size();
+        if (!node->has_children() || (n < global_work_queue_sequential_cutoff())) {
+            TaskTraceSpan span{"visit_in_region", n};
+            _visit_in_region_descend(node, lo, hi, [&accumulator, &visit](Coordinate xy, auto const& value) {
+                visit(accumulator, xy, value);
+            });
+            co_return accumulator;
+        }
+        if (!_morton_block_meets(_morton_block_of(node), lo, hi))
+            co_return accumulator;
+        int m = std::popcount(node->_bitmap);
+        std::vector<A> results(m, identity);
+        {
+            Coroutine::Nursery nursery;
+            for (int i = 0; i != m; ++i) {
+                const N* child = node->_children[i];
+                if (global_work_queue_should_fork(child->_estimated_size()))
+                    co_await nursery.fork(results[i], _coroutine_parallel_fold_in_region<A>(child, lo, hi, identity, visit, combine));
+                else
+                    results[i] = co_await _coroutine_parallel_fold_in_region<A>(child, lo, hi, identity, visit, combine);
+            }
+            co_await nursery.join();
+        }
+        for (A& result : results)
+            accumulator = combine(std::move(accumulator), std::move(result));
+        co_return accumulator;
+    }
+
+    // visit(A&, Coordinate, T const&) folds one entry into a task's
+    // accumulator; combine(A, A) -> A merges a lower-coded block's
+    // accumulator with the next's
+    template<typename T, typename A, typename V, typename C>
+    Coroutine::Future<A> coroutine_parallel_fold_in_region(const WaitableMap<Coordinate, T>& map,
+                                                           Coordinate lo, Coordinate hi,
+                                                           A identity,
+                                                           V visit,
+                                                           C combine) {
+        assert((lo.x <= hi.x) && (lo.y <= hi.y));
+        co_return co_await _coroutine_parallel_fold_in_region<A>(map.kv._inner ? &*map.kv._inner : nullptr,
+                                                                 lo, hi, identity, visit, combine);
+    }
+
+    // action(Coordinate, T const&), called concurrently for distinct cells
+    template<typename T, typename F>
+    Coroutine::Task coroutine_parallel_visit_in_region(const WaitableMap<Coordinate, T>& map,
+                                                       Coordinate lo, Coordinate hi,
+                                                       F action) {
+        co_await coroutine_parallel_fold_in_region(map, lo, hi,
+                                                   std::monostate{},
+                                                   [&action](std::monostate&, Coordinate xy, T const& value) {
+            action(xy, value);
+        },
+                                                   [](std::monostate, std::monostate) {
+            return std::monostate{};
+        });
+    }
+
+    // ---- Changed regions ------------------------------------------------------
+    //
+    // Where two versions of a map may differ, for consumers that keep a
+    // derived image of one version and want to bring it up to date with the
+    // next.  The walk descends the two tries together and skips any subtree
+    // they share by pointer, which after a rebuild is everything that the
+    // rebuild did not touch, so its cost follows the changes rather than the
+    // map.  Each leaf that differs, or exists in only one version, is
+    // reported as its Morton block clipped to the query rectangle;
+    // a reported rectangle may contain unchanged cells, but every changed
+    // cell in the query lies in some reported rectangle.
+
+    template<typename N, typename F>
+    void _visit_changed_descend(const N* a, const N* b,
+                                Coordinate lo, Coordinate hi,
+                                F& action) {
+        if (a == b)
+            return;
+        if (!a)
+            std::swap(a, b);
+        _MortonBlock block = _morton_block_of(a);
+        if (b && ((b->_shift != a->_shift) || (b->_prefix != a->_prefix))) {
+            if (b->_shift > a->_shift) {
+                std::swap(a, b);
+                block = _morton_block_of(a);
+            }
+            if ((a->_shift == b->_shift) || !a->prefix_includes_key(b->_prefix)) {
+                // disjoint blocks: each side is wholly changed
+                _visit_changed_descend(a, (const N*)nullptr, lo, hi, action);
+                _visit_changed_descend(b, (const N*)nullptr, lo, hi, action);
+                return;
+            }
+        }
+        if (!_morton_block_meets(block, lo, hi))
+            return;
+        if (a->has_values()) {
+            action(Coordinate{std::max(block.x0, lo.x), std::max(block.y0, lo.y)},
+                   Coordinate{std::min(block.x1, hi.x), std::min(block.y1, hi.y)});
+            return;
+        }
+        // b is null, the same block, or nested in one of a's slots
+        bool same = b && (b->_shift == a->_shift);
+        auto bitmap = a->_bitmap;
+        if (same)
+            bitmap |= b->_bitmap;
+        else if (b)
+            bitmap |= (decltype(bitmap))1 << a->get_index_for_key(b->_prefix);
+        for (; bitmap; bitmap &= (bitmap - 1)) {
+            int index = bit::ctz(bitmap);
+            auto select = (decltype(bitmap))1 << index;
+            auto child = [index, select](const N* node) -> const N* {
+                if (!node || !(node->_bitmap & select))
+                    return nullptr;
+                return node->_children[std::popcount(node->_bitmap & (select - 1))];
+            };
+            const N* other = nullptr;
+            if (same)
+                other = child(b);
+            else if (b && (a->get_index_for_key(b->_prefix) == index))
+                other = b;
+            _visit_changed_descend(child(a), other, lo, hi, action);
+        }
+    }
+
+    // action(Coordinate lo, Coordinate hi) for each possibly-changed
+    // rectangle, in no particular order
+    template<typename T, typename F>
+    void visit_changed_in_region(const WaitableMap<Coordinate, T>& before,
+                                 const WaitableMap<Coordinate, T>& after,
+                                 Coordinate lo, Coordinate hi,
+                                 F&& action) {
+        assert((lo.x <= hi.x) && (lo.y <= hi.y));
+        _visit_changed_descend(before.kv._inner ? &*before.kv._inner : nullptr,
+                               after.kv._inner ? &*after.kv._inner : nullptr,
+                               lo, hi, action);
+    }
+
+    // ---- Nearest-first queries ---------------------------------------------
+    //
+    // Best-first search over the same Morton blocks: a min-queue holds nodes
+    // keyed by the distance from the centre to their block (a lower bound
+    // for everything inside) and entries keyed by their exact distance.
+    // Popping in key order visits entries nearest first, expands only
+    // blocks that could still hold something nearer than what has been
+    // visited, and stops as soon as the action declines more or the queue
+    // passes the radius, so the cost follows the answer and the local
+    // density, not the map's extent.  Equal distances visit in Morton
+    // order: a node sorts before an entry at the same key, so every entry
+    // at a distance is queued before the first of them is visited.
+    //
+    // Distances are in the metric's own units: Manhattan, or SQUARED
+    // Euclidean (saturating, which only conflates pairs more than 2^31.5
+    // apart).
+
+    enum SpatialMetric {
+        SPATIAL_EUCLIDEAN,
+        SPATIAL_MANHATTAN,
+    };
+
+    inline u64 spatial_distance_for_offsets(SpatialMetric metric, u64 dx, u64 dy) {
+        switch (metric) {
+            case SPATIAL_EUCLIDEAN: {
+                u64 a = dx * dx;
+                u64 b = dy * dy;
+                return (a > ~b) ? ~(u64)0 : a + b;
+            }
+            case SPATIAL_MANHATTAN:
+                return dx + dy;
+        }
+        std::unreachable();
+    }
+
+    inline u64 spatial_distance(SpatialMetric metric, Coordinate a, Coordinate b) {
+        auto offset = [](i32 p, i32 q) -> u64 {
+            return (p < q) ? (u64)((i64)q - p) : (u64)((i64)p - q);
+        };
+        return spatial_distance_for_offsets(metric, offset(a.x, b.x), offset(a.y, b.y));
+    }
+
+    // The distance equivalent of a radius in cells
+    inline u64 spatial_distance_for_radius(SpatialMetric metric, u64 radius) {
+        if (radius > std::numeric_limits<u32>::max())
+            return ~(u64)0;
+        return spatial_distance_for_offsets(metric, radius, 0);
+    }
+
+    template<typename N>
+    u64 _spatial_distance_to_block(SpatialMetric metric, Coordinate centre, const N* node) {
+        _MortonBlock b = _morton_block_of(node);
+        auto offset = [](i32 p, i32 lo, i32 hi) -> u64 {
+            if (p < lo)
+                return (u64)((i64)lo - p);
+            if (hi < p)
+                return (u64)((i64)p - hi);
+            return 0;
+        };
+        return spatial_distance_for_offsets(metric,
+                                            offset(centre.x, b.x0, b.x1),
+                                            offset(centre.y, b.y0, b.y1));
+    }
+
+    // action(Coordinate, T, u64 distance) -> bool: false ends the search
+    template<typename N, typename F>
+    void _visit_nearest_search(const N* root,
+                               Coordinate centre,
+                               SpatialMetric metric,
+                               u64 max_distance,
+                               F&& action) {
+        if (!root)
+            return;
+        using H = DefaultKeyService<Coordinate>;
+        struct Item {
+            u64 distance;
+            bool is_entry;
+            u64 code;       // the entry's, or the block's first
+            const N* node;  // the entry's leaf, or the block
+            int index;      // the entry's slot in its leaf
+            bool operator>(const Item& other) const {
+                return std::tie(distance, is_entry, code) > std::tie(other.distance, other.is_entry, other.code);
+            }
+        };
+        std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+        auto push_node = [&](const N* node) {
+            u64 d = _spatial_distance_to_block(metric, centre, node);
+            if (d <= max_distance)
+                queue.push(Item{d, false, node->_prefix, node, 0});
+        };
+        push_node(root);
+        while (!queue.empty()) {
+            Item item = queue.top();
+            queue.pop();
+            if (item.is_entry) {
+                if (!action(H{}.decode(item.code), item.node->_values[item.index], item.distance))
+                    return;
+            } else if (item.node->has_children()) {
+                int n = std::popcount(item.node->_bitmap);
+                for (int i = 0; i != n; ++i)
+                    push_node(item.node->_children[i]);
+            } else {
+                const N* leaf = item.node;
+                auto b = leaf->_bitmap;
+                for (int i = 0; b != 0; ++i, (b &= (b-1))) {
+                    u64 code = leaf->_prefix | bit::ctz(b);
+                    u64 d = spatial_distance(metric, centre, H{}.decode(code));
+                    if (d <= max_distance)
+                        queue.push(Item{d, true, code, leaf, i});
+                }
+            }
+        }
+    }
+
+    // Entries within `radius` cells of `centre`, nearest first, until
+    // action(Coordinate, T, u64 distance) returns false.  The general
+    // primitive: stop after k for k-nearest, or on the first match for
+    // "the nearest such-and-such".
+    template<typename T, typename F>
+    void visit_nearest(const WaitableMap<Coordinate, T>& map,
+                       Coordinate centre,
+                       SpatialMetric metric,
+                       u64 radius,
+                       F&& action) {
+        _visit_nearest_search(map.kv._inner ? &*map.kv._inner : nullptr,
+                              centre, metric,
+                              spatial_distance_for_radius(metric, radius),
+                              action);
+    }
+
+    template<typename T, typename D, typename F>
+    void visit_nearest(const PersistentMap<Coordinate, T, DefaultKeyService<Coordinate>, D>& map,
+                       Coordinate centre,
+                       SpatialMetric metric,
+                       u64 radius,
+                       F&& action) {
+        _visit_nearest_search(map._inner ? &*map._inner : nullptr,
+                              centre, metric,
+                              spatial_distance_for_radius(metric, radius),
+                              action);
+    }
+
+    // Every entry within `radius` cells of `centre`, nearest first
+    template<typename Map, typename F>
+    void visit_in_radius(const Map& map,
+                         Coordinate centre,
+                         u64 radius,
+                         SpatialMetric metric,
+                         F&& action) {
+        visit_nearest(map, centre, metric, radius, [&action](Coordinate xy, auto const& value, u64) {
+            action(xy, value);
+            return true;
+        });
+    }
+
+    // The k entries nearest `centre` (fewer if the map, or the radius, runs
+    // out), nearest first
+    template<typename T, typename Map>
+    std::vector<std::pair<Coordinate, T>> _k_nearest(const Map& map,
+                                                     Coordinate centre,
+                                                     size_t k,
+                                                     SpatialMetric metric,
+                                                     u64 radius) {
+        std::vector<std::pair<Coordinate, T>> result;
+        if (!k)
+            return result;
+        visit_nearest(map, centre, metric, radius, [&result, k](Coordinate xy, T const& value, u64) {
+            result.emplace_back(xy, value);
+            return result.size() < k;
+        });
+        return result;
+    }
+
+    template<typename T>
+    std::vector<std::pair<Coordinate, T>> k_nearest(const WaitableMap<Coordinate, T>& map,
+                                                    Coordinate centre,
+                                                    size_t k,
+                                                    SpatialMetric metric = SPATIAL_EUCLIDEAN,
+                                                    u64 radius = ~(u64)0) {
+        return _k_nearest<T>(map, centre, k, metric, radius);
+    }
+
+    template<typename T, typename D>
+    std::vector<std::pair<Coordinate, T>> k_nearest(const PersistentMap<Coordinate, T, DefaultKeyService<Coordinate>, D>& map,
+                                                    Coordinate centre,
+                                                    size_t k,
+                                                    SpatialMetric metric = SPATIAL_EUCLIDEAN,
+                                                    u64 radius = ~(u64)0) {
+        return _k_nearest<T>(map, centre, k, metric, radius);
+    }
+
     // Combine for the ki waiter index: WRITE replaces a key's waitset, CLEAR
     // erases it, MERGE is the read-modify-write union (the combine's `old` arg is
     // the RMW read), NONE keeps it.
@@ -187,6 +567,7 @@ namespace wry {
         for (int c = 0; c < n_slots; ++c)
             if (out[c])
                 node->insert_child(out[c]);
+        node->_recompute_augment();
         return node;
     }
 
@@ -275,6 +656,12 @@ namespace wry {
         skiplist_partition_frame(cursor, (uint64_t)prefix, shift, n_slots, child_cur,
                                  [](const auto& key) -> uint64_t { return H{}.encode(key.first); });
 
+        // The modifier count under a child is not known without walking it,
+        // so bound the child's work by the codes it spans; small frames are
+        // awaited in place, and large ones forked only if the pool is hungry
+        size_t child_span = (child_shift + SW >= (int)(sizeof(size_t) * 8))
+            ? SIZE_MAX : (size_t)1 << (child_shift + SW);
+
         std::pair<const KvAMT*, const KiAMT*> results[SLOTS] = {};
         Coroutine::Nursery nursery;
         for (int c = 0; c < n_slots; ++c) {
@@ -283,10 +670,13 @@ namespace wry {
             const KiAMT* ki_c = unified_extract_child(ki, c, shift);
             if (!child_cur[c]) {
                 results[c] = {kv_c, ki_c}; // no mods: share
-            } else {
+            } else if (global_work_queue_should_fork(child_span)) {
                 co_await nursery.fork(results[c],
                     unified_frame<Key, T>(child_prefix, child_shift, kv_c, ki_c,
                                           *child_cur[c], action_for_key));
+            } else {
+                results[c] = co_await unified_frame<Key, T>(child_prefix, child_shift, kv_c, ki_c,
+                                                            *child_cur[c], action_for_key);
             }
         }
         co_await nursery.join();
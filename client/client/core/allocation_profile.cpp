@@ -0,0 +1,526 @@
+//
+//  allocation_profile.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+#include <cxxabi.h>
+#include <execinfo.h>
+
+#include "allocation_profile.hpp"
+#include "garbage_collected.hpp"
+#include "term.hpp"
+
+#include "test.hpp"
+
+namespace wry {
+
+    enum : size_t { ALLOCATION_SAMPLE_MAX_DEPTH = 24 };
+
+    // malloc'd, never GC: the profiler must not allocate what it measures.
+    struct AllocationSample {
+        AllocationSample* _Nullable next;
+        void* _Nonnull address;
+        size_t size;
+        uint64_t interval;
+        uint32_t depth;
+        void* _Nullable stack[ALLOCATION_SAMPLE_MAX_DEPTH];
+    };
+
+    // Disabled threads recheck the global configuration after this many
+    // bytes; it bounds how long a start takes to reach every thread.
+    constexpr uint64_t ALLOCATION_PROFILE_RECHECK_BYTES = 1 << 20;
+
+    constexpr uint64_t ALLOCATION_PROFILE_DISABLED = UINT64_MAX;
+
+    constinit Atomic<uint64_t> _global_allocation_profile_interval{ALLOCATION_PROFILE_DISABLED};
+    constinit Atomic<bool> _global_allocation_profile_record_stacks{false};
+
+    // Mutator side.  Policy (see garbage_collected.cpp): GC-adjacent TLS
+    // must be trivially destructible; the pending list is a raw pointer,
+    // handed over at every report, so nothing is stranded at thread exit
+    // that the report discipline would not already strand.
+    constinit thread_local uint64_t _thread_local_gc_bytes_until_sample = 0;
+    constinit thread_local bool _thread_local_allocation_profile_armed = false;
+    constinit thread_local uint64_t _thread_local_allocation_profile_rng = 0;
+    constinit thread_local AllocationSample* _thread_local_allocation_samples = nullptr;
+
+    static_assert(std::is_trivially_destructible_v<
+                      decltype(_thread_local_gc_bytes_until_sample)>);
+    static_assert(std::is_trivially_destructible_v<
+                      decltype(_thread_local_allocation_samples)>);
+
+    static uint64_t _allocation_profile_next_budget(uint64_t interval) {
+        if (interval == 0)
+            return 0;
+        uint64_t& x = _thread_local_allocation_profile_rng;
+        if (!x)
+            x = (uint64_t)(uintptr_t)&x ^ 0x9E3779B97F4A7C15ull;
+        // xorshift64*
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        uint64_t r = x * 0x2545F4914F6CDD1Dull;
+        // Uniform on (0, 1]; exponential with mean `interval`.
+        double u = ((r >> 11) + 1) * 0x1.0p-53;
+        double budget = -std::log(u) * (double)interval;
+        return budget < (double)(UINT64_MAX / 2) ? (uint64_t)budget : UINT64_MAX / 2;
+    }
+
+    void _garbage_collected_sample_allocation(void* address, std::size_t count) {
+        uint64_t interval = _global_allocation_profile_interval.load_relaxed();
+        if (interval == ALLOCATION_PROFILE_DISABLED) {
+            _thread_local_allocation_profile_armed = false;
+            _thread_local_gc_bytes_until_sample = ALLOCATION_PROFILE_RECHECK_BYTES;
+            return;
+        }
+        if (!_thread_local_allocation_profile_armed) {
+            // A recheck found the profiler on: start a fresh budget rather
+            // than sampling whichever allocation happened to notice.
+            _thread_local_allocation_profile_armed = true;
+            _thread_local_gc_bytes_until_sample = _allocation_profile_next_budget(interval);
+            if (interval)
+                return;
+        }
+        auto* sample = (AllocationSample*)malloc(sizeof(AllocationSample));
+        if (!sample) [[unlikely]]
+            abort();
+        sample->address = address;
+        sample->size = count;
+        sample->interval = interval;
+        sample->depth = 0;
+        if (_global_allocation_profile_record_stacks.load_relaxed()) {
+            void* frames[ALLOCATION_SAMPLE_MAX_DEPTH + 1];
+            int n = backtrace(frames, ALLOCATION_SAMPLE_MAX_DEPTH + 1);
+            // Skip our own frame; operator new is inline, so the next frame
+            // is the allocating function.
+            if (n > 1) {
+                sample->depth = (uint32_t)(n - 1);
+                memcpy(sample->stack, frames + 1, sample->depth * sizeof(void*));
+            }
+        }
+        sample->next = _thread_local_allocation_samples;
+        _thread_local_allocation_samples = sample;
+        _thread_local_gc_bytes_until_sample = _allocation_profile_next_budget(interval);
+    }
+
+    AllocationSample* _allocation_profile_take_samples() {
+        return std::exchange(_thread_local_allocation_samples, nullptr);
+    }
+
+
+    // Collector side
+
+    namespace {
+
+        struct StackKey {
+            uint32_t depth;
+            void* stack[ALLOCATION_SAMPLE_MAX_DEPTH];
+            bool operator<(StackKey const& other) const {
+                if (depth != other.depth)
+                    return depth < other.depth;
+                return memcmp(stack, other.stack, depth * sizeof(void*)) < 0;
+            }
+        };
+
+        struct Volume {
+            double objects = 0;
+            double bytes = 0;
+        };
+
+        struct TypeStats {
+            uint64_t sampled_objects = 0;
+            Volume allocated;
+            Volume live;
+            uint64_t last_visited = 0;
+            uint64_t last_survived = 0;
+            uint64_t total_visited = 0;
+            uint64_t total_survived = 0;
+        };
+
+        struct SiteStats {
+            Volume allocated;
+            Volume live;
+        };
+
+        struct LiveSample {
+            TypeStats* type;
+            SiteStats* site;
+            Volume weight;
+        };
+
+        struct SweepTally {
+            uint64_t visited = 0;
+            uint64_t survived = 0;
+        };
+
+        struct AllocationProfile {
+
+            // Guards the aggregates against queries from other threads.
+            // std::map and unordered_map node addresses are stable, so the
+            // collector-only maps below hold plain pointers into them.
+            std::mutex _mutex;
+            std::unordered_map<std::type_index, TypeStats> _types;
+            std::map<StackKey, SiteStats> _sites;
+
+            // Collector thread only.
+            std::unordered_map<const void*, LiveSample> _live;
+            std::unordered_map<std::type_index, SweepTally> _sweep;
+            uint64_t _collections = 0;
+
+            void clear_locked() {
+                _types.clear();
+                _sites.clear();
+            }
+
+        };
+
+        AllocationProfile& _profile() {
+            static AllocationProfile* p = new AllocationProfile;
+            return *p;
+        }
+
+        // Collector thread only: a reset or stop from another thread only
+        // raises this, and the collector drops its own tables next time.
+        constinit Atomic<uint64_t> _global_allocation_profile_generation{0};
+        constinit uint64_t _collector_allocation_profile_generation = 0;
+
+        void _collector_sync_generation(AllocationProfile& p) {
+            uint64_t g = _global_allocation_profile_generation.load_acquire();
+            if (g != _collector_allocation_profile_generation) {
+                _collector_allocation_profile_generation = g;
+                p._live.clear();
+                p._sweep.clear();
+            }
+        }
+
+        Volume _sample_weight(AllocationSample const* s) {
+            // Poisson sampling at mean interval I catches an allocation of
+            // size n with probability 1 - exp(-n/I); weight by its inverse.
+            double objects = 1.0;
+            if (s->interval && s->size) {
+                double p = -std::expm1(-(double)s->size / (double)s->interval);
+                objects = 1.0 / p;
+            }
+            return Volume{objects, objects * (double)s->size};
+        }
+
+        std::string _demangle(const char* name) {
+            int status = 0;
+            char* d = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+            std::string result = (status == 0 && d) ? d : name;
+            free(d);
+            return result;
+        }
+
+        struct UnresolvedType {};
+
+    } // namespace
+
+    void allocation_profile_start(uint64_t sample_interval_bytes, bool record_stacks) {
+        _global_allocation_profile_record_stacks.store_relaxed(record_stacks);
+        _global_allocation_profile_interval.store_release(sample_interval_bytes);
+        // Other threads notice at their next recheck; the caller at once.
+        _thread_local_allocation_profile_armed = false;
+        _thread_local_gc_bytes_until_sample = 0;
+    }
+
+    void allocation_profile_stop() {
+        _global_allocation_profile_interval.store_release(ALLOCATION_PROFILE_DISABLED);
+        _global_allocation_profile_generation.fetch_add_release(1);
+        AllocationProfile& p = _profile();
+        std::scoped_lock guard{p._mutex};
+        for (auto& [_, t] : p._types)
+            t.live = {};
+        for (auto& [_, s] : p._sites)
+            s.live = {};
+    }
+
+    bool allocation_profile_is_enabled() {
+        return _global_allocation_profile_interval.load_relaxed() != ALLOCATION_PROFILE_DISABLED;
+    }
+
+    void allocation_profile_reset() {
+        _global_allocation_profile_generation.fetch_add_release(1);
+        AllocationProfile& p = _profile();
+        std::scoped_lock guard{p._mutex};
+        p.clear_locked();
+    }
+
+    void _allocation_profile_receive(AllocationSample* samples,
+                                     Bag<const GarbageCollected*> const& allocations) {
+        if (!samples)
+            return;
+        AllocationProfile& p = _profile();
+        _collector_sync_generation(p);
+
+        std::unordered_map<const void*, AllocationSample*> pending;
+        for (AllocationSample* s = samples; s; s = s->next)
+            pending.emplace(s->address, s);
+
+        std::scoped_lock guard{p._mutex};
+        auto attribute = [&](AllocationSample* s, std::type_index type, const void* key) {
+            Volume w = _sample_weight(s);
+            TypeStats& t = p._types[type];
+            StackKey k{s->depth, {}};
+            memcpy(k.stack, s->stack, s->depth * sizeof(void*));
+            SiteStats& site = p._sites[k];
+            ++t.sampled_objects;
+            t.allocated.objects += w.objects;
+            t.allocated.bytes += w.bytes;
+            site.allocated.objects += w.objects;
+            site.allocated.bytes += w.bytes;
+            if (key) {
+                t.live.objects += w.objects;
+                t.live.bytes += w.bytes;
+                site.live.objects += w.objects;
+                site.live.bytes += w.bytes;
+                p._live[key] = LiveSample{&t, &site, w};
+            }
+        };
+        // The report's objects are fully constructed and not yet swept
+        // (sweeps only see cohorts, which this bag has not yet joined), so
+        // their vtables are valid here.
+        for (const GarbageCollected* object : allocations) {
+            if (pending.empty())
+                break;
+            auto it = pending.find(dynamic_cast<const void*>(object));
+            if (it == pending.end())
+                continue;
+            attribute(it->second, std::type_index(typeid(*object)), object);
+            pending.erase(it);
+        }
+        // Not expected: every sampled allocation is constructed before its
+        // thread next reports.  Count rather than lose them.
+        for (auto& [_, s] : pending)
+            attribute(s, std::type_index(typeid(UnresolvedType)), nullptr);
+
+        while (samples)
+            free(std::exchange(samples, samples->next));
+    }
+
+    bool _allocation_profile_is_tracking() {
+        AllocationProfile& p = _profile();
+        _collector_sync_generation(p);
+        return allocation_profile_is_enabled() || !p._live.empty();
+    }
+
+    void _allocation_profile_sweep_visit(const GarbageCollected* object, bool is_deleted) {
+        AllocationProfile& p = _profile();
+        SweepTally& tally = p._sweep[std::type_index(typeid(*object))];
+        ++tally.visited;
+        if (is_deleted) {
+            auto it = p._live.find(object);
+            if (it != p._live.end()) {
+                LiveSample& s = it->second;
+                std::scoped_lock guard{p._mutex};
+                // A concurrent reset may have freed what s points into;
+                // it bumps the generation before taking the lock.
+                if (_global_allocation_profile_generation.load_relaxed()
+                    == _collector_allocation_profile_generation) {
+                    s.type->live.objects -= s.weight.objects;
+                    s.type->live.bytes -= s.weight.bytes;
+                    s.site->live.objects -= s.weight.objects;
+                    s.site->live.bytes -= s.weight.bytes;
+                }
+                p._live.erase(it);
+            }
+        } else {
+            ++tally.survived;
+        }
+    }
+
+    void _allocation_profile_sweep_completed(uint16_t sweep_mask) {
+        AllocationProfile& p = _profile();
+        _collector_sync_generation(p);
+        ++p._collections;
+        struct Line { std::type_index type; SweepTally tally; };
+        std::vector<Line> lines;
+        {
+            std::scoped_lock guard{p._mutex};
+            for (auto& [type, tally] : p._sweep) {
+                TypeStats& t = p._types[type];
+                t.last_visited = tally.visited;
+                t.last_survived = tally.survived;
+                t.total_visited += tally.visited;
+                t.total_survived += tally.survived;
+                lines.push_back({type, tally});
+            }
+        }
+        p._sweep.clear();
+        // One line per collection: the heaviest few candidate populations
+        // and how many of them the sweep had to keep.
+        std::sort(lines.begin(), lines.end(), [](Line const& a, Line const& b) {
+            return a.tally.visited > b.tally.visited;
+        });
+        printf("C0: profile sweep mask=%04x:", sweep_mask);
+        for (size_t i = 0; i != std::min(lines.size(), (size_t)4); ++i)
+            printf(" %s %" PRIu64 "/%" PRIu64,
+                   _demangle(lines[i].type.name()).c_str(),
+                   lines[i].tally.survived,
+                   lines[i].tally.visited);
+        printf("\n");
+    }
+
+
+    // Queries
+
+    std::vector<AllocationProfileRow> allocation_profile_snapshot() {
+        AllocationProfile& p = _profile();
+        std::vector<AllocationProfileRow> rows;
+        {
+            std::scoped_lock guard{p._mutex};
+            rows.reserve(p._types.size());
+            for (auto& [type, t] : p._types) {
+                rows.push_back(AllocationProfileRow{
+                    .type_name = type == std::type_index(typeid(UnresolvedType))
+                        ? std::string("(unresolved)")
+                        : _demangle(type.name()),
+                    .sampled_objects = t.sampled_objects,
+                    .allocated_objects = t.allocated.objects,
+                    .allocated_bytes = t.allocated.bytes,
+                    .live_objects = std::max(t.live.objects, 0.0),
+                    .live_bytes = std::max(t.live.bytes, 0.0),
+                    .last_visited = t.last_visited,
+                    .last_survived = t.last_survived,
+                    .total_visited = t.total_visited,
+                    .total_survived = t.total_survived,
+                });
+            }
+        }
+        std::sort(rows.begin(), rows.end(), [](auto const& a, auto const& b) {
+            return a.allocated_bytes > b.allocated_bytes;
+        });
+        return rows;
+    }
+
+    void allocation_profile_print_table(FILE* out, size_t top_sites) {
+        auto rows = allocation_profile_snapshot();
+        fprintf(out, "%-48s %10s %12s %12s %12s %8s %8s\n",
+                "type", "samples", "est.objects", "est.bytes", "live.bytes",
+                "surv.last", "surv.all");
+        for (auto const& r : rows) {
+            auto percent = [](uint64_t num, uint64_t den) {
+                return den ? 100.0 * (double)num / (double)den : 0.0;
+            };
+            fprintf(out, "%-48.48s %10" PRIu64 " %12.0f %12.0f %12.0f %7.1f%% %7.1f%%\n",
+                    r.type_name.c_str(),
+                    r.sampled_objects,
+                    r.allocated_objects,
+                    r.allocated_bytes,
+                    r.live_bytes,
+                    percent(r.last_survived, r.last_visited),
+                    percent(r.total_survived, r.total_visited));
+        }
+        if (!top_sites)
+            return;
+        AllocationProfile& p = _profile();
+        std::vector<std::pair<StackKey, SiteStats>> sites;
+        {
+            std::scoped_lock guard{p._mutex};
+            sites.assign(p._sites.begin(), p._sites.end());
+        }
+        std::sort(sites.begin(), sites.end(), [](auto const& a, auto const& b) {
+            return a.second.allocated.bytes > b.second.allocated.bytes;
+        });
+        sites.resize(std::min(sites.size(), top_sites));
+        for (auto const& [key, s] : sites) {
+            fprintf(out, "\n%12.0f bytes %12.0f objects allocated, %12.0f bytes live\n",
+                    s.allocated.bytes, s.allocated.objects, s.live.bytes);
+            char** symbols = backtrace_symbols(key.stack, (int)key.depth);
+            for (uint32_t i = 0; i != key.depth; ++i)
+                fprintf(out, "    %s\n", symbols ? symbols[i] : "?");
+            free(symbols);
+        }
+    }
+
+    bool allocation_profile_write_pprof(const char* path) {
+        FILE* f = fopen(path, "w");
+        if (!f)
+            return false;
+        AllocationProfile& p = _profile();
+        std::vector<std::pair<StackKey, SiteStats>> sites;
+        {
+            std::scoped_lock guard{p._mutex};
+            sites.assign(p._sites.begin(), p._sites.end());
+        }
+        // The estimates are already unsampled, so the "heapprofile" header
+        // (no sampling rate) is the right legacy dialect.
+        Volume live, allocated;
+        for (auto const& [_, s] : sites) {
+            live.objects += std::max(s.live.objects, 0.0);
+            live.bytes += std::max(s.live.bytes, 0.0);
+            allocated.objects += s.allocated.objects;
+            allocated.bytes += s.allocated.bytes;
+        }
+        auto integer = [](double x) { return (uint64_t)std::llround(std::max(x, 0.0)); };
+        fprintf(f, "heap profile: %" PRIu64 ": %" PRIu64 " [%" PRIu64 ": %" PRIu64 "] @ heapprofile\n",
+                integer(live.objects), integer(live.bytes),
+                integer(allocated.objects), integer(allocated.bytes));
+        for (auto const& [key, s] : sites) {
+            fprintf(f, "%" PRIu64 ": %" PRIu64 " [%" PRIu64 ": %" PRIu64 "] @",
+                    integer(s.live.objects), integer(s.live.bytes),
+                    integer(s.allocated.objects), integer(s.allocated.bytes));
+            if (!key.depth)
+                fprintf(f, " 0x0");
+            for (uint32_t i = 0; i != key.depth; ++i)
+                fprintf(f, " %p", key.stack[i]);
+            fprintf(f, "\n");
+        }
+#if defined(__linux__)
+        // pprof symbolizes the addresses against these mappings.
+        if (FILE* maps = fopen("/proc/self/maps", "r")) {
+            fprintf(f, "\nMAPPED_LIBRARIES:\n");
+            char buffer[4096];
+            size_t n;
+            while ((n = fread(buffer, 1, sizeof buffer, maps)) > 0)
+                fwrite(buffer, 1, n, f);
+            fclose(maps);
+        }
+#endif
+        return fclose(f) == 0;
+    }
+
+
+    // Every allocation sampled, so the counts are exact: the rooted half
+    // must survive each sweep that visits it and the dropped half must all
+    // be deleted within a few cycles.
+    define_test("gc_allocation_profile") {
+        allocation_profile_reset();
+        // No suspension until the loop is done: start arms only the
+        // calling thread immediately.
+        allocation_profile_start(0);
+        std::vector<Root<HeapInt64*>> kept;
+        for (int i = 0; i != 1000; ++i) {
+            kept.emplace_back(new HeapInt64(i));
+            (void) new HeapInt64(-i);
+        }
+        co_await Coroutine::SuspendAndSchedule{};
+        co_await Coroutine::WaitForCollectionCycles{4};
+        allocation_profile_stop();
+
+        auto rows = allocation_profile_snapshot();
+        auto it = std::find_if(rows.begin(), rows.end(), [](auto const& r) {
+            return r.type_name.find("HeapInt64") != std::string::npos;
+        });
+        assert(it != rows.end());
+        assert(it->sampled_objects >= 2000);
+        assert(it->allocated_bytes >= 2000.0 * sizeof(HeapInt64));
+        assert(it->total_visited - it->total_survived >= 1000);
+        allocation_profile_print_table(stdout);
+        allocation_profile_reset();
+        co_return;
+    };
+
+} // namespace wry
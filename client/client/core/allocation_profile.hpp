@@ -0,0 +1,121 @@
+//
+//  allocation_profile.hpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#ifndef allocation_profile_hpp
+#define allocation_profile_hpp
+
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bag.hpp"
+
+namespace wry {
+
+    struct GarbageCollected;
+
+    // Sampling allocation profiler for the garbage collected heap.
+    //
+    // Which kinds of object drive collector pressure?  The profiler answers
+    // per dynamic type (and optionally per allocating call stack) with
+    // estimated allocation volume, estimated live volume, and the survival
+    // rate each sweep observed.
+    //
+    // Mechanism, in the order an allocation meets it:
+    //
+    //   - GarbageCollected::operator new counts down a thread-local byte
+    //     budget; exhausting it takes the out-of-line sample path, which
+    //     records the raw address, size and (optionally) a backtrace, and
+    //     redraws the budget from an exponential distribution with the
+    //     configured mean (tcmalloc-style Poisson sampling, so big objects
+    //     are sampled proportionally more often and every estimate is
+    //     unbiased).  When the profiler is off the budget is just a periodic
+    //     recheck, so the disabled cost is one compare per allocation.
+    //
+    //   - The samples ride the thread's next Report to the collector.  By
+    //     then the objects are fully constructed, so the collector resolves
+    //     each sample's dynamic type by matching it against the report's
+    //     allocation bag (dynamic_cast<void const*> recovers the address
+    //     operator new returned).
+    //
+    //   - Each sweep walk tallies, per type, the objects it visited and the
+    //     objects it deleted, and retires the live samples it deletes.
+    //
+    // The sweep visits only its own cohort (see collector_sweep_walk), so a
+    // type's survival rate is that of the objects the collection could have
+    // deleted: long-lived objects certified reachable are not re-counted.
+    //
+    // Everything except the mutator sample path runs on the collector
+    // thread; queries may come from any thread.  Portable: no Darwin APIs.
+
+    // Start, or retune, sampling.  On average one sample per
+    // `sample_interval_bytes` allocated per thread; 0 records every
+    // allocation.  `record_stacks` captures a backtrace per sample for the
+    // per-site table and the pprof output.  Threads pick up the change
+    // within one recheck budget of allocation.
+    void allocation_profile_start(uint64_t sample_interval_bytes = 512 * 1024,
+                                  bool record_stacks = true);
+
+    // Stop sampling.  Accumulated totals are kept; live tracking is dropped
+    // (it cannot follow deletions it no longer watches).
+    void allocation_profile_stop();
+
+    bool allocation_profile_is_enabled();
+
+    // Discard all accumulated data.
+    void allocation_profile_reset();
+
+    struct AllocationProfileRow {
+        std::string type_name;        // demangled
+        uint64_t sampled_objects;     // raw sample count
+        double allocated_objects;     // estimated
+        double allocated_bytes;       // estimated
+        double live_objects;          // estimated, sampled and not yet swept
+        double live_bytes;
+        uint64_t last_visited;        // most recent sweep that saw this type
+        uint64_t last_survived;
+        uint64_t total_visited;       // all sweeps while profiling
+        uint64_t total_survived;
+    };
+
+    // Per-type rows, sorted by estimated allocated bytes, descending.
+    std::vector<AllocationProfileRow> allocation_profile_snapshot();
+
+    // Human-readable per-type table; `top_sites` > 0 appends that many
+    // heaviest call stacks, symbolized.
+    void allocation_profile_print_table(FILE* _Nonnull out, size_t top_sites = 0);
+
+    // Write a legacy-format ("heapprofile") heap profile that pprof reads:
+    // in-use and allocated estimates per call stack, plus the mapped
+    // libraries where the platform exposes them.  Returns false on I/O
+    // failure.
+    bool allocation_profile_write_pprof(const char* _Nonnull path);
+
+
+    // Collector plumbing
+
+    struct AllocationSample;
+
+    // Mutator: detach this thread's pending samples for its Report.
+    AllocationSample* _Nullable _allocation_profile_take_samples();
+
+    // Collector: attribute (and free) a report's samples against the
+    // report's allocation bag, which must not yet have been spliced away.
+    void _allocation_profile_receive(AllocationSample* _Nullable samples,
+                                     Bag<const GarbageCollected*> const& allocations);
+
+    // Collector: sweep hooks.  is_tracking is read once per walk; visit is
+    // called for every object the walk examines, before it is deleted.
+    bool _allocation_profile_is_tracking();
+    void _allocation_profile_sweep_visit(const GarbageCollected* _Nonnull object,
+                                         bool is_deleted);
+    void _allocation_profile_sweep_completed(uint16_t sweep_mask);
+
+} // namespace wry
+
+#endif /* allocation_profile_hpp */
@@ -0,0 +1,144 @@
+//
+//  bump_allocator.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <mutex>
+
+#include "atomic.hpp"
+#include "bump_allocator.hpp"
+
+namespace wry::bump {
+
+    namespace {
+
+        struct SlabPool {
+
+            std::mutex _mutex;
+            Slab* _Nullable _head = nullptr;
+            std::size_t _pooled = 0;
+            // Four idle slabs (64 MB) absorb the usual jitter between
+            // threads' working sets without pinning a burst's peak forever.
+            std::size_t _capacity = 4;
+
+            Atomic<std::size_t> _system_bytes;
+            Atomic<std::uint64_t> _system_allocations;
+            Atomic<std::uint64_t> _system_frees;
+            Atomic<std::uint64_t> _pool_hits;
+            Atomic<std::uint64_t> _orphaned;
+            Atomic<std::uint64_t> _reclaimed;
+            Atomic<std::size_t> _orphans_pending;
+
+            void _free_to_system(Slab* _Nonnull slab) {
+                _system_bytes.fetch_sub_relaxed(slab->size());
+                _system_frees.fetch_add_relaxed(1);
+                free(slab);
+            }
+
+        };
+
+        // Immortal: slabs are released from thread_local teardown at exit.
+        SlabPool& _slab_pool() {
+            static SlabPool* pool = new SlabPool;
+            return *pool;
+        }
+
+    } // namespace
+
+    Slab* slab_acquire(std::size_t capacity) {
+        SlabPool& pool = _slab_pool();
+        if (sizeof(Slab) + capacity <= DEFAULT_SLAB_SIZE) {
+            Slab* slab = nullptr;
+            {
+                std::scoped_lock guard{pool._mutex};
+                if ((slab = pool._head)) {
+                    pool._head = slab->_next;
+                    --pool._pooled;
+                }
+            }
+            if (slab) {
+                pool._pool_hits.fetch_add_relaxed(1);
+                slab->_next = nullptr;
+                return slab;
+            }
+        }
+        Slab* slab = Slab::make_with_minimum_capacity(capacity);
+        pool._system_bytes.fetch_add_relaxed(slab->size());
+        pool._system_allocations.fetch_add_relaxed(1);
+        ASAN_POISON_MEMORY_REGION(slab->_begin, (std::size_t)(slab->_end - slab->_begin));
+        return slab;
+    }
+
+    void slab_release_list(Slab* head) {
+        SlabPool& pool = _slab_pool();
+        Slab* excess = nullptr;
+        {
+            std::scoped_lock guard{pool._mutex};
+            while (head) {
+                Slab* slab = std::exchange(head, head->_next);
+                ASAN_POISON_MEMORY_REGION(slab->_begin, (std::size_t)(slab->_end - slab->_begin));
+                if ((slab->size() == DEFAULT_SLAB_SIZE) && (pool._pooled < pool._capacity)) {
+                    slab->_next = pool._head;
+                    pool._head = slab;
+                    ++pool._pooled;
+                } else {
+                    slab->_next = excess;
+                    excess = slab;
+                }
+            }
+        }
+        // Free outside the lock
+        while (excess)
+            pool._free_to_system(std::exchange(excess, excess->_next));
+    }
+
+    void slab_pool_set_capacity(std::size_t slabs) {
+        SlabPool& pool = _slab_pool();
+        Slab* excess = nullptr;
+        {
+            std::scoped_lock guard{pool._mutex};
+            pool._capacity = slabs;
+            while (pool._pooled > pool._capacity) {
+                Slab* slab = std::exchange(pool._head, pool._head->_next);
+                --pool._pooled;
+                slab->_next = excess;
+                excess = slab;
+            }
+        }
+        while (excess)
+            pool._free_to_system(std::exchange(excess, excess->_next));
+    }
+
+    SlabPoolStatistics slab_pool_statistics() {
+        SlabPool& pool = _slab_pool();
+        SlabPoolStatistics result = {};
+        {
+            std::scoped_lock guard{pool._mutex};
+            result.pooled = pool._pooled;
+            result.capacity = pool._capacity;
+        }
+        result.system_bytes = pool._system_bytes.load_relaxed();
+        result.system_allocations = pool._system_allocations.load_relaxed();
+        result.system_frees = pool._system_frees.load_relaxed();
+        result.pool_hits = pool._pool_hits.load_relaxed();
+        result.orphaned = pool._orphaned.load_relaxed();
+        result.reclaimed = pool._reclaimed.load_relaxed();
+        result.orphans_pending = pool._orphans_pending.load_relaxed();
+        return result;
+    }
+
+    void _slab_pool_note_orphaned(std::size_t slabs) {
+        SlabPool& pool = _slab_pool();
+        pool._orphaned.fetch_add_relaxed(slabs);
+        pool._orphans_pending.fetch_add_relaxed(slabs);
+    }
+
+    void _slab_pool_note_reclaimed(std::size_t slabs) {
+        SlabPool& pool = _slab_pool();
+        pool._reclaimed.fetch_add_relaxed(slabs);
+        pool._orphans_pending.fetch_sub_relaxed(slabs);
+    }
+
+} // namespace wry::bump
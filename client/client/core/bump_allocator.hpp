@@ -49,13 +49,17 @@
 //   - OS specific?
 //   - We can reserve large chunks of address space but not alloc them
 //     - Count up?
-// - When should we free (as opposed to reuse) blocks? [never]
+// - When should we free (as opposed to reuse) blocks? [via the slab pool]
+//   - A list being swapped out returns the slabs it did not touch this use;
+//     default-size slabs park in a bounded global pool, the rest (and any
+//     overflow) go back to the system
 // - Make the heap legible [no]
 //   - Technically possible but no compelling use case
 // - When can we reset the arena [?]
 //   - requires tight coupling of threads
-//   - One option is to hand off the old arena to the garbage collector, which
-//     will keep it alive until all threads have passed a handshake
+//   - An exiting thread hands its lists to the epoch system, which recycles
+//     them into the pool once every pin that could see them has advanced
+//     (see epoch::orphan_this_thread_slabs)
 // - Implicit thread_local or explicit handle for different arenas?
 //
 // Reference
@@ -101,6 +105,7 @@ namespace wry {
             unsigned char* _Nonnull const _end; // pointer to end of allocation
             unsigned char _begin[];             // flexible array member
                         
+            // Direct from the system; most callers want slab_acquire.
             static Slab* _Nonnull make_with_minimum_capacity(std::size_t capacity)
             {
                 std::size_t size = std::bit_ceil(sizeof(Slab) + capacity);
@@ -115,7 +120,48 @@ namespace wry {
                 return that;
             }
             
+            std::size_t size() const {
+                return (std::size_t)(_end - (unsigned char const*)this);
+            }
+
         }; // bump::Slab
+
+
+        // Slab pool
+        //
+        // A global, bounded cache of idle default-size slabs shared by all
+        // threads.  Releasing more than the capacity, or any oversize slab,
+        // frees to the system, so the steady-state footprint is the
+        // threads' working lists plus at most `capacity` idle slabs.  Slab
+        // traffic is one lock per 16 MB of allocation, so a mutex suffices.
+
+        struct SlabPoolStatistics {
+            std::size_t pooled;             // idle slabs in the pool now
+            std::size_t capacity;           // pool bound, in slabs
+            std::size_t system_bytes;       // currently malloc'd for slabs
+            std::uint64_t system_allocations;
+            std::uint64_t system_frees;
+            std::uint64_t pool_hits;        // acquisitions served by the pool
+            std::uint64_t orphaned;         // slabs handed off by exiting threads
+            std::uint64_t reclaimed;        // orphaned slabs recycled after their epoch
+            std::size_t orphans_pending;    // slabs awaiting their epoch
+        };
+
+        // A slab with at least `capacity` bytes of payload, from the pool if
+        // possible.  Payload is ASan-poisoned.
+        [[nodiscard]] Slab* _Nonnull slab_acquire(std::size_t capacity);
+
+        // Return a whole list of slabs (linked through _next).
+        void slab_release_list(Slab* _Nullable head);
+
+        void slab_pool_set_capacity(std::size_t slabs);
+
+        // Snapshot; fields are individually but not mutually consistent.
+        [[nodiscard]] SlabPoolStatistics slab_pool_statistics();
+
+        // For the orphan hand-off in epoch_allocator.cpp.
+        void _slab_pool_note_orphaned(std::size_t slabs);
+        void _slab_pool_note_reclaimed(std::size_t slabs);
         
         // TODO:
         // - Bump down or up?
@@ -163,8 +209,8 @@ namespace wry {
                         // Use next slab
                         _cursor = _cursor->_next;
                     } else {
-                        // Create new slab
-                        Slab* _Nonnull tail = Slab::make_with_minimum_capacity(std::max<std::size_t>(count, DEFAULT_SLAB_SIZE - sizeof(Slab)));
+                        // Take a new slab
+                        Slab* _Nonnull tail = slab_acquire(std::max<std::size_t>(count, DEFAULT_SLAB_SIZE - sizeof(Slab)));
                         if (_cursor) {
                             // Link to existing list
                             _cursor->_next = tail;
@@ -229,14 +275,27 @@ namespace wry {
                 _begin = 0;
                 _end = 0;
                 _cursor = nullptr;
-                Slab* _Nullable head = std::exchange(_head, nullptr);
-                while (head) {
-                    free(std::exchange(head, head->_next));
-                }
+                slab_release_list(std::exchange(_head, nullptr));
             }
             
-            // Swap out the backing memory
+            // Return the slabs this use of the list never reached: those
+            // after the cursor, and the cursor itself if nothing was
+            // allocated from it (only possible when it is the head).  Their
+            // contents are from a previous use, already dead, so this is
+            // what lets a list shrink after a burst.
+            void _release_untouched_slabs() {
+                if (!_cursor)
+                    return;
+                slab_release_list(std::exchange(_cursor->_next, nullptr));
+                if ((_cursor == _head) && (_end == (std::intptr_t)_cursor->_end)) {
+                    _cursor = nullptr;
+                    slab_release_list(std::exchange(_head, nullptr));
+                }
+            }
+
+            // Swap out the backing memory, trimmed to what was used
             [[nodiscard]] Slab* _Nullable exchange_head_and_restart(Slab* _Nullable desired) {
+                _release_untouched_slabs();
                 Slab* _Nullable result = std::exchange(_head, desired);
                 restart();
                 return result;
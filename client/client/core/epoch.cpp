@@ -0,0 +1,184 @@
+//
+//  epoch.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <chrono>
+#include <latch>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "epoch.hpp"
+#include "epoch_allocator.hpp"
+#include "concurrent_skiplist.hpp"
+
+#include "test.hpp"
+
+namespace wry::epoch {
+
+    SlotService::Slot* SlotService::register_slot() {
+        for (Slot* slot = head.load_acquire(); slot; slot = slot->next) {
+            bool expected = false;
+            if (slot->in_use.compare_exchange_strong_acquire_relaxed(expected, true))
+                return slot;
+        }
+        Slot* slot = new Slot{};
+        slot->in_use.store_relaxed(true);
+        Slot* expected = head.load_relaxed();
+        do {
+            slot->next = expected;
+        } while (!head.compare_exchange_weak_release_relaxed(expected, slot));
+        return slot;
+    }
+
+    void SlotService::release_slot(Slot* slot) {
+        assert(slot->in_use.load_relaxed());
+        assert(!slot->word.load_relaxed());
+        slot->in_use.store_release(false);
+    }
+
+    bool SlotService::try_advance() {
+        // Pairs with the fence in pin
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t e = current.load_acquire();
+        // Non-thread pins on the prior epoch
+        if (explicit_pins[(e - 1) & 1].load_seq_cst())
+            return false;
+        for (Slot* slot = head.load_acquire(); slot; slot = slot->next) {
+            uint64_t word = slot->word.load_acquire();
+            if (word && ((uint32_t)(word >> 1) != e))
+                return false;
+        }
+        if (current.compare_exchange_strong_acq_rel_relaxed(e, e + 1)) {
+            if (waiters.load_relaxed())
+                current.notify_all();
+        }
+        // Either we advanced, or a racing call did
+        return true;
+    }
+
+    void SlotService::wait(Epoch expected) {
+        // Unpinning threads read `waiters` without ordering it against
+        // their slot store, so a wakeup can be missed; the timeout bounds
+        // what that costs us, and each lap makes its own attempt.
+        for (;;) {
+            uint32_t observed = current.load_relaxed();
+            if (observed != expected.raw)
+                return;
+            if (try_advance())
+                continue;
+            waiters.fetch_add_seq_cst(1);
+            if (!try_advance())
+                (void) current.wait_for(observed, Ordering::RELAXED, 1'000'000);
+            waiters.fetch_sub_relaxed(1);
+        }
+    }
+
+
+    // Throughput of the packed Service against SlotService, for pin/unpin
+    // pairs and for skiplist inserts bracketed by a pin, over a range of
+    // thread counts.  Each uses a private instance, so the global epoch is
+    // not disturbed.
+
+    namespace {
+
+        template<typename F>
+        double _measure_threads(int threads, F&& body) {
+            std::latch start{threads + 1};
+            std::latch done{threads};
+            std::vector<std::thread> pool;
+            for (int i = 0; i != threads; ++i) {
+                pool.emplace_back([&, i] {
+                    start.arrive_and_wait();
+                    body(i);
+                    done.arrive_and_wait();
+                    // Other threads' skiplist nodes live in our slabs until
+                    // everyone is done
+                    orphan_this_thread_slabs();
+                });
+            }
+            auto t0 = std::chrono::steady_clock::now();
+            start.arrive_and_wait();
+            done.wait();
+            auto t1 = std::chrono::steady_clock::now();
+            for (auto& t : pool)
+                t.join();
+            return std::chrono::duration<double>(t1 - t0).count();
+        }
+
+        struct PackedPins {
+            Service* _Nonnull service;
+            Epoch pin() { return service->pin(); }
+            void unpin(Epoch e) { (void) service->unpin(e); }
+        };
+
+        struct SlotPins {
+            SlotService* _Nonnull service;
+            SlotService::Slot* _Nullable slot = nullptr;
+            Epoch pin() {
+                if (!slot)
+                    slot = service->register_slot();
+                return service->pin(slot);
+            }
+            void unpin(Epoch e) { (void) service->unpin(slot, e); }
+            ~SlotPins() {
+                if (slot)
+                    service->release_slot(slot);
+            }
+        };
+
+        template<typename Pins, typename S>
+        double _pin_unpin_rate(S& service, int threads, int iterations) {
+            double seconds = _measure_threads(threads, [&](int) {
+                Pins pins{&service};
+                for (int j = 0; j != iterations; ++j)
+                    pins.unpin(pins.pin());
+            });
+            return (double)threads * iterations / seconds;
+        }
+
+        template<typename Pins, typename S>
+        double _skiplist_insert_rate(S& service, int threads, int iterations) {
+            ConcurrentSkiplistSet<uint64_t, DefaultKeyService<uint64_t>, EpochDiscipline> set;
+            double seconds = _measure_threads(threads, [&](int i) {
+                Pins pins{&service};
+                uint64_t x = 0x9E3779B97F4A7C15ull * (uint64_t)(i + 1);
+                for (int j = 0; j != iterations; ++j) {
+                    x ^= x << 13;
+                    x ^= x >> 7;
+                    x ^= x << 17;
+                    Epoch e = pins.pin();
+                    (void) set.try_emplace(x);
+                    pins.unpin(e);
+                }
+            });
+            return (double)threads * iterations / seconds;
+        }
+
+    } // namespace
+
+    define_test("epoch_pin_scaling") {
+        static constinit Service packed = {};
+        static constinit SlotService slots = {};
+        printf("epoch pin scaling (Mops/s)\n");
+        printf("%8s %12s %12s %12s %12s\n",
+               "threads", "pin:packed", "pin:slots", "insert:packed", "insert:slots");
+        for (int threads = 1; threads <= 64; threads *= 2) {
+            double a = _pin_unpin_rate<PackedPins>(packed, threads, 1 << 15);
+            double b = _pin_unpin_rate<SlotPins>(slots, threads, 1 << 15);
+            double c = _skiplist_insert_rate<PackedPins>(packed, threads, 1 << 12);
+            double d = _skiplist_insert_rate<SlotPins>(slots, threads, 1 << 12);
+            printf("%8d %12.2f %12.2f %12.2f %12.2f\n",
+                   threads, a * 1e-6, b * 1e-6, c * 1e-6, d * 1e-6);
+        }
+        // With every slot released, a waiter advances the epoch itself
+        Epoch e{slots.current.load_relaxed()};
+        slots.wait(e);
+        assert(slots.current.load_relaxed() != e.raw);
+        co_return;
+    };
+
+} // namespace wry::epoch
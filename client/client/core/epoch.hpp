@@ -8,6 +8,9 @@
 #ifndef epoch_hpp
 #define epoch_hpp
 
+#include <atomic>
+#include <cstddef>
+
 #include "assert.hpp"
 #include "atomic.hpp"
 
@@ -35,6 +38,18 @@ namespace wry {
         // We don't anticipate enough contention on the global state to make
         // that worthwhile.  If it proves to be an issue, a half-measure would be
         // to have a fixed sized list that threads spread over.
+        //
+        // SlotService below is that Crossbeam-style alternative, selected by
+        // WRY_EPOCH_SLOTS; the epoch_pin_scaling test measures both.
+
+
+        // Compile-time choice of the service behind the thread and global
+        // pins.  The packed Service stays the default until measurements on
+        // the target machines favor the slots.
+
+#ifndef WRY_EPOCH_SLOTS
+#define WRY_EPOCH_SLOTS 0
+#endif
 
 
         // Cyclic group of order 2^N
@@ -119,8 +134,9 @@ namespace wry {
                 Count waiting      : 1;   // A thread is waiting
                 Count pins_prior;         // Pins in the prior epoch
 
-                // TODO: If we want to wait on epoch, the layout may matter to
-                // Linux 32-bit futex.
+                // Waiters watch `current`.  The Linux futex compares only
+                // the low 32 bits of the 64-bit State, so `current` must be
+                // the first member (asserted after the struct).
 
 
                 // Validate that a given pinned epoch is consistent with this state;
@@ -198,6 +214,8 @@ namespace wry {
 
             };
 
+            static_assert(offsetof(State, current) == 0);
+
             Atomic<State> state;
 
             // Operations on the atomic state are obstruction-free.
@@ -288,8 +306,158 @@ namespace wry {
 
         inline constinit Service global_service = {};
 
+
+        // Per-thread epoch slots
+        //
+        // Every Service operation is a CAS on one shared word, so pin, unpin
+        // and repin serialize on a single cache line and throughput falls as
+        // threads are added.  SlotService instead gives each thread its own
+        // cache-line-padded slot in which it publishes the epoch it has
+        // pinned.  Pinning and unpinning touch only the thread's own line;
+        // the cost moves to advancement, which must scan every slot.
+        //
+        // Protocol (Crossbeam / DEBRA):
+        //
+        //   - pin stores (epoch << 1) | 1 to the slot, issues a sequentially
+        //     consistent fence, and rereads the global epoch; if it moved,
+        //     it pins again.  The fence pairs with the fence in try_advance,
+        //     so either the pinner sees the advance or the advancer sees the
+        //     pin.
+        //
+        //   - unpin stores 0 with release.
+        //
+        //   - try_advance moves the epoch from E to E+1 only if every pinned
+        //     slot holds E.  Threads attempt it every ADVANCE_CADENCE
+        //     operations, and whenever somebody is waiting, so the cost of
+        //     the scan is amortized.
+        //
+        // The acquire-release chain unpin -> scan -> advance -> pin carries
+        // the same happens-before as the packed Service's RMW chain.
+        //
+        // Non-thread pins (pin_global, pin_explicit) have no slot to publish
+        // into; they are counted by epoch parity, since only the current
+        // and prior epochs can be pinned.
+        //
+        // Slots are registered once per thread and never freed; a released
+        // slot is reused by the next registering thread.  The registry is a
+        // push-only list so scanners need no protection.
+
+        struct SlotService {
+
+            struct alignas(CACHE_LINE_SIZE) Slot {
+                Atomic<uint64_t> word;         // (epoch << 1) | 1 while pinned
+                Atomic<bool> in_use;
+                uint32_t countdown;            // owner only
+                Slot* _Nullable next;          // immutable once published
+            };
+
+            enum : uint32_t { ADVANCE_CADENCE = 16 };
+
+            alignas(CACHE_LINE_SIZE) Atomic<uint32_t> current;
+            alignas(CACHE_LINE_SIZE) Atomic<Slot*> head;
+            Atomic<uint32_t> waiters;
+            Atomic<uint32_t> explicit_pins[2];
+
+            static uint64_t _encode(Epoch e) {
+                return ((uint64_t)e.raw << 1) | 1;
+            }
+
+            [[nodiscard]] Slot* _Nonnull register_slot();
+            void release_slot(Slot* _Nonnull slot);
+
+            // Returns true if this call, or a racing one, advanced the epoch
+            bool try_advance();
+
+            [[nodiscard]] Epoch pin(Slot* _Nonnull slot) {
+                assert(!slot->word.load_relaxed());
+                Epoch e{current.load_relaxed()};
+                for (;;) {
+                    slot->word.store_relaxed(_encode(e));
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    Epoch observed{current.load_acquire()};
+                    if (observed == e)
+                        return e;
+                    e = observed;
+                }
+            }
+
+            Epoch unpin(Slot* _Nonnull slot, Epoch occupied) {
+                assert(slot->word.load_relaxed() == _encode(occupied));
+                slot->word.store_release(0);
+                // A stale read of waiters delays a waiter by at most its
+                // timeout; see wait.
+                if (waiters.load_relaxed() || !slot->countdown--) {
+                    slot->countdown = ADVANCE_CADENCE;
+                    try_advance();
+                }
+                return Epoch{current.load_relaxed()};
+            }
+
+            [[nodiscard]] Epoch repin(Slot* _Nonnull slot, Epoch occupied) {
+                assert(slot->word.load_relaxed() == _encode(occupied));
+                if (waiters.load_relaxed() || !slot->countdown--) {
+                    slot->countdown = ADVANCE_CADENCE;
+                    try_advance();
+                }
+                Epoch e{current.load_acquire()};
+                if (e != occupied) {
+                    // Moving forward needs no fence: the epoch cannot pass
+                    // e while this slot still shows occupied, and a scanner
+                    // that sees e is consistent with it.
+                    assert(e == occupied + 1);
+                    slot->word.store_release(_encode(e));
+                }
+                return e;
+            }
+
+            [[nodiscard]] Epoch pin_global() {
+                for (;;) {
+                    uint32_t e = current.load_relaxed();
+                    explicit_pins[e & 1].fetch_add_seq_cst(1);
+                    if (current.load_seq_cst() == e)
+                        return Epoch{e};
+                    explicit_pins[e & 1].fetch_sub_release(1);
+                }
+            }
+
+            // The caller already holds a pin on `occupied`, so it is the
+            // current or prior epoch and cannot become older while we count.
+            void pin_explicit(Epoch occupied) {
+                assert(((current.load_relaxed() - occupied.raw) & ~1u) == 0);
+                explicit_pins[occupied.raw & 1].fetch_add_relaxed(1);
+            }
+
+            void unpin_global(Epoch occupied) {
+                explicit_pins[occupied.raw & 1].fetch_sub_release(1);
+                if (waiters.load_relaxed())
+                    try_advance();
+            }
+
+            // As Service::wait
+            void wait(Epoch expected);
+
+        }; // struct SlotService
+
+        inline constinit SlotService global_slot_service = {};
+
     } // namespace wry::epoch
 
+#if WRY_EPOCH_SLOTS
+
+    [[nodiscard]] inline epoch::Epoch pin_global_epoch() {
+        return epoch::global_slot_service.pin_global();
+    }
+
+    inline void unpin_global_epoch(epoch::Epoch epoch) {
+        wry::epoch::global_slot_service.unpin_global(epoch);
+    }
+
+    inline void pin_global_epoch_explicit(epoch::Epoch epoch) {
+        return wry::epoch::global_slot_service.pin_explicit(epoch);
+    }
+
+#else
+
     [[nodiscard]] inline epoch::Epoch pin_global_epoch() {
         return epoch::global_service.pin();
     }
@@ -302,6 +470,8 @@ namespace wry {
         return wry::epoch::global_service.pin_explicit(epoch);
     }
 
+#endif
+
 } // namespace wry
 
 #endif /* epoch_hpp */
@@ -0,0 +1,130 @@
+//
+//  epoch_allocator.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <mutex>
+#include <thread>
+
+#include "epoch_allocator.hpp"
+
+#include "test.hpp"
+
+namespace wry::epoch {
+
+    namespace {
+
+        // One exiting thread's slabs, concatenated, with the last epoch the
+        // thread observed.  Everything in the list was allocated at or
+        // before that epoch.
+        struct OrphanedSlabs {
+            OrphanedSlabs* _Nullable next;
+            bump::Slab* _Nullable head;
+            std::size_t count;
+            Epoch retired;
+        };
+
+        // Thread exits are rare, so a mutex and a plain list.
+        std::mutex _orphaned_slabs_mutex;
+        OrphanedSlabs* _Nullable _orphaned_slabs_head = nullptr;
+
+    } // namespace
+
+    void orphan_this_thread_slabs() {
+        assert(!local_state.is_pinned);
+        // The owner reuses a list once its known epoch has moved SIZE times
+        // past the list's last use; an orphan must wait for the same
+        // distance measured from the thread's last known epoch.
+        bump::Slab* lists[LocalState::SIZE + 1] = {};
+        lists[0] = bump::this_thread_state.exchange_head_and_restart(nullptr);
+        for (std::size_t i = 0; i != LocalState::SIZE; ++i)
+            lists[i + 1] = std::exchange(local_state.alternates[i], nullptr);
+        bump::Slab* head = nullptr;
+        std::size_t count = 0;
+        for (bump::Slab* list : lists) {
+            while (list) {
+                bump::Slab* slab = std::exchange(list, list->_next);
+                slab->_next = head;
+                head = slab;
+                ++count;
+            }
+        }
+        if (!head)
+            return;
+        auto* node = new OrphanedSlabs{nullptr, head, count, local_state.known};
+        bump::_slab_pool_note_orphaned(count);
+        {
+            std::scoped_lock guard{_orphaned_slabs_mutex};
+            node->next = _orphaned_slabs_head;
+            _orphaned_slabs_head = node;
+        }
+        orphaned_slab_lists.fetch_add_release(1);
+    }
+
+    void reclaim_orphaned_slabs(Epoch observed) {
+        OrphanedSlabs* ready = nullptr;
+        {
+            std::unique_lock guard{_orphaned_slabs_mutex, std::try_to_lock};
+            // Somebody else is already reclaiming; the next change retries.
+            if (!guard.owns_lock())
+                return;
+            OrphanedSlabs** p = &_orphaned_slabs_head;
+            while (OrphanedSlabs* node = *p) {
+                if (observed - node->retired >= (int32_t)LocalState::SIZE) {
+                    *p = node->next;
+                    node->next = ready;
+                    ready = node;
+                } else {
+                    p = &node->next;
+                }
+            }
+        }
+        while (ready) {
+            OrphanedSlabs* node = std::exchange(ready, ready->next);
+            orphaned_slab_lists.fetch_sub_relaxed(1);
+            bump::_slab_pool_note_reclaimed(node->count);
+            bump::slab_release_list(node->head);
+            delete node;
+        }
+    }
+
+    // Transient threads that allocate and exit must not grow the heap: each
+    // one's slabs are orphaned, then recycled once the epoch moves on, and
+    // the next one is served from the pool.
+    define_test("epoch_slab_recycling") {
+        auto churn = [] {
+            pin_this_thread();
+            for (int i = 0; i != 3; ++i)
+                (void) allocate(bump::DEFAULT_SLAB_SIZE / 2);
+            unpin_this_thread();
+            orphan_this_thread_slabs();
+        };
+        auto before = bump::slab_pool_statistics();
+        for (int i = 0; i != 8; ++i) {
+            std::thread(churn).join();
+            // Collection cycles advance the epoch many times over.
+            co_await Coroutine::WaitForCollectionCycles{1};
+        }
+        auto after = bump::slab_pool_statistics();
+        assert(after.orphaned > before.orphaned);
+        assert(after.reclaimed - before.reclaimed
+               >= (after.orphaned - before.orphaned) - after.orphans_pending);
+        // Eight threads' worth of slabs, but only the first needed to come
+        // from the system; allow slack for concurrent tests' slab traffic.
+        assert(after.pool_hits > before.pool_hits);
+        printf("slab pool: pooled=%zu system=%zuMB allocations=%llu frees=%llu "
+               "hits=%llu orphaned=%llu reclaimed=%llu pending=%zu\n",
+               after.pooled,
+               after.system_bytes >> 20,
+               (unsigned long long)after.system_allocations,
+               (unsigned long long)after.system_frees,
+               (unsigned long long)after.pool_hits,
+               (unsigned long long)after.orphaned,
+               (unsigned long long)after.reclaimed,
+               after.orphans_pending);
+        co_return;
+    };
+
+} // namespace wry::epoch
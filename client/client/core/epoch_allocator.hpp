@@ -24,6 +24,15 @@ namespace wry {
         // ...
         // < buffer eventually reused >
 
+        // Slab lists orphaned by exiting threads, awaiting their epoch.  The
+        // count lets every epoch change skip the reclaim call when there is
+        // nothing to reclaim.
+        inline constinit Atomic<std::size_t> orphaned_slab_lists = {};
+
+        // Recycle into the slab pool every orphaned list whose epoch is far
+        // enough behind `observed` that no pin can still see into it.
+        void reclaim_orphaned_slabs(Epoch observed);
+
         // LocalState will be instantiated as a thread_local variable and not
         // exposed to other threads
         
@@ -42,6 +51,11 @@ namespace wry {
             enum : std::size_t { SIZE = 3 };
             bump::Slab* _Nullable alternates[SIZE] = {};
 
+#if WRY_EPOCH_SLOTS
+            // Registered on first pin, released at thread exit
+            SlotService::Slot* _Nullable slot = {};
+#endif
+
             void _update_with(Epoch observed) {
                 if (observed != known) {
 
@@ -57,9 +71,34 @@ namespace wry {
                     // rotate buffer
                     std::rotate(alternates, alternates + 1, alternates + SIZE);
                     known = observed;
+                    if (orphaned_slab_lists.load_relaxed()) [[unlikely]]
+                        reclaim_orphaned_slabs(observed);
                 }
             }
 
+#if WRY_EPOCH_SLOTS
+
+            void pin() {
+                assert(!is_pinned);
+                if (!slot) [[unlikely]]
+                    slot = global_slot_service.register_slot();
+                _update_with(global_slot_service.pin(slot));
+                is_pinned = true;
+            }
+
+            void unpin() {
+                assert(is_pinned);
+                _update_with(global_slot_service.unpin(slot, known));
+                is_pinned = false;
+            }
+
+            void repin() {
+                assert(is_pinned);
+                _update_with(global_slot_service.repin(slot, known));
+            }
+
+#else
+
             void pin() {
                 assert(!is_pinned);
                 _update_with(global_service.pin());
@@ -80,6 +119,8 @@ namespace wry {
                 _update_with(global_service.repin(known));
             }
 
+#endif
+
         };
 
         constinit inline thread_local LocalState local_state = {};
@@ -94,7 +135,11 @@ namespace wry {
             assert(!local_state.is_pinned
                    || (expected != local_state.known + 1));
 
+#if WRY_EPOCH_SLOTS
+            global_slot_service.wait(expected);
+#else
             global_service.wait(expected);
+#endif
         }
 
         // Keep the epoch pinned while a thread is awake
@@ -121,6 +166,24 @@ namespace wry {
             // no op
         }
 
+        // Hand this thread's slabs -- the current list and the alternates
+        // -- to the epoch system before the thread exits, so the bump::State
+        // destructor does not abort.  Other threads may still hold pointers
+        // into them; they are tagged with this thread's last known epoch
+        // and recycled by reclaim_orphaned_slabs once every pin that could
+        // hold such a pointer has advanced past it.  Call unpinned.
+        void orphan_this_thread_slabs();
+
+        // Return this thread's epoch slot, if it has one, for reuse by a
+        // later thread.  Call unpinned, at thread exit.
+        inline void release_this_thread_slot() {
+            assert(!local_state.is_pinned);
+#if WRY_EPOCH_SLOTS
+            if (local_state.slot)
+                global_slot_service.release_slot(std::exchange(local_state.slot, nullptr));
+#endif
+        }
+
 
     } // namespace wry::epoch
 
@@ -0,0 +1,582 @@
+//
+//  epoll_reactor.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include "epoll_reactor.hpp"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "test.hpp"
+
+namespace wry {
+
+    // MARK: TimerWheel
+
+    void TimerWheel::insert(ReactorOperation* op, std::vector<ReactorOperation*>& due) {
+        uint64_t tick = tick_from_deadline(op->_deadline);
+        if (tick <= _tick) {
+            due.push_back(op);
+            return;
+        }
+        ++_size;
+        int level = (63 - std::countl_zero(tick ^ _tick)) / SLOT_BITS;
+        if (level >= LEVELS) {
+            _overflow.push_back(op);
+            return;
+        }
+        _slots[level][(tick >> (level * SLOT_BITS)) & (SLOTS - 1)].push_back(op);
+        ++_counts[level];
+    }
+
+    void TimerWheel::advance(uint64_t tick, std::vector<ReactorOperation*>& due) {
+        std::size_t first = due.size();
+        while (_tick < tick) {
+            if (!_size) {
+                _tick = tick;
+                break;
+            }
+            if (!_counts[0]) {
+                // Nothing expires before the next turn of level one
+                uint64_t boundary = (_tick | (SLOTS - 1)) + 1;
+                if (boundary > tick) {
+                    _tick = tick;
+                    break;
+                }
+                _tick = boundary - 1;
+            }
+            ++_tick;
+            // Turn over every wheel whose period starts here, top down, so a
+            // timer can fall through several levels in one tick
+            if (!(_tick & (((uint64_t)1 << (LEVELS * SLOT_BITS)) - 1))) {
+                ReactorOperation* list = _overflow.take();
+                while (list) {
+                    ReactorOperation* op = std::exchange(list, list->_next);
+                    --_size;
+                    insert(op, due);
+                }
+            }
+            for (int level = LEVELS - 1; level != 0; --level) {
+                if (_tick & (((uint64_t)1 << (level * SLOT_BITS)) - 1))
+                    continue;
+                ReactorOperation* list = _slots[level][(_tick >> (level * SLOT_BITS)) & (SLOTS - 1)].take();
+                while (list) {
+                    ReactorOperation* op = std::exchange(list, list->_next);
+                    --_counts[level];
+                    --_size;
+                    insert(op, due);
+                }
+            }
+            ReactorOperation* list = _slots[0][_tick & (SLOTS - 1)].take();
+            while (list) {
+                ReactorOperation* op = std::exchange(list, list->_next);
+                --_counts[0];
+                --_size;
+                due.push_back(op);
+            }
+        }
+        // Ticks are coarser than deadlines; slots keep insertion order, so
+        // a stable sort makes equal deadlines fire first-come-first-served
+        std::stable_sort(due.begin() + first, due.end(), [](ReactorOperation* a, ReactorOperation* b) {
+            return a->_deadline < b->_deadline;
+        });
+    }
+
+    uint64_t TimerWheel::next_tick() const {
+        uint64_t result = UINT64_MAX;
+        if (!_size)
+            return result;
+        for (int level = 0; level != LEVELS; ++level) {
+            if (!_counts[level])
+                continue;
+            uint64_t base = _tick >> (level * SLOT_BITS);
+            for (uint64_t k = 1; k != SLOTS; ++k) {
+                if (_slots[level][(base + k) & (SLOTS - 1)].head) {
+                    result = std::min(result, (base + k) << (level * SLOT_BITS));
+                    break;
+                }
+            }
+        }
+        if (_overflow.head) {
+            uint64_t base = _tick >> (LEVELS * SLOT_BITS);
+            result = std::min(result, (base + 1) << (LEVELS * SLOT_BITS));
+        }
+        return result;
+    }
+
+
+    // MARK: EpollReactor
+
+    namespace {
+
+        // epoll_event::data tags for the reactor's own descriptors; fds are
+        // stored as themselves
+        constexpr uint64_t _REACTOR_WAKE = UINT64_MAX;
+        constexpr uint64_t _REACTOR_TIMER = UINT64_MAX - 1;
+
+        int _reactor_checked(int result, const char* what) {
+            if (result < 0) [[unlikely]] {
+                perror(what);
+                abort();
+            }
+            return result;
+        }
+
+    } // namespace
+
+    EpollReactor::EpollReactor()
+    : _epoll(_reactor_checked(epoll_create1(EPOLL_CLOEXEC), "epoll_create1"))
+    , _wake(_reactor_checked(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK), "eventfd"))
+    , _timer(_reactor_checked(timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK), "timerfd_create"))
+    , _is_canceled(false)
+    , _wheel(TimerWheel::tick_from_now(reactor_now())) {
+        epoll_event event = { .events = EPOLLIN, .data = { .u64 = _REACTOR_WAKE } };
+        _reactor_checked(epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &event), "epoll_ctl");
+        event.data.u64 = _REACTOR_TIMER;
+        _reactor_checked(epoll_ctl(_epoll, EPOLL_CTL_ADD, _timer, &event), "epoll_ctl");
+    }
+
+    EpollReactor::~EpollReactor() {
+        close(_timer);
+        close(_wake);
+        close(_epoll);
+    }
+
+    void EpollReactor::_wake_up() {
+        uint64_t one = 1;
+        (void) write(_wake, &one, sizeof(one));
+    }
+
+    void EpollReactor::_rearm(int fd, Interest& interest) {
+        uint32_t mask = ((interest.reader ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : 0u)
+                         | (interest.writer ? (uint32_t)EPOLLOUT : 0u));
+        if (mask) {
+            epoll_event event = { .events = mask | EPOLLONESHOT, .data = { .u64 = (uint64_t)fd } };
+            if (epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &event))
+                perror("epoll_ctl");
+        } else {
+            (void) epoll_ctl(_epoll, EPOLL_CTL_DEL, fd, nullptr);
+            _interests.erase(fd);
+        }
+    }
+
+    void EpollReactor::_when_ready(int fd, ReactorOperation* op, bool is_write) {
+        assert(op->_callback);
+        {
+            std::scoped_lock guard{_mutex};
+            auto [where, inserted] = _interests.try_emplace(fd);
+            Interest& interest = where->second;
+            ReactorOperation*& slot = is_write ? interest.writer : interest.reader;
+            assert(!slot);
+            slot = op;
+            uint32_t mask = ((interest.reader ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : 0u)
+                             | (interest.writer ? (uint32_t)EPOLLOUT : 0u));
+            epoll_event event = { .events = mask | EPOLLONESHOT, .data = { .u64 = (uint64_t)fd } };
+            if (!epoll_ctl(_epoll, inserted ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event))
+                return;
+            if (errno != EPERM) {
+                perror("epoll_ctl");
+                abort();
+            }
+            // Regular files and block devices do not support epoll, and are
+            // always ready
+            slot = nullptr;
+            if (inserted)
+                _interests.erase(where);
+            _ready.emplace_back(op, (uint64_t)(is_write ? EPOLLOUT : EPOLLIN));
+        }
+        _wake_up();
+    }
+
+    void EpollReactor::when_readable(int fd, ReactorOperation* op) {
+        _when_ready(fd, op, false);
+    }
+
+    void EpollReactor::when_writable(int fd, ReactorOperation* op) {
+        _when_ready(fd, op, true);
+    }
+
+    void EpollReactor::when_deadline(uint64_t deadline, ReactorOperation* op) {
+        assert(op->_callback);
+        op->_deadline = deadline;
+        {
+            std::scoped_lock guard{_mutex};
+            _pending_timers.push_back(op);
+        }
+        _wake_up();
+    }
+
+    void EpollReactor::when_triggered(ReactorUserEvent& event, ReactorOperation* op) {
+        assert(op->_callback);
+        {
+            std::scoped_lock guard{_mutex};
+            assert(!event._waiter);
+            if (!event._triggers) {
+                event._waiter = op;
+                return;
+            }
+            _ready.emplace_back(op, std::exchange(event._triggers, 0));
+        }
+        _wake_up();
+    }
+
+    void EpollReactor::trigger(ReactorUserEvent& event) {
+        {
+            std::scoped_lock guard{_mutex};
+            ++event._triggers;
+            if (!event._waiter)
+                return;
+            _ready.emplace_back(std::exchange(event._waiter, nullptr),
+                                std::exchange(event._triggers, 0));
+        }
+        _wake_up();
+    }
+
+    void EpollReactor::cancel() {
+        _is_canceled.store_release(true);
+        _wake_up();
+    }
+
+    void EpollReactor::_arm_timer(uint64_t tick) {
+        if (tick == _armed_tick)
+            return;
+        _armed_tick = tick;
+        itimerspec spec = {};
+        if (tick != UINT64_MAX) {
+            uint64_t t = tick * TimerWheel::TICK_NANOSECONDS;
+            spec.it_value.tv_sec = (time_t)(t / 1'000'000'000);
+            spec.it_value.tv_nsec = (long)(t % 1'000'000'000);
+        }
+        if (timerfd_settime(_timer, TFD_TIMER_ABSTIME, &spec, nullptr))
+            perror("timerfd_settime");
+    }
+
+    void EpollReactor::run() {
+        constexpr int N = 64;
+        epoll_event events[N];
+        std::vector<std::pair<ReactorOperation*, uint64_t>> ready;
+        std::vector<ReactorOperation*> due;
+        while (!_is_canceled.load_acquire()) {
+            int result = epoll_wait(_epoll, events, N, -1);
+            if (result < 0) {
+                if (errno != EINTR)
+                    perror("epoll_wait");
+                continue;
+            }
+            ReactorOperation* timers = nullptr;
+            {
+                std::scoped_lock guard{_mutex};
+                for (int i = 0; i != result; ++i) {
+                    uint64_t data = events[i].data.u64;
+                    if (data == _REACTOR_WAKE) {
+                        uint64_t count = 0;
+                        (void) read(_wake, &count, sizeof(count));
+                        continue;
+                    }
+                    if (data == _REACTOR_TIMER) {
+                        uint64_t count = 0;
+                        (void) read(_timer, &count, sizeof(count));
+                        _armed_tick = UINT64_MAX;
+                        continue;
+                    }
+                    int fd = (int)data;
+                    auto where = _interests.find(fd);
+                    if (where == _interests.end())
+                        continue;
+                    Interest& interest = where->second;
+                    uint32_t mask = events[i].events;
+                    bool is_hangup = mask & (EPOLLHUP | EPOLLERR);
+                    if (interest.reader && (is_hangup || (mask & (EPOLLIN | EPOLLRDHUP))))
+                        ready.emplace_back(std::exchange(interest.reader, nullptr), mask);
+                    if (interest.writer && (is_hangup || (mask & EPOLLOUT)))
+                        ready.emplace_back(std::exchange(interest.writer, nullptr), mask);
+                    _rearm(fd, interest);
+                }
+                timers = _pending_timers.take();
+                ready.insert(ready.end(), _ready.begin(), _ready.end());
+                _ready.clear();
+            }
+            while (timers) {
+                ReactorOperation* op = std::exchange(timers, timers->_next);
+                _wheel.insert(op, due);
+            }
+            _wheel.advance(TimerWheel::tick_from_now(reactor_now()), due);
+            for (ReactorOperation* op : due)
+                op->_callback(op, 0);
+            for (auto [op, value] : ready)
+                op->_callback(op, value);
+            due.clear();
+            ready.clear();
+            _arm_timer(_wheel.next_tick());
+        }
+    }
+
+    uint64_t reactor_bytes_readable(int fd) {
+        int available = 0;
+        if (ioctl(fd, FIONREAD, &available) || (available < 0))
+            return 0;
+        return (uint64_t)available;
+    }
+
+    uint64_t reactor_bytes_writable(int fd) {
+        struct stat status = {};
+        if (fstat(fd, &status))
+            return 0;
+        int capacity = 0;
+        int queued = 0;
+        if (S_ISFIFO(status.st_mode)) {
+            capacity = fcntl(fd, F_GETPIPE_SZ);
+            if (ioctl(fd, FIONREAD, &queued))
+                return 0;
+        } else if (S_ISSOCK(status.st_mode)) {
+            socklen_t length = sizeof(capacity);
+            if (getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &capacity, &length) || ioctl(fd, SIOCOUTQ, &queued))
+                return 0;
+        }
+        return (capacity > queued) ? (uint64_t)(capacity - queued) : 0;
+    }
+
+    EpollReactor global_reactor;
+
+    void global_reactor_cancel() {
+        global_reactor.cancel();
+    }
+
+    void global_reactor_service() {
+        global_reactor.run();
+    }
+
+
+    // MARK: Tests
+
+    namespace {
+
+        // Records when and in what order it was called back
+        struct _ReactorProbe : ReactorOperation {
+            Atomic<uint32_t> _count = {};
+            uint64_t _result = 0;
+            uint64_t _when = 0;
+            std::vector<int>* _Nullable _order = nullptr;
+            int _identifier = 0;
+
+            _ReactorProbe() {
+                _callback = [](ReactorOperation* op, uint64_t result) {
+                    auto* that = static_cast<_ReactorProbe*>(op);
+                    that->_result = result;
+                    that->_when = reactor_now();
+                    if (that->_order)
+                        that->_order->push_back(that->_identifier);
+                    that->_count.fetch_add_release(1);
+                    that->_count.notify_all();
+                };
+            }
+
+            void wait_for_count(uint32_t n) {
+                for (uint32_t observed = _count.load_acquire(); observed < n; )
+                    _count.wait(observed, Ordering::ACQUIRE);
+            }
+        };
+
+        void _set_nonblocking(int fd) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+
+    } // namespace
+
+    // The wheel, with a synthetic clock spanning every level and the
+    // overflow list: each timer fires exactly once, at the first advance
+    // that reaches its tick, and each batch is in deadline order.
+    define_test("timer_wheel") {
+        std::mt19937_64 engine{1};
+        const uint64_t origin = 12345;
+        TimerWheel wheel{origin};
+        constexpr int N = 4096;
+        std::vector<ReactorOperation> ops(N);
+        std::vector<int> fired(N);
+        std::vector<ReactorOperation*> due;
+        for (int i = 0; i != N; ++i) {
+            // Log-uniform delays from sub-tick to beyond the top level
+            int bits = (int)(engine() % 32);
+            uint64_t delay = engine() & (((uint64_t)1 << bits) - 1);
+            ops[i]._deadline = (origin + 1) * TimerWheel::TICK_NANOSECONDS + delay * TimerWheel::TICK_NANOSECONDS / 3;
+            wheel.insert(&ops[i], due);
+        }
+        assert(due.empty());
+        uint64_t tick = origin;
+        while (!wheel.empty()) {
+            uint64_t next = wheel.next_tick();
+            assert(next > tick);
+            // Sometimes stop short, sometimes overshoot
+            uint64_t step = std::max<uint64_t>(1, engine() % (2 * (next - tick) + 1));
+            uint64_t previous = tick;
+            tick += step;
+            wheel.advance(tick, due);
+            for (std::size_t k = 0; k != due.size(); ++k) {
+                ReactorOperation* op = due[k];
+                uint64_t target = TimerWheel::tick_from_deadline(op->_deadline);
+                assert(previous < target && target <= tick);
+                assert(!k || due[k - 1]->_deadline <= op->_deadline);
+                ++fired[op - ops.data()];
+            }
+            due.clear();
+        }
+        for (int n : fired)
+            assert(n == 1);
+        co_return;
+    };
+
+    // A live reactor on pipes, loopback TCP, timers and user events
+    define_test("epoll_reactor") {
+        EpollReactor reactor;
+        std::thread thread([&reactor] { reactor.run(); });
+
+        {
+            // Pipe: readable on write, hangup on close
+            int fds[2] = {};
+            _reactor_checked(pipe2(fds, O_NONBLOCK | O_CLOEXEC), "pipe2");
+            _ReactorProbe probe;
+            reactor.when_readable(fds[0], &probe);
+            char c = 'x';
+            (void) write(fds[1], &c, 1);
+            probe.wait_for_count(1);
+            assert(probe._result & EPOLLIN);
+            // async_read and async_write report these, as kqueue does
+            assert(reactor_bytes_readable(fds[0]) == 1);
+            assert(reactor_bytes_writable(fds[1]) == (uint64_t)fcntl(fds[1], F_GETPIPE_SZ) - 1);
+            assert(read(fds[0], &c, 1) == 1 && c == 'x');
+            reactor.when_readable(fds[0], &probe);
+            close(fds[1]);
+            probe.wait_for_count(2);
+            assert(probe._result & EPOLLHUP);
+            close(fds[0]);
+        }
+
+        {
+            // Loopback TCP: accept, then a reader and a writer pending on
+            // the same socket at once
+            int listener = _reactor_checked(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0), "socket");
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t length = sizeof(address);
+            _reactor_checked(bind(listener, (sockaddr*)&address, length), "bind");
+            _reactor_checked(listen(listener, 4), "listen");
+            _reactor_checked(getsockname(listener, (sockaddr*)&address, &length), "getsockname");
+            _set_nonblocking(listener);
+
+            _ReactorProbe accepted;
+            reactor.when_readable(listener, &accepted);
+            int client = _reactor_checked(socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0), "socket");
+            (void) connect(client, (sockaddr*)&address, length);
+            _ReactorProbe connected;
+            reactor.when_writable(client, &connected);
+            accepted.wait_for_count(1);
+            int server = _reactor_checked(accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC), "accept4");
+            connected.wait_for_count(1);
+            assert(connected._result & EPOLLOUT);
+
+            _ReactorProbe readable;
+            _ReactorProbe writable;
+            reactor.when_readable(server, &readable);
+            reactor.when_writable(server, &writable);
+            writable.wait_for_count(1);
+            assert(readable._count.load_acquire() == 0);
+            const char message[] = "hello";
+            assert(write(client, message, sizeof(message)) == (ssize_t)sizeof(message));
+            readable.wait_for_count(1);
+            char buffer[sizeof(message)] = {};
+            assert(read(server, buffer, sizeof(buffer)) == (ssize_t)sizeof(message));
+            assert(!memcmp(buffer, message, sizeof(message)));
+            close(server);
+            close(client);
+            close(listener);
+        }
+
+        {
+            // Timers fire in deadline order and never early, however they
+            // were requested
+            constexpr int N = 64;
+            std::mt19937_64 engine{2};
+            std::vector<_ReactorProbe> probes(N);
+            std::vector<int> order;
+            uint64_t now = reactor_now();
+            for (int i = 0; i != N; ++i) {
+                probes[i]._order = &order;
+                probes[i]._identifier = i;
+                reactor.when_deadline(now + (engine() % 100'000'000), &probes[i]);
+            }
+            for (auto& probe : probes)
+                probe.wait_for_count(1);
+            assert(order.size() == N);
+            for (std::size_t k = 0; k != order.size(); ++k) {
+                const _ReactorProbe& probe = probes[order[k]];
+                assert(probe._when >= probe._deadline);
+                assert(!k || probes[order[k - 1]]._deadline <= probe._deadline);
+            }
+        }
+
+        {
+            // A user event triggered before and after the wait
+            ReactorUserEvent event;
+            _ReactorProbe probe;
+            reactor.trigger(event);
+            reactor.trigger(event);
+            reactor.when_triggered(event, &probe);
+            probe.wait_for_count(1);
+            assert(probe._result == 2);
+            reactor.when_triggered(event, &probe);
+            reactor.trigger(event);
+            probe.wait_for_count(2);
+            assert(probe._result == 1);
+        }
+
+        {
+            // The sender interface
+            struct Receiver {
+                Atomic<uint32_t>* _Nonnull done;
+                void set_value(uint64_t) {
+                    done->store_release(1);
+                    done->notify_all();
+                }
+            };
+            Atomic<uint32_t> done = {};
+            uint64_t before = reactor_now();
+            auto operation = async_sleep_for(std::chrono::milliseconds(5), reactor)
+                .connect(Receiver{&done});
+            operation.start();
+            for (uint32_t observed = 0; !observed; )
+                done.wait(observed, Ordering::ACQUIRE);
+            assert(reactor_now() - before >= 5'000'000);
+        }
+
+        reactor.cancel();
+        thread.join();
+        co_return;
+    };
+
+} // namespace wry
+
+#endif // defined(__linux__)
@@ -0,0 +1,283 @@
+//
+//  epoll_reactor.hpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#ifndef epoll_reactor_hpp
+#define epoll_reactor_hpp
+
+#if defined(__linux__)
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "atomic.hpp"
+#include "execution.hpp"
+
+namespace wry {
+
+    // Linux counterpart of kqueue_reactor
+    //
+    // A dedicated thread waits on an epoll set and runs callbacks on that
+    // thread, trusting them to return promptly.  Readiness is level-
+    // triggered and one-shot per request, as with kqueue's EV_ONESHOT.
+    //
+    //   readable / writable : the fd, registered with EPOLLONESHOT
+    //   timer               : a hierarchical timing wheel, armed onto a
+    //                         single timerfd
+    //   user event          : a ReactorUserEvent, posted by any thread
+    //
+    // Requests from other threads are handed over under a mutex, and an
+    // eventfd interrupts the wait.
+    //
+    // epoll is keyed by fd, so unlike EV_UDATA_SPECIFIC there may be at
+    // most one reader and one writer pending on an fd at a time.
+
+    // A pending request.  The reactor calls `_callback` on its own thread
+    // with the epoll events that satisfied a readiness request, the number
+    // of triggers of a user event, or zero for a timer.
+    struct ReactorOperation {
+        void (*_Nullable _callback)(ReactorOperation* _Nonnull, uint64_t result) = nullptr;
+        ReactorOperation* _Nullable _next = nullptr;   // timer lists
+        uint64_t _deadline = 0;                         // CLOCK_MONOTONIC nanoseconds
+    };
+
+    inline uint64_t reactor_now() {
+        struct timespec ts = {};
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1'000'000'000 + (uint64_t)ts.tv_nsec;
+    }
+
+
+    // Hierarchical timing wheel
+    //
+    // LEVELS wheels of SLOTS slots.  A timer due at tick d sits at the
+    // highest level L at which d differs from the current tick, in slot
+    // (d >> L * SLOT_BITS) % SLOTS, which is strictly ahead of the current
+    // slot of that level.  When the current tick reaches the start of that
+    // slot's period, the slot is emptied and its timers reinserted, which
+    // places each at a lower level, down to expiry at level zero.  Insertion
+    // and expiry are O(1), and a timer moves at most LEVELS times.  Timers
+    // beyond the top level wait in an overflow list.
+    //
+    // Deadlines round up to whole ticks, so timers never fire early.
+
+    struct TimerWheel {
+
+        static constexpr int SLOT_BITS = 6;
+        static constexpr int SLOTS = 1 << SLOT_BITS;
+        static constexpr int LEVELS = 4;
+        static constexpr uint64_t TICK_NANOSECONDS = 1'000'000;
+
+        struct List {
+            ReactorOperation* _Nullable head = nullptr;
+            ReactorOperation* _Nullable tail = nullptr;
+
+            void push_back(ReactorOperation* _Nonnull op) {
+                op->_next = nullptr;
+                *(tail ? &tail->_next : &head) = op;
+                tail = op;
+            }
+
+            [[nodiscard]] ReactorOperation* _Nullable take() {
+                tail = nullptr;
+                return std::exchange(head, nullptr);
+            }
+        };
+
+        List _slots[LEVELS][SLOTS];
+        std::size_t _counts[LEVELS] = {};
+        List _overflow;
+        std::size_t _size = 0;
+        uint64_t _tick;                // every tick up to here is processed
+
+        explicit TimerWheel(uint64_t tick) : _tick(tick) {}
+
+        static uint64_t tick_from_deadline(uint64_t deadline) {
+            return (deadline + TICK_NANOSECONDS - 1) / TICK_NANOSECONDS;
+        }
+
+        static uint64_t tick_from_now(uint64_t now) {
+            return now / TICK_NANOSECONDS;
+        }
+
+        [[nodiscard]] bool empty() const { return !_size; }
+
+        // Timers already due are appended to `due`
+        void insert(ReactorOperation* _Nonnull op, std::vector<ReactorOperation*>& due);
+
+        // Process ticks up to `tick`, appending expired timers to `due` in
+        // expiry order
+        void advance(uint64_t tick, std::vector<ReactorOperation*>& due);
+
+        // The next tick at which advance may have work, or UINT64_MAX
+        [[nodiscard]] uint64_t next_tick() const;
+
+    }; // struct TimerWheel
+
+
+    // Edge-triggered event posted by any thread; a trigger with no waiter
+    // is remembered, and triggers coalesce.  Guarded by the reactor's mutex.
+    struct ReactorUserEvent {
+        ReactorOperation* _Nullable _waiter = nullptr;
+        uint64_t _triggers = 0;
+    };
+
+
+    struct EpollReactor {
+
+        struct Interest {
+            ReactorOperation* _Nullable reader = nullptr;
+            ReactorOperation* _Nullable writer = nullptr;
+        };
+
+        int _epoll;
+        int _wake;                     // eventfd
+        int _timer;                    // timerfd
+
+        std::mutex _mutex;
+        std::unordered_map<int, Interest> _interests;
+        TimerWheel::List _pending_timers;
+        std::vector<std::pair<ReactorOperation*, uint64_t>> _ready;
+
+        Atomic<bool> _is_canceled;
+
+        // Reactor thread only
+        TimerWheel _wheel;
+        uint64_t _armed_tick = UINT64_MAX;
+
+        EpollReactor();
+        EpollReactor(EpollReactor const&) = delete;
+        ~EpollReactor();
+        EpollReactor& operator=(EpollReactor const&) = delete;
+
+        void when_readable(int fd, ReactorOperation* _Nonnull op);
+        void when_writable(int fd, ReactorOperation* _Nonnull op);
+        void when_deadline(uint64_t deadline, ReactorOperation* _Nonnull op);
+        void when_triggered(ReactorUserEvent& event, ReactorOperation* _Nonnull op);
+        void trigger(ReactorUserEvent& event);
+
+        // Serve requests until canceled; pending requests are abandoned
+        void run();
+        void cancel();
+
+        void _when_ready(int fd, ReactorOperation* _Nonnull op, bool is_write);
+        void _rearm(int fd, Interest& interest);
+        void _wake_up();
+        void _arm_timer(uint64_t tick);
+
+    }; // struct EpollReactor
+
+    extern EpollReactor global_reactor;
+
+    void global_reactor_cancel();
+    void global_reactor_service();
+
+
+    // What kqueue reports as a readiness event's `data`: the bytes
+    // available to read (zero at end of file), and the space left in the
+    // write buffer of a pipe or socket.  Zero where the fd cannot say, as
+    // for the regular files epoll cannot watch.
+    uint64_t reactor_bytes_readable(int fd);
+    uint64_t reactor_bytes_writable(int fd);
+
+
+    // Senders
+    //
+    // async_read and async_write complete with the byte counts above, the
+    // same quantities as their kqueue_reactor counterparts.
+
+    struct ReactorRequest {
+        enum {
+            READABLE,
+            WRITABLE,
+            DEADLINE,
+            USER_EVENT,
+        } tag;
+        EpollReactor* _Nonnull reactor;
+        int fd = -1;
+        uint64_t deadline = 0;
+        ReactorUserEvent* _Nullable event = nullptr;
+    };
+
+    template<typename Receiver>
+    struct _reactor_operation : ReactorOperation {
+        ReactorRequest _request;
+        Receiver _receiver;
+
+        static void _static_callback(ReactorOperation* _Nonnull op, uint64_t result) {
+            auto* that = static_cast<_reactor_operation*>(op);
+            // Report readiness as kqueue does, by byte count, not by mask
+            switch (that->_request.tag) {
+                case ReactorRequest::READABLE:
+                    result = reactor_bytes_readable(that->_request.fd);
+                    break;
+                case ReactorRequest::WRITABLE:
+                    result = reactor_bytes_writable(that->_request.fd);
+                    break;
+                default:
+                    break;
+            }
+            std::move(that->_receiver).set_value(std::move(result));
+        }
+
+        void start() {
+            _callback = &_static_callback;
+            EpollReactor* reactor = _request.reactor;
+            switch (_request.tag) {
+                case ReactorRequest::READABLE:
+                    return reactor->when_readable(_request.fd, this);
+                case ReactorRequest::WRITABLE:
+                    return reactor->when_writable(_request.fd, this);
+                case ReactorRequest::DEADLINE:
+                    return reactor->when_deadline(_request.deadline, this);
+                case ReactorRequest::USER_EVENT:
+                    return reactor->when_triggered(*_request.event, this);
+            }
+        }
+    };
+
+    struct reactor_sender {
+        ReactorRequest request;
+        template<typename Receiver>
+        auto connect(Receiver receiver) {
+            return _reactor_operation<Receiver>{{}, request, std::move(receiver)};
+        }
+    };
+
+
+    // Sender factories
+
+    inline auto async_read(int fd, EpollReactor& reactor = global_reactor) {
+        return reactor_sender{{.tag = ReactorRequest::READABLE, .reactor = &reactor, .fd = fd}};
+    }
+
+    inline auto async_write(int fd, EpollReactor& reactor = global_reactor) {
+        return reactor_sender{{.tag = ReactorRequest::WRITABLE, .reactor = &reactor, .fd = fd}};
+    }
+
+    inline auto async_sleep_until(uint64_t deadline, EpollReactor& reactor = global_reactor) {
+        return reactor_sender{{.tag = ReactorRequest::DEADLINE, .reactor = &reactor, .deadline = deadline}};
+    }
+
+    inline auto async_sleep_for(std::chrono::nanoseconds duration, EpollReactor& reactor = global_reactor) {
+        return async_sleep_until(reactor_now() + (uint64_t)duration.count(), reactor);
+    }
+
+    inline auto async_wait(ReactorUserEvent& event, EpollReactor& reactor = global_reactor) {
+        return reactor_sender{{.tag = ReactorRequest::USER_EVENT, .reactor = &reactor, .event = &event}};
+    }
+
+} // namespace wry
+
+#endif // defined(__linux__)
+
+#endif /* epoll_reactor_hpp */
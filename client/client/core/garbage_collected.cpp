@@ -18,6 +18,7 @@
 
 #include "garbage_collected.hpp"
 
+#include "allocation_profile.hpp"
 #include "bag.hpp"
 #include "epoch_allocator.hpp"
 #include "HeapString.hpp"
@@ -387,6 +388,9 @@ namespace wry {
         Bag<const GarbageCollected*> shaded;
         Bag<const GarbageCollected*> rooted;
         Bag<const GarbageCollected*> weak_registrations;
+        // Allocation profiler samples taken this period; null unless the
+        // profiler is on.  Resolved against `allocations` at receive.
+        AllocationSample* samples = nullptr;
         Epoch epoch;
 
     }; // struct Report
@@ -411,6 +415,7 @@ namespace wry {
             .shaded = std::move(_thread_local_shaded_objects),
             .rooted = std::move(_thread_local_rooted_objects),
             .weak_registrations = std::move(_thread_local_weak_registrations),
+            .samples = _allocation_profile_take_samples(),
             .epoch = epoch::local_state.known
         };
         // Publish with release so the collector's acquire-exchange reads the
@@ -812,6 +817,11 @@ namespace wry {
                 // pass-lengthened iterations.)
                 assert(H <= E + 1);
 
+                // Before the splice below empties the allocation bag the
+                // samples are resolved against.
+                _allocation_profile_receive(std::exchange(head->samples, nullptr),
+                                            head->allocations);
+
                 if (!head->allocations.is_empty()) {
                     size_t n = head->allocations.size();
                     _allocated_since_scan += n;
@@ -876,6 +886,11 @@ namespace wry {
 
             printf("C0: garbage collector starts\n");
 
+            // WRY_GC_PROFILE=<bytes> starts the allocation profiler with
+            // that mean sample interval (0 samples every allocation).
+            if (const char* interval = getenv("WRY_GC_PROFILE"))
+                allocation_profile_start(strtoull(interval, nullptr, 0));
+
 #if WRY_GC_DEBUG
             // TEMP: forensics ring + ASan report narration
             if (!_debug_freed_ring)
@@ -1509,6 +1524,7 @@ namespace wry {
             size_t delete_count = 0;
             uint16_t stripped = 0;
             int counter = 0;
+            const bool profile = _allocation_profile_is_tracking();
 
             for (int key = 0; key != 16; ++key) {
                 uint16_t key_bit = (uint16_t)(1u << key);
@@ -1555,6 +1571,8 @@ namespace wry {
                         // requires a reachable pointer, so a white object
                         // cannot be rooted -- the standing S1 oracle.
                         assert(reference_count == 0);
+                        if (profile)
+                            _allocation_profile_sweep_visit(object, true);
 #if WRY_GC_DEBUG
                         if (_debug_freed_ring) { // TEMP: record the delete
                             DebugFreedRecord& r =
@@ -1584,6 +1602,8 @@ namespace wry {
                         ++delete_count;
                         --_heap_objects;
                     } else {
+                        if (profile)
+                            _allocation_profile_sweep_visit(object, false);
                         uint16_t after_gray = before_gray;
                         if (strip) {
                             // The stripped bits are all in CLEARING, which
@@ -1618,6 +1638,9 @@ namespace wry {
                 if (_is_sweeping[k])
                     kstate[k].scans += 1;
 
+            if (profile)
+                _allocation_profile_sweep_completed(sweep_mask);
+
             int nonempty = 0;
             for (auto& c : _cohorts_by_key)
                 if (!c.objects.is_empty())
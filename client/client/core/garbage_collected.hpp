@@ -118,17 +118,32 @@ namespace wry {
     extern thread_local uint64_t _thread_local_gc_allocated_bytes;
     extern thread_local uint64_t _thread_local_gc_allocated_objects;
 
-    inline void* _Nonnull GarbageCollected::operator new(std::size_t count) {
+    // Allocation profiler hook (see allocation_profile.hpp): a per-thread
+    // byte budget whose exhaustion takes the out-of-line sample path.  When
+    // profiling is off the budget is only a periodic recheck.
+    extern thread_local uint64_t _thread_local_gc_bytes_until_sample;
+    void _garbage_collected_sample_allocation(void* _Nonnull address, std::size_t count);
+
+    inline void _garbage_collected_note_allocation(void* _Nonnull address, std::size_t count) {
         _thread_local_gc_allocated_bytes += count;
         ++_thread_local_gc_allocated_objects;
-        return calloc(count, 1);
+        if (count < _thread_local_gc_bytes_until_sample) [[likely]]
+            _thread_local_gc_bytes_until_sample -= count;
+        else
+            _garbage_collected_sample_allocation(address, count);
+    }
+
+    inline void* _Nonnull GarbageCollected::operator new(std::size_t count) {
+        void* address = calloc(count, 1);
+        _garbage_collected_note_allocation(address, count);
+        return address;
     }
 
     inline void* _Nonnull GarbageCollected::operator new(std::size_t count, std::align_val_t al) {
         assert((size_t)al <= alignof(std::max_align_t));
-        _thread_local_gc_allocated_bytes += count;
-        ++_thread_local_gc_allocated_objects;
-        return calloc(count, 1);
+        void* address = calloc(count, 1);
+        _garbage_collected_note_allocation(address, count);
+        return address;
     }
 
     inline void GarbageCollected::operator delete(void* _Nullable pointer) {
@@ -7,91 +7,293 @@
 
 #include "global_work_queue.hpp"
 
+#include <cstdio>
+#include <utility>
+
 #include "atomic.hpp"
-#include "bump_allocator.hpp"
 #include "concurrent_queue.hpp"
+#include "coroutine.hpp"
+#include "epoch_allocator.hpp"
 #include "garbage_collected.hpp"
+#include "task_trace.hpp"
 #include "thread_public.hpp"
+#include "work_stealing_queue.hpp"
 
 
 namespace wry {
 
     constexpr int GLOBAL_WORK_QUEUE_REPIN_CADENCE = 10;
+    constexpr int GLOBAL_WORK_QUEUE_MAX_WORKERS = 256;
+    
+    // About a microsecond of rebuild or traversal per step, against a fork
+    // that costs a frame, a push and possibly a steal
+    constexpr std::size_t GLOBAL_WORK_QUEUE_SEQUENTIAL_CUTOFF = 128;
+    
+    // One take in this many prefers BACKGROUND to NORMAL
+    constexpr uint32_t GLOBAL_WORK_QUEUE_BACKGROUND_PERIOD = 8;
 
-    BlockingDeque<void*> global_work_queue;
+    // Work stealing
+    //
+    // Each worker owns a Chase-Lev deque.  Work scheduled by a worker goes
+    // onto its own deque and is popped LIFO, so a lone worker explores a
+    // fork tree depth-first and bounds the work outstanding.  Work scheduled
+    // from outside the pool (main, collector, I/O threads) goes onto a
+    // mutex-protected injector.  An idle worker tries its own deque, then
+    // the injector, then steals FIFO from victims scanned from a random
+    // start, which takes the oldest (typically largest) subtrees.
+    //
+    // Sleeping uses an event count.  A worker that finds nothing reads the
+    // count, announces itself in `_sleepers`, searches once more, and only
+    // then waits for the count to change.  A scheduler publishes its work,
+    // then checks `_sleepers` and, if nonzero, bumps the count and wakes
+    // one.  The fences on both sides ensure either the scheduler sees the
+    // sleeper or the sleeper's final search sees the work, so wakeups are
+    // not missed, and an idle pool makes no system calls on schedule.
+    //
+    // One wake per schedule throttles ramp-up; a woken thief that leaves
+    // its victim nonempty wakes the next, so a burst fans out in
+    // logarithmically many steps.
+    //
+    // Each of these structures is replicated per priority lane; a search
+    // runs the whole sequence for one lane before moving to the next.  The
+    // injectors are mutex-protected, so a worker checks a per-lane count
+    // before locking one.
 
     namespace {
 
-        // TODO: bump-allocator slab hand-off
-        //
-        // The thread_local `bump::this_thread_state` aborts on its destructor
-        // if it still owns slabs at thread exit (by deliberate design, see
-        // bump_allocator.hpp).  At present a worker thread can finish servicing
-        // and exit while bump-allocated objects it produced are still in use
-        // elsewhere — typically because the work it just ran allocated objects
-        // visible to other threads via the GC heap.
-        //
-        // The proper fix is to hand the slab list off to an owner that keeps
-        // it alive long enough: the garbage collector (which can free a slab
-        // after a handshake confirms no thread holds a pointer into it), or
-        // an arena pool that other threads can pull from.  Until that exists,
-        // we leak: each exiting worker prepends its slab list onto a global
-        // singly-linked list and never frees it.  The leak is bounded by the
-        // number of workers that have ever run.
-        Atomic<bump::Slab*> _orphaned_bump_slabs{};
-
-        void _leak_this_thread_bump_slabs() {
-            bump::Slab* mine = bump::this_thread_state.exchange_head_and_restart(nullptr);
-            if (!mine)
-                return;
-            bump::Slab* tail = mine;
-            while (tail->_next)
-                tail = tail->_next;
-            bump::Slab* expected = _orphaned_bump_slabs.load_relaxed();
+        struct WorkerDeques {
+            WorkStealingQueue<void*> lanes[WORK_PRIORITY_COUNT];
+        };
+
+        BlockingDeque<void*> _injectors[WORK_PRIORITY_COUNT];
+        // Pushed and not yet popped, approximately; see _wake_one_if_sleeping
+        constinit Atomic<std::ptrdiff_t> _injected[WORK_PRIORITY_COUNT] = {};
+
+        // Never freed: a thief may hold a pointer at any time.  A slot
+        // vacated by an exiting worker is handed, deque and all, to the
+        // next worker to register; a worker that finds every slot taken
+        // runs without a deque and schedules through the injectors.
+        constinit Atomic<WorkerDeques*> _deques[GLOBAL_WORK_QUEUE_MAX_WORKERS] = {};
+        constinit Atomic<bool> _deque_is_vacant[GLOBAL_WORK_QUEUE_MAX_WORKERS] = {};
+        constinit Atomic<int> _deque_count = {};
+
+        constinit thread_local WorkerDeques* _Nullable _this_thread_deques = nullptr;
+        constinit thread_local int _this_thread_deque_index = -1;
+        constinit thread_local uint64_t _victim_prng_state = 0x9E3779B97F4A7C15ULL;
+        constinit thread_local WorkPriority _this_thread_priority = WorkPriority::NORMAL;
+        constinit thread_local uint32_t _this_thread_take_count = 0;
+
+        constinit Atomic<uint32_t> _wake_events = {};
+        constinit Atomic<uint32_t> _sleepers = {};
+        constinit Atomic<bool> _is_canceled = {};
+
+        // Route everything through the injector, reproducing the old single
+        // global queue for comparison
+        constinit Atomic<bool> _is_central_only = {};
+        
+        // Fork every subproblem, reproducing fixed fine-grained splitting
+        // for comparison
+        constinit Atomic<bool> _is_eager_forking = {};
+        
+        // Put everything in the NORMAL lane, reproducing the single FIFO
+        // for comparison
+        constinit Atomic<bool> _is_single_lane = {};
+        
+        int _lane_of(WorkPriority priority) {
+            return _is_single_lane.load_relaxed() ? (int)WorkPriority::NORMAL : (int)priority;
+        }
+
+        uint64_t _victim_xorshift64() {
+            uint64_t x = _victim_prng_state;
+            x ^= x << 13;
+            x ^= x >>  7;
+            x ^= x << 17;
+            _victim_prng_state = x;
+            return x;
+        }
+
+        void _wake_one_if_sleeping() {
+            // Pairs with the sleeper's announcement; see above
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (_sleepers.load_relaxed()) {
+                _wake_events.fetch_add_release(1);
+                _wake_events.notify_one();
+            }
+        }
+
+        [[nodiscard]] bool _try_take_lane(void*& item, int lane) {
+            WorkerDeques* self = _this_thread_deques;
+            if (self && self->lanes[lane].try_pop(item))
+                return true;
+            if ((_injected[lane].load_relaxed() > 0) && _injectors[lane].try_pop_back(item)) {
+                _injected[lane].fetch_sub_relaxed(1);
+                return true;
+            }
+            int n = _deque_count.load_acquire();
+            if (n) {
+                int start = (int)(_victim_xorshift64() % (uint64_t)n);
+                for (int i = 0; i != n; ++i) {
+                    WorkerDeques* victim = _deques[(start + i) % n].load_acquire();
+                    if (!victim || (victim == self) || victim->lanes[lane].looks_empty())
+                        continue;
+                    if (victim->lanes[lane].try_steal(item)) {
+                        task_trace(TaskTraceKind::STEAL, item, (uint64_t)((start + i) % n));
+                        if (!victim->lanes[lane].looks_empty())
+                            _wake_one_if_sleeping();
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        [[nodiscard]] bool _try_take(void*& item, WorkPriority& priority) {
+            constexpr int CRITICAL = (int)WorkPriority::CRITICAL;
+            constexpr int NORMAL = (int)WorkPriority::NORMAL;
+            constexpr int BACKGROUND = (int)WorkPriority::BACKGROUND;
+            bool is_background_first = !(++_this_thread_take_count % GLOBAL_WORK_QUEUE_BACKGROUND_PERIOD);
+            const int order[WORK_PRIORITY_COUNT] = {
+                CRITICAL,
+                is_background_first ? BACKGROUND : NORMAL,
+                is_background_first ? NORMAL : BACKGROUND,
+            };
+            for (int lane : order) {
+                if (_try_take_lane(item, lane)) {
+                    priority = (WorkPriority)lane;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Returns nullptr once canceled
+        [[nodiscard]] void* _Nullable _take_or_sleep(WorkPriority& priority) {
+            void* item = nullptr;
+            for (;;) {
+                if (_is_canceled.load_acquire())
+                    return nullptr;
+                if (_try_take(item, priority))
+                    return item;
+                uint32_t ticket = _wake_events.load_acquire();
+                _sleepers.fetch_add_seq_cst(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                bool found = !_is_canceled.load_acquire() && _try_take(item, priority);
+                if (!found && !_is_canceled.load_acquire()) {
+                    task_trace(TaskTraceKind::SLEEP, nullptr);
+                    _wake_events.wait(ticket, Ordering::ACQUIRE);
+                    task_trace(TaskTraceKind::WAKE, nullptr);
+                }
+                _sleepers.fetch_sub_relaxed(1);
+                if (found)
+                    return item;
+            }
+        }
+
+        void _register_this_thread_deque() {
+            // The acquire pairs with the departing owner's release, so its
+            // last push or pop happens before our first
+            int n = _deque_count.load_acquire();
+            for (int index = 0; index != n; ++index) {
+                bool expected = true;
+                if (_deque_is_vacant[index].compare_exchange_strong_acq_rel_relaxed(expected, false)) {
+                    WorkerDeques* deque = _deques[index].load_acquire();
+                    assert(deque);
+                    _this_thread_deques = deque;
+                    _this_thread_deque_index = index;
+                    _victim_prng_state ^= 0xD1B54A32D192ED03ULL * (uint64_t)(index + 1);
+                    return;
+                }
+            }
+            int index = _deque_count.load_relaxed();
+            // Claim the slot before publishing the count; thieves skip a
+            // slot whose pointer is not yet stored
             do {
-                tail->_next = expected;
-            } while (!_orphaned_bump_slabs.compare_exchange_weak_relaxed_relaxed(expected, mine));
+                if (index == GLOBAL_WORK_QUEUE_MAX_WORKERS) {
+                    fprintf(stderr, "global_work_queue: more than %d workers; "
+                            "the excess schedules through the injectors\n",
+                            GLOBAL_WORK_QUEUE_MAX_WORKERS);
+                    return;
+                }
+            } while (!_deque_count.compare_exchange_weak_acq_rel_relaxed(index, index + 1));
+            auto* deque = new WorkerDeques;
+            _deques[index].store_release(deque);
+            _this_thread_deques = deque;
+            _this_thread_deque_index = index;
+            _victim_prng_state ^= 0xD1B54A32D192ED03ULL * (uint64_t)(index + 1);
+        }
+
+        void _deregister_this_thread_deque() {
+            int index = std::exchange(_this_thread_deque_index, -1);
+            _this_thread_deques = nullptr;
+            if (index >= 0)
+                _deque_is_vacant[index].store_release(true);
         }
 
-    } // anonymous namespace
+    } // namespace
+
+    void global_work_queue_cancel() {
+        _is_canceled.store_release(true);
+        for (auto& injector : _injectors)
+            injector.cancel();
+        _wake_events.fetch_add_release(1);
+        _wake_events.notify_all();
+    }
     
-    // Note that while we wake one waiter when adding one work unit, we don't
-    // reserve that work for that waiter; instead another thread might complete
-    // a task and take that work.  This is fine.
+    void global_work_queue_schedule(void* pointer) {
+        global_work_queue_schedule(pointer, _this_thread_priority);
+    }
     
-    // TODO: Work queue
-    //
-    // This placeholder global queue is not particularly performant.  Replace
-    // it with thread local work-stealing queues.
-    //
-    // The global blocking queue has the advantage of simplicity, particularly
-    // for sleeping threads when idle.  Work out how to coordinate sleeping
-    // without missed wakeups when there is no simple global definition of
-    // empty.
-    //
-    // Sketch: after a thread has tried to steal from every queue, increment a
-    // global sleep count.  Set a flag on each queue in turn.  Atomically sleep on
-    // the expected global.  If a worker thread adds to its queue and discovers
-    // the flag set, it increments the global and wakes sleepers?
-    //
-    // We want to fairly slowly throttle the number of threads up and down
-    // rather than waking every single push.  We need some medium-term
-    // estimate of the workload.
+    void global_work_queue_schedule(void* pointer, WorkPriority priority) {
+        assert(pointer);
+        task_trace(TaskTraceKind::SCHEDULE, pointer, (uint64_t)priority);
+        int lane = _lane_of(priority);
+        WorkerDeques* self = _this_thread_deques;
+        if (self && !_is_central_only.load_relaxed()) {
+            self->lanes[lane].push(pointer);
+        } else {
+            _injectors[lane].push_back(pointer);
+            // Before the fence in _wake_one_if_sleeping, so a sleeper's
+            // final search sees either the count or our wake
+            _injected[lane].fetch_add_relaxed(1);
+        }
+        _wake_one_if_sleeping();
+    }
     
-    // TODO: Work queue and fork order
-    //
-    // If we have a single thread and it pops the most recent job, we get
-    // depth-first exploration of trees and a bound on the amount of jobs
-    // waiting.
+    WorkPriority global_work_queue_current_priority() {
+        return _this_thread_priority;
+    }
     
+    WorkPriority global_work_queue_exchange_priority(WorkPriority priority) {
+        return std::exchange(_this_thread_priority, priority);
+    }
+
+    void _global_work_queue_set_central_only(bool flag) {
+        _is_central_only.store_relaxed(flag);
+    }
     
-    void global_work_queue_cancel() {
-        global_work_queue.cancel();
+    std::size_t global_work_queue_sequential_cutoff() {
+        return _is_eager_forking.load_relaxed() ? 0 : GLOBAL_WORK_QUEUE_SEQUENTIAL_CUTOFF;
     }
     
-    void global_work_queue_schedule(void* pointer) {
-        assert(pointer);
-        global_work_queue.push_back(pointer);
+    bool global_work_queue_should_fork(std::size_t estimated_work) {
+        if (_is_eager_forking.load_relaxed())
+            return true;
+        if (estimated_work < GLOBAL_WORK_QUEUE_SEQUENTIAL_CUTOFF)
+            return false;
+        WorkerDeques* self = _this_thread_deques;
+        if (!self)
+            return true;
+        // Lazy splitting: work already on our deque is what a thief would
+        // take, so only expose more once it is gone and somebody is idle
+        return self->lanes[_lane_of(_this_thread_priority)].looks_empty() && _sleepers.load_relaxed();
+    }
+    
+    void _global_work_queue_set_eager_forking(bool flag) {
+        _is_eager_forking.store_relaxed(flag);
+    }
+    
+    void _global_work_queue_set_single_lane(bool flag) {
+        _is_single_lane.store_relaxed(flag);
     }
         
     void global_work_queue_service() {
@@ -105,11 +307,11 @@ namespace wry {
             mutator_pin();
             thread_public_register(str);
             mutator_unpin();
+            task_trace_set_thread_name(str);
         }
-        for (;;) {
-            global_work_queue.wait_not_empty();
-            if (global_work_queue.is_canceled())
-                break;
+        _register_this_thread_deque();
+        WorkPriority priority = WorkPriority::NORMAL;
+        while (void* callback = _take_or_sleep(priority)) {
             // Unpin every few tasks so a continuously-refilled queue cannot
             // hold this pin (and thus wedge the epoch) indefinitely.
             //
@@ -122,22 +324,30 @@ namespace wry {
             // thread_public churn test against the unguarded waitablemap
             // rebuild.
             mutator_pin();
-            void* callback = {};
             int countdown = GLOBAL_WORK_QUEUE_REPIN_CADENCE;
-            while (countdown-- && global_work_queue.try_pop_back(callback)) {
+            do {
                 assert(callback);
+                _this_thread_priority = priority;
+                task_trace(TaskTraceKind::TASK_BEGIN, callback, (uint64_t)priority);
                 (*(void(**)(void*))callback)(callback);
-            }
+                task_trace(TaskTraceKind::TASK_END, callback);
+                callback = nullptr;
+            } while (--countdown && _try_take(callback, priority));
             mutator_unpin();
         }
+        // Any work left in the deque is abandoned with the rest of the
+        // canceled queue; the slot passes to the next worker to register.
+        _deregister_this_thread_deque();
         mutator_pin();
         thread_public_deregister();
         mutator_unpin();
-        // Hand off (i.e. leak) any slabs this thread still owns so that the
-        // bump::State destructor doesn't abort.  See _leak_this_thread_bump_slabs.
-        _leak_this_thread_bump_slabs();
-        // TODO: We can safely free the slabs after a certain number of epochs
-        // have passed.  This is a use case for a "global_work_queue_schedule_after_epoch(epoch, ...)"
+        // Hand off any slabs this thread still owns so that the bump::State
+        // destructor doesn't abort.  Objects it produced may still be in
+        // use elsewhere; the epoch system recycles the slabs into the pool
+        // once no pin can see them.
+        epoch::orphan_this_thread_slabs();
+        epoch::release_this_thread_slot();
+        Coroutine::frame_pool_flush_this_thread();
     }
     
 }
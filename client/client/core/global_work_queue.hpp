@@ -8,6 +8,8 @@
 #ifndef global_work_queue_hpp
 #define global_work_queue_hpp
 
+#include <cstddef>
+
 namespace wry {
     
     // Simple global work queue
@@ -35,14 +37,82 @@ namespace wry {
     // Offset hacking can be used to recover the address of an object the
     // function pointer is not the first member of.
     //
-    // Longer term, the intent is to use thread-sharded work-stealing queues or
-    // some other low-contention strategy.
+    // Workers each own a work-stealing deque; see global_work_queue.cpp.
+    
+    // Priority lanes
+    //
+    // Every worker has a deque per lane and the injector has a queue per
+    // lane.  Work goes into the lane of the task that schedules it, so
+    // forked children and continuations inherit their parent's priority.
+    // Threads outside the pool schedule NORMAL unless a WorkPriorityScope
+    // says otherwise, and a coroutine can move lanes with
+    // Coroutine::SuspendAndScheduleWithPriority.
+    //
+    // A worker serves CRITICAL strictly first: own deque, injector, then
+    // steals.  NORMAL and BACKGROUND are weighted.  One take in
+    // GLOBAL_WORK_QUEUE_BACKGROUND_PERIOD looks at BACKGROUND before
+    // NORMAL, so a busy pool cannot starve a save.  Preemption is
+    // cooperative: a background task that reaches a suspension point
+    // reschedules into its own lane, and the worker then takes any critical
+    // work that arrived meanwhile.
+    
+    enum class WorkPriority : int {
+        CRITICAL,        // the frame's World::step
+        NORMAL,
+        BACKGROUND,      // map builds, saves
+    };
+    
+    constexpr int WORK_PRIORITY_COUNT = 3;
     
     void global_work_queue_schedule(void*);
+    void global_work_queue_schedule(void*, WorkPriority);
+    
+    // The lane this thread schedules into: that of the task it is running
+    [[nodiscard]] WorkPriority global_work_queue_current_priority();
+    [[nodiscard]] WorkPriority global_work_queue_exchange_priority(WorkPriority);
+    
+    // Schedule from this thread at `priority` for the scope's extent, which
+    // must not contain a suspension point
+    struct WorkPriorityScope {
+        WorkPriority _previous;
+        explicit WorkPriorityScope(WorkPriority priority)
+        : _previous(global_work_queue_exchange_priority(priority)) {}
+        WorkPriorityScope(WorkPriorityScope const&) = delete;
+        ~WorkPriorityScope() { (void) global_work_queue_exchange_priority(_previous); }
+        WorkPriorityScope& operator=(WorkPriorityScope const&) = delete;
+    };
     
     void global_work_queue_service();
     void global_work_queue_cancel();
     
+    // Benchmark hook: route all work through the single shared injector
+    // queue, as before work stealing, for comparison.
+    void _global_work_queue_set_central_only(bool);
+    
+    // Granularity
+    //
+    // A parallel algorithm that could either fork a subproblem or just
+    // call it asks `global_work_queue_should_fork` with an estimate of the
+    // subproblem's work in elementary steps (keys visited or modified).
+    // Below the sequential cutoff the fork costs more than it can recover.
+    // Above it, work is split lazily: only when this worker's deque is
+    // empty and another worker is asleep, so a busy pool is not flooded
+    // with tiny tasks.  Callers ask again for each subproblem, so a worker
+    // that falls idle mid-traversal is fed at the next opportunity.
+    //
+    // Work scheduled from outside the pool always forks.
+    
+    [[nodiscard]] std::size_t global_work_queue_sequential_cutoff();
+    [[nodiscard]] bool global_work_queue_should_fork(std::size_t estimated_work);
+    
+    // Benchmark hook: fork everything, as before adaptive granularity, for
+    // comparison.
+    void _global_work_queue_set_eager_forking(bool);
+    
+    // Benchmark hook: put everything in one lane, as before priorities, for
+    // comparison.
+    void _global_work_queue_set_single_lane(bool);
+    
 
 }
 
@@ -7,6 +7,8 @@
 
 #include "kqueue_reactor.hpp"
 
+#if defined(__APPLE__)
+
 namespace wry {
     
     struct kqueue_reactor {
@@ -84,3 +86,5 @@ namespace wry {
 
     
 } // namespace wry
+
+#endif // defined(__APPLE__)
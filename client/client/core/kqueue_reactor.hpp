@@ -8,6 +8,8 @@
 #ifndef kqueue_reactor_hpp
 #define kqueue_reactor_hpp
 
+#if defined(__APPLE__)
+
 #include <sanitizer/tsan_interface.h>
 
 // kqueue
@@ -36,7 +38,7 @@ namespace wry {
     //
     // macOS    : kqueue
     // Windows  : IOCP
-    // Linux    : epoll (io_uring?)
+    // Linux    : epoll; see epoll_reactor.hpp
     // Fallback : select
     
     // kqueue
@@ -96,4 +98,6 @@ namespace wry {
 
 } // namespace wry
 
+#endif // defined(__APPLE__)
+
 #endif /* kqueue_reactor_hpp */
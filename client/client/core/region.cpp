@@ -0,0 +1,142 @@
+//
+//  region.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "region.hpp"
+#include "concurrent_skiplist.hpp"
+
+#include "test.hpp"
+
+namespace wry {
+
+    namespace {
+
+        Region::Chunk* _Nonnull _region_make_chunk(std::size_t capacity,
+                                                   Region::Chunk* _Nullable next) {
+            void* raw = std::aligned_alloc(Region::ALIGNMENT,
+                                           (sizeof(Region::Chunk) + capacity + Region::ALIGNMENT - 1)
+                                           & ~(Region::ALIGNMENT - 1));
+            if (!raw) [[unlikely]] {
+                perror(__PRETTY_FUNCTION__);
+                abort();
+            }
+            Region::Chunk* chunk = static_cast<Region::Chunk*>(raw);
+            chunk->_next = next;
+            chunk->_capacity = capacity;
+            chunk->_used.store_relaxed(0);
+            return chunk;
+        }
+
+    } // namespace
+
+    Region::Region()
+    : _current(_region_make_chunk(FIRST_CHUNK_SIZE, nullptr)) {
+    }
+
+    Region::~Region() {
+        Chunk* chunk = _current.load_relaxed();
+        while (chunk)
+            free(std::exchange(chunk, chunk->_next));
+    }
+
+    void* Region::_allocate_slow(Chunk* exhausted, std::size_t count) {
+        for (;;) {
+            {
+                std::scoped_lock guard{_mutex};
+                Chunk* chunk = _current.load_relaxed();
+                if (chunk == exhausted) {
+                    // We are first to find it full; grow geometrically, and
+                    // give an oversized request a chunk of its own size
+                    std::size_t capacity = std::max(std::min(chunk->_capacity * 2, MAX_CHUNK_SIZE),
+                                                    count);
+                    chunk = _region_make_chunk(capacity, exhausted);
+                    chunk->_used.store_relaxed(count);
+                    _current.store_release(chunk);
+                    return chunk->_begin;
+                }
+                // Somebody else installed a chunk; compete for it
+                exhausted = chunk;
+            }
+            std::size_t offset = exhausted->_used.fetch_add_relaxed(count);
+            if (offset + count <= exhausted->_capacity)
+                return exhausted->_begin + offset;
+        }
+    }
+
+    std::size_t Region::capacity() const {
+        std::size_t n = 0;
+        for (Chunk* chunk = _current.load_acquire(); chunk; chunk = chunk->_next)
+            n += chunk->_capacity;
+        return n;
+    }
+
+    void Region::_garbage_collected_debug() const {
+        printf("%s\n", __PRETTY_FUNCTION__);
+    }
+
+
+    define_test("region") {
+        {
+            // Sequential allocations are adjacent, and oversized ones get
+            // their own chunk
+            Region* region = new Region;
+            auto* a = (unsigned char*) region->allocate(40);
+            auto* b = (unsigned char*) region->allocate(8);
+            assert(b == a + 48);
+            (void) region->allocate(Region::MAX_CHUNK_SIZE * 2);
+            assert(region->capacity() >= Region::MAX_CHUNK_SIZE * 2 + Region::FIRST_CHUNK_SIZE);
+        }
+        {
+            // Concurrent allocations are disjoint
+            Region* region = new Region;
+            constexpr int THREADS = 8;
+            constexpr int N = 1 << 12;
+            std::vector<std::vector<uint64_t*>> results(THREADS);
+            std::vector<std::thread> threads;
+            for (int t = 0; t != THREADS; ++t) {
+                threads.emplace_back([region, &results, t] {
+                    for (int i = 0; i != N; ++i) {
+                        auto* p = (uint64_t*) region->allocate(sizeof(uint64_t) * (1 + (i & 7)));
+                        assert(((uintptr_t)p & (Region::ALIGNMENT - 1)) == 0);
+                        *p = ((uint64_t)t << 32) | (uint64_t)i;
+                        results[t].push_back(p);
+                    }
+                });
+            }
+            for (auto& thread : threads)
+                thread.join();
+            for (int t = 0; t != THREADS; ++t)
+                for (int i = 0; i != N; ++i)
+                    assert(*results[t][i] == (((uint64_t)t << 32) | (uint64_t)i));
+        }
+        {
+            // A skiplist in a region is a skiplist, with its nodes in
+            // insertion order (while they fit in the first chunk)
+            ConcurrentSkiplistSet<int, DefaultKeyService<int>, RegionDiscipline> a;
+            std::set<int> b;
+            const int* previous = nullptr;
+            for (int i = 0; i != 1 << 7; ++i) {
+                int j = rand() & 255;
+                auto [where, inserted] = a.try_emplace(j);
+                if (b.insert(j).second) {
+                    assert(inserted);
+                    assert(!previous || (&*where > previous));
+                    previous = &*where;
+                }
+            }
+            auto c = a.begin();
+            for (int k : b)
+                assert((c != a.end()) && (*c++ == k));
+            assert(c == a.end());
+        }
+        co_return;
+    };
+
+} // namespace wry
@@ -0,0 +1,109 @@
+//
+//  region.hpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#ifndef region_hpp
+#define region_hpp
+
+#include <mutex>
+#include <type_traits>
+
+#include "assert.hpp"
+#include "atomic.hpp"
+#include "garbage_collected.hpp"
+
+namespace wry {
+
+    // A shared arena whose lifetime is that of one garbage collected object
+    // ======================================================================
+    //
+    // Some structures are built by many threads at once and then die all
+    // together with the snapshot that owns them; the per-tick ready set is
+    // the motivating case.  Allocating their nodes individually from the
+    // collector costs an allocation, a report entry and a sweep visit per
+    // node, and scatters the nodes across the heap.
+    //
+    // A Region is a single GarbageCollected object owning a chain of chunks.
+    // Allocation is one fetch_add on the current chunk's cursor, so nodes
+    // are laid out contiguously in allocation order, whichever thread
+    // allocates them.  When the collector deletes the Region, the chunks
+    // are freed in one operation.  Destructors are never run.
+    //
+    // The collector does not trace into a Region; its contents must not
+    // hold the only reference to any garbage collected object.  The owner
+    // keeps the Region alive by scanning it.
+    //
+    // Unlike bump::State, which is thread-local and epoch-recycled, the
+    // cursor is shared; use a Region where locality and a common lifetime
+    // matter more than a contended cache line.
+
+    struct Region : GarbageCollected {
+
+        static constexpr std::size_t ALIGNMENT = 16;
+        static constexpr std::size_t FIRST_CHUNK_SIZE = 16 * 1024;
+        static constexpr std::size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
+        struct Chunk {
+            Chunk* _Nullable _next;        // older chunk
+            std::size_t _capacity;
+            Atomic<std::size_t> _used;     // may overshoot _capacity
+            alignas(ALIGNMENT) unsigned char _begin[] __counted_by(_capacity);
+        };
+
+        Atomic<Chunk*> _current;
+        std::mutex _mutex;                 // serializes chunk installation
+
+        Region();
+        virtual ~Region() override;
+
+        [[nodiscard]] void* _Nonnull allocate(std::size_t count,
+                                              std::size_t alignment = ALIGNMENT) {
+            assert(alignment <= ALIGNMENT);
+            count = (count + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+            Chunk* chunk = _current.load_acquire();
+            std::size_t offset = chunk->_used.fetch_add_relaxed(count);
+            if (offset + count <= chunk->_capacity) [[likely]]
+                return chunk->_begin + offset;
+            return _allocate_slow(chunk, count);
+        }
+
+        [[nodiscard]] void* _Nonnull _allocate_slow(Chunk* _Nonnull exhausted,
+                                                    std::size_t count);
+
+        // Bytes obtained from the system
+        [[nodiscard]] std::size_t capacity() const;
+
+        virtual void _garbage_collected_debug() const override;
+        virtual void _garbage_collected_scan() const override {}
+
+    }; // struct Region
+
+
+    // Discipline for intrusive containers whose nodes live in a Region.  The
+    // container supplies the Region (the skiplist keeps it in its Head), so
+    // the allocator here only forbids individual allocation.
+    struct RegionAllocated {
+
+        static void* _Nonnull operator new(std::size_t, void* _Nonnull ptr) {
+            return ptr;
+        }
+
+    };
+
+    struct RegionDiscipline {
+        using IntrusiveAllocator = RegionAllocated;
+        template<typename T> using Slot = T;
+        template<typename T> using AtomicSlot = Atomic<T>;
+        using InnerDiscipline = RegionDiscipline;
+    };
+
+    template<typename Discipline>
+    inline constexpr bool is_region_discipline_v
+        = std::is_base_of_v<RegionAllocated, typename Discipline::IntrusiveAllocator>;
+
+} // namespace wry
+
+#endif /* region_hpp */
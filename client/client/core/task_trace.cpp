@@ -0,0 +1,410 @@
+//
+//  task_trace.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <utility>
+
+#include "task_trace.hpp"
+
+#include "coroutine.hpp"
+#include "test.hpp"
+
+namespace wry {
+
+    constexpr int TASK_TRACE_MAX_THREADS = 256;
+
+    // Single-writer ring.  The writer announces the index it is about to
+    // overwrite in `_claimed`, fences, writes the slot, and publishes it in
+    // `_head`.  A reader that copies slots and then sees `_claimed` has
+    // moved past them knows they may be torn.  The fields are relaxed
+    // atomics only so that the tolerated race is well-defined.
+    struct TaskTraceRing {
+
+        struct Slot {
+            Atomic<uint64_t> nanoseconds;
+            Atomic<uint64_t> kind;
+            Atomic<const char*> name;
+            Atomic<uint64_t> subject;
+            Atomic<uint64_t> argument;
+        };
+
+        uint32_t _index;
+        Atomic<const char*> _name;     // leaked on rename; readers may hold it
+        Atomic<bool> _is_orphaned;     // its thread has exited
+        Atomic<uint64_t> _floor;       // events below were reset away
+        alignas(64) Atomic<uint64_t> _claimed;
+        Atomic<uint64_t> _head;
+        Slot _slots[TASK_TRACE_CAPACITY];
+
+    }; // struct TaskTraceRing
+
+    constinit Atomic<bool> _task_trace_is_enabled{false};
+
+    namespace {
+
+        // Registered once per thread and never freed: a reader may hold a
+        // pointer at any time.  Once every slot is taken, a new thread
+        // adopts the ring of one that has exited.
+        constinit Atomic<TaskTraceRing*> _rings[TASK_TRACE_MAX_THREADS] = {};
+        constinit Atomic<int> _ring_count = {};
+
+        constinit thread_local TaskTraceRing* _Nullable _this_thread_ring = nullptr;
+        constinit thread_local bool _this_thread_is_exiting = false;
+        constinit thread_local uint64_t _this_thread_span_count = 0;
+
+        // Only touched when a ring is acquired, so that the hooks read
+        // trivially destructible thread_locals
+        struct TaskTraceThreadExit {
+            ~TaskTraceThreadExit() {
+                _this_thread_is_exiting = true;
+                if (TaskTraceRing* ring = std::exchange(_this_thread_ring, nullptr))
+                    ring->_is_orphaned.store_release(true);
+            }
+        };
+
+        constinit thread_local TaskTraceThreadExit _this_thread_exit{};
+
+        uint64_t _task_trace_now() {
+            auto t = std::chrono::steady_clock::now().time_since_epoch();
+            return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(t).count();
+        }
+
+        [[nodiscard]] TaskTraceRing* _Nullable _acquire_ring() {
+            if (_this_thread_is_exiting)
+                return nullptr;
+            TaskTraceRing* ring = nullptr;
+            int index = _ring_count.load_relaxed();
+            while ((index < TASK_TRACE_MAX_THREADS)
+                   && !_ring_count.compare_exchange_weak_acq_rel_relaxed(index, index + 1))
+                ;
+            if (index < TASK_TRACE_MAX_THREADS) {
+                ring = new TaskTraceRing{};
+                ring->_index = (uint32_t)index;
+                _rings[index].store_release(ring);
+            } else {
+                for (int i = 0; i != TASK_TRACE_MAX_THREADS; ++i) {
+                    TaskTraceRing* candidate = _rings[i].load_acquire();
+                    if (candidate && candidate->_is_orphaned.exchange_acquire(false)) {
+                        // The exited thread's events would be misattributed
+                        candidate->_floor.store_release(candidate->_head.load_relaxed());
+                        candidate->_name.store_release(nullptr);
+                        ring = candidate;
+                        break;
+                    }
+                }
+                if (!ring)
+                    return nullptr;            // events from this thread are dropped
+            }
+            (void) &_this_thread_exit;
+            _this_thread_ring = ring;
+            return ring;
+        }
+
+        void _write_json_string(FILE* _Nonnull f, const char* _Nonnull s) {
+            fputc('"', f);
+            for (; *s; ++s) {
+                unsigned char c = (unsigned char)*s;
+                if (c == '"' || c == '\\')
+                    fprintf(f, "\\%c", c);
+                else if (c < 0x20)
+                    fprintf(f, "\\u%04x", c);
+                else
+                    fputc(c, f);
+            }
+            fputc('"', f);
+        }
+
+        void _collect(std::vector<TaskTraceEvent>& events, std::vector<const char*>& names) {
+            int n = std::min(_ring_count.load_acquire(), TASK_TRACE_MAX_THREADS);
+            for (int i = 0; i != n; ++i) {
+                TaskTraceRing* ring = _rings[i].load_acquire();
+                names.push_back(ring ? ring->_name.load_acquire() : nullptr);
+                if (!ring)
+                    continue;
+                uint64_t head = ring->_head.load_acquire();
+                uint64_t first = std::max(ring->_floor.load_acquire(),
+                                          head > TASK_TRACE_CAPACITY ? head - TASK_TRACE_CAPACITY : 0);
+                std::size_t base = events.size();
+                for (uint64_t j = first; j != head; ++j) {
+                    auto& slot = ring->_slots[j % TASK_TRACE_CAPACITY];
+                    events.push_back(TaskTraceEvent{
+                        slot.nanoseconds.load_relaxed(),
+                        (TaskTraceKind)slot.kind.load_relaxed(),
+                        (uint32_t)i,
+                        slot.name.load_relaxed(),
+                        slot.subject.load_relaxed(),
+                        slot.argument.load_relaxed(),
+                    });
+                }
+                // Drop what the writer may have overwritten while we copied
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint64_t claimed = ring->_claimed.load_relaxed();
+                if (claimed > first + TASK_TRACE_CAPACITY) {
+                    std::size_t torn = std::min<uint64_t>(claimed - first - TASK_TRACE_CAPACITY, head - first);
+                    events.erase(events.begin() + (std::ptrdiff_t)base,
+                                 events.begin() + (std::ptrdiff_t)(base + torn));
+                }
+            }
+        }
+
+    } // namespace
+
+    void _task_trace_record(TaskTraceKind kind, uint64_t subject, const char* name, uint64_t argument) {
+        TaskTraceRing* ring = _this_thread_ring;
+        if (!ring) [[unlikely]] {
+            ring = _acquire_ring();
+            if (!ring)
+                return;
+        }
+        uint64_t head = ring->_head.load_relaxed();
+        ring->_claimed.store_relaxed(head + 1);
+        std::atomic_thread_fence(std::memory_order_release);
+        auto& slot = ring->_slots[head % TASK_TRACE_CAPACITY];
+        slot.nanoseconds.store_relaxed(_task_trace_now());
+        slot.kind.store_relaxed((uint64_t)kind);
+        slot.name.store_relaxed(name);
+        slot.subject.store_relaxed(subject);
+        slot.argument.store_relaxed(argument);
+        ring->_head.store_release(head + 1);
+    }
+
+    uint64_t _task_trace_span_begin(const char* name, uint64_t value) {
+        TaskTraceRing* ring = _this_thread_ring;
+        if (!ring && !(ring = _acquire_ring()))
+            return 0;
+        // Unique across threads without contention
+        uint64_t id = ((uint64_t)(ring->_index + 1) << 40) | (++_this_thread_span_count & ((uint64_t{1} << 40) - 1));
+        _task_trace_record(TaskTraceKind::SPAN_BEGIN, id, name, value);
+        return id;
+    }
+
+    void task_trace_start() {
+        _task_trace_is_enabled.store_relaxed(true);
+    }
+
+    void task_trace_stop() {
+        _task_trace_is_enabled.store_relaxed(false);
+    }
+
+    bool task_trace_is_enabled() {
+        return _task_trace_is_enabled.load_relaxed();
+    }
+
+    void task_trace_reset() {
+        int n = std::min(_ring_count.load_acquire(), TASK_TRACE_MAX_THREADS);
+        for (int i = 0; i != n; ++i)
+            if (TaskTraceRing* ring = _rings[i].load_acquire())
+                ring->_floor.store_release(ring->_head.load_acquire());
+    }
+
+    void task_trace_set_thread_name(const char* name) {
+        TaskTraceRing* ring = _this_thread_ring;
+        if (!ring && !(ring = _acquire_ring()))
+            return;
+        ring->_name.store_release(strdup(name));
+    }
+
+    std::vector<TaskTraceEvent> task_trace_snapshot() {
+        std::vector<TaskTraceEvent> events;
+        std::vector<const char*> names;
+        _collect(events, names);
+        return events;
+    }
+
+    std::vector<const char*> task_trace_thread_names() {
+        std::vector<TaskTraceEvent> events;
+        std::vector<const char*> names;
+        _collect(events, names);
+        return names;
+    }
+
+    bool task_trace_write_chrome_json(const char* path) {
+        FILE* f = fopen(path, "w");
+        if (!f)
+            return false;
+        std::vector<TaskTraceEvent> events;
+        std::vector<const char*> names;
+        _collect(events, names);
+        uint64_t origin = UINT64_MAX;
+        for (auto const& e : events)
+            origin = std::min(origin, e.nanoseconds);
+
+        fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        fprintf(f, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"wry\"}}");
+        for (std::size_t i = 0; i != names.size(); ++i) {
+            char fallback[32];
+            snprintf(fallback, sizeof(fallback), "thread %zu", i);
+            fprintf(f, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"name\":\"thread_name\",\"args\":{\"name\":", i);
+            _write_json_string(f, names[i] ? names[i] : fallback);
+            fprintf(f, "}}");
+        }
+
+        // The rings may have lost the beginnings of slices whose ends they
+        // kept; skip those ends so that each thread's slices stay nested
+        std::vector<int> task_depth(names.size());
+        std::vector<bool> is_sleeping(names.size());
+        for (auto const& e : events) {
+            double ts = (double)(e.nanoseconds - origin) * 1e-3;
+            const char* name = e.name ? e.name : "?";
+            fprintf(f, ",\n");
+            switch (e.kind) {
+                case TaskTraceKind::TASK_BEGIN:
+                    ++task_depth[e.thread];
+                    fprintf(f, "{\"ph\":\"B\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"name\":\"task\","
+                            "\"args\":{\"frame\":\"0x%" PRIx64 "\"}},\n", e.thread, ts, e.subject);
+                    fprintf(f, "{\"ph\":\"f\",\"bp\":\"e\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,"
+                            "\"name\":\"schedule\",\"cat\":\"schedule\",\"id\":\"0x%" PRIx64 "\"}",
+                            e.thread, ts, e.subject);
+                    break;
+                case TaskTraceKind::TASK_END:
+                    if (!task_depth[e.thread]) {
+                        fprintf(f, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,"
+                                "\"name\":\"task end (begin lost)\"}", e.thread, ts);
+                        break;
+                    }
+                    --task_depth[e.thread];
+                    fprintf(f, "{\"ph\":\"E\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f}", e.thread, ts);
+                    break;
+                case TaskTraceKind::SCHEDULE:
+                    fprintf(f, "{\"ph\":\"s\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,"
+                            "\"name\":\"schedule\",\"cat\":\"schedule\",\"id\":\"0x%" PRIx64 "\"}",
+                            e.thread, ts, e.subject);
+                    break;
+                case TaskTraceKind::FORK:
+                    fprintf(f, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,"
+                            "\"name\":\"fork\",\"args\":{\"child\":\"0x%" PRIx64 "\"}}",
+                            e.thread, ts, e.subject);
+                    break;
+                case TaskTraceKind::STEAL:
+                    fprintf(f, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,"
+                            "\"name\":\"steal\",\"args\":{\"victim\":%" PRIu64 ",\"frame\":\"0x%" PRIx64 "\"}}",
+                            e.thread, ts, e.argument, e.subject);
+                    break;
+                case TaskTraceKind::SLEEP:
+                    is_sleeping[e.thread] = true;
+                    fprintf(f, "{\"ph\":\"B\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"name\":\"sleep\"}",
+                            e.thread, ts);
+                    break;
+                case TaskTraceKind::WAKE:
+                    if (!is_sleeping[e.thread]) {
+                        fprintf(f, "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,"
+                                "\"name\":\"wake\"}", e.thread, ts);
+                        break;
+                    }
+                    is_sleeping[e.thread] = false;
+                    fprintf(f, "{\"ph\":\"E\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f}", e.thread, ts);
+                    break;
+                case TaskTraceKind::SPAN_BEGIN:
+                    fprintf(f, "{\"ph\":\"b\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"cat\":\"span\","
+                            "\"id\":\"0x%" PRIx64 "\",\"name\":", e.thread, ts, e.subject);
+                    _write_json_string(f, name);
+                    fprintf(f, ",\"args\":{\"value\":%" PRIu64 "}}", e.argument);
+                    break;
+                case TaskTraceKind::SPAN_END:
+                    fprintf(f, "{\"ph\":\"e\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,\"cat\":\"span\","
+                            "\"id\":\"0x%" PRIx64 "\",\"name\":", e.thread, ts, e.subject);
+                    _write_json_string(f, name);
+                    fprintf(f, "}");
+                    break;
+            }
+        }
+        fprintf(f, "\n]}\n");
+        return fclose(f) == 0;
+    }
+
+
+    namespace {
+
+        Coroutine::Future<int64_t> _traced_fib(int n) {
+            if (n < 2)
+                co_return n;
+            TaskTraceSpan span{"traced_fib", (uint64_t)n};
+            int64_t a = 0;
+            Coroutine::Nursery nursery;
+            co_await nursery.fork(a, _traced_fib(n - 1));
+            int64_t b = co_await _traced_fib(n - 2);
+            co_await nursery.join();
+            co_return a + b;
+        }
+
+    } // namespace
+
+    // Every span of a fork/join tree is recorded and matched, even those
+    // that end on another thread, and the dump is well-formed enough to
+    // begin and end as JSON.  Then the cost per event, off and on.
+    define_test("task_trace") {
+        task_trace_reset();
+        task_trace_start();
+        int64_t result = co_await _traced_fib(16);
+        task_trace_stop();
+        assert(result == 987);
+        (void) result;
+
+        // Calls with n >= 2: fib(17) - 1
+        constexpr int SPANS = 1596;
+        std::vector<TaskTraceEvent> events = task_trace_snapshot();
+        std::vector<uint64_t> begun, ended;
+        int forks = 0;
+        int tasks = 0;
+        for (auto const& e : events) {
+            if (e.kind == TaskTraceKind::SPAN_BEGIN && e.name && !strcmp(e.name, "traced_fib"))
+                begun.push_back(e.subject);
+            if (e.kind == TaskTraceKind::SPAN_END && e.name && !strcmp(e.name, "traced_fib"))
+                ended.push_back(e.subject);
+            forks += (e.kind == TaskTraceKind::FORK);
+            tasks += (e.kind == TaskTraceKind::TASK_BEGIN);
+        }
+        assert(begun.size() == SPANS);
+        std::sort(begun.begin(), begun.end());
+        std::sort(ended.begin(), ended.end());
+        assert(begun == ended);
+        assert(std::adjacent_find(begun.begin(), begun.end()) == begun.end());
+        assert(forks >= SPANS);
+        assert(tasks >= 1);
+
+        auto path = std::filesystem::temp_directory_path() / "wry_task_trace.json";
+        bool ok = task_trace_write_chrome_json(path.c_str());
+        assert(ok);
+        (void) ok;
+        {
+            FILE* f = fopen(path.c_str(), "r");
+            assert(f);
+            char first = (char)fgetc(f);
+            fseek(f, -2, SEEK_END);
+            char last = (char)fgetc(f);
+            fclose(f);
+            assert(first == '{' && last == '}');
+            (void) first; (void) last;
+        }
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+
+        constexpr int N = 1 << 20;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i != N; ++i)
+            task_trace(TaskTraceKind::SCHEDULE, &i);
+        auto t1 = std::chrono::steady_clock::now();
+        task_trace_start();
+        for (int i = 0; i != N; ++i)
+            task_trace(TaskTraceKind::SCHEDULE, &i);
+        auto t2 = std::chrono::steady_clock::now();
+        task_trace_stop();
+        task_trace_reset();
+        auto per_event = [](auto dt) {
+            return std::chrono::duration<double, std::nano>(dt).count() / N;
+        };
+        printf("task_trace: %.2fns per event off, %.2fns on\n", per_event(t1 - t0), per_event(t2 - t1));
+        co_return;
+    };
+
+} // namespace wry
@@ -0,0 +1,129 @@
+//
+//  task_trace.hpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#ifndef task_trace_hpp
+#define task_trace_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "atomic.hpp"
+
+namespace wry {
+
+    // Scheduler tracing
+    //
+    // When a tick stalls, were the workers idle, starved, or stuck in one
+    // long serial leaf?  Each thread records what it does into its own ring
+    // of its most recent TASK_TRACE_CAPACITY events:
+    //
+    //   TASK_BEGIN / TASK_END    a worker runs one scheduled callback
+    //   SCHEDULE                 work becomes runnable
+    //   FORK                     a Nursery forks or spawns a child
+    //   STEAL                    a worker takes work from another's deque
+    //   SLEEP / WAKE             a worker blocks for lack of work
+    //   SPAN_BEGIN / SPAN_END    a named span; see TaskTraceSpan
+    //
+    // A ring has a single writer, which publishes each event with a release
+    // store, so recording takes no locks and makes no system calls: one
+    // clock read and a few stores.  A reader copies a ring and then discards
+    // whatever the writer overwrote meanwhile, so the trace can be dumped
+    // while it is still recording.  It is a flight recorder: leave it on,
+    // and dump it when a tick runs long.  When tracing is off, each hook
+    // costs a relaxed load and a branch.
+    //
+    // The dump is Chrome trace event JSON, which Perfetto (ui.perfetto.dev)
+    // and chrome://tracing open directly.  Schedules are drawn as flow
+    // arrows to the task they make runnable, and spans as async slices, so
+    // a span may suspend and end on another thread.
+
+    constexpr std::size_t TASK_TRACE_CAPACITY = 1 << 15;
+
+    enum class TaskTraceKind : uint32_t {
+        TASK_BEGIN,
+        TASK_END,
+        SCHEDULE,
+        FORK,
+        STEAL,
+        SLEEP,
+        WAKE,
+        SPAN_BEGIN,
+        SPAN_END,
+    };
+
+    struct TaskTraceEvent {
+        uint64_t nanoseconds;          // steady_clock
+        TaskTraceKind kind;
+        uint32_t thread;               // index into task_trace_thread_names
+        const char* _Nullable name;    // spans only
+        uint64_t subject;              // task address, or span id
+        uint64_t argument;             // victim index, or span value
+    };
+
+    void task_trace_start();
+    void task_trace_stop();
+    bool task_trace_is_enabled();
+
+    // Discard everything recorded so far
+    void task_trace_reset();
+
+    // Label this thread's events; the name is copied
+    void task_trace_set_thread_name(const char* _Nonnull name);
+
+    // Every event still held, in recording order per thread
+    std::vector<TaskTraceEvent> task_trace_snapshot();
+    std::vector<const char*> task_trace_thread_names();
+
+    // Returns false on I/O failure
+    bool task_trace_write_chrome_json(const char* _Nonnull path);
+
+
+    // Hooks
+
+    extern Atomic<bool> _task_trace_is_enabled;
+
+    void _task_trace_record(TaskTraceKind kind,
+                            uint64_t subject,
+                            const char* _Nullable name,
+                            uint64_t argument);
+
+    [[nodiscard]] uint64_t _task_trace_span_begin(const char* _Nonnull name, uint64_t value);
+
+    inline void task_trace(TaskTraceKind kind, const void* _Nullable subject, uint64_t argument = 0) {
+        if (_task_trace_is_enabled.load_relaxed()) [[unlikely]]
+            _task_trace_record(kind, (uint64_t)(uintptr_t)subject, nullptr, argument);
+    }
+
+    // Named span over a scope, which may contain suspension points.  The
+    // name must outlive the trace (a literal).  `value` is shown with the
+    // span; use it for the size of the work.  A span begun while tracing is
+    // on always records its end.
+    struct TaskTraceSpan {
+
+        uint64_t _id = 0;
+        const char* _Nonnull _name;
+
+        explicit TaskTraceSpan(const char* _Nonnull name, uint64_t value = 0)
+        : _name(name) {
+            if (_task_trace_is_enabled.load_relaxed()) [[unlikely]]
+                _id = _task_trace_span_begin(name, value);
+        }
+
+        TaskTraceSpan(TaskTraceSpan const&) = delete;
+
+        ~TaskTraceSpan() {
+            if (_id) [[unlikely]]
+                _task_trace_record(TaskTraceKind::SPAN_END, _id, _name, 0);
+        }
+
+        TaskTraceSpan& operator=(TaskTraceSpan const&) = delete;
+
+    }; // struct TaskTraceSpan
+
+} // namespace wry
+
+#endif /* task_trace_hpp */
@@ -5,4 +5,121 @@
 //  Created by Antony Searle on 24/11/2024.
 //
 
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #include "work_stealing_queue.hpp"
+
+#include "global_work_queue.hpp"
+#include "persistent_map.hpp"
+#include "test.hpp"
+
+namespace wry {
+
+    // Every item is taken exactly once, whether popped by the owner or
+    // stolen, across buffer growth.
+    define_test("work_stealing_queue") {
+        constexpr int N = 1 << 16;
+        constexpr int THIEVES = 3;
+        WorkStealingQueue<void*> queue{4};
+        std::vector<Atomic<int>> seen(N);
+        Atomic<int> taken{0};
+        Atomic<bool> done{false};
+        auto take = [&](void* item) {
+            seen[(uintptr_t)item - 1].fetch_add_relaxed(1);
+            taken.fetch_add_relaxed(1);
+        };
+        std::vector<std::thread> thieves;
+        for (int t = 0; t != THIEVES; ++t) {
+            thieves.emplace_back([&] {
+                void* item = nullptr;
+                while (!done.load_acquire())
+                    if (queue.try_steal(item))
+                        take(item);
+            });
+        }
+        void* item = nullptr;
+        for (int i = 0; i != N; ++i) {
+            queue.push((void*)(uintptr_t)(i + 1));
+            // Pop about a third, so the owner and thieves contend
+            if ((i % 3 == 0) && queue.try_pop(item))
+                take(item);
+        }
+        while (taken.load_relaxed() != N)
+            if (queue.try_pop(item))
+                take(item);
+        done.store_release(true);
+        for (auto& thief : thieves)
+            thief.join();
+        for (auto& n : seen)
+            assert(n.load_relaxed() == 1);
+        co_return;
+    };
+
+
+    // Fork/join throughput of the work-stealing pool against the single
+    // shared queue it replaced.
+
+    namespace {
+
+        Coroutine::Future<int64_t> _fork_join_fib(int n) {
+            if (n < 2)
+                co_return n;
+            int64_t a = 0;
+            Coroutine::Nursery nursery;
+            co_await nursery.fork(a, _fork_join_fib(n - 1));
+            int64_t b = co_await _fork_join_fib(n - 2);
+            co_await nursery.join();
+            co_return a + b;
+        }
+
+        Coroutine::Future<double> _time_fib(int n) {
+            auto t0 = std::chrono::steady_clock::now();
+            int64_t result = co_await _fork_join_fib(n);
+            auto t1 = std::chrono::steady_clock::now();
+            assert(result == 75025);
+            (void) result;
+            co_return std::chrono::duration<double>(t1 - t0).count();
+        }
+
+        Coroutine::Future<double> _time_rebuild() {
+            using A = PersistentMap<uint64_t, int>::AMT;
+            auto combine = [](const int*, const int& m) -> std::optional<int> {
+                return m;
+            };
+            const A* source = nullptr;
+            for (uint64_t k = 0; k != (1 << 15); ++k)
+                source = A::insert(source, k * 7, (int)k);
+            std::vector<std::pair<uint64_t, int>> mods;
+            for (uint64_t k = 0; k != (1 << 15); k += 3)
+                mods.emplace_back(k * 11, (int)k);
+            auto t0 = std::chrono::steady_clock::now();
+            for (int i = 0; i != 8; ++i)
+                (void) co_await A::coroutine_parallel_rebuild(source, mods, 0, mods.size(), combine);
+            auto t1 = std::chrono::steady_clock::now();
+            co_return std::chrono::duration<double>(t1 - t0).count();
+        }
+
+    } // namespace
+
+    define_test("work_stealing_benchmark") {
+        // Root pin for the rebuild's work tree; see amt_parallel_rebuild
+        auto guard = pin_global_epoch();
+        double fib[2] = {};
+        double rebuild[2] = {};
+        for (int central = 0; central != 2; ++central) {
+            _global_work_queue_set_central_only(central);
+            fib[central] = co_await _time_fib(25);
+            rebuild[central] = co_await _time_rebuild();
+        }
+        _global_work_queue_set_central_only(false);
+        unpin_global_epoch(guard);
+        printf("fork/join fib(25): stealing %.1fms, central %.1fms\n",
+               fib[0] * 1e3, fib[1] * 1e3);
+        printf("amt parallel rebuild x8: stealing %.1fms, central %.1fms\n",
+               rebuild[0] * 1e3, rebuild[1] * 1e3);
+        co_return;
+    };
+
+} // namespace wry
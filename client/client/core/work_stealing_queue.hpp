@@ -10,22 +10,21 @@
 
 #include <cstddef>
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
 
+#include <atomic>
 #include <concepts>
 #include <new>
 #include <bit>
 
 #include "atomic.hpp"
-#include "garbage_collected.hpp"
+#include "concepts.hpp"
 #include "mutex.hpp"
 #include "utility.hpp"
 
 namespace wry {
 
-    // TODO: Replace global_work_queue with thread_local work stealing queues
-
-    constexpr size_t CACHE_LINE_BYTES = 64;
-    
     namespace _blocking_work_stealing_queue {
         
         template<Relocatable T>
@@ -81,140 +80,138 @@ namespace wry {
     
     namespace _lockfree_work_stealing_queue {
                 
+        // Power-of-two ring buffer.  A superseded buffer may still be read by
+        // a thief that loaded it before the swap, so it is kept, linked from
+        // its successor, until the queue is destroyed; geometric growth
+        // bounds the total at twice the live buffer.
         template<AlwaysLockFreeAtomic T>
-        struct CircularWeakArray : GarbageCollected {
+        struct CircularArray {
             
+            CircularArray* _Nullable _previous;
             size_t _mask;
             mutable Atomic<T> _data[];
             
             size_t capacity() const { return _mask + 1; }
             
-            explicit CircularWeakArray(size_t mask) : _mask(mask) {
-                assert(std::has_single_bit(_mask + 1));
-            }
-            
-            static CircularWeakArray* make(size_t capacity) {
-                void* raw = calloc(sizeof(CircularWeakArray) + sizeof(T) * capacity, 1);
-                size_t mask = capacity - 1;
-                return new(raw) CircularWeakArray(mask);
+            static CircularArray* _Nonnull make(size_t capacity, CircularArray* _Nullable previous) {
+                assert(std::has_single_bit(capacity));
+                void* raw = calloc(sizeof(CircularArray) + sizeof(Atomic<T>) * capacity, 1);
+                if (!raw) [[unlikely]] {
+                    perror(__PRETTY_FUNCTION__);
+                    abort();
+                }
+                CircularArray* a = static_cast<CircularArray*>(raw);
+                a->_previous = previous;
+                a->_mask = capacity - 1;
+                return a;
             }
             
-            Atomic<T>& operator[](size_t i) const {
-                return _data[i & _mask];
+            Atomic<T>& operator[](ptrdiff_t i) const {
+                return _data[(size_t)i & _mask];
             }
             
-            virtual void _garbage_collected_scan() const override { /* weak */ }
-            
-        }; // struct CircularWeakArray<AlwaysLockFreeAtomic T>
+        }; // struct CircularArray<AlwaysLockFreeAtomic T>
         
         
+        // Chase-Lev deque: the owner pushes and pops at the bottom (LIFO);
+        // any thread steals from the top (FIFO).  Memory orderings follow
+        // the C11 version of
+        //
         // Nhat Minh Lê, Antoniu Pop, Albert Cohen, Francesco Zappa Nardelli.
         // Correct and Efficient WorkStealing for Weak Memory Models.
         // PPoPP ’13 - Proceedings of the 18th ACM SIGPLAN symposium on
         // Principles and practice of parallel programming, Feb 2013, Shenzhen,
         // China. pp.69-80, ff10.1145/2442516.2442524ff. ffhal-00802885f
+        //
+        // The owner's bottom and the thieves' top live on separate cache
+        // lines.  A steal that loses a race reports failure even though the
+        // deque may be nonempty; callers move on to another victim.
         
         template<AlwaysLockFreeAtomic T>
         struct WorkStealingQueue {
             
-            alignas(CACHE_LINE_BYTES) struct {
-                mutable Atomic<CircularWeakArray<T> const*> _array;
-                mutable Atomic<ptrdiff_t> _bottom;
-                mutable ptrdiff_t _cached_top;
-            };
+            alignas(CACHE_LINE_SIZE) Atomic<ptrdiff_t> _top;
+            alignas(CACHE_LINE_SIZE) Atomic<ptrdiff_t> _bottom;
+            Atomic<CircularArray<T>*> _array;
             
-            alignas(CACHE_LINE_BYTES) struct {
-                mutable Atomic<ptrdiff_t> _top;
-            };
-            
-            explicit WorkStealingQueue(const CircularWeakArray<T>* array)
-            : _array(array)
+            explicit WorkStealingQueue(size_t capacity)
+            : _top(0)
             , _bottom(0)
-            , _cached_top(0)
-            , _top(0) {
+            , _array(CircularArray<T>::make(capacity, nullptr)) {
             }
             
-            explicit WorkStealingQueue(size_t capacity)
-            : WorkStealingQueue(CircularWeakArray<T>::make(capacity)) {
+            WorkStealingQueue()
+            : WorkStealingQueue(64) {
             }
             
-            WorkStealingQueue()
-            : WorkStealingQueue(16) {
+            WorkStealingQueue(const WorkStealingQueue&) = delete;
+            WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+            
+            ~WorkStealingQueue() {
+                CircularArray<T>* a = _array.load_relaxed();
+                while (a)
+                    free(std::exchange(a, a->_previous));
             }
             
-            void push(T item) const {
-                CircularWeakArray<T> const* array = this->_array.load_relaxed();
-                ptrdiff_t bottom = this->_bottom.load_relaxed();
-                ptrdiff_t capacity = array->capacity();
-                assert(bottom - _cached_top <= capacity);
-                if (bottom - _cached_top == capacity) {
-                    // we may be out of space; refresh our knowledge of top
-                    _cached_top = this->_top.load_seq_cst();
-                    assert(bottom - _cached_top <= capacity);
-                    if (bottom - _cached_top == capacity) {
-                        // we are out of space; expand the array
-                        CircularWeakArray<T>* new_array = CircularWeakArray<T>::make(capacity << 1);
-                        for (ptrdiff_t i = _cached_top; i != bottom; ++i)
-                            (*new_array)[i].store_relaxed((*array)[i].load_relaxed());
-                        _array.store_release(new_array);
-                        array = new_array;
-                    }
+            // Owner only
+            void push(T item) {
+                ptrdiff_t bottom = _bottom.load_relaxed();
+                ptrdiff_t top = _top.load_acquire();
+                CircularArray<T>* array = _array.load_relaxed();
+                if (bottom - top > (ptrdiff_t)array->capacity() - 1) [[unlikely]] {
+                    CircularArray<T>* larger = CircularArray<T>::make(array->capacity() << 1, array);
+                    for (ptrdiff_t i = top; i != bottom; ++i)
+                        (*larger)[i].store_relaxed((*array)[i].load_relaxed());
+                    _array.store_release(larger);
+                    array = larger;
                 }
                 (*array)[bottom].store_relaxed(item);
-                _bottom.store_release(bottom + 1);
+                std::atomic_thread_fence(std::memory_order_release);
+                _bottom.store_relaxed(bottom + 1);
             }
             
-            bool try_pop(T& item) const {
-                ptrdiff_t bottom = this->_bottom.load_relaxed();
-                ptrdiff_t new_bottom = bottom - 1;
-                
-                _bottom.store_relaxed(new_bottom);
-                ptrdiff_t _cached_top = _top.load_seq_cst();
-                
-                assert(_cached_top <= bottom);
-                ptrdiff_t new_top = _cached_top + 1;
-                ptrdiff_t new_size = new_bottom - _cached_top;
-                if (new_size < 0) {
-                    // the queue had no items
-                    _bottom.store_relaxed(bottom);
+            // Owner only
+            [[nodiscard]] bool try_pop(T& item) {
+                ptrdiff_t bottom = _bottom.load_relaxed() - 1;
+                CircularArray<T>* array = _array.load_relaxed();
+                _bottom.store_relaxed(bottom);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                ptrdiff_t top = _top.load_relaxed();
+                if (top > bottom) {
+                    // empty
+                    _bottom.store_relaxed(bottom + 1);
                     return false;
                 }
-                CircularWeakArray<T> const* array = this->_array.load_relaxed();
-                // speculative load
-                item = (*array)[new_bottom].load_relaxed();
-                if (new_size > 0) {
-                    // the queue had multiple items
+                item = (*array)[bottom].load_relaxed();
+                if (top != bottom)
                     return true;
-                }
-                assert(new_size == 0);
-                // the queue had one item
-                // we race try_pop_front for the last element
-                bool success = this->_top.compare_exchange_weak_seq_cst_relaxed(_cached_top,
-                                                                                new_top);
-                assert(bottom == new_top);
-                _bottom.store_relaxed(bottom);
-                return success;
+                // The last item; race the thieves for it
+                bool won = _top.compare_exchange_strong_seq_cst_relaxed(top, top + 1);
+                _bottom.store_relaxed(bottom + 1);
+                return won;
             }
             
-            bool try_steal(T& item) const {
-                ptrdiff_t top = _top.load_seq_cst();
+            // Any thread
+            [[nodiscard]] bool try_steal(T& item) {
+                ptrdiff_t top = _top.load_acquire();
+                std::atomic_thread_fence(std::memory_order_seq_cst);
                 ptrdiff_t bottom = _bottom.load_acquire();
                 if (!(top < bottom))
                     return false;
-                CircularWeakArray<T> const* array = _array.load_acquire();
-                // speculative load
+                CircularArray<T>* array = _array.load_acquire();
+                // speculative load, claimed by the CAS
                 item = (*array)[top].load_relaxed();
-                ptrdiff_t new_top = top + 1;
-                // try to claim the right to actually look at item
-                return _top.compare_exchange_weak_seq_cst_relaxed(top,
-                                                                  new_top);
+                return _top.compare_exchange_strong_seq_cst_relaxed(top, top + 1);
             }
             
-            
+            // Racy; a hint for wakeup decisions only
+            [[nodiscard]] bool looks_empty() const {
+                return _bottom.load_relaxed() <= _top.load_relaxed();
+            }
             
         }; // struct WorkStealingQueue<AlwaysLockFreeAtomic T>
         
-    } // namespace _locking_work_stealing_queue
+    } // namespace _lockfree_work_stealing_queue
     
     using _lockfree_work_stealing_queue::WorkStealingQueue;
     
@@ -21,11 +21,14 @@
 #include <synchapi.h>
 #endif // defined(WIN32)
 
-#if defined(LINUX)
+#if defined(__linux__)
+#include <errno.h>
+#include <climits>
+#include <ctime>
 #include <linux/futex.h>
 #include <sys/syscall.h>
 #include <unistd.h>
-#endif // defined(LINUX)
+#endif // defined(__linux__)
 
 #include <atomic>
 
@@ -383,20 +386,72 @@ return __atomic_##operation##_fetch(&value, operand, _WRY_ATOMIC_##order);\
         
 #if defined(__linux__)
         
-        // TODO: This code sketch is untested
+        // The futex word is 32 bits.  A 64-bit atomic waits on its low half
+        // (the first word on little-endian), so a change confined to the high
+        // half does not release a waiter; such types must keep the field that
+        // waiters watch in the low word (epoch::Service::State does).
+        
+        static_assert(std::endian::native == std::endian::little);
         
-        void wait(T& expected, Ordering order) requires(sizeof(T) == 4) noexcept {
-            (void) syscall(SYS_futex, &value, FUTEX_WAIT_PRIVATE, &expected, nullptr, nullptr, 0);
+        long _futex(int op, uint32_t argument, const struct timespec* _Nullable timeout) const noexcept {
+            return syscall(SYS_futex, (uint32_t const*)&value, op, argument, timeout, nullptr, 0);
+        }
+        
+        void wait(T& expected, Ordering order) noexcept requires(sizeof(T) == 4 || sizeof(T) == 8) {
+            uint64_t buffer = {};
+            __builtin_memcpy(&buffer, &expected, sizeof(T));
+            for (;;) {
+                T discovered = std::bit_cast<T>(__atomic_load_n(&value, (int)order));
+                if (__builtin_memcmp(&buffer, &discovered, sizeof(T))) {
+                    expected = discovered;
+                    return;
+                }
+                if (_futex(FUTEX_WAIT_PRIVATE, (uint32_t)buffer, nullptr) < 0) switch (errno) {
+                    case EAGAIN:
+                    case EINTR:
+                        break;
+                    default:
+                        perror(__PRETTY_FUNCTION__);
+                        abort();
+                }
+            }
+        }
+        
+        // The futex timeout is relative; a wakeup that does not change the
+        // value restarts the full timeout, so this may wait longer than
+        // asked (it is not used where that matters).
+        AtomicWaitResult wait_for(T& expected, Ordering order, uint64_t timeout_ns) noexcept requires(sizeof(T) == 4 || sizeof(T) == 8) {
+            uint64_t buffer = {};
+            __builtin_memcpy(&buffer, &expected, sizeof(T));
+            struct timespec timeout = {
+                .tv_sec = (time_t)(timeout_ns / 1'000'000'000),
+                .tv_nsec = (long)(timeout_ns % 1'000'000'000),
+            };
+            for (;;) {
+                T discovered = std::bit_cast<T>(__atomic_load_n(&value, (int)order));
+                if (__builtin_memcmp(&buffer, &discovered, sizeof(T))) {
+                    expected = discovered;
+                    return AtomicWaitResult::NO_TIMEOUT;
+                }
+                if (_futex(FUTEX_WAIT_PRIVATE, (uint32_t)buffer, &timeout) < 0) switch (errno) {
+                    case ETIMEDOUT:
+                        return AtomicWaitResult::TIMEOUT;
+                    case EAGAIN:
+                    case EINTR:
+                        break;
+                    default:
+                        perror(__PRETTY_FUNCTION__);
+                        abort();
+                }
+            }
         }
         
-        void notify_one() requires { sizeof(T) == 4 } noexcept {
-            static_assert(sizeof(T) == 4);
-            (void) syscall(SYS_futex, &value, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+        void notify_one() noexcept requires(sizeof(T) == 4 || sizeof(T) == 8) {
+            (void) _futex(FUTEX_WAKE_PRIVATE, 1, nullptr);
         }
         
-        void notify_all() requires { sizeof(T) == 4 } noexcept {
-            static_assert(sizeof(T) == 4);
-            (void) syscall(SYS_futex, &value, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+        void notify_all() noexcept requires(sizeof(T) == 4 || sizeof(T) == 8) {
+            (void) _futex(FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
         }
         
 #endif // defined(__linux__)
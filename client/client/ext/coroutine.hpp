@@ -15,7 +15,9 @@
 #include <deque>
 #include <exception>
 #include <memory>
+#include <new>
 #include <semaphore>
+#include <type_traits>
 #include <thread>
 
 #include "atomic.hpp"
@@ -25,6 +27,7 @@
 #include "mutex.hpp"
 
 #include "global_work_queue.hpp"
+#include "task_trace.hpp"
 
 namespace wry {
 
@@ -69,9 +72,23 @@ namespace wry::Coroutine {
         }
     };
 
+    // Move the coroutine, and the work it schedules from now on, into the
+    // lane `priority`
+    struct SuspendAndScheduleWithPriority : std::suspend_always {
+        WorkPriority priority;
+        void await_suspend(std::coroutine_handle<> handle) const noexcept {
+            global_work_queue_schedule(handle.address(), priority);
+        }
+    };
+
+    // The thread keeps the coroutine's priority, so the hop back to the pool
+    // lands in the lane it left
     struct SuspendAndScheduleOnTemporaryThread : std::suspend_always {
         void await_suspend(std::coroutine_handle<> handle) const noexcept {
-            std::thread{handle}.detach();
+            std::thread{[handle, priority = global_work_queue_current_priority()] {
+                (void) global_work_queue_exchange_priority(priority);
+                handle.resume();
+            }}.detach();
         }
     };
 
@@ -222,6 +239,122 @@ namespace wry::Coroutine {
 
     // Basic coroutine
     
+    // Coroutine frame pool
+    //
+    // Every Future's frame is allocated when the coroutine is called and
+    // freed at its final suspend, often on another thread; World::step and
+    // the parallel rebuilds make thousands per tick.  The promises draw
+    // frames from per-thread freelists bucketed by 64-byte size class.  A
+    // thread whose list for a class grows past LOCAL_LIMIT returns a batch
+    // to a shared depot; a thread whose list is empty takes a batch from
+    // the depot, or carves a fresh batch from one system allocation.  Frames
+    // freed on a different thread than allocated them thus flow back in
+    // batches, and the fast paths touch only thread-local state.
+    //
+    // Frames above the largest class use the global operator new.  Pooled
+    // memory is retained for the life of the process; a thread's cached
+    // frames return to the depot when it exits.
+    //
+    // WRY_COROUTINE_FRAME_POOL=0 restores the global operator new, for
+    // comparison.
+
+#ifndef WRY_COROUTINE_FRAME_POOL
+#define WRY_COROUTINE_FRAME_POOL 1
+#endif
+
+    namespace _frame_pool {
+
+        inline constexpr std::size_t GRANULE = 64;
+        inline constexpr std::size_t CLASSES = 32;      // frames up to 2 KB
+        inline constexpr std::size_t BATCH = 32;
+        inline constexpr std::size_t LOCAL_LIMIT = 2 * BATCH;
+
+        // Overlays a free frame.  Only the head of a depot batch uses
+        // next_batch and count.
+        struct Block {
+            Block* _Nullable next;
+            Block* _Nullable next_batch;
+            std::size_t count;
+        };
+
+        struct LocalState {
+            Block* _Nullable heads[CLASSES];
+            uint32_t counts[CLASSES];
+            uint64_t allocations;   // folded into the statistics at each refill
+            bool is_drained_at_exit;
+        };
+
+        constinit inline thread_local LocalState local_state = {};
+        static_assert(std::is_trivially_destructible_v<LocalState>);
+
+        [[nodiscard]] void* _Nonnull refill(std::size_t size_class);
+        void spill(std::size_t size_class);
+        [[nodiscard]] void* _Nonnull allocate_large(std::size_t count);
+        void drain_at_exit();
+
+        inline std::size_t size_class_of(std::size_t count) {
+            return (count - 1) / GRANULE;
+        }
+
+        [[nodiscard]] inline void* _Nonnull allocate(std::size_t count) {
+            std::size_t c = size_class_of(count);
+            if (c >= CLASSES) [[unlikely]]
+                return allocate_large(count);
+            LocalState& local = local_state;
+            ++local.allocations;
+            Block* block = local.heads[c];
+            if (!block) [[unlikely]]
+                return refill(c);
+            local.heads[c] = block->next;
+            --local.counts[c];
+            return block;
+        }
+
+        inline void deallocate(void* _Nonnull pointer, std::size_t count) {
+            std::size_t c = size_class_of(count);
+            if (c >= CLASSES) [[unlikely]]
+                return ::operator delete(pointer, count);
+            LocalState& local = local_state;
+            Block* block = static_cast<Block*>(pointer);
+            block->next = local.heads[c];
+            local.heads[c] = block;
+            if (!block->next && !local.is_drained_at_exit) [[unlikely]]
+                drain_at_exit();
+            if (++local.counts[c] > LOCAL_LIMIT) [[unlikely]]
+                spill(c);
+        }
+
+    } // namespace _frame_pool
+
+    struct FramePoolStatistics {
+        uint64_t allocations;        // pooled, as of each thread's last refill
+        uint64_t large_allocations;  // too big to pool
+        uint64_t system_batches;
+        uint64_t system_bytes;
+        uint64_t depot_takes;
+        uint64_t depot_returns;
+        std::size_t depot_blocks;
+    };
+
+    FramePoolStatistics frame_pool_statistics();
+
+    // Return this thread's cached frames to the depot.  Runs at thread exit
+    // for any thread that has cached frames; call it sooner to hand them
+    // back early.
+    void frame_pool_flush_this_thread();
+
+    // Promise base that routes frame allocation through the pool
+    struct PooledFrame {
+#if WRY_COROUTINE_FRAME_POOL
+        static void* _Nonnull operator new(std::size_t count) {
+            return _frame_pool::allocate(count);
+        }
+        static void operator delete(void* _Nonnull pointer, std::size_t count) {
+            _frame_pool::deallocate(pointer, count);
+        }
+#endif
+    };
+
     template<typename...>
     struct Future;
     
@@ -230,7 +363,7 @@ namespace wry::Coroutine {
     template<>
     struct Future<> {
         
-        struct Promise {
+        struct Promise : PooledFrame {
             
             std::coroutine_handle<> _continuation;
                                     
@@ -326,7 +459,7 @@ namespace wry::Coroutine {
     template<typename T>
     struct Future<T> {
         
-        struct Promise {
+        struct Promise : PooledFrame {
             
             std::coroutine_handle<> _continuation{};
             T* _target{};
@@ -471,6 +604,7 @@ namespace wry::Coroutine {
                     ++(_nursery->_children);
                     _future._set_continuation(_nursery);
                     auto result = std::move(_future)._into_handle();
+                    task_trace(TaskTraceKind::FORK, result.address());
                     global_work_queue_schedule(std::move(continuation));
                     return result;
                 }
@@ -493,6 +627,7 @@ namespace wry::Coroutine {
                     _future._set_continuation(_nursery);
                     _future._set_target(_target);
                     auto result = std::move(_future)._into_handle();
+                    task_trace(TaskTraceKind::FORK, result.address());
                     global_work_queue_schedule(std::move(continuation));
                     return result;
                 }
@@ -535,7 +670,9 @@ namespace wry::Coroutine {
         void soon(Future<>&& future) {
             ++_children;
             future._set_continuation(this);
-            global_work_queue_schedule(std::move(future)._into_handle());
+            auto handle = std::move(future)._into_handle();
+            task_trace(TaskTraceKind::FORK, handle.address());
+            global_work_queue_schedule(std::move(handle));
         }
         
         template<typename T>
@@ -543,7 +680,9 @@ namespace wry::Coroutine {
             _children++;
             future._set_continuation(this);
             future._set_target(&target);
-            global_work_queue_schedule(std::move(future)._into_handle());
+            auto handle = std::move(future)._into_handle();
+            task_trace(TaskTraceKind::FORK, handle.address());
+            global_work_queue_schedule(std::move(handle));
         }
                         
     }; // struct Nursery
@@ -8,8 +8,19 @@
 #ifndef mutex_hpp
 #define mutex_hpp
 
+#if defined(__APPLE__)
 #include <os/lock.h>
 #include <os/os_sync_wait_on_address.h>
+#endif // defined(__APPLE__)
+
+#if defined(__linux__)
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // defined(__linux__)
 
 #include <atomic>
 #include <mutex>
@@ -69,19 +80,18 @@ namespace wry {
 #ifdef __linux__
         
         inline void platform_wait_on_address(void* addr, int value) {
-            syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, &value, nullptr, nullptr, 0);
+            syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
         }
         
         inline void platform_wait_on_address_with_timeout(void* addr, int value, uint64_t nanoseconds) {
             struct timespec timeout {
-                tv_sec = (time_t)(nanoseconds / 1000000000),
-                tv_nsec = (decltype(tv_ns))(nanoseconds % 1000000000),
+                .tv_sec = (time_t)(nanoseconds / 1000000000),
+                .tv_nsec = (long)(nanoseconds % 1000000000),
             };
-            syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, &value, &timeout, nullptr, 0);
+            syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, &timeout, nullptr, 0);
         }
-
         
-        inline void platform_wake_by_address_all(void* addr) {
+        inline void platform_wake_by_address_any(void* addr) {
             syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
         }
         
@@ -159,6 +169,11 @@ namespace wry {
                 if (_state.exchange(UNLOCKED, std::memory_order::release) == AWAITED)
                     platform_wake_by_address_any(&_state);
             }
+            
+            bool try_lock() {
+                int expected = UNLOCKED;
+                return _state.compare_exchange_strong(expected, LOCKED, std::memory_order::acquire, std::memory_order::relaxed);
+            }
                         
         };
         
@@ -226,6 +241,10 @@ namespace wry {
     using FastBasicLockable = FastLockable;
 #endif
 
+#ifdef __linux__
+    using FastLockable = _platform_futex_mutex::Mutex;
+    using FastBasicLockable = FastLockable;
+#endif
     
 } // namespace wry
 
@@ -355,19 +355,12 @@ namespace wry {
                 assert(occupant == this->_entity_id);
                 tx->write_entity_id_for_coordinate(_old_location, EntityID{0});
                 {
-                    // location mirrors occupancy: rebuild the released
-                    // cell's set without us (PersistentSet has no erase;
-                    // sets here are tiny), preserving any non-occupying
-                    // residents
+                    // location mirrors occupancy: the released cell's set
+                    // without us, preserving any non-occupying residents
                     WaitSet located;
                     (void) tx->try_read_located_for_coordinate(_old_location, located);
-                    WaitSet without;
-                    EntityID self = this->_entity_id;
-                    located.for_each([&without, self](EntityID id) {
-                        if (id != self)
-                            without.set(id);
-                    });
-                    tx->write_located_for_coordinate(_old_location, without);
+                    located.erase(this->_entity_id);
+                    tx->write_located_for_coordinate(_old_location, located);
                 }
                 new_this->_old_time = _new_time;
                 new_this->_old_location = _new_location;
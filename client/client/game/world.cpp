@@ -5,6 +5,8 @@
 //  Created by Antony Searle on 30/7/2023.
 //
 
+#include "flat_frozen_set.hpp"
+#include "task_trace.hpp"
 #include "transaction.hpp"
 #include "world.hpp"
 
@@ -52,7 +54,7 @@ namespace wry {
                 // constructed, the ready set should be empty
                 assert(_ready.is_empty());
 
-                ConcurrentSkiplistSet<ReadyKey, ReadyKeyCompare, ScanDiscipline> mut_ready;
+                ConcurrentSkiplistSet<ReadyKey, ReadyKeyCompare, RegionDiscipline> mut_ready;
 
                 // Copy the EntityIDs waiting on now to the _ready skiplist
                 waiting_on_now.for_each([this, &mut_ready] (std::pair<Time, EntityID> x) {
@@ -60,7 +62,7 @@ namespace wry {
                     (void) mut_ready.try_emplace(x.second);
                 });
 
-                _ready = FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, ScanDiscipline>(std::move(mut_ready));
+                _ready = FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, RegionDiscipline>(std::move(mut_ready));
 
                 // HACK: _ready is now populated, _waiting_on_time is now pruned
 
@@ -76,23 +78,16 @@ namespace wry {
     // (and one for the head): spawn a child frame for each successor in the
     // tower, top level first (each successor tightens the bound for the
     // levels below it), notify our own entity while the children run, join,
-    // then prefix-sum.  With successors laid out so that a HIGHER level
-    // covers a LATER key interval, the level-i child's subtree is preceded
-    // within this frame by self plus the children at levels below i -- that
-    // is the value written into its `n`.  The frame returns its subtree
-    // total; the head frame's return is the tick's total, which advances the
-    // World's EntityID cursor.
+    // then sum.  The frame returns its subtree total; the head frame's
+    // return is the tick's total, which advances the World's EntityID
+    // cursor.
     //
-    // `n` and `requested` are written exactly once, by the parent frame
-    // (n) and the owning frame (requested), and are complete only once the
-    // notify nursery in step() has joined; try_lookup_cumulant reads them
-    // in the rebuild, on the far side of that barrier.  Two frames never
-    // touch the same field.
-    //
-    // The lookup that consumes `n` adds it for every node it ENTERS on the
-    // way down, so the head needs none.  The head frame is the same code
-    // with a null entity: no self-notify, weight zero.
-    using ReadyNode = _skiplist_detail::Node<ReadyKey, ReadyKeyCompare, ScanDiscipline>;
+    // `requested` is written exactly once, by the owning frame, and is
+    // complete only once the notify nursery in step() has joined; the
+    // prefix sums of `requested` are taken on the far side of that barrier
+    // (see ReadyCumulants).  The head frame is the same code with a null
+    // entity: no self-notify, weight zero.
+    using ReadyNode = _skiplist_detail::Node<ReadyKey, ReadyKeyCompare, RegionDiscipline>;
     using Next = ReadyNode::AtomicSlot<ReadyNode* _Nullable>;
     [[nodiscard]] Coroutine::Future<int64_t> notify_and_accumulate(Next const* _Nonnull self_next,
                                                                    size_t self_levels,
@@ -128,60 +123,52 @@ namespace wry {
         }
         // Wait for results
         co_await nursery.join();
-        // Accumulate
-        for (size_t i = 0; i != self_levels; ++i) {
-            results[i + 1] += results[i];
-        }
-        // Write back if bounds permit
-        bound2 = bound;
-        for (size_t i = self_levels; i--;) {
-            ReadyNode const* child = self_next[i].nonatomic_load();
-            if (child != bound2) {
-                assert(child);
-                child->_key.n = results[i];
-                bound2 = child;
-            }
-        }
         // Kick the total up to the next level
-        co_return results[self_levels];
+        int64_t total = 0;
+        for (size_t i = 0; i != self_levels + 1; ++i)
+            total += results[i];
+        co_return total;
+    }
+
+    // The ready set, flattened once all `requested` are final.  Each rebuild
+    // leaf that commits an entity looks up its requester, so the lookups are
+    // as many as the commits; as a sorted array with an Eytzinger index and
+    // exclusive prefix sums, each is a branch-free descent of a few cache
+    // lines and one load, where the skiplist walk chased a pointer per level
+    // and added a partial sum per node entered.
+    //
+    // The ids are immutable, so the array and its index are built beside
+    // the notify pass, which only writes `requested`; after the join only
+    // the prefix sums remain, and they are taken a block per task.
+    using ReadyCumulants = FlatFrozenSet<ReadyKey, ReadyKeyCompare>;
+
+    // Copies only the ids, so it can run while the notify pass writes
+    // `requested`; `sources[i]` is the skiplist key at sorted index i
+    [[nodiscard]] Coroutine::Task compact_ready_ids(FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, RegionDiscipline> const& ready,
+                                                    ReadyCumulants& cumulants,
+                                                    std::vector<ReadyKey const*>& sources) {
+        TaskTraceSpan span{"World::step compact ready"};
+        std::vector<ReadyKey> ids;
+        for (ReadyKey const& key : ready) {
+            ids.push_back(ReadyKey{key.id});
+            sources.push_back(&key);
+        }
+        cumulants = ReadyCumulants::adopt(std::move(ids));
+        co_return;
     }
 
-    [[nodiscard]] bool try_lookup_cumulant(FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, ScanDiscipline> const& ready,
+    [[nodiscard]] bool try_lookup_cumulant(ReadyCumulants const& ready,
                                            EntityID id,
                                            int64_t& victim) {
-        int64_t n = 0;
-        size_t i = ready._head->_top.load_relaxed() - 1;
-        assert((i + 1) > 0);
-        auto left = ready._head->_next + i;
-        for (;;) {
-            ReadyNode* _Nullable candidate = left->nonatomic_load();
-            if (!candidate || (id < candidate->_key.id)) {
-                // Descend a level
-                if (i == 0) {
-                    // Looked up an EntityID that wasn't ready, such as when
-                    // one Entity creates another
-                    return false;
-                }
-                --i;
-                --left;
-            } else if (candidate->_key.id < id) {
-                // Move right: we enter candidate's interval, so add its
-                // prefix-within-frame; the target lies inside it.
-                left = candidate->_next + i;
-                assert(candidate->_key.n >= 0);
-                n += candidate->_key.n;
-            } else {
-                // Found: we enter the target too, and its n is the last
-                // term -- its own prefix within the frame we reached it
-                // from.  The entered nodes' n telescope to the absolute
-                // exclusive prefix.
-                assert(candidate->_key.n >= 0);
-                n += candidate->_key.n;
-                victim = n;
-                assert(candidate->_key.requested >= 0);
-                return candidate->_key.requested;
-            }
+        size_t i = ready.find_index(id);
+        if (i == ready.size()) {
+            // Looked up an EntityID that wasn't ready, such as when one
+            // Entity creates another
+            return false;
         }
+        victim = ready.prefix(i);
+        assert(ready.weight(i) >= 0);
+        return ready.weight(i);
     }
 
     Coroutine::Future<Root<World*>> World::step() const {
@@ -194,6 +181,8 @@ namespace wry {
         }
 #endif // NDEBUG
 
+        TaskTraceSpan step_span{"World::step", (uint64_t)_time};
+
         TransactionContext context{._world = this};
         
         Time next_time = _time + 1;
@@ -208,7 +197,7 @@ namespace wry {
         // this->_waiting_on_time contains all EntityIDs to notify after this->_time
 
         auto [waiting_on_next_time, next_waiting_on_time] = partition_first(_waiting_on_time, next_time);
-        ConcurrentSkiplistSet<ReadyKey, ReadyKeyCompare, ScanDiscipline> next_ready;
+        ConcurrentSkiplistSet<ReadyKey, ReadyKeyCompare, RegionDiscipline> next_ready;
 
         // Mutable:
         // waiting_on_next_time contains all EntityIDs to notify at next_time
@@ -219,7 +208,10 @@ namespace wry {
         // masked for_each on _waiting_on_time
 
         int64_t entity_id_requests = 0;
+        ReadyCumulants ready_cumulants;
+        std::vector<ReadyKey const*> ready_sources;
         {
+            TaskTraceSpan span{"World::step notify"};
             Coroutine::Nursery nursery;
 
             // For each EntityID ready now, look up the Entity and notify it.
@@ -236,6 +228,9 @@ namespace wry {
                                                         nullptr,   // bound: +infinity
                                                         &context));
 
+            // Lay out the ready ids while their entities are notified
+            co_await nursery.fork(compact_ready_ids(_ready, ready_cumulants, ready_sources));
+
             // For each EntityID ready next_time, copy it into next_ready
             co_await nursery.fork(waiting_on_next_time
                                   .coroutine_parallel_for_each([next_time, &next_ready](std::pair<Time, EntityID> kv) {
@@ -246,6 +241,11 @@ namespace wry {
             co_await nursery.join();
         }
 
+        co_await ready_cumulants.coroutine_parallel_prefix([&ready_sources](size_t i) {
+            return ready_sources[i]->requested;
+        });
+        assert(ready_cumulants.total() == entity_id_requests);
+
         // All transactions are now described and ready to be resolved in
         // parallel.
                     
@@ -424,7 +424,7 @@ namespace wry {
 
 
         auto action_for_entity_for_entity_id
-        = [this, &next_ready]
+        = [this, &next_ready, &ready_cumulants]
         (const std::pair<EntityID, Atomic<const Transaction::Node*>>& kv)
         -> Coroutine::Future<std::pair<ParallelRebuildAction<Entity const*>, ParallelRebuildAction<std::vector<EntityID>>>> {
             
@@ -469,7 +469,7 @@ namespace wry {
                 // unique committer of kv.first, and the successor is not yet
                 // published.
                 int64_t cumulant = 0;
-                if (try_lookup_cumulant(_ready, kv.first, cumulant)) {
+                if (try_lookup_cumulant(ready_cumulants, kv.first, cumulant)) {
                     result.first.value->_free_entity_id = _entity_id_source + cumulant;
                 }
                 {
@@ -522,6 +522,7 @@ namespace wry {
             co_return result;
         };
         
+        TaskTraceSpan rebuild_span{"World::step rebuild"};
         Coroutine::Nursery nursery;
         
         co_await nursery.fork(new_value_for_coordinate,
@@ -559,7 +560,7 @@ namespace wry {
         co_return new World{
             next_time,
             _entity_id_source + entity_id_requests,
-            FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, ScanDiscipline>(std::move(next_ready)),
+            FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, RegionDiscipline>(std::move(next_ready)),
             new_entity_id_for_coordinate,
             new_located_for_coordinate,
             new_entity_for_entity_id,
@@ -35,12 +35,10 @@ namespace wry {
 
     struct ReadyKey {
         EntityID id;
-        mutable int64_t n;
         mutable int64_t requested;
 
         constexpr /* implicit */ ReadyKey(EntityID k)
         : id(k)
-        , n{-1}
         , requested{-1} {            
         }
 
@@ -77,7 +75,11 @@ namespace wry {
         EntityID _entity_id_source;
 
 
-        FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, ScanDiscipline> _ready;
+        // The ready set is built during the previous tick and dies with
+        // this snapshot, so its nodes share one Region: laid out in
+        // insertion order, untraced, and freed together when the collector
+        // deletes the Region.
+        FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, RegionDiscipline> _ready;
 
         // Occupancy vs location (split 2026-07-26):
         //
@@ -122,7 +124,7 @@ namespace wry {
 
         World(Time time,
               EntityID entity_id_source,
-              FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, ScanDiscipline> ready,
+              FrozenSkiplistSet<ReadyKey, ReadyKeyCompare, RegionDiscipline> ready,
               WaitableMap<Coordinate, EntityID> entity_id_for_coordinate,
               WaitableMap<Coordinate, WaitSet> located_for_coordinate,
               WaitableMap<EntityID, const Entity*> entity_for_entity_id,
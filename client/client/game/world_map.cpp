@@ -23,84 +23,157 @@ namespace wry {
         constexpr uint8_t MAP_TERM_SRGB[4]   = { 255,   0, 255, 255 };  // magenta
         constexpr uint8_t MAP_ENTITY_SRGB[4] = { 255, 255, 255, 255 };  // white
 
-        void plot(WorldMap& map, Coordinate xy, const uint8_t (&srgb)[4]) {
-            size_t i = (size_t)(xy.x - WorldMap::X0);
-            size_t j = (size_t)(xy.y - WorldMap::Y0);
-            std::memcpy(map.rgba.data() + (j * WorldMap::EXTENT + i) * 4,
-                        srgb, 4);
+        // Rasterize one block from scratch: transparent, then each layer
+        // over its cells.
+        void world_map_rasterize_block(const World* world, size_t block, uint8_t* rgba) {
+            constexpr int32_t B = WorldMap::BLOCK;
+            int32_t bx = WorldMap::X0 + (int32_t)(block % WorldMap::BLOCKS) * B;
+            int32_t by = WorldMap::Y0 + (int32_t)(block / WorldMap::BLOCKS) * B;
+            std::memset(rgba, 0, WorldMap::BLOCK_BYTES);
+            auto plot = [rgba, bx, by](Coordinate xy, const uint8_t (&srgb)[4]) {
+                size_t i = (size_t)(xy.x - bx);
+                size_t j = (size_t)(xy.y - by);
+                std::memcpy(rgba + (j * B + i) * 4, srgb, 4);
+            };
+            Coordinate lo{bx, by};
+            Coordinate hi{bx + B - 1, by + B - 1};
+            visit_in_region(world->_terrain_for_coordinate, lo, hi,
+                            [&plot](Coordinate xy, Terrain t) {
+                if ((t < 0) || (t >= TERRAIN_KIND_COUNT))
+                    t = TERRAIN_KIND_COUNT - 1;
+                plot(xy, TERRAIN_COLOR_SRGB[t]);
+            });
+            // Sparse layers: any Term on the ground, then any occupying
+            // entity on top (a travelling machine claims both its endpoint
+            // cells, so it shows as a two-pixel blip).
+            visit_in_region(world->_term_for_coordinate, lo, hi,
+                            [&plot](Coordinate xy, Term) {
+                plot(xy, MAP_TERM_SRGB);
+            });
+            visit_in_region(world->_entity_id_for_coordinate, lo, hi,
+                            [&plot](Coordinate xy, EntityID id) {
+                if (id)
+                    plot(xy, MAP_ENTITY_SRGB);
+            });
+        }
+
+        // Mark the blocks under the layer's changed cells
+        template<typename T>
+        void world_map_mark_changed(const WaitableMap<Coordinate, T>& before,
+                                    const WaitableMap<Coordinate, T>& after,
+                                    bool* dirty) {
+            constexpr int32_t B = WorldMap::BLOCK;
+            constexpr int32_t E = WorldMap::EXTENT;
+            visit_changed_in_region(before, after,
+                                    Coordinate{WorldMap::X0, WorldMap::Y0},
+                                    Coordinate{WorldMap::X0 + E - 1, WorldMap::Y0 + E - 1},
+                                    [dirty](Coordinate lo, Coordinate hi) {
+                for (int32_t j = (lo.y - WorldMap::Y0) / B; j <= (hi.y - WorldMap::Y0) / B; ++j)
+                    for (int32_t i = (lo.x - WorldMap::X0) / B; i <= (hi.x - WorldMap::X0) / B; ++i)
+                        dirty[j * WorldMap::BLOCKS + i] = true;
+            });
         }
 
     } // anonymous namespace
 
-    // Not parallel on purpose: this is a ~1 Hz background amenity that
-    // should cost much less than a core, so it runs as one coroutine that
-    // periodically yields back to the pool (each slice is a fraction of a
-    // millisecond of AMT descent).  It runs on pool workers, which are
-    // pinned mutators, so reading the snapshot's GC structure is safe.
+    void WorldMap::merge_earlier(const WorldMap& earlier) {
+        WorldMap merged;
+        size_t i = 0;
+        size_t j = 0;
+        while ((i != blocks.size()) || (j != earlier.blocks.size())) {
+            const WorldMap* source;
+            size_t k;
+            if ((j == earlier.blocks.size())
+                || ((i != blocks.size()) && (blocks[i] <= earlier.blocks[j]))) {
+                if ((j != earlier.blocks.size()) && (blocks[i] == earlier.blocks[j]))
+                    ++j;  // replaced
+                source = this;
+                k = i++;
+            } else {
+                source = &earlier;
+                k = j++;
+            }
+            merged.blocks.push_back(source->blocks[k]);
+            merged.rgba.insert(merged.rgba.end(),
+                               source->block_rgba(k),
+                               source->block_rgba(k) + BLOCK_BYTES);
+        }
+        *this = std::move(merged);
+    }
+
+    // Not parallel on purpose: this is a background amenity that should
+    // cost much less than a core, so it runs as one coroutine that
+    // periodically yields back to the pool.  Incremental: the structural
+    // diff against the last mapped snapshot finds the blocks whose cells
+    // changed, in time proportional to the changes, and only those are
+    // rasterized and handed over.  The first build diffs against nothing,
+    // so it draws every block that has any content.  It runs on pool
+    // workers, which are pinned mutators, so reading the snapshots' GC
+    // structure is safe.
     static Coroutine::Task world_map_build(Root<const World*> snapshot,
                                            std::shared_ptr<WorldMapHandoff> handoff) {
 
-        constexpr int32_t E = WorldMap::EXTENT;
-        constexpr int32_t X0 = WorldMap::X0;
-        constexpr int32_t Y0 = WorldMap::Y0;
-
-        WorldMap* map = new WorldMap;
-        map->rgba.assign((size_t)E * (size_t)E * 4, 0);  // transparent = unmapped
-
         const World* world = &*snapshot;
+        const World* mapped = handoff->mapped._ptr;
 
-        // Base layer: terrain, in horizontal slices with a yield between
-        // each so the build never hogs a worker.
-        constexpr int32_t SLICE_ROWS = 16;
-        for (int32_t j = 0; j != E; j += SLICE_ROWS) {
-            visit_in_region(world->_terrain_for_coordinate,
-                            Coordinate{X0, Y0 + j},
-                            Coordinate{X0 + E - 1, Y0 + j + SLICE_ROWS - 1},
-                            [map](Coordinate xy, Terrain t) {
-                if ((t < 0) || (t >= TERRAIN_KIND_COUNT))
-                    t = TERRAIN_KIND_COUNT - 1;
-                plot(*map, xy, TERRAIN_COLOR_SRGB[t]);
-            });
-            co_await Coroutine::SuspendAndSchedule{};
+        bool dirty[WorldMap::BLOCKS * WorldMap::BLOCKS] = {};
+        if (mapped) {
+            world_map_mark_changed(mapped->_terrain_for_coordinate, world->_terrain_for_coordinate, dirty);
+            world_map_mark_changed(mapped->_term_for_coordinate, world->_term_for_coordinate, dirty);
+            world_map_mark_changed(mapped->_entity_id_for_coordinate, world->_entity_id_for_coordinate, dirty);
+        } else {
+            world_map_mark_changed(WaitableMap<Coordinate, Terrain>{}, world->_terrain_for_coordinate, dirty);
+            world_map_mark_changed(WaitableMap<Coordinate, Term>{}, world->_term_for_coordinate, dirty);
+            world_map_mark_changed(WaitableMap<Coordinate, EntityID>{}, world->_entity_id_for_coordinate, dirty);
+        }
+
+        // Rasterize a row's worth of blocks between yields, so the build
+        // never hogs a worker.
+        WorldMap* map = new WorldMap;
+        for (size_t block = 0; block != (size_t)(WorldMap::BLOCKS * WorldMap::BLOCKS); ++block) {
+            if (!dirty[block])
+                continue;
+            map->blocks.push_back((uint16_t)block);
+            map->rgba.resize(map->blocks.size() * WorldMap::BLOCK_BYTES);
+            world_map_rasterize_block(world, block, map->block_rgba(map->blocks.size() - 1));
+            if (!(map->blocks.size() % WorldMap::BLOCKS))
+                co_await Coroutine::SuspendAndSchedule{};
         }
 
-        // Sparse layers, one visit each: any Term on the ground, then any
-        // occupying entity on top (a travelling machine claims both its
-        // endpoint cells, so it shows as a two-pixel blip).
-        visit_in_region(world->_term_for_coordinate,
-                        Coordinate{X0, Y0}, Coordinate{X0 + E - 1, Y0 + E - 1},
-                        [map](Coordinate xy, Term) {
-            plot(*map, xy, MAP_TERM_SRGB);
-        });
-        co_await Coroutine::SuspendAndSchedule{};
-
-        visit_in_region(world->_entity_id_for_coordinate,
-                        Coordinate{X0, Y0}, Coordinate{X0 + E - 1, Y0 + E - 1},
-                        [map](Coordinate xy, EntityID id) {
-            if (id)
-                plot(*map, xy, MAP_ENTITY_SRGB);
-        });
-
-        // Publish (see WorldMapHandoff for the ordering contract).  A
-        // superseded, never-consumed build is deleted here.
-        WorldMap* superseded = handoff->finished.exchange_release(map);
-        delete superseded;
+        // Publish (see WorldMapHandoff for the ordering contract).  An
+        // update the renderer has not taken yet is merged under this one
+        // rather than dropped, since its blocks may not be redrawn again.
+        if (map->blocks.empty()) {
+            delete map;
+        } else {
+            if (WorldMap* earlier = handoff->finished.exchange_acquire(nullptr)) {
+                map->merge_earlier(*earlier);
+                delete earlier;
+            }
+            WorldMap* superseded = handoff->finished.exchange_release(map);
+            assert(!superseded);
+            (void) superseded;
+        }
+        handoff->mapped = std::move(snapshot);
         handoff->in_flight.store_release(false);
 
-        // Fall off the end: the frame (and the Root snapshot) is destroyed
-        // on a pool worker, which is a mutator, as ~Root requires.
+        // Fall off the end: the frame is destroyed on a pool worker, which
+        // is a mutator, as ~Root requires.
         co_return;
     }
 
     void world_map_build_async(Root<const World*> snapshot,
                                std::shared_ptr<WorldMapHandoff> handoff) {
+        WorkPriorityScope background{WorkPriority::BACKGROUND};
         wait_group_spawn(world_map_build(std::move(snapshot), std::move(handoff)));
     }
 
-    // End-to-end build over a hand-made world: pins the pixel/world
+    // End-to-end builds over a hand-made world: pins the pixel/world
     // orientation contract (row j = world y = Y0 + j), the layer order
     // (entity over term over terrain), rect clipping, the unmapped =
-    // transparent convention, and the in_flight/finished handoff protocol.
+    // transparent convention, the in_flight/finished handoff protocol, and
+    // that later builds publish just the changed blocks, merging any
+    // update the renderer has not yet taken.
     define_test("world_map_build") {
 
         World* w = new World;
@@ -122,26 +195,48 @@ namespace wry {
         w->hack_repair_invariant();
 
         auto handoff = std::make_shared<WorldMapHandoff>();
-        handoff->in_flight.store_relaxed(true);
-        world_map_build_async(Root<const World*>{w}, handoff);
 
         // The builder yields between slices; polling with the same
         // scheduler lets it interleave.  Wall-clock bound, as in the async
         // save test.
-        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
-        while (handoff->in_flight.load_acquire()
-               && (std::chrono::steady_clock::now() < deadline))
-            co_await Coroutine::SuspendAndSchedule{};
-        assert(!handoff->in_flight.load_acquire());
+        auto build = [handoff](const World* snapshot) -> Coroutine::Task {
+            handoff->in_flight.store_relaxed(true);
+            world_map_build_async(Root<const World*>{snapshot}, handoff);
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+            while (handoff->in_flight.load_acquire()
+                   && (std::chrono::steady_clock::now() < deadline))
+                co_await Coroutine::SuspendAndSchedule{};
+            assert(!handoff->in_flight.load_acquire());
+        };
+
+        // The renderer's view: updates applied in order to a transparent
+        // image
+        constexpr int32_t E = WorldMap::EXTENT;
+        constexpr int32_t B = WorldMap::BLOCK;
+        std::vector<uint8_t> image((size_t)E * E * 4, 0);
+        auto apply = [&image](const WorldMap* m) {
+            for (size_t k = 0; k != m->blocks.size(); ++k) {
+                size_t x = (size_t)(m->blocks[k] % WorldMap::BLOCKS) * B;
+                size_t y = (size_t)(m->blocks[k] / WorldMap::BLOCKS) * B;
+                for (size_t j = 0; j != (size_t)B; ++j)
+                    std::memcpy(image.data() + ((y + j) * E + x) * 4,
+                                m->block_rgba(k) + j * B * 4,
+                                B * 4);
+            }
+        };
 
+        co_await build(w);
         WorldMap* m = handoff->take_finished();
         assert(m);
-        assert(m->rgba.size() == (size_t)WorldMap::EXTENT * WorldMap::EXTENT * 4);
+        assert(m->rgba.size() == m->blocks.size() * WorldMap::BLOCK_BYTES);
+        assert(m->blocks.size() < (size_t)(WorldMap::BLOCKS * WorldMap::BLOCKS));
+        apply(m);
+        delete m;
 
-        auto px = [m](int32_t x, int32_t y) -> const uint8_t* {
+        auto px = [&image](int32_t x, int32_t y) -> const uint8_t* {
             size_t i = (size_t)(x - WorldMap::X0);
             size_t j = (size_t)(y - WorldMap::Y0);
-            return m->rgba.data() + (j * WorldMap::EXTENT + i) * 4;
+            return image.data() + (j * E + i) * 4;
         };
         auto is = [](const uint8_t* p, const uint8_t (&c)[4]) {
             return std::memcmp(p, c, 4) == 0;
@@ -157,7 +252,52 @@ namespace wry {
         assert(px(-128, 0)[3] == 0);              // {-129,0} clipped, no wrap
         assert(px(0, 127)[3] == 0);               // {0,128} clipped, no wrap
 
+        // Nothing changed: nothing published
+        co_await build(w);
+        assert(!handoff->take_finished());
+
+        // The entity moves: the next world shares everything else, and the
+        // update is the one block it moved within
+        World* w2 = new World(w->_time,
+                              w->_entity_id_source,
+                              w->_ready,
+                              w->_entity_id_for_coordinate,
+                              w->_located_for_coordinate,
+                              w->_entity_for_entity_id,
+                              w->_term_for_coordinate,
+                              w->_terrain_for_coordinate,
+                              w->_waiting_on_time);
+        EntityID victim = {};
+        w2->_entity_id_for_coordinate.kv.try_erase(Coordinate{6, 1}, victim);
+        w2->_entity_id_for_coordinate.set(Coordinate{7, 1}, EntityID{42});
+        w2->hack_repair_invariant();
+        co_await build(w2);
+
+        // ...and an unconsumed update survives being superseded
+        World* w3 = new World(w2->_time,
+                              w2->_entity_id_source,
+                              w2->_ready,
+                              w2->_entity_id_for_coordinate,
+                              w2->_located_for_coordinate,
+                              w2->_entity_for_entity_id,
+                              w2->_term_for_coordinate,
+                              w2->_terrain_for_coordinate,
+                              w2->_waiting_on_time);
+        w3->_term_for_coordinate.set(Coordinate{-100, 100}, term_make_integer_with(8));
+        w3->hack_repair_invariant();
+        co_await build(w3);
+
+        m = handoff->take_finished();
+        assert(m);
+        assert(m->blocks.size() == 2);
+        apply(m);
         delete m;
+        assert(is(px(6, 1), TERRAIN_COLOR_SRGB[TERRAIN_SAND]));
+        assert(is(px(7, 1), MAP_ENTITY_SRGB));
+        assert(is(px(5, 0), MAP_TERM_SRGB));
+        assert(is(px(-100, 100), MAP_TERM_SRGB));
+        assert(is(px(0, 0), TERRAIN_COLOR_SRGB[TERRAIN_GRASS]));
+
         co_return;
     };
 
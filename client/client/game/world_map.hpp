@@ -16,11 +16,17 @@
 
 namespace wry {
 
-    // A one-pixel-per-tile RGBA8 (sRGB bytes) image of the mapped world
-    // region: terrain as the base layer in the shared TERRAIN_COLOR_SRGB
-    // colors, with the sparse Term and entity-occupancy layers plotted over
-    // it in deliberately un-natural colors.  Unmapped cells (no terrain
-    // generated) stay transparent black.
+    // An update to a one-pixel-per-tile RGBA8 (sRGB bytes) image of the
+    // mapped world region: terrain as the base layer in the shared
+    // TERRAIN_COLOR_SRGB colors, with the sparse Term and entity-occupancy
+    // layers plotted over it in deliberately un-natural colors.  Unmapped
+    // cells (no terrain generated) stay transparent black.
+    //
+    // The image is cut into BLOCK x BLOCK pixel blocks, and an update
+    // carries only the blocks whose world cells changed since the previous
+    // update, so building and uploading it costs in proportion to activity.
+    // Applying every update in order to an all-transparent image yields the
+    // current map.
     //
     // The mapped rect is fixed to the starting terrain region for now;
     // growing it belongs with lazy terrain generation.
@@ -30,16 +36,39 @@ namespace wry {
         static constexpr int32_t X0 = -EXTENT / 2;  // world x of pixel column 0
         static constexpr int32_t Y0 = -EXTENT / 2;  // world y of pixel row 0
 
-        // Row-major, row j = world row y = Y0 + j (so texture v ~ world y
-        // when uploaded rows-in-order).  EXTENT * EXTENT * 4 bytes.
+        static constexpr int32_t BLOCK = 16;        // pixels per block side
+        static constexpr int32_t BLOCKS = EXTENT / BLOCK;  // blocks per side
+        static constexpr size_t BLOCK_BYTES = (size_t)BLOCK * BLOCK * 4;
+
+        // Indices (row * BLOCKS + column) of the blocks this update
+        // replaces, ascending
+        std::vector<uint16_t> blocks;
+
+        // The blocks' pixels, BLOCK_BYTES each in the order of `blocks`;
+        // within a block, row-major with row j = world row y = Y0 + row *
+        // BLOCK + j (so texture v ~ world y when uploaded rows-in-order).
         std::vector<uint8_t> rgba;
 
+        uint8_t* block_rgba(size_t k) {
+            return rgba.data() + k * BLOCK_BYTES;
+        }
+
+        const uint8_t* block_rgba(size_t k) const {
+            return rgba.data() + k * BLOCK_BYTES;
+        }
+
+        // Fold an earlier update, never applied, under this one: its blocks
+        // that this one does not replace join it
+        void merge_earlier(const WorldMap& earlier);
+
     };
 
     // Producer -> consumer handoff between the background build coroutine
     // (thread-pool worker) and the renderer (main thread), shared_ptr-held
     // by both so an in-flight build never dangles across a WorldState
     // teardown (the same lifetime idiom as save_game_async's result cell).
+    // Builds are incremental, so the handoff also carries the builder's
+    // memory of the world it last mapped.
     //
     // Ordering: the builder publishes with finished.exchange_release, the
     // renderer consumes with take_finished's exchange_acquire; that
@@ -53,6 +82,11 @@ namespace wry {
         Atomic<WorldMap*> finished{nullptr};
         Atomic<bool> in_flight{false};
 
+        // Builder only.  The snapshot the last published update brings the
+        // map up to; builds are serialized by in_flight, whose release /
+        // acquire chain also orders successive builders' accesses.
+        Root<const World*> mapped;
+
         // Main thread (renderer).  Caller owns the result.
         WorldMap* take_finished() {
             return finished.exchange_acquire(nullptr);
@@ -70,7 +104,8 @@ namespace wry {
     // walk-a-frozen-snapshot contract as the async save: World::step never
     // mutates, it builds fresh worlds, so the walk reads stable structure
     // while play continues).  Anchored in the process WaitGroup; yields to
-    // the pool between slices of work.
+    // the pool between slices of work.  Publishes the blocks that changed
+    // since handoff->mapped, and only if there are any.
     void world_map_build_async(Root<const World*> snapshot,
                                std::shared_ptr<WorldMapHandoff> handoff);
 
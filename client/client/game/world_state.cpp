@@ -214,10 +214,12 @@ namespace wry {
 
     void WorldState::new_game() {
         install_displayed_world(*this, make_starting_world());
+        _save_journal = std::make_shared<SaveJournal>();
     }
 
     void WorldState::load_from_save(int id) {
         install_displayed_world(*this, load_game(id));
+        _save_journal = std::make_shared<SaveJournal>();
     }
 
     void WorldState::save_current() {
@@ -227,13 +229,14 @@ namespace wry {
         // World::step() never mutates (it builds a fresh World), so the
         // background walk reads a stable snapshot even as play continues, and
         // the Root keeps it (and everything reachable) alive until the save
-        // finishes.
+        // finishes.  The first save of a game writes a checkpoint; later ones
+        // append only what changed since, to the same slot.
         Root<World const*> w;
         if (!_worlds.try_pop_front(w))
             return;
         // The callback runs on a worker thread when the save finishes; post the
         // result for the main-thread pump to surface in the log.
-        save_game_async(w, [this](bool ok) {
+        save_game_journaled(_save_journal, w, [this](bool ok) {
             _gui.post_notification(ok ? "Saved." : "Save failed.");
         });
         _worlds.push_front(std::move(w));
@@ -378,21 +381,27 @@ namespace wry {
         Root<World const*> old_world;
         (void) _worlds.try_pop_front(old_world);
         assert(old_world);
+        // The step is the frame's critical path: its tasks, and everything
+        // they fork, run ahead of the map build and any save.
         Coroutine::Nursery nursery;
-        nursery.soon(_world_to_render, old_world->step());
+        {
+            WorkPriorityScope critical{WorkPriority::CRITICAL};
+            nursery.soon(_world_to_render, old_world->step());
+        }
         sync_wait(nursery.join());
         _worlds.emplace_back(_world_to_render);
         assert(_world_to_render);
 
-        // ~1 Hz: hand a rooted snapshot of the freshly stepped world to the
-        // background map builder.  The load_acquire pairs with the builder's
-        // completion store_release, so the previous build's publication is
-        // visible before we permit the next one; the map may lag the world
-        // by a second or two, by design.
+        // ~4 Hz: hand a rooted snapshot of the freshly stepped world to the
+        // background map builder, which redraws only what changed since the
+        // last snapshot it mapped.  The load_acquire pairs with the
+        // builder's completion store_release, so the previous build's
+        // publication is visible before we permit the next one; the map may
+        // lag the world by a fraction of a second, by design.
         {
             auto now = std::chrono::steady_clock::now();
             if (!_map_handoff->in_flight.load_acquire()
-                && (now - _map_last_start >= std::chrono::seconds(1))) {
+                && (now - _map_last_start >= std::chrono::milliseconds(250))) {
                 _map_last_start = now;
                 _map_handoff->in_flight.store_relaxed(true);
                 world_map_build_async(Root<const World*>{_world_to_render._ptr},
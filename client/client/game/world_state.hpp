@@ -35,6 +35,8 @@
 #include "server.hpp"
 
 namespace wry {
+
+    struct SaveJournal;
     
     struct WorldState {
         
@@ -69,6 +71,11 @@ namespace wry {
         // valid because the Player entry is shared, not rebuilt.
         Player const* _local_player = nullptr;
 
+        // The displayed game's save chain (save.hpp): saves after the first
+        // append deltas.  Replaced, starting a new chain, whenever the
+        // displayed world is.
+        std::shared_ptr<SaveJournal> _save_journal;
+
 
         // debug toggles ('j' / 'p' / 'w')
         bool _show_jacobian = false;
@@ -111,7 +118,7 @@ namespace wry {
         // always traverses what it visually crosses.
         float _map_zoom = 64.0f;
 
-        // World-map pipeline: ~1 Hz background rebuild of the
+        // World-map pipeline: ~4 Hz incremental background update of the
         // one-pixel-per-tile map image, double-buffered into textures on
         // the render side.  shared_ptr so an in-flight build outlives us.
         std::shared_ptr<WorldMapHandoff> _map_handoff =
@@ -178,8 +185,8 @@ namespace wry {
         void new_game();
         void load_from_save(int id);
 
-        // Serialize the displayed world to a new save file.  Synchronous for
-        // now; the world is read non-destructively (popped and re-pushed).
+        // Save the displayed world into _save_journal, in the background; the
+        // world is read non-destructively (popped and re-pushed).
         void save_current();
 
         void _regenerate_uniforms();
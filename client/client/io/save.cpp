@@ -20,6 +20,7 @@
 #include <functional>
 #include <mutex>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include <fcntl.h>
@@ -28,6 +29,7 @@
 #include "coroutine.hpp"
 #include "save.hpp"
 #include "save_format.hpp"
+#include "save_writer.hpp"
 #include "term.hpp"
 #include "test.hpp"
 
@@ -36,6 +38,8 @@ namespace wry {
     namespace {
         constexpr uint32_t SAVE_MAGIC   = 0x57525953;  // 'WRYS'
         constexpr uint32_t SAVE_VERSION = TERM_SAVE_VERSION;
+        constexpr uint32_t JOURNAL_MAGIC = 0x5752594A;  // 'WRYJ'
+        constexpr uint32_t SEGMENT_MAGIC = 0x57525944;  // 'WRYD'
 
         std::filesystem::path saves_dir() {
             // TODO: real per-user save location.  Cwd is fine for sketch.
@@ -50,6 +54,17 @@ namespace wry {
             std::snprintf(buf, sizeof buf, "save_%d.wry", id);
             return saves_dir() / buf;
         }
+
+        // The journal of deltas over save_<id>.wry; see SaveJournal
+        std::filesystem::path journal_path_for_id(int id) {
+            char buf[32];
+            std::snprintf(buf, sizeof buf, "save_%d.wryj", id);
+            return saves_dir() / buf;
+        }
+
+        uint64_t journal_checksum(const uint8_t* data, size_t n) {
+            return save_type_tag_fnv1a(std::string_view((const char*)data, n));
+        }
     }
 
     World* restart_game() {
@@ -59,9 +74,11 @@ namespace wry {
 
     // Serialize the (immutable) world into a byte buffer.  Pure read of the
     // world plus local Saver state, so it is lock-free and safe to run
-    // concurrently -- background saves may overlap.
-    static std::vector<uint8_t> serialize_world(const World* world) {
-        Saver s;
+    // concurrently -- background saves may overlap.  With a sink, the bytes
+    // stream into it as the walk proceeds and the returned buffer is empty.
+    // serialize_world_into leaves the Saver's state (what it reached, and
+    // under which SaveRefs) to the caller, as a journal checkpoint needs.
+    static void serialize_world_into(Saver& s, const World* world) {
         // Reserve space for the file header.  We write the real values once
         // we know the record count.
         s.write_u32(SAVE_MAGIC);
@@ -74,11 +91,45 @@ namespace wry {
 
         // Patch record count.
         uint32_t record_count = s._next_ref - 1;
-        std::memcpy(s._stream.data() + record_count_offset, &record_count, sizeof(uint32_t));
+        s.patch_stream(record_count_offset, &record_count, sizeof(uint32_t));
 
         // Append root ref at the tail.
         s.write_ref(root_ref);
 
+        s.spill_stream();
+    }
+
+    static std::vector<uint8_t> serialize_world(const World* world, SaveSink* sink = nullptr) {
+        Saver s;
+        s._sink = sink;
+        serialize_world_into(s, world);
+        return std::move(s._stream);
+    }
+
+    // Serialize the objects of `world` that the Saver's earlier saves did not
+    // reach as one framed journal segment (see SaveJournal), continuing its
+    // SaveRef numbering
+    static std::vector<uint8_t> serialize_journal_segment(Saver& s, const World* world) {
+        s.write_u32(SEGMENT_MAGIC);
+        size_t payload_bytes_offset = s._stream.size();
+        s.write_u64(0);  // placeholder
+        size_t payload_offset = s._stream.size();
+
+        SaveRef first = s._next_ref;
+        s.write_u32(first);
+        size_t record_count_offset = s._stream.size();
+        s.write_u32(0);  // placeholder
+
+        SaveRef root_ref = s.save_world(world);
+        s.resolve_pending();
+
+        uint32_t record_count = s._next_ref - first;
+        s.patch_stream(record_count_offset, &record_count, sizeof(uint32_t));
+        s.write_ref(root_ref);
+
+        uint64_t payload_bytes = s._stream.size() - payload_offset;
+        s.patch_stream(payload_bytes_offset, &payload_bytes, sizeof(uint64_t));
+        s.write_u64(journal_checksum(s._stream.data() + payload_offset, payload_bytes));
         return std::move(s._stream);
     }
 
@@ -127,32 +178,65 @@ namespace wry {
 #endif
     }
 
+    static std::mutex save_id_mutex;
+
+    // The first id above every existing save.  Call under save_id_mutex,
+    // and publish before releasing it.
+    static int next_save_id() {
+        int next_id = 1;
+        for (auto& entry : std::filesystem::directory_iterator(saves_dir())) {
+            const auto& p = entry.path();
+            if (p.extension() != ".wry") continue;
+            int id = 0;
+            if (std::sscanf(p.filename().string().c_str(), "save_%d.wry", &id) == 1)
+                next_id = std::max(next_id, id + 1);
+        }
+        return next_id;
+    }
+
+    // Atomically rename a flushed and closed temp into the next free save id
+    // (picked here, under a lock, so concurrent saves can't collide).  The
+    // lock covers only the pick and the rename, never a flush.  A journal left
+    // at the id by a deleted chain is removed first, lest it be replayed over
+    // the new save.  Returns the id published, or -1.
+    static int publish_temp_save(const std::filesystem::path& temp_path) {
+        std::scoped_lock guard{save_id_mutex};
+        std::error_code ec;
+        int id = next_save_id();
+        std::filesystem::remove(journal_path_for_id(id), ec);
+        std::filesystem::rename(temp_path, save_path_for_id(id), ec);
+        return ec ? -1 : id;
+    }
+
     // Close the temp -- which also surfaces deferred write errors -- and, only
-    // if every step succeeded, atomically rename it into the next free save id
-    // (picked here, under a lock, so concurrent saves can't collide).  On any
-    // failure the temp is removed and nothing is published: a failed save leaves
-    // no file rather than a corrupt one.  Returns whether a save was published.
-    static bool publish_or_discard(int fd, const std::filesystem::path& temp_path, bool ok) {
+    // if every step succeeded, publish it.  On any failure the temp is removed
+    // and nothing is published: a failed save leaves no file rather than a
+    // corrupt one.  Returns the id published, or -1.
+    static int publish_or_discard_id(int fd, const std::filesystem::path& temp_path, bool ok) {
         ok = (close(fd) == 0) && ok;  // close() always runs; its error counts
-        if (ok) {
-            static std::mutex save_id_mutex;
-            std::scoped_lock guard{save_id_mutex};
-            int next_id = 1;
-            for (auto& entry : std::filesystem::directory_iterator(saves_dir())) {
-                const auto& p = entry.path();
-                if (p.extension() != ".wry") continue;
-                int id = 0;
-                if (std::sscanf(p.filename().string().c_str(), "save_%d.wry", &id) == 1)
-                    next_id = std::max(next_id, id + 1);
-            }
+        int id = ok ? publish_temp_save(temp_path) : -1;
+        if (id < 0) {
             std::error_code ec;
-            std::filesystem::rename(temp_path, save_path_for_id(next_id), ec);
+            std::filesystem::remove(temp_path, ec);
+        }
+        return id;
+    }
+
+    static bool publish_or_discard(int fd, const std::filesystem::path& temp_path, bool ok) {
+        return publish_or_discard_id(fd, temp_path, ok) >= 0;
+    }
+
+    // As publish_or_discard, but over the existing save `id`.  The rename
+    // replaces it atomically, so the slot is never missing or doubled.
+    static bool replace_or_discard(int fd, const std::filesystem::path& temp_path, int id, bool ok) {
+        ok = (close(fd) == 0) && ok;
+        std::error_code ec;
+        if (ok) {
+            std::filesystem::rename(temp_path, save_path_for_id(id), ec);
             ok = !ec;
         }
-        if (!ok) {
-            std::error_code ec;
+        if (!ok)
             std::filesystem::remove(temp_path, ec);
-        }
         return ok;
     }
 
@@ -168,6 +252,78 @@ namespace wry {
         return publish_or_discard(fd, temp, ok);
     }
 
+#if defined(__linux__)
+
+    namespace {
+
+        // Holds a Saver's spilled buffers and patches, so that the walk never
+        // waits on the disk, until they are replayed into a SaveFileWriter
+        struct SaveBuffers : SaveSink {
+
+            std::vector<std::vector<uint8_t>> _buffers;
+            std::vector<SaveFileWriter::Patch> _patches;
+
+            virtual void append(std::vector<uint8_t>&& bytes) override {
+                _buffers.push_back(std::move(bytes));
+            }
+
+            virtual void patch(size_t offset, const void* data, size_t count) override {
+                auto* p = (const uint8_t*)data;
+                _patches.push_back(SaveFileWriter::Patch{offset, std::vector<uint8_t>(p, p + count)});
+            }
+
+            void replay(SaveSink& sink) && {
+                for (auto& bytes : _buffers)
+                    sink.append(std::move(bytes));
+                for (auto const& patch : _patches)
+                    sink.patch(patch.offset, patch.bytes.data(), patch.bytes.size());
+                _buffers.clear();
+                _patches.clear();
+            }
+
+        };
+
+    } // namespace
+
+    // Detached coroutine form of save_game.  Holds the rooted snapshot in its
+    // frame and walks it on a pool worker into spilled buffers, without
+    // touching the disk.  A throwaway thread then pushes the buffers through
+    // a pipelined SaveFileWriter, whose queue may fill and whose final fsync
+    // -> close chain blocks until the data is stable.  The id lock is taken
+    // only once the file is closed, for the pick and the rename, as
+    // publish_or_discard takes it.  When the save finishes, on_done(ok)
+    // reports the result.
+    static Coroutine::Task background_save_coroutine(Root<World const*> snapshot,
+                                                     std::function<void(bool)> on_done) {
+        SaveBuffers buffers;
+        (void) serialize_world(&*snapshot, &buffers);
+
+        // Write on a throwaway thread, then hop BACK to a pool worker:
+        // completing the coroutine destroys the frame and its Root, and
+        // ~Root asserts a mutator thread.
+        co_await Coroutine::SuspendAndScheduleOnTemporaryThread{};
+        bool ok = false;
+        std::filesystem::path temp;
+        int fd = make_temp_save(temp);
+        if (fd >= 0) {
+            SaveFileWriter writer{fd};
+            std::move(buffers).replay(writer);
+            ok = writer.finish() && (publish_temp_save(temp) >= 0);
+            if (!ok) {
+                std::error_code ec;
+                std::filesystem::remove(temp, ec);
+            }
+        }
+        co_await Coroutine::SuspendAndSchedule{};
+
+        if (on_done)
+            on_done(ok);
+
+        co_return;
+    }
+
+#else
+
     // Detached coroutine form of save_game.  Holds the rooted snapshot in its
     // frame and yields (reschedules to the work queue) between the walk and the
     // file write, and between file chunks -- so it never holds a worker's mutator
@@ -221,12 +377,250 @@ namespace wry {
         co_return;
     }
 
+#endif // defined(__linux__)
+
     void save_game_async(Root<World const*> snapshot, std::function<void(bool)> on_done) {
         // Anchor the save in the process-lifetime WaitGroup so a shutdown can't
         // abandon it mid-yield; the coroutine owns the Root snapshot in its frame.
+        // Saves run in the background lane, behind the frame's step.
+        WorkPriorityScope background{WorkPriority::BACKGROUND};
         wait_group_spawn(background_save_coroutine(std::move(snapshot), std::move(on_done)));
     }
 
+    void SaveJournal::_reset() {
+        _id = -1;
+        _seen = SwissTable<const void*, SaveRef>{};
+        _next_ref = 1;
+        _checkpoint_records = 0;
+        _checkpoint_checksum = 0;
+        _checkpoint_bytes = 0;
+        _journal_bytes = 0;
+        _segments = 0;
+        _retained.clear();
+    }
+
+    static bool pwrite_all(int fd, const uint8_t* data, size_t n, size_t offset) {
+        for (size_t off = 0; off < n; ) {
+            ssize_t w = ::pwrite(fd, data + off, n - off, (off_t)(offset + off));
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            off += (size_t)w;
+        }
+        return true;
+    }
+
+    // The journal header names the checkpoint it extends, by record count
+    // and checksum, so a journal outliving its checkpoint is never replayed
+    // over the one that replaced it
+    struct JournalHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t checkpoint_records;
+        uint32_t reserved;
+        uint64_t checkpoint_checksum;
+    };
+
+    // Append a segment to save_<id>.wryj at its committed length `offset`,
+    // creating it (header first) when the offset is zero.  Anything past the
+    // committed length -- a torn earlier append -- is overwritten and cut
+    // off.  Blocks until the segment is on stable storage.  Returns the new
+    // committed length, or 0 on failure.
+    static size_t append_journal_segment(int id,
+                                         size_t offset,
+                                         uint32_t checkpoint_records,
+                                         uint64_t checkpoint_checksum,
+                                         const std::vector<uint8_t>& segment) {
+        int fd = ::open(journal_path_for_id(id).c_str(),
+                        O_WRONLY | O_CREAT | (offset ? 0 : O_TRUNC), 0644);
+        if (fd < 0) return 0;
+        bool ok = true;
+        if (!offset) {
+            JournalHeader header = {
+                JOURNAL_MAGIC, SAVE_VERSION, checkpoint_records, 0, checkpoint_checksum
+            };
+            ok = pwrite_all(fd, (const uint8_t*)&header, sizeof header, 0);
+            offset = sizeof header;
+        }
+        size_t end = offset + segment.size();
+        ok = ok
+            && pwrite_all(fd, segment.data(), segment.size(), offset)
+            && (ftruncate(fd, (off_t)end) == 0)
+            && flush_temp_save(fd);
+        ok = (close(fd) == 0) && ok;
+        return ok ? end : 0;
+    }
+
+    // Detached coroutine behind save_game_journaled.  The walk runs pinned
+    // and unbroken, as it must: it reads the chain's _seen, whose keys are
+    // only sound while the objects they name cannot be collected, and the
+    // snapshot and the save's transients are rooted before the first
+    // suspension.  The blocking append or checkpoint runs on a throwaway
+    // thread, and the chain is updated back on a pool worker.  Then it takes
+    // over any snapshot queued meanwhile.
+    static Coroutine::Task journaled_save_coroutine(std::shared_ptr<SaveJournal> journal,
+                                                    Root<World const*> snapshot,
+                                                    std::vector<std::function<void(bool)>> on_done) {
+        SaveJournal& j = *journal;
+        for (;;) {
+            const World* world = &*snapshot;
+            bool is_checkpoint = j.should_compact();
+            Saver s;
+            std::vector<uint8_t> buffer;
+            if (is_checkpoint) {
+                serialize_world_into(s, world);
+                buffer = std::move(s._stream);
+            } else {
+                s._seen = std::move(j._seen);
+                s._next_ref = j._next_ref;
+                buffer = serialize_journal_segment(s, world);
+            }
+            std::vector<Root<GarbageCollected const*>> retained;
+            retained.emplace_back(world);
+            for (const GarbageCollected* p : s._transients)
+                retained.emplace_back(p);
+
+            int old_id = j._id;
+            int id = -1;
+            size_t journal_bytes = 0;
+            co_await Coroutine::SuspendAndScheduleOnTemporaryThread{};
+            if (is_checkpoint) {
+                std::filesystem::path temp;
+                int fd = make_temp_save(temp);
+                if (fd >= 0) {
+                    bool ok = write_all(fd, buffer.data(), buffer.size()) && flush_temp_save(fd);
+                    if (old_id < 0) {
+                        id = publish_or_discard_id(fd, temp, ok);
+                    } else if (replace_or_discard(fd, temp, old_id, ok)) {
+                        // The new checkpoint subsumes the old chain in its
+                        // slot.  Until the old journal goes, its header
+                        // names the replaced checkpoint, so a crash here
+                        // leaves a journal the loader ignores.
+                        std::error_code ec;
+                        std::filesystem::remove(journal_path_for_id(old_id), ec);
+                        id = old_id;
+                    }
+                }
+            } else {
+                journal_bytes = append_journal_segment(old_id, j._journal_bytes,
+                                                       j._checkpoint_records,
+                                                       j._checkpoint_checksum, buffer);
+                if (journal_bytes)
+                    id = old_id;
+            }
+            co_await Coroutine::SuspendAndSchedule{};
+
+            bool ok = id >= 0;
+            if (!ok) {
+                j._reset();
+            } else if (is_checkpoint) {
+                j._id = id;
+                j._checkpoint_records = s._next_ref - 1;
+                j._checkpoint_checksum = journal_checksum(buffer.data(), buffer.size());
+                j._checkpoint_bytes = buffer.size();
+                j._journal_bytes = 0;
+                j._segments = 0;
+                j._retained = std::move(retained);
+            } else {
+                j._journal_bytes = journal_bytes;
+                ++j._segments;
+                for (auto& root : retained)
+                    j._retained.push_back(std::move(root));
+            }
+            if (ok) {
+                j._seen = std::move(s._seen);
+                j._next_ref = s._next_ref;
+            }
+            retained.clear();
+
+            for (auto& f : on_done)
+                if (f)
+                    f(ok);
+            on_done.clear();
+
+            std::scoped_lock guard{j._mutex};
+            if (!j._queued._ptr) {
+                j._is_saving = false;
+                break;
+            }
+            snapshot = std::move(j._queued);
+            on_done = std::move(j._queued_on_done);
+            j._queued_on_done.clear();
+        }
+        co_return;
+    }
+
+    void save_game_journaled(std::shared_ptr<SaveJournal> journal,
+                             Root<World const*> snapshot,
+                             std::function<void(bool)> on_done) {
+        {
+            std::scoped_lock guard{journal->_mutex};
+            if (journal->_is_saving) {
+                journal->_queued = std::move(snapshot);
+                journal->_queued_on_done.push_back(std::move(on_done));
+                return;
+            }
+            journal->_is_saving = true;
+        }
+        std::vector<std::function<void(bool)>> callbacks;
+        callbacks.push_back(std::move(on_done));
+        WorkPriorityScope background{WorkPriority::BACKGROUND};
+        wait_group_spawn(journaled_save_coroutine(std::move(journal),
+                                                  std::move(snapshot),
+                                                  std::move(callbacks)));
+    }
+
+    // Replay save_<id>.wryj, if any, over its loaded checkpoint, returning
+    // the newest World.  A journal whose header names another checkpoint is
+    // ignored.  Stops at the first segment that is torn, fails its checksum,
+    // or does not follow on; the segments before it stand.
+    static World* replay_journal(Loader& L, int id, World* w,
+                                 const std::vector<uint8_t>& checkpoint) {
+        std::ifstream in(journal_path_for_id(id), std::ios::binary | std::ios::ate);
+        if (!in) return w;
+        std::streamsize sz = in.tellg();
+        in.seekg(0, std::ios::beg);
+        std::vector<uint8_t> buf((size_t)sz);
+        in.read((char*)buf.data(), sz);
+
+        const uint8_t* p = buf.data();
+        const uint8_t* end = p + buf.size();
+        JournalHeader header = {};
+        if ((size_t)(end - p) < sizeof header) return w;
+        std::memcpy(&header, p, sizeof header);
+        p += sizeof header;
+        if ((header.magic != JOURNAL_MAGIC) || (header.version != SAVE_VERSION)
+            || (header.checkpoint_records != L._ptrs.size() - 1)
+            || (header.checkpoint_checksum != journal_checksum(checkpoint.data(), checkpoint.size()))) {
+            fprintf(stderr, "save: journal for save %d does not match it; ignoring the journal\n", id);
+            return w;
+        }
+
+        constexpr size_t FRAMING = sizeof(uint32_t) + 2 * sizeof(uint64_t);
+        while ((size_t)(end - p) >= FRAMING) {
+            uint32_t magic;
+            uint64_t payload_bytes;
+            std::memcpy(&magic, p, sizeof magic);
+            std::memcpy(&payload_bytes, p + sizeof magic, sizeof payload_bytes);
+            if ((magic != SEGMENT_MAGIC) || (payload_bytes > (size_t)(end - p) - FRAMING))
+                break;
+            const uint8_t* payload = p + sizeof magic + sizeof payload_bytes;
+            uint64_t checksum;
+            std::memcpy(&checksum, payload + payload_bytes, sizeof checksum);
+            if (checksum != journal_checksum(payload, payload_bytes))
+                break;
+            L._cursor = payload;
+            L._end = payload + payload_bytes;
+            World* next = L.load_journal_segment();
+            if (!next)
+                break;
+            w = next;
+            p = payload + payload_bytes + sizeof checksum;
+        }
+        return w;
+    }
+
     World* load_game(int id) {
         auto path = save_path_for_id(id);
         std::ifstream in(path, std::ios::binary | std::ios::ate);
@@ -241,6 +635,7 @@ namespace wry {
         L._cursor = buf.data();
         L._end    = buf.data() + buf.size();
         World* w = L.load_world();
+        if (w) w = replay_journal(L, id, w, buf);
         if (w) w->hack_repair_invariant();
         // Version-rejected (or otherwise unreadable) file: empty world, the
         // same fallback as an absent file.
@@ -280,15 +675,16 @@ namespace wry {
 
     void delete_game(int id) {
         std::error_code ec;
+        std::filesystem::remove(journal_path_for_id(id), ec);
         std::filesystem::remove(save_path_for_id(id), ec);
     }
 
     // Read a save file's raw bytes (empty vector if absent).  Used by the tests
     // to identify their own file by exact content rather than by id arithmetic,
     // which races when other tests save concurrently into the shared ./saves.
-    static std::vector<uint8_t> read_save_file(int id) {
+    static std::vector<uint8_t> read_file_bytes(const std::filesystem::path& path) {
         std::vector<uint8_t> b;
-        std::ifstream in(save_path_for_id(id), std::ios::binary | std::ios::ate);
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
         if (in) {
             auto sz = in.tellg();
             in.seekg(0);
@@ -298,6 +694,10 @@ namespace wry {
         return b;
     }
 
+    static std::vector<uint8_t> read_save_file(int id) {
+        return read_file_bytes(save_path_for_id(id));
+    }
+
     // Round-trip through the real save files (save_game writes a numbered
     // .wry, load_game reads it back), exercising the file glue that the
     // in-memory save_format tests do not.  Self-cleaning: the file it
@@ -381,4 +781,264 @@ namespace wry {
         co_return;
     };
 
+    namespace {
+
+        // Save through the journal and wait for the result, as
+        // save_game_async_roundtrip does
+        Coroutine::Future<bool> _save_journaled_and_wait(std::shared_ptr<SaveJournal> journal,
+                                                         World const* world) {
+            auto result = std::make_shared<std::atomic<int>>(-1);
+            auto done = Coroutine::OneShotEvent::make();
+            save_game_journaled(std::move(journal), Root<World const*>(world), [result, done](bool ok) {
+                result->store(ok ? 1 : 0, std::memory_order_relaxed);
+                done->signal();
+            });
+            bool signaled = co_await done->wait_until(std::chrono::steady_clock::now()
+                                                      + std::chrono::seconds(30));
+            co_return signaled && (result->load(std::memory_order_relaxed) == 1);
+        }
+
+        // The next World, with one cell of _term_for_coordinate changed
+        World* _world_with_term(World const* w, Coordinate xy, Term value) {
+            World* next = new World(w->_time, w->_entity_id_source, w->_ready,
+                                    w->_entity_id_for_coordinate, w->_located_for_coordinate,
+                                    w->_entity_for_entity_id, w->_term_for_coordinate,
+                                    w->_terrain_for_coordinate, w->_waiting_on_time);
+            next->_term_for_coordinate.set(xy, value);
+            return next;
+        }
+
+        bool _has_term(World const* w, Coordinate xy, int64_t value) {
+            Term t;
+            return w->_term_for_coordinate.try_get(xy, t) && (t._data == term_make_integer_with(value)._data);
+        }
+
+        std::size_t save_journal_sink = 0;
+
+    } // namespace
+
+    // A chain of checkpoint and deltas round-trips through load_game,
+    // survives a torn append, and compacts in place, ignoring a journal left
+    // over from before; then the cost of a delta against a checkpoint for a
+    // small change to a large World.
+    define_test("save_game_journal_roundtrip") {
+
+        World* w = new World;
+        w->_time = Time{0x10A10A1};
+        for (int32_t i = 0; i != 4096; ++i)
+            w->_term_for_coordinate.set(Coordinate{i & 63, i >> 6}, term_make_integer_with(i));
+        w->hack_repair_invariant();
+        Root<World const*> keep(w);
+
+        auto journal = std::make_shared<SaveJournal>();
+        bool ok = co_await _save_journaled_and_wait(journal, w);
+        assert(ok);
+        int id = journal->_id;
+        assert(id >= 0);
+        assert(!journal->_journal_bytes);
+
+        // A delta carries the changed path, not the World
+        World* w2 = _world_with_term(w, Coordinate{5, 5}, term_make_integer_with(-1));
+        ok = co_await _save_journaled_and_wait(journal, w2);
+        assert(ok);
+        assert(journal->_id == id);
+        assert(journal->_segments == 1);
+        assert(journal->_journal_bytes * 10 < journal->_checkpoint_bytes);
+        {
+            World* v = load_game(id);
+            assert(v->_time == w->_time);
+            assert(_has_term(v, Coordinate{5, 5}, -1));
+            assert(_has_term(v, Coordinate{6, 5}, 6 + 5 * 64));
+        }
+
+        // A torn tail is ignored, then overwritten by the next append
+        {
+            std::ofstream out(journal_path_for_id(id), std::ios::binary | std::ios::app);
+            uint32_t magic = SEGMENT_MAGIC;
+            uint64_t payload_bytes = 1 << 20;
+            out.write((const char*)&magic, sizeof magic);
+            out.write((const char*)&payload_bytes, sizeof payload_bytes);
+        }
+        {
+            World* v = load_game(id);
+            assert(_has_term(v, Coordinate{5, 5}, -1));
+        }
+        World* w3 = _world_with_term(w2, Coordinate{7, 7}, term_make_integer_with(-2));
+        ok = co_await _save_journaled_and_wait(journal, w3);
+        assert(ok);
+        assert(journal->_segments == 2);
+        {
+            World* v = load_game(id);
+            assert(_has_term(v, Coordinate{5, 5}, -1));
+            assert(_has_term(v, Coordinate{7, 7}, -2));
+        }
+
+        // Compaction replaces the checkpoint in its slot and drops the
+        // journal
+        std::vector<uint8_t> old_journal = read_file_bytes(journal_path_for_id(id));
+        assert(!old_journal.empty());
+        journal->_segments = SaveJournal::MAX_SEGMENTS;
+        World* w4 = _world_with_term(w3, Coordinate{9, 9}, term_make_integer_with(-3));
+        ok = co_await _save_journaled_and_wait(journal, w4);
+        assert(ok);
+        assert(journal->_id == id);
+        assert(!journal->_segments);
+        assert(!std::filesystem::exists(journal_path_for_id(id)));
+        {
+            World* v = load_game(id);
+            assert(_has_term(v, Coordinate{7, 7}, -2));
+            assert(_has_term(v, Coordinate{9, 9}, -3));
+        }
+
+        // A crash between the rename and the journal's removal leaves the
+        // old journal beside the new checkpoint; it is not replayed
+        {
+            std::ofstream out(journal_path_for_id(id), std::ios::binary);
+            out.write((const char*)old_journal.data(), (std::streamsize)old_journal.size());
+        }
+        {
+            World* v = load_game(id);
+            assert(_has_term(v, Coordinate{9, 9}, -3));
+        }
+        delete_game(id);
+
+        // Checkpoint and delta of a 2^16-cell World with 64 changed cells
+        {
+            World* big = new World;
+            big->_time = Time{0x10A10A2};
+            for (int32_t i = 0; i != (1 << 16); ++i)
+                big->_term_for_coordinate.set(Coordinate{i & 255, i >> 8}, term_make_integer_with(i));
+            big->hack_repair_invariant();
+            Root<World const*> keep_big(big);
+            World* next = big;
+            for (int32_t i = 0; i != 64; ++i)
+                next = _world_with_term(next, Coordinate{i * 4, i * 4}, term_make_integer_with(-i));
+
+            auto chain = std::make_shared<SaveJournal>();
+            auto t0 = std::chrono::steady_clock::now();
+            ok = co_await _save_journaled_and_wait(chain, big);
+            assert(ok);
+            auto t1 = std::chrono::steady_clock::now();
+            size_t checkpoint_bytes = chain->_checkpoint_bytes;
+            ok = co_await _save_journaled_and_wait(chain, next);
+            assert(ok);
+            auto t2 = std::chrono::steady_clock::now();
+            assert(chain->_segments == 1);
+            save_journal_sink += chain->_journal_bytes;
+            printf("journaled save of a 2^16-cell World, then 64 changed cells\n");
+            printf("%12s %12s %12s %12s\n", "checkpoint B", "delta B", "checkpoint ms", "delta ms");
+            printf("%12zu %12zu %12.2f %12.2f\n", checkpoint_bytes, chain->_journal_bytes,
+                   std::chrono::duration<double, std::milli>(t1 - t0).count(),
+                   std::chrono::duration<double, std::milli>(t2 - t1).count());
+            delete_game(chain->_id);
+        }
+
+        (void) ok;
+        co_return;
+    };
+
+    // Tick latency under a concurrent save and background load, first with
+    // a single lane and then with priority lanes.  A tick is a critical
+    // fork/join tree of short leaves, shaped like World::step.  The load is
+    // one background filler per core, each running short slices separated
+    // by yields, shaped like the map build.  Prints latency percentiles;
+    // the lanes should cut the tail.
+
+    namespace {
+
+        void _spin_for(std::chrono::microseconds duration) {
+            auto until = std::chrono::steady_clock::now() + duration;
+            while (std::chrono::steady_clock::now() < until)
+                ;
+        }
+
+        Coroutine::Task _tick_tree(int depth) {
+            if (!depth) {
+                _spin_for(std::chrono::microseconds(20));
+                co_return;
+            }
+            Coroutine::Nursery nursery;
+            co_await nursery.fork(_tick_tree(depth - 1));
+            co_await _tick_tree(depth - 1);
+            co_await nursery.join();
+        }
+
+        Coroutine::Task _background_filler(const Atomic<bool>* is_done) {
+            while (!is_done->load_relaxed()) {
+                _spin_for(std::chrono::microseconds(200));
+                co_await Coroutine::SuspendAndSchedule{};
+            }
+        }
+
+    } // namespace
+
+    define_test("save_tick_latency") {
+
+        World* w = new World;
+        w->_time = Time{0x7A7E7A7E};
+        for (int32_t i = 0; i != (1 << 16); ++i)
+            w->_term_for_coordinate.set(Coordinate{i & 255, i >> 8}, term_make_integer_with(i));
+        w->hack_repair_invariant();
+        Root<World const*> root(w);
+        std::vector<uint8_t> ref = serialize_world(w);
+
+        constexpr int TICKS = 200;
+        const int fillers = (int)std::max(1u, std::thread::hardware_concurrency());
+        double table[2][4] = {};
+        for (int lanes = 0; lanes != 2; ++lanes) {
+            _global_work_queue_set_single_lane(!lanes);
+
+            auto result = std::make_shared<std::atomic<int>>(-1);
+            auto done = Coroutine::OneShotEvent::make();
+            Atomic<bool> is_done{false};
+            Coroutine::Nursery load;
+            {
+                WorkPriorityScope background{WorkPriority::BACKGROUND};
+                for (int i = 0; i != fillers; ++i)
+                    load.soon(_background_filler(&is_done));
+            }
+            save_game_async(root, [result, done](bool ok) {
+                result->store(ok ? 1 : 0, std::memory_order_relaxed);
+                done->signal();
+            });
+
+            std::vector<double> latencies;
+            co_await Coroutine::SuspendAndScheduleWithPriority{WorkPriority::CRITICAL};
+            for (int tick = 0; tick != TICKS; ++tick) {
+                auto t0 = std::chrono::steady_clock::now();
+                co_await _tick_tree(6);
+                auto t1 = std::chrono::steady_clock::now();
+                latencies.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+            }
+            co_await Coroutine::SuspendAndScheduleWithPriority{WorkPriority::NORMAL};
+
+            is_done.store_relaxed(true);
+            co_await load.join();
+            bool signaled = co_await done->wait_until(std::chrono::steady_clock::now()
+                                                      + std::chrono::seconds(30));
+            assert(signaled);
+            assert(result->load(std::memory_order_relaxed) == 1);
+            (void) signaled;
+
+            std::sort(latencies.begin(), latencies.end());
+            table[lanes][0] = latencies[TICKS / 2];
+            table[lanes][1] = latencies[TICKS * 9 / 10];
+            table[lanes][2] = latencies[TICKS * 99 / 100];
+            table[lanes][3] = latencies.back();
+        }
+        _global_work_queue_set_single_lane(false);
+
+        for (auto& [name, id] : enumerate_games())
+            if (read_save_file(id) == ref)
+                delete_game(id);
+
+        printf("tick latency under save and %d background fillers (ms):\n", fillers);
+        printf("               p50     p90     p99     max\n");
+        for (int lanes = 0; lanes != 2; ++lanes)
+            printf("    %-8s %7.2f %7.2f %7.2f %7.2f\n", lanes ? "lanes" : "single",
+                   table[lanes][0], table[lanes][1], table[lanes][2], table[lanes][3]);
+
+        co_return;
+    };
+
 } // namespace wry
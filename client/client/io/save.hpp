@@ -9,7 +9,11 @@
 #define save_hpp
 
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+#include "save_format.hpp"
 #include "world.hpp"
 
 namespace wry {
@@ -29,6 +33,71 @@ bool save_game(const World* world);
 void save_game_async(Root<World const*> snapshot, std::function<void(bool)> on_done = {});
 void delete_game(int id);
 
+// Incremental saves.  One game's saves form a chain: a checkpoint,
+// save_<id>.wry, written like any save, and an append-only journal,
+// save_<id>.wryj, of the deltas since.  Successive Worlds share all but
+// their changed paths, so a delta walks from the new World and emits only
+// the objects that no earlier save in the chain reached, referring to the
+// rest by their earlier SaveRefs; its cost follows the change, not the
+// World.  load_game replays the journal over the checkpoint.
+//
+// Each delta is appended as one framed segment
+//
+//     [magic u32] [payload_bytes u64] payload [FNV-1a of payload u64]
+//
+// at the journal's committed length, which is then flushed to stable
+// storage.  A crash mid-append leaves a torn tail that fails its checksum;
+// the loader stops at the first invalid segment and the next append
+// overwrites it.
+//
+// The saved objects' addresses key the chain, so the journal keeps every
+// World it saved alive, and with them the versions the deltas superseded.
+// It compacts -- renames a fresh checkpoint over the old one and deletes
+// the journal -- when the journal outgrows half its checkpoint, bounding
+// both that memory and the replay cost, or after MAX_SEGMENTS deltas.  The
+// game keeps its slot.  The journal header names its checkpoint by record
+// count and checksum, so a crash between the rename and the deletion
+// leaves a journal that is ignored.  A new SaveJournal, as after loading,
+// starts with a checkpoint in a new slot.
+struct SaveJournal {
+
+    static constexpr int MAX_SEGMENTS = 256;
+
+    // Saves on one journal run one at a time; a snapshot requested while
+    // one runs waits here, superseding any already waiting
+    std::mutex _mutex;
+    bool _is_saving = false;
+    Root<World const*> _queued;
+    std::vector<std::function<void(bool)>> _queued_on_done;
+
+    // The chain, touched only by the running save
+    int _id = -1;                        // slot of the checkpoint; -1 before it
+    SwissTable<const void*, SaveRef> _seen;
+    SaveRef _next_ref = 1;
+    uint32_t _checkpoint_records = 0;
+    uint64_t _checkpoint_checksum = 0;
+    size_t _checkpoint_bytes = 0;
+    size_t _journal_bytes = 0;           // committed length; 0 if no journal
+    int _segments = 0;
+    std::vector<Root<GarbageCollected const*>> _retained;
+
+    [[nodiscard]] bool should_compact() const {
+        return (_id < 0) || (_segments >= MAX_SEGMENTS) || (_journal_bytes * 2 > _checkpoint_bytes);
+    }
+
+    // Forget the chain; the next save writes a checkpoint
+    void _reset();
+
+};
+
+// Save `snapshot` into the journal's chain as a delta, or as a checkpoint
+// when the policy says to compact.  Returns immediately; on_done(ok) as for
+// save_game_async.  A failed save resets the chain, so the next one writes
+// a checkpoint.
+void save_game_journaled(std::shared_ptr<SaveJournal> journal,
+                         Root<World const*> snapshot,
+                         std::function<void(bool)> on_done = {});
+
 std::vector<std::pair<std::string, int>> enumerate_games();
 
 } // namespace wry::sim
@@ -129,8 +129,10 @@ namespace wry {
 
     SaveRef Saver::visit_entity(const Entity* p) {
         if (!p) return SAVE_REF_NULL;
-        auto it = _seen.find((const void*)p);
-        if (it != _seen.end()) {
+        // One probe both finds and claims; SAVE_REF_NULL is the in-progress
+        // sentinel.  The body may rehash _seen, so the id is stored by key.
+        auto [it, inserted] = _seen.emplace((const void*)p, SAVE_REF_NULL);
+        if (!inserted) {
             if (it->second == SAVE_REF_NULL) {
                 // In-progress; back-edge.  Sketch assumes DAG.
                 record_back_edge(p);
@@ -138,7 +140,6 @@ namespace wry {
             }
             return it->second;
         }
-        _seen[(const void*)p] = SAVE_REF_NULL;  // in-progress sentinel
 
         begin_record(p->_save_type_tag());
         p->_save_body(*this);
@@ -153,15 +154,14 @@ namespace wry {
 
     SaveRef Saver::visit_heap_value(const HeapTerm* p) {
         if (!p) return SAVE_REF_NULL;
-        auto it = _seen.find((const void*)p);
-        if (it != _seen.end()) {
+        auto [it, inserted] = _seen.emplace((const void*)p, SAVE_REF_NULL);
+        if (!inserted) {
             if (it->second == SAVE_REF_NULL) {
                 record_back_edge(p);
                 return SAVE_REF_NULL;
             }
             return it->second;
         }
-        _seen[(const void*)p] = SAVE_REF_NULL;
 
         begin_record(p->_save_type_tag());
         p->_save_body(*this);
@@ -177,12 +177,11 @@ namespace wry {
     template<typename T>
     SaveRef Saver::visit(const T* p) {
         if (!p) return SAVE_REF_NULL;
-        auto it = _seen.find((const void*)p);
-        if (it != _seen.end()) {
+        auto [it, inserted] = _seen.emplace((const void*)p, SAVE_REF_NULL);
+        if (!inserted) {
             assert(it->second != SAVE_REF_NULL && "back-edge in non-polymorphic type unsupported in sketch");
             return it->second;
         }
-        _seen[(const void*)p] = SAVE_REF_NULL;
 
         begin_record(save_type_tag_v<T>);
         emit_body(p, *this);  // ADL or namespace lookup
@@ -328,9 +327,11 @@ namespace wry {
 
         // To save _ready and _waiting_on_time we merge them
         Set t{_waiting_on_time};
-        for (auto [entity_id, _, _2] : _ready)
+        for (auto [entity_id, _] : _ready)
             t.set({_time, entity_id});
         SaveRef waiting_on_time  = s.visit<NodeSet_U128>(t._inner);
+        if (t._inner != _waiting_on_time._inner)
+            s._transients.push_back(t._inner);
 
         // The ki waiter index is semantic state, not a regenerable cache: a
         // waiter registered before the save must still be registered after a
@@ -428,7 +429,7 @@ namespace wry {
             auto it = _seen.find(p.target);
             assert(it != _seen.end() && it->second != SAVE_REF_NULL);
             SaveRef r = it->second;
-            std::memcpy(_stream.data() + p.offset, &r, sizeof(SaveRef));
+            patch_stream(p.offset, &r, sizeof(SaveRef));
         }
         _pending.clear();
     }
@@ -673,8 +674,31 @@ namespace wry {
         }
 
         _ptrs.assign(count + 1, nullptr);  // +1 because IDs are 1-based
+        _load_records(1, count);
 
-        for (uint32_t id = 1; id <= count; ++id) {
+        SaveRef root_ref = read_u32();
+        resolve_fixups();
+        return (World*)_ptrs[root_ref];
+    }
+
+    World* Loader::load_journal_segment() {
+        SaveRef first = read_u32();
+        uint32_t count = read_u32();
+        if (first != _ptrs.size()) {
+            fprintf(stderr, "save: journal segment starts at record %u, expected %zu; refusing to load\n",
+                    first, _ptrs.size());
+            return nullptr;
+        }
+        _ptrs.resize((size_t)first + count, nullptr);
+        _load_records(first, count);
+
+        SaveRef root_ref = read_u32();
+        resolve_fixups();
+        return (World*)_ptrs[root_ref];
+    }
+
+    void Loader::_load_records(SaveRef first, uint32_t count) {
+        for (SaveRef id = first; id != first + count; ++id) {
             uint64_t tag = read_varint();
             uint32_t body_len = read_u32();
             const uint8_t* body_start = _cursor;
@@ -691,10 +715,6 @@ namespace wry {
             // Sanity: the load_into should have consumed exactly body_len bytes.
             assert(_cursor == body_start + body_len);
         }
-
-        SaveRef root_ref = read_u32();
-        resolve_fixups();
-        return (World*)_ptrs[root_ref];
     }
 
     void Loader::resolve_fixups() {
@@ -1063,6 +1083,9 @@ namespace wry {
         w->_term_for_coordinate.set(Coordinate{0, 4}, term_make_opcode(OPCODE_FLIP_FLOP));
         w->_term_for_coordinate.set(Coordinate{-2, -2}, shared_term);
         w->_term_for_coordinate.set(Coordinate{7, 7}, term_make_string_with("hello save"));
+        // Made separately; interning makes it the same object, so the
+        // string is emitted once
+        w->_term_for_coordinate.set(Coordinate{7, 8}, term_make_string_with("hello save"));
 
         // Terrain patch spanning positive and negative coordinates, plus a
         // waiter on a terrain cell (an entity waiting on a terrain change),
@@ -1093,6 +1116,18 @@ namespace wry {
         World* w2 = test_load_from_buffer(b1);
         assert(w2);
 
+        {
+            std::string_view needle = "hello save";
+            std::string_view haystack((const char*)b1.data(), b1.size());
+            size_t first = haystack.find(needle);
+            assert(first != std::string_view::npos);
+            assert(haystack.find(needle, first + 1) == std::string_view::npos);
+            Term s1, s2;
+            assert(w2->_term_for_coordinate.try_get(Coordinate{7, 7}, s1));
+            assert(w2->_term_for_coordinate.try_get(Coordinate{7, 8}, s2));
+            assert(s1._data == s2._data);
+        }
+
         // Maps / terms / entities / wait set: targeted semantic checks.
         assert(w2->_time == w->_time);
 
@@ -8,19 +8,24 @@
 //  snapshot; load is the latency-critical path.
 //
 //  This is v1 sketch quality: in-memory buffers, no zstd, no schema-version
-//  handshake, no incremental save.  All deferrable; the shape is the point.
+//  handshake.  All deferrable; the shape is the point.  Incremental saves
+//  (SaveJournal, save.hpp) reuse the record format: a delta is the records
+//  of the objects that the previous saves did not reach, and refers to the
+//  ones they did by their earlier SaveRefs.
 //
 
 #ifndef save_format_hpp
 #define save_format_hpp
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <utility>
 #include <vector>
-#include <unordered_map>
 
 #include "stdint.hpp"
 #include "save_types.hpp"
+#include "swiss_table.hpp"
 
 namespace wry {
 
@@ -62,6 +67,19 @@ namespace wry {
     enum : uint32_t { SAVE_REF_NULL = 0 };
     using SaveRef = uint32_t;
 
+    // ---------------------------------------------------------------------
+    // SaveSink: optional destination for a streaming save.  The Saver hands
+    // over completed stream bytes as the walk proceeds, so writing overlaps
+    // serialization, and forwards later patches (the record count, cycle
+    // back-edges) that land in bytes already handed over.
+    // ---------------------------------------------------------------------
+
+    struct SaveSink {
+        virtual ~SaveSink() = default;
+        virtual void append(std::vector<uint8_t>&& bytes) = 0;
+        virtual void patch(size_t offset, const void* data, size_t count) = 0;
+    };
+
     // ---------------------------------------------------------------------
     // Saver: emits records to a growing byte buffer.  Mutator never touches
     // this; the saver thread holds a frozen snapshot root and walks it.
@@ -69,10 +87,23 @@ namespace wry {
 
     struct Saver {
 
+        // With a sink, _stream holds only the unspilled tail, which starts
+        // at file offset _spilled; offsets elsewhere are file offsets.
+        static constexpr size_t SPILL_SIZE = size_t{1} << 20;
+
         std::vector<uint8_t> _stream;
-        std::unordered_map<const void*, SaveRef> _seen;
+        SaveSink* _Nullable _sink = nullptr;
+        size_t _spilled = 0;
+        SwissTable<const void*, SaveRef> _seen;    // every record visits it
         SaveRef _next_ref = 1;  // 0 reserved for null
 
+        // Objects built for the save itself (the World's merged time wheel)
+        // that its records reference but nothing else keeps alive.  A
+        // journal carries _seen into the next save, so it must keep these
+        // alive too, or a later allocation at the same address would be
+        // mistaken for them.
+        std::vector<const GarbageCollected*> _transients;
+
         // Pending back-edges: when a cycle is detected mid-walk, the saver
         // emits a placeholder and records (offset, target_ptr).  Offsets in
         // an OpenRecord are body-relative and translated to stream offsets
@@ -133,9 +164,37 @@ namespace wry {
             write_u32(r);
         }
 
+        size_t stream_offset() const {
+            return _spilled + _stream.size();
+        }
+
+        // Overwrite bytes already in the stream, wherever they now are
+        void patch_stream(size_t offset, const void* data, size_t n) {
+            const uint8_t* p = (const uint8_t*)data;
+            if (offset < _spilled) {
+                size_t m = std::min(n, _spilled - offset);
+                assert(_sink);
+                _sink->patch(offset, p, m);
+                offset += m;
+                p += m;
+                n -= m;
+            }
+            if (n)
+                std::memcpy(_stream.data() + (offset - _spilled), p, n);
+        }
+
+        // Hand the stream so far to the sink, if any
+        void spill_stream() {
+            if (!_sink || _stream.empty())
+                return;
+            _spilled += _stream.size();
+            _sink->append(std::exchange(_stream, {}));
+            _stream.reserve(SPILL_SIZE);
+        }
+
         void record_back_edge(const void* target) {
             if (_open.empty()) {
-                _pending.push_back({ _stream.size(), target });
+                _pending.push_back({ stream_offset(), target });
             } else {
                 _open.back().pending.push_back({ _open.back().body.size(), target });
             }
@@ -176,10 +235,12 @@ namespace wry {
             uint32_t body_len = (uint32_t)r.body.size();
             const uint8_t* p = (const uint8_t*)&body_len;
             _stream.insert(_stream.end(), p, p + sizeof(uint32_t));
-            size_t body_start = _stream.size();
+            size_t body_start = stream_offset();
             _stream.insert(_stream.end(), r.body.begin(), r.body.end());
             for (const Pending& q : r.pending)
                 _pending.push_back({ body_start + q.offset, q.target });
+            if (_sink && (_stream.size() >= SPILL_SIZE))
+                spill_stream();
         }
 
         // Top-level: walk the World snapshot, returning the SaveRef of the
@@ -255,6 +316,16 @@ namespace wry {
         // Drive the load.  Returns the World root.
         World* load_world();
 
+        // Continue a load with one journal segment (see SaveJournal):
+        // [first SaveRef u32] [record_count u32] records [root SaveRef u32],
+        // whose records take the ids following those already loaded and
+        // may refer to any of them.  Returns the segment's World root, or
+        // null if the segment does not follow on.
+        World* load_journal_segment();
+
+        // Read `count` records, the first of which has id `first`
+        void _load_records(SaveRef first, uint32_t count);
+
         // After the main pass, patch any forward refs (empty in DAG case).
         void resolve_fixups();
 
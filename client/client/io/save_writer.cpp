@@ -0,0 +1,413 @@
+//
+//  save_writer.cpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#include "save_writer.hpp"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <random>
+#include <utility>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "test.hpp"
+
+namespace wry {
+
+    // A minimal io_uring, driven directly through the system calls.  One
+    // thread submits and reaps, so the only shared words are the kernel's
+    // ends of the rings.
+
+    struct SaveFileWriter::Ring {
+
+        int _fd = -1;
+        void* _sq_pointer = MAP_FAILED;
+        size_t _sq_size = 0;
+        void* _cq_pointer = MAP_FAILED;
+        size_t _cq_size = 0;
+        io_uring_sqe* _sqes = (io_uring_sqe*)MAP_FAILED;
+        size_t _sqes_size = 0;
+
+        unsigned* _sq_head;
+        unsigned* _sq_tail;
+        unsigned* _sq_array;
+        unsigned _sq_mask;
+        unsigned _sq_entries;
+        unsigned _to_submit = 0;
+
+        unsigned* _cq_head;
+        unsigned* _cq_tail;
+        io_uring_cqe* _cqes;
+        unsigned _cq_mask;
+
+        // Null if the kernel lacks io_uring or any opcode we need
+        static Ring* _Nullable make(unsigned entries) {
+            Ring* ring = new Ring;
+            if (!ring->_setup(entries)) {
+                delete ring;
+                return nullptr;
+            }
+            return ring;
+        }
+
+        ~Ring() {
+            if (_sqes != MAP_FAILED)
+                munmap(_sqes, _sqes_size);
+            if ((_cq_pointer != MAP_FAILED) && (_cq_pointer != _sq_pointer))
+                munmap(_cq_pointer, _cq_size);
+            if (_sq_pointer != MAP_FAILED)
+                munmap(_sq_pointer, _sq_size);
+            if (_fd >= 0)
+                close(_fd);
+        }
+
+        bool _setup(unsigned entries) {
+            io_uring_params params = {};
+            _fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+            if (_fd < 0)
+                return false;
+            _sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool is_single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+            if (is_single_mmap)
+                _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+            _sq_pointer = mmap(nullptr, _sq_size, PROT_READ | PROT_WRITE,
+                               MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+            if (_sq_pointer == MAP_FAILED)
+                return false;
+            _cq_pointer = is_single_mmap
+                ? _sq_pointer
+                : mmap(nullptr, _cq_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+            if (_cq_pointer == MAP_FAILED)
+                return false;
+            _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            _sqes = (io_uring_sqe*)mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+            if (_sqes == MAP_FAILED)
+                return false;
+            auto* sq = (unsigned char*)_sq_pointer;
+            _sq_head = (unsigned*)(sq + params.sq_off.head);
+            _sq_tail = (unsigned*)(sq + params.sq_off.tail);
+            _sq_array = (unsigned*)(sq + params.sq_off.array);
+            _sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+            _sq_entries = params.sq_entries;
+            auto* cq = (unsigned char*)_cq_pointer;
+            _cq_head = (unsigned*)(cq + params.cq_off.head);
+            _cq_tail = (unsigned*)(cq + params.cq_off.tail);
+            _cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+            _cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+            return _supports({IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_CLOSE});
+        }
+
+        bool _supports(std::initializer_list<int> opcodes) {
+            constexpr int N = 256;
+            alignas(io_uring_probe) unsigned char buffer[sizeof(io_uring_probe) + N * sizeof(io_uring_probe_op)] = {};
+            auto* probe = (io_uring_probe*)buffer;
+            if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PROBE, probe, N) < 0)
+                return false;
+            for (int opcode : opcodes)
+                if ((opcode > probe->last_op) || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+                    return false;
+            return true;
+        }
+
+        // The caller fills the entry before the next get or submit
+        [[nodiscard]] io_uring_sqe* _Nonnull get() {
+            unsigned tail = *_sq_tail;
+            if (tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) == _sq_entries)
+                submit(0);
+            unsigned index = tail & _sq_mask;
+            io_uring_sqe* sqe = _sqes + index;
+            std::memset(sqe, 0, sizeof(io_uring_sqe));
+            _sq_array[index] = index;
+            __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+            ++_to_submit;
+            return sqe;
+        }
+
+        // Submit everything queued, and wait until at least `wait_count`
+        // completions are available
+        void submit(unsigned wait_count) {
+            for (;;) {
+                long result = syscall(__NR_io_uring_enter, _fd, _to_submit, wait_count,
+                                      wait_count ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+                if (result >= 0) {
+                    _to_submit -= (unsigned)result;
+                    if (!_to_submit || wait_count)
+                        return;
+                } else if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+                    perror("io_uring_enter");
+                    abort();
+                }
+            }
+        }
+
+        [[nodiscard]] bool try_pop(io_uring_cqe& cqe) {
+            unsigned head = *_cq_head;
+            if (head == __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE))
+                return false;
+            cqe = _cqes[head & _cq_mask];
+            __atomic_store_n(_cq_head, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        io_uring_cqe pop() {
+            io_uring_cqe cqe = {};
+            while (!try_pop(cqe))
+                submit(1);
+            return cqe;
+        }
+
+    }; // struct SaveFileWriter::Ring
+
+    namespace {
+
+        // user_data for the finishing chain; appends use their slot index
+        enum : uint64_t {
+            _SAVE_WRITER_FSYNC = 0x100,
+            _SAVE_WRITER_CLOSE,
+        };
+
+        bool _pwrite_all(int fd, const uint8_t* data, size_t n, size_t offset) {
+            for (size_t done = 0; done < n; ) {
+                ssize_t w = ::pwrite(fd, data + done, n - done, (off_t)(offset + done));
+                if (w < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    return false;
+                }
+                done += (size_t)w;
+            }
+            return true;
+        }
+
+    } // namespace
+
+    SaveFileWriter::SaveFileWriter(int fd)
+    : _fd(fd)
+    , _ring(Ring::make(2 * DEPTH)) {
+    }
+
+    SaveFileWriter::~SaveFileWriter() {
+        if (_ring)
+            while (_in_flight)
+                _complete_one();
+        abandon();
+        delete _ring;
+    }
+
+    void SaveFileWriter::_submit_write(unsigned index) {
+        Slot& slot = _slots[index];
+        io_uring_sqe* sqe = _ring->get();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = _fd;
+        sqe->addr = (uint64_t)(slot.bytes.data() + slot.done);
+        sqe->len = (uint32_t)(slot.bytes.size() - slot.done);
+        sqe->off = slot.offset + slot.done;
+        sqe->user_data = index;
+        _ring->submit(0);
+    }
+
+    void SaveFileWriter::_complete_one() {
+        io_uring_cqe cqe = _ring->pop();
+        assert(cqe.user_data < DEPTH);
+        Slot& slot = _slots[cqe.user_data];
+        if (cqe.res <= 0) {
+            _ok = false;
+        } else {
+            slot.done += (size_t)cqe.res;
+            if (slot.done < slot.bytes.size()) {
+                // Short write; send the rest
+                _submit_write((unsigned)cqe.user_data);
+                return;
+            }
+        }
+        slot.in_use = false;
+        slot.bytes = {};
+        --_in_flight;
+    }
+
+    void SaveFileWriter::append(std::vector<uint8_t>&& bytes) {
+        size_t offset = std::exchange(_offset, _offset + bytes.size());
+        if (!_ok || bytes.empty())
+            return;
+        if (!_ring) {
+            _ok = _pwrite_all(_fd, bytes.data(), bytes.size(), offset);
+            return;
+        }
+        while (_in_flight == DEPTH)
+            _complete_one();
+        unsigned index = 0;
+        while (_slots[index].in_use)
+            ++index;
+        _slots[index] = Slot{std::move(bytes), offset, 0, true};
+        ++_in_flight;
+        _submit_write(index);
+    }
+
+    void SaveFileWriter::patch(size_t offset, const void* data, size_t count) {
+        assert(offset + count <= _offset);
+        auto* p = (const uint8_t*)data;
+        _patches.push_back(Patch{offset, std::vector<uint8_t>(p, p + count)});
+    }
+
+    bool SaveFileWriter::drain() {
+        if (_ring)
+            while (_in_flight)
+                _complete_one();
+        return _ok;
+    }
+
+    void SaveFileWriter::abandon() {
+        if (!_is_closed) {
+            close(_fd);
+            _is_closed = true;
+        }
+    }
+
+    bool SaveFileWriter::_finish_synchronously() {
+        bool ok = _ok;
+        for (const Patch& patch : _patches)
+            ok = ok && _pwrite_all(_fd, patch.bytes.data(), patch.bytes.size(), patch.offset);
+        ok = ok && !fsync(_fd);
+        ok = !close(_fd) && ok;
+        _is_closed = true;
+        return ok;
+    }
+
+    bool SaveFileWriter::finish() {
+        if (!drain()) {
+            abandon();
+            return false;
+        }
+        if (!_ring)
+            return _finish_synchronously();
+        // Appends are complete, so patches cannot be overtaken.  They are a
+        // few bytes into the page cache, not worth a link each.
+        for (const Patch& patch : _patches) {
+            if (!_pwrite_all(_fd, patch.bytes.data(), patch.bytes.size(), patch.offset)) {
+                abandon();
+                return false;
+            }
+        }
+        io_uring_sqe* sqe = _ring->get();
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->fd = _fd;
+        sqe->user_data = _SAVE_WRITER_FSYNC;
+        sqe = _ring->get();
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = _fd;
+        sqe->user_data = _SAVE_WRITER_CLOSE;
+        _ring->submit(0);
+        bool ok = true;
+        bool is_closed = false;
+        for (int n = 2; n--;) {
+            io_uring_cqe cqe = _ring->pop();
+            if (cqe.user_data == _SAVE_WRITER_CLOSE)
+                is_closed = (cqe.res == 0);
+            ok = ok && (cqe.res == 0);
+        }
+        // A failed fsync cancels the close
+        if (is_closed)
+            _is_closed = true;
+        abandon();
+        return ok;
+    }
+
+
+    // Bytes and patches survive the pipeline, and a failed write fails the
+    // finish.  Then throughput against one blocking write per buffer.
+    define_test("save_writer") {
+        std::filesystem::path directory = std::filesystem::temp_directory_path();
+        std::filesystem::path from = directory / "wry_save_writer.tmp";
+        std::mt19937_64 engine{3};
+        std::vector<uint8_t> expected;
+        for (int i = 0; i != 19; ++i) {
+            std::vector<uint8_t> chunk((engine() % (1 << 20)) + 1);
+            for (uint8_t& b : chunk)
+                b = (uint8_t)engine();
+            expected.insert(expected.end(), chunk.begin(), chunk.end());
+        }
+        auto write_file = [&](SaveFileWriter& writer) {
+            size_t offset = 0;
+            while (offset < expected.size()) {
+                size_t n = std::min<size_t>(Saver::SPILL_SIZE, expected.size() - offset);
+                writer.append(std::vector<uint8_t>(expected.begin() + offset,
+                                                   expected.begin() + offset + n));
+                offset += n;
+            }
+        };
+        {
+            int fd = open(from.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+            assert(fd >= 0);
+            SaveFileWriter writer{fd};
+            write_file(writer);
+            uint32_t magic = 0x57525953;
+            writer.patch(8, &magic, sizeof(magic));
+            std::memcpy(expected.data() + 8, &magic, sizeof(magic));
+            bool ok = writer.finish();
+            assert(ok);
+            std::vector<uint8_t> actual(std::filesystem::file_size(from));
+            int rd = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+            assert(rd >= 0);
+            assert(read(rd, actual.data(), actual.size()) == (ssize_t)actual.size());
+            close(rd);
+            assert(actual == expected);
+            std::filesystem::remove(from);
+        }
+        {
+            // A write to a read-only fd fails
+            int fd = open(from.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+            assert(fd >= 0);
+            close(fd);
+            fd = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+            SaveFileWriter writer{fd};
+            write_file(writer);
+            bool ok = writer.finish();
+            assert(!ok);
+            std::filesystem::remove(from);
+        }
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            int fd = open(from.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+            SaveFileWriter writer{fd};
+            write_file(writer);
+            bool ok = writer.finish();
+            assert(ok);
+            auto t1 = std::chrono::steady_clock::now();
+            fd = open(from.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0644);
+            ok = _pwrite_all(fd, expected.data(), expected.size(), 0) && !fsync(fd);
+            close(fd);
+            assert(ok);
+            auto t2 = std::chrono::steady_clock::now();
+            double megabytes = (double)expected.size() / (1 << 20);
+            printf("save writer (%s): %.0f MB/s, blocking: %.0f MB/s\n",
+                   writer.is_pipelined() ? "io_uring" : "pwrite",
+                   megabytes / std::chrono::duration<double>(t1 - t0).count(),
+                   megabytes / std::chrono::duration<double>(t2 - t1).count());
+            std::filesystem::remove(from);
+        }
+        co_return;
+    };
+
+} // namespace wry
+
+#endif // defined(__linux__)
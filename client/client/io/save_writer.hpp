@@ -0,0 +1,95 @@
+//
+//  save_writer.hpp
+//  client
+//
+//  Created by Antony Searle on 18/10/2026.
+//
+
+#ifndef save_writer_hpp
+#define save_writer_hpp
+
+#if defined(__linux__)
+
+#include <filesystem>
+#include <vector>
+
+#include "save_format.hpp"
+
+namespace wry {
+
+    // Pipelined writer for one save file
+    //
+    // Appended buffers are written through an io_uring with up to DEPTH in
+    // flight, so the Saver serializes the next buffer while the disk takes
+    // the last, and only waits when the disk falls DEPTH buffers behind.
+    // Patches are held back until every append has completed, and then
+    // the file is finished by a linked chain
+    //
+    //     fsync -> close
+    //
+    // in which a failed fsync cancels the close.  Publishing is left to the
+    // caller: the rename belongs under whatever lock picks the name, and
+    // that lock should not be held while the disk flushes.
+    //
+    // Where io_uring is unavailable (old kernel, seccomp, sysctl) the same
+    // sequence runs synchronously with pwrite.
+
+    struct SaveFileWriter : SaveSink {
+
+        static constexpr unsigned DEPTH = 8;
+
+        struct Ring;
+
+        struct Slot {
+            std::vector<uint8_t> bytes;
+            size_t offset;             // file offset of bytes[0]
+            size_t done;               // bytes written so far
+            bool in_use;
+        };
+
+        struct Patch {
+            size_t offset;
+            std::vector<uint8_t> bytes;
+        };
+
+        int _fd;
+        bool _ok = true;
+        bool _is_closed = false;
+        size_t _offset = 0;            // end of appended bytes
+        Ring* _Nullable _ring;
+        Slot _slots[DEPTH] = {};
+        unsigned _in_flight = 0;
+        std::vector<Patch> _patches;
+
+        // Takes ownership of the fd
+        explicit SaveFileWriter(int fd);
+        SaveFileWriter(SaveFileWriter const&) = delete;
+        virtual ~SaveFileWriter() override;
+        SaveFileWriter& operator=(SaveFileWriter const&) = delete;
+
+        virtual void append(std::vector<uint8_t>&& bytes) override;
+        virtual void patch(size_t offset, const void* data, size_t count) override;
+
+        // Wait for every append; false if any failed
+        [[nodiscard]] bool drain();
+
+        // Apply the patches, flush to stable storage and close the fd;
+        // false if any step failed.  The fd is closed either way.
+        [[nodiscard]] bool finish();
+
+        // Close the fd without publishing
+        void abandon();
+
+        [[nodiscard]] bool is_pipelined() const { return _ring; }
+
+        void _submit_write(unsigned index);
+        void _complete_one();
+        [[nodiscard]] bool _finish_synchronously();
+
+    }; // struct SaveFileWriter
+
+} // namespace wry
+
+#endif // defined(__linux__)
+
+#endif /* save_writer_hpp */
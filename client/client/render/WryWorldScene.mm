@@ -10,6 +10,7 @@
 
 #include <algorithm>
 #include <bit>
+#include <memory>
 #include <random>
 
 #include <MetalKit/MetalKit.h>
@@ -129,12 +130,15 @@
     id<MTLTexture> _terrainORM;
 
     // Double-buffered world-map texture (one texel per tile).  The
-    // background builder hands finished pixel buffers to the main thread,
-    // which uploads into the back texture and flips; the front texture was
-    // last written a whole build (~1 s) earlier, far outside any frame
-    // still in flight on the GPU.
+    // background builder hands updates (the changed blocks) to the main
+    // thread, which uploads them into the back texture and flips; the front
+    // texture was last written a whole build (~250 ms) earlier, far outside
+    // any frame still in flight on the GPU.  The back texture misses the
+    // update that went to the front, so that update is kept to replay
+    // first.
     id<MTLTexture> _mapTexture[2];
     int _mapFrontIndex;
+    std::unique_ptr<wry::WorldMap> _mapFrontUpdate;
 
     wry::Table<ulong, simd_float4> _opcode_to_coordinate;
 
@@ -1186,6 +1190,18 @@
     [_cursor set];
 }
 
+-(void)uploadWorldMap:(const wry::WorldMap&)update toTexture:(id<MTLTexture>)texture {
+    using wry::WorldMap;
+    for (size_t k = 0; k != update.blocks.size(); ++k) {
+        NSUInteger x = (NSUInteger)(update.blocks[k] % WorldMap::BLOCKS) * WorldMap::BLOCK;
+        NSUInteger y = (NSUInteger)(update.blocks[k] / WorldMap::BLOCKS) * WorldMap::BLOCK;
+        [texture replaceRegion:MTLRegionMake2D(x, y, WorldMap::BLOCK, WorldMap::BLOCK)
+                   mipmapLevel:0
+                     withBytes:update.block_rgba(k)
+                   bytesPerRow:(NSUInteger)WorldMap::BLOCK * 4];
+    }
+}
+
 // WryScene: the world scene runs until the app quits; no transitions yet.
 - (id<WryScene>)nextScene {
     return nil;
@@ -1220,16 +1236,16 @@
     Root<World*>& new_world = _model->_world_to_render;
     assert(new_world);
 
-    // Adopt a freshly built world map, if the background builder finished
-    // one: upload into the back texture of the double buffer and flip.
+    // Adopt a world-map update, if the background builder finished one:
+    // bring the back texture of the double buffer level with the front,
+    // upload the changed blocks into it, and flip.
     if (wry::WorldMap* built = _model->_map_handoff->take_finished()) {
         int back = _mapFrontIndex ^ 1;
-        [_mapTexture[back] replaceRegion:MTLRegionMake2D(0, 0, wry::WorldMap::EXTENT, wry::WorldMap::EXTENT)
-                             mipmapLevel:0
-                               withBytes:built->rgba.data()
-                             bytesPerRow:(NSUInteger)wry::WorldMap::EXTENT * 4];
+        if (_mapFrontUpdate)
+            [self uploadWorldMap:*_mapFrontUpdate toTexture:_mapTexture[back]];
+        [self uploadWorldMap:*built toTexture:_mapTexture[back]];
         _mapFrontIndex = back;
-        delete built;
+        _mapFrontUpdate.reset(built);
     }
 
     const bool show_map = _model->_show_map;